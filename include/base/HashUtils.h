@@ -17,12 +17,112 @@
 #ifndef INCLUDE_BASE_HASHUTILS_H_
 #define INCLUDE_BASE_HASHUTILS_H_
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #include <string>
 
 namespace QS {
 
 namespace HashUtils {
 
+namespace Internal {
+
+inline uint64_t Read64(const char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t Read32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Same as Mix, multiplying by 32-bit halves for compilers without 128-bit
+// integers
+inline uint64_t MixBy32(uint64_t a, uint64_t b) {
+  uint64_t aLo = a & 0xffffffffULL;
+  uint64_t aHi = a >> 32;
+  uint64_t bLo = b & 0xffffffffULL;
+  uint64_t bHi = b >> 32;
+  uint64_t ll = aLo * bLo;
+  uint64_t lh = aLo * bHi;
+  uint64_t hl = aHi * bLo;
+  uint64_t hh = aHi * bHi;
+  uint64_t mid = (ll >> 32) + (lh & 0xffffffffULL) + (hl & 0xffffffffULL);
+  uint64_t lo = (mid << 32) | (ll & 0xffffffffULL);
+  uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  return lo ^ hi;
+}
+
+// Multiply to 128 bits and fold the halves, which spreads every input bit
+// into all the output bits
+inline uint64_t Mix(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+  return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+  return MixBy32(a, b);
+#endif
+}
+
+}  // namespace Internal
+
+// 64-bit hash of bytes in the way of wyhash, which consumes 16 bytes a step.
+// Paths sharing a long prefix and differing only in the tail still get
+// well distributed hashes.
+inline uint64_t Hash64(const char *data, size_t len) {
+  using Internal::Mix;
+  using Internal::Read32;
+  using Internal::Read64;
+  const uint64_t k0 = 0xa0761d6478bd642fULL;
+  const uint64_t k1 = 0xe7037ed1a0b428dbULL;
+  const uint64_t k2 = 0x8ebc6af09c88c6e3ULL;
+
+  uint64_t h = k0;
+  const char *p = data;
+  size_t n = len;
+  while (n > 16) {
+    h = Mix(Read64(p) ^ k1, Read64(p + 8) ^ h);
+    p += 16;
+    n -= 16;
+  }
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (n >= 8) {
+    a = Read64(p);
+    b = Read64(p + n - 8);
+  } else if (n >= 4) {
+    a = Read32(p);
+    b = Read32(p + n - 4);
+  } else if (n > 0) {
+    a = (static_cast<uint64_t>(static_cast<unsigned char>(p[0])) << 16) |
+        (static_cast<uint64_t>(static_cast<unsigned char>(p[n >> 1])) << 8) |
+        static_cast<uint64_t>(static_cast<unsigned char>(p[n - 1]));
+  }
+  return Mix(k2 ^ len, Mix(a ^ k1, b ^ h));
+}
+
+// 64-bit FNV-1a hash of bytes. Unlike Hash64, its value is fixed by the
+// algorithm alone, so it is safe to persist, e.g. in names of files on disk
+// which are shared among processes and kept across versions.
+inline uint64_t StableHash64(const char *data, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+inline uint64_t StableHash64(const std::string &str) {
+  return StableHash64(str.data(), str.size());
+}
+
 struct EnumHash {
   template <typename T>
   int operator()(T enumValue) const {
@@ -30,17 +130,12 @@ struct EnumHash {
   }
 };
 
+// Notes: operator() is not declared noexcept on purpose, so libstdc++
+// unordered containers cache the hash code in each node and never hash a
+// key again when rehashing or comparing.
 struct StringHash {
-  int operator()(const std::string &strToHash) const {
-    if (strToHash.empty()) {
-      return 0;
-    }
-
-    int hash = 0;
-    for (const auto &charValue : strToHash) {
-      hash = charValue + 31 * hash;
-    }
-    return hash;
+  size_t operator()(const std::string &strToHash) const {
+    return static_cast<size_t>(Hash64(strToHash.data(), strToHash.size()));
   }
 };
 
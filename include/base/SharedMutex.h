@@ -0,0 +1,86 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_BASE_SHAREDMUTEX_H_
+#define INCLUDE_BASE_SHAREDMUTEX_H_
+
+#include <pthread.h>
+
+namespace QS {
+
+namespace Threading {
+
+// A reader-writer mutex, as std::shared_mutex is not available in C++11.
+//
+// lock/unlock take the exclusive ownership, so SharedMutex works with
+// std::lock_guard and std::unique_lock; lock_shared/unlock_shared take the
+// shared ownership, use SharedLock for it.
+//
+// Notes: SharedMutex is not recursive in either mode. Writers are preferred
+// to avoid being starved by a storm of readers, so a thread holding the
+// shared ownership must not acquire it again.
+class SharedMutex {
+ public:
+  SharedMutex() {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(
+        &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&m_rwlock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+  }
+  ~SharedMutex() { pthread_rwlock_destroy(&m_rwlock); }
+
+  SharedMutex(SharedMutex &&) = delete;
+  SharedMutex(const SharedMutex &) = delete;
+  SharedMutex &operator=(SharedMutex &&) = delete;
+  SharedMutex &operator=(const SharedMutex &) = delete;
+
+ public:
+  void lock() { pthread_rwlock_wrlock(&m_rwlock); }
+  void unlock() { pthread_rwlock_unlock(&m_rwlock); }
+  void lock_shared() { pthread_rwlock_rdlock(&m_rwlock); }
+  void unlock_shared() { pthread_rwlock_unlock(&m_rwlock); }
+
+ private:
+  pthread_rwlock_t m_rwlock;
+};
+
+// RAII wrapper holding the shared ownership of a SharedMutex
+class SharedLock {
+ public:
+  explicit SharedLock(SharedMutex &mutex) : m_mutex(mutex) {  // NOLINT
+    m_mutex.lock_shared();
+  }
+  ~SharedLock() { m_mutex.unlock_shared(); }
+
+  SharedLock(SharedLock &&) = delete;
+  SharedLock(const SharedLock &) = delete;
+  SharedLock &operator=(SharedLock &&) = delete;
+  SharedLock &operator=(const SharedLock &) = delete;
+
+ private:
+  SharedMutex &m_mutex;
+};
+
+}  // namespace Threading
+}  // namespace QS
+
+
+#endif  // INCLUDE_BASE_SHAREDMUTEX_H_
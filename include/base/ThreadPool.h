@@ -31,6 +31,10 @@
 
 namespace QS {
 
+namespace Data {
+class ThreadPoolDiskIOEngine;
+}  // namespace Data
+
 namespace Threading {
 
 class TaskHandle;
@@ -107,6 +111,7 @@ class ThreadPool {
   friend class TaskHandle;
   friend class ThreadPoolInitializer;
   friend class ThreadPoolTest;
+  friend class QS::Data::ThreadPoolDiskIOEngine;
 };
 
 template <typename F, typename... Args>
@@ -200,6 +200,15 @@ class Client {
                                     time_t modifiedSince = 0,
                                     bool *modified = nullptr) = 0;
 
+  // Get meta data of a file or a directory
+  //
+  // @param  : path
+  // @return : ClientError
+  //
+  // Lookup resolves whether the path is a file, a directory (with or without
+  // a dir object) or not existing, and grows the dir tree with the found node.
+  virtual ClientError<QSError> Lookup(const std::string &path) = 0;
+
   // Get information about mounted bucket
   //
   // @param  : stvfs(output)
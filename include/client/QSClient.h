@@ -190,6 +190,17 @@ class QSClient : public Client {
   ClientError<QSError> Stat(const std::string &path, time_t modifiedSince = 0,
                             bool *modified = nullptr) override;
 
+  // Get meta data of a file or a directory
+  //
+  // @param  : path
+  // @return : ClientError
+  //
+  // Lookup heads the object of path and lists the prefix of path appended
+  // with "/" concurrently, so it tells a file, a dir with or without a dir
+  // object, or a missing path within one round trip. The dir node grown into
+  // the dir tree is of path appended with "/".
+  ClientError<QSError> Lookup(const std::string &path) override;
+
   // Get information about mounted bucket
   //
   // @param  : *stvfs(output)
@@ -35,6 +35,7 @@ const char* GetProgramName();
 
 std::string GetDefaultCredentialsFile();
 std::string GetDefaultDiskCacheDirectory();
+std::string GetDiskCacheIndexFileName();  // index of kept disk cache files
 std::string GetDefaultLogDirectory();
 std::string GetDefaultLogLevelName();
 uint16_t    GetDefaultMaxRetries();
@@ -56,7 +57,14 @@ uint16_t GetFragmentSize();
 blkcnt_t GetBlocks(off_t size);  // Number of 512B blocks allocated
 
 uint64_t GetMaxCacheSize();      // File data cache size in bytes
+uint64_t GetMaxDiskCacheSize();  // Disk tier size in bytes, 0 if disabled
+uint64_t GetMaxSharedCacheSize();  // Shared cache size in bytes
+uint64_t GetDiskCacheBlockSize();  // Block size of disk cache index bitmap
+uint64_t GetMaxPageExtentSize();   // Max size of a page merged from pages
+uint16_t GetDefaultDirtyRatio();  // Dirty bytes limit in percent of cache
+uint16_t GetDefaultDirtyBackgroundRatio();  // Writeback threshold in percent
 size_t GetMaxStatCount();        // File meta data cache max count
+uint32_t GetDefaultNegativeExpireInSec();  // Expire time of not existing paths
 uint16_t GetMaxListObjectsCount();  // max count for list operation
 
 int GetQSConnectionDefaultRetries();
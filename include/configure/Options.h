@@ -66,10 +66,30 @@ class Options {
   uint16_t GetRetries() const { return m_retries; }
   uint32_t GetRequestTimeOut() const { return m_requestTimeOut; }
   uint32_t GetMaxCacheSizeInMB() const { return m_maxCacheSizeInMB; }
+  uint32_t GetMaxDiskCacheSizeInMB() const { return m_maxDiskCacheSizeInMB; }
   const std::string GetDiskCacheDirectory() const { return m_diskCacheDir; }
+  bool IsKeepDiskCache() const { return m_keepDiskCache; }
+  bool IsDiskDirectIO() const { return m_diskDirectIO; }
+  bool IsCompressCache() const { return m_compressCache; }
+  bool IsAdmissionFilter() const { return m_admissionFilter; }
+  bool IsMemoryPressure() const { return m_memoryPressure; }
+  const std::string GetCachePolicyFile() const { return m_cachePolicyFile; }
+  const std::string GetSharedCacheDirectory() const {
+    return m_sharedCacheDir;
+  }
+  uint32_t GetMaxSharedCacheSizeInMB() const {
+    return m_maxSharedCacheSizeInMB;
+  }
+  const std::string GetAccessLogFile() const { return m_accessLogFile; }
+  uint32_t GetWarmUpCount() const { return m_warmUpCount; }
+  uint32_t GetFileQuota() const { return m_fileQuota; }
+  bool IsFileQuotaInPercent() const { return m_fileQuotaInPercent; }
+  uint16_t GetDirtyRatio() const { return m_dirtyRatio; }
+  uint16_t GetDirtyBackgroundRatio() const { return m_dirtyBackgroundRatio; }
   uint32_t GetMaxStatCountInK() const { return m_maxStatCountInK; }
   int32_t GetMaxListCount() const { return m_maxListCount; }
   int32_t GetStatExpireInMin() const { return m_statExpireInMin; }
+  uint32_t GetNegativeExpireInSec() const { return m_negativeExpireInSec; }
   uint16_t GetParallelTransfers() const { return m_parallelTransfers; }
   uint32_t GetTransferBufferSizeInMB() const {
     return m_transferBufferSizeInMB;
@@ -107,7 +127,30 @@ class Options {
   void SetMaxCacheSizeInMB(uint32_t maxcache) {
     m_maxCacheSizeInMB = maxcache;
   }
+  void SetMaxDiskCacheSizeInMB(uint32_t maxdiskcache) {
+    m_maxDiskCacheSizeInMB = maxdiskcache;
+  }
   void SetDiskCacheDirectory(const char *diskdir) { m_diskCacheDir = diskdir; }
+  void SetKeepDiskCache(bool keepcache) { m_keepDiskCache = keepcache; }
+  void SetDiskDirectIO(bool directio) { m_diskDirectIO = directio; }
+  void SetCompressCache(bool compress) { m_compressCache = compress; }
+  void SetAdmissionFilter(bool admission) { m_admissionFilter = admission; }
+  void SetMemoryPressure(bool mempressure) { m_memoryPressure = mempressure; }
+  void SetCachePolicyFile(const char *file) { m_cachePolicyFile = file; }
+  void SetSharedCacheDirectory(const char *dir) { m_sharedCacheDir = dir; }
+  void SetMaxSharedCacheSizeInMB(uint32_t maxsharedcache) {
+    m_maxSharedCacheSizeInMB = maxsharedcache;
+  }
+  void SetAccessLogFile(const char *file) { m_accessLogFile = file; }
+  void SetWarmUpCount(uint32_t warmup) { m_warmUpCount = warmup; }
+  void SetFileQuota(uint32_t quota, bool inPercent) {
+    m_fileQuota = quota;
+    m_fileQuotaInPercent = inPercent;
+  }
+  void SetDirtyRatio(unsigned ratio) { m_dirtyRatio = ratio; }
+  void SetDirtyBackgroundRatio(unsigned ratio) {
+    m_dirtyBackgroundRatio = ratio;
+  }
   void SetMaxStatCountInK(uint32_t maxstat) {
     m_maxStatCountInK = maxstat;
   }
@@ -115,6 +158,9 @@ class Options {
     m_maxListCount = maxlist;
   }
   void SetStatExpireInMin(int32_t expire) { m_statExpireInMin = expire; }
+  void SetNegativeExpireInSec(uint32_t expire) {
+    m_negativeExpireInSec = expire;
+  }
   void SetParallelTransfers(unsigned numtransfers) {
     m_parallelTransfers = numtransfers;
   }
@@ -152,10 +198,26 @@ class Options {
   uint16_t m_retries;
   uint32_t m_requestTimeOut;  // in milliseconds
   uint32_t m_maxCacheSizeInMB;
+  uint32_t m_maxDiskCacheSizeInMB;  // 0 if disk tier is disabled
   std::string m_diskCacheDir;
+  bool m_keepDiskCache;  // keep disk cache files across mounts
+  bool m_diskDirectIO;   // open disk cache files with O_DIRECT
+  bool m_compressCache;  // compress cold pages before spilling to disk
+  bool m_admissionFilter;  // admit files into full cache by frequency
+  bool m_memoryPressure;  // shrink cache under cgroup memory pressure
+  std::string m_cachePolicyFile;  // path pattern rules, empty if no rules
+  std::string m_sharedCacheDir;  // shared by processes, empty if disabled
+  uint32_t m_maxSharedCacheSizeInMB;
+  std::string m_accessLogFile;  // access history, empty if disabled
+  uint32_t m_warmUpCount;  // num of hottest files to prefetch at mount
+  uint32_t m_fileQuota;  // max cache size of a file, in MB or percent
+  bool m_fileQuotaInPercent;  // file quota is percent of cache size
+  uint16_t m_dirtyRatio;  // throttle writers above it, percent of cache
+  uint16_t m_dirtyBackgroundRatio;  // start writeback above it, in percent
   uint32_t m_maxStatCountInK;
   int32_t m_maxListCount;  // negative value will list all files for ls
   int32_t m_statExpireInMin;  //  negative value will disable state expire
+  uint32_t m_negativeExpireInSec;  // 0 will disable negative lookup cache
   uint16_t m_parallelTransfers;  // count of file transfers in parallel
   uint32_t m_transferBufferSizeInMB;
   uint16_t m_clientPoolSize;
@@ -0,0 +1,121 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_DATA_ACCESSHISTORY_H_
+#define INCLUDE_DATA_ACCESSHISTORY_H_
+
+#include <stddef.h>  // for size_t
+#include <time.h>
+
+#include <sys/types.h>  // for off_t
+
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/HashUtils.h"
+
+namespace QS {
+
+namespace Data {
+
+// Record of the accesses of an object
+struct AccessRecord {
+  std::string path;
+  double heat = 0;   // num of accesses, decayed by time
+  time_t time = 0;   // time of last access
+  off_t offset = 0;  // range accessed is [offset, offset + size)
+  size_t size = 0;
+};
+
+// History of object accesses, kept across mounts to warm up cache
+//
+// The history file contains one record per line, in the form of
+//   <heat> <time> <offset> <size> <path>
+// The heat of a record halves every hour without access, and the range of
+// a record covers all the ranges accessed. Thread safe.
+class AccessHistory {
+ public:
+  // @param  : history file path, max num of records
+  AccessHistory(const std::string &file, size_t maxNumRecords);
+
+  AccessHistory(AccessHistory &&) = delete;
+  AccessHistory(const AccessHistory &) = delete;
+  AccessHistory &operator=(AccessHistory &&) = delete;
+  AccessHistory &operator=(const AccessHistory &) = delete;
+  ~AccessHistory() = default;
+
+ public:
+  // Load records from history file
+  //
+  // @param  : void
+  // @return : bool
+  //
+  // Invalid lines are skipped.
+  bool Load();
+
+  // Save records into history file
+  //
+  // @param  : void
+  // @return : bool
+  //
+  // The file is written from a copy of the records, without blocking Record.
+  bool Save();
+
+  // Record an access of an object
+  //
+  // @param  : object path, offset, len of bytes
+  // @return : true if it's time to save records
+  //
+  // Accesses of an object within a second count once. A new object replaces
+  // the coldest one when there are max num of records. Record returns true
+  // at most once a minute, and the caller is supposed to Save in background.
+  bool Record(const std::string &path, off_t offset, size_t len);
+
+  // Get the hottest records
+  //
+  // @param  : max num of records
+  // @return : records, hottest first
+  std::vector<AccessRecord> GetHottest(size_t num) const;
+
+  size_t GetNumRecords() const;
+
+ private:
+  // Write records into history file, without locking records
+  bool SaveRecords(const std::vector<AccessRecord> &records, time_t now);
+
+  // Keep the hottest records, no more than max num of records
+  void UnguardedPrune(time_t now);
+
+  // Remove the coldest record
+  void UnguardedRemoveColdest(time_t now);
+
+ private:
+  std::string m_file;
+  size_t m_maxNumRecords = 0;
+  time_t m_savedTime = 0;  // time of last saving
+  std::unordered_map<std::string, AccessRecord, HashUtils::StringHash>
+      m_records;
+  mutable std::mutex m_mutex;
+  std::mutex m_saveMutex;  // serialize writing of history file
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_ACCESSHISTORY_H_
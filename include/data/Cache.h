@@ -22,15 +22,22 @@
 
 #include <sys/types.h>  // for off_t
 
+#include <atomic>  // NOLINT
 #include <iostream>
 #include <list>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "base/HashUtils.h"
+#include "data/CachePolicy.h"
+#include "data/DiskCacheIndex.h"
 #include "data/File.h"
+#include "data/FrequencySketch.h"
+#include "data/MemoryPressure.h"
 #include "data/Page.h"
 
 namespace QS {
@@ -51,10 +58,14 @@ using CacheListIterator = CacheList::iterator;
 using CacheListConstIterator = CacheList::const_iterator;
 using FileIdToCacheListIteratorMap =
     std::unordered_map<std::string, CacheListIterator, HashUtils::StringHash>;
+// Map of the object content, identified by etag and size, to a file id
+using ETagToFileIdMap =
+    std::unordered_map<std::string, std::string, HashUtils::StringHash>;
 
 class Cache {
  public:
-  explicit Cache(uint64_t capacity) : m_capacity(capacity) {}
+  explicit Cache(uint64_t capacity, uint64_t diskCapacity = 0)
+      : m_capacity(capacity), m_diskCapacity(diskCapacity) {}
   Cache(Cache &&) = default;
   Cache(const Cache &) = delete;
   Cache &operator=(Cache &&) = default;
@@ -71,6 +82,18 @@ class Cache {
   // then there is no avaiable needSize space.
   bool HasFreeSpace(size_t needSize) const;  // size in byte
 
+  // Has available free space in disk tier
+  //
+  // @param  : disk folder path, need size
+  // @return : bool
+  //
+  // The disk space is limited by the disk tier capacity if it's enabled, and
+  // by the free space of the disk where the disk folder is located. To avoid
+  // a statvfs on every write, the free space of the disk is estimated by the
+  // bytes added into disk cache since it's checked, and it's checked again
+  // only every few seconds.
+  bool HasFreeDiskSpace(const std::string &diskfolder, size_t needSize) const;
+
   // Is the last file in cache open
   //
   // @param  : void
@@ -109,9 +132,97 @@ class Cache {
   // Get cache Capacity
   uint64_t GetCapacity() const { return m_capacity; }
 
+  // Get size of bytes stored in disk file, i.e. the size of disk tier
+  uint64_t GetDiskSize() const { return m_diskSize; }
+
+  // Get disk tier capacity, 0 if disk tier is disabled
+  uint64_t GetDiskCapacity() const { return m_diskCapacity; }
+
+  // Get size of bytes modified locally and not uploaded yet, including the
+  // bytes in disk file
+  uint64_t GetDirtySize() const { return m_dirtySize.load(); }
+
+  // Get dirty files to write back
+  //
+  // @param  : size of dirty bytes to write back, file excluded
+  // @return : file ids, least recently used first
+  //
+  // The least recently used dirty files are collected until their dirty
+  // bytes sum up to the given size.
+  std::vector<std::string> GetDirtyFiles(uint64_t size,
+                                         const std::string &fileExcluded) const;
+
+  // Make the capacity elastic under memory pressure
+  //
+  // @param  : memory pressure watcher
+  // @return : void
+  //
+  // The capacity given at construction becomes the max capacity. The
+  // capacity is adapted to the memory status at most once a second, and
+  // the least recently used files are discarded when the capacity shrinks.
+  void SetMemoryPressure(std::unique_ptr<MemoryPressure> memoryPressure);
+
+  // Set cache policy of path pattern rules
+  //
+  // @param  : cache policy
+  // @return : void
+  //
+  // The matching rule is applied to a file when it's added into cache or
+  // renamed. Pinned files are never discarded, demoted or compressed.
+  void SetCachePolicy(std::unique_ptr<CachePolicy> cachePolicy);
+
+  // Get the cache policy rule matching the file
+  CacheRule GetCacheRule(const std::string &fileId) const;
+
+  // Set max size of a file in cache
+  //
+  // @param  : quota, flag whether quota is percent of capacity
+  // @return : void
+  //
+  // A file growing beyond the quota discards its own least recently
+  // accessed pages instead of the other files. Pinned files and files of
+  // disk tier are not limited. Quota of 0 means no limit.
+  void SetFileQuota(uint64_t quota, bool inPercent = false);
+
+  // Get max size of a file in cache in bytes, 0 if no limit
+  uint64_t GetFileQuota() const;
+
+  // Filter the files admitted into cache by access frequency (TinyLFU)
+  //
+  // @param  : frequency sketch
+  // @return : void
+  void SetFrequencySketch(std::unique_ptr<FrequencySketch> sketch);
+
+  // Record an access of file for the admission filter
+  void RecordAccess(const std::string &fileId);
+
+  // Whether to admit the content of a file not in cache
+  //
+  // @param  : file id, size of content to add
+  // @return : bool
+  //
+  // Content is always admitted if there is no frequency sketch, the file
+  // is in cache already or there is free space. Otherwise it's admitted
+  // only if the file is accessed more frequently than the least recently
+  // used file which would be discarded for it; a file not admitted should
+  // be read through without caching.
+  bool Admit(const std::string &fileId, size_t size) const;
+
+  // Get size of bytes read from each tier of cache
+  const CacheTierStats &GetTierStats() const { return m_tierStats; }
+
+  // Get hit ratio of each tier of cache, in a printable string
+  std::string GetTierHitRatios() const;
+
   // Get file mtime
   time_t GetTime(const std::string &fileId) const;
 
+  // Get etag of the object which file content belongs to
+  std::string GetETag(const std::string &fileId) const;
+
+  // Get generation of local modifications of file, 0 if file not exists
+  uint64_t GetDirtyGeneration(const std::string &fileId) const;
+
   // Get file size
   uint64_t GetFileSize(const std::string &filePath) const;
 
@@ -138,16 +249,44 @@ class Cache {
                                             char *buffer,
                                             time_t mtimeSince = 0);
 
+  // Read file cache into a buffer
+  //
+  // @param  : file path, offset, len, buffer, modified time since from,
+  //           unloaded ranges (could be null)
+  // @return : size of bytes have been writen to buffer
+  //
+  // The bytes are copied from pages into the buffer directly, bytes not
+  // present are zeroed. It does not allocate when unloaded ranges is null,
+  // which makes it suitable for serving the FUSE read.
+  size_t Read(const std::string &fileId, off_t offset, size_t len,
+              char *buffer, time_t mtimeSince,
+              ContentRangeDeque *unloadedRanges);
+
+  // Get slices of file cache for zero-copy consumers
+  //
+  // @param  : file path, offset, len, slices, modified time since from
+  // @return : size of bytes in the slices, not including holes
+  //
+  // Slices are appended into the given vector, they refer to the bytes in
+  // memory or in disk file directly (e.g. to build a fuse_bufvec), and are
+  // valid only until the file cache is written, resized, erased or moved
+  // between memory and disk tier.
+  size_t ReadSlices(const std::string &fileId, off_t offset, size_t len,
+                    FileSliceVec *slices, time_t mtimeSince = 0);
+
  private:
   // Write a block of bytes into file cache
   //
-  // @param  : file path, file offset, len, buffer, modification time
+  // @param  : file path, file offset, len, buffer, modification time,
+  //           flag of bytes modified locally
   // @return : bool
   //
   // If File of fileId doesn't exist, create one.
   // From pointer of buffer, number of len bytes will be writen.
+  // Bytes modified locally are dirty until the file is set with the etag of
+  // the uploaded object, the dirty files are never discarded from cache.
   bool Write(const std::string &fileId, off_t offset, size_t len,
-             const char *buffer, time_t mtime);
+             const char *buffer, time_t mtime, bool dirty = false);
 
   // Write stream into file cache
   //
@@ -161,29 +300,60 @@ class Cache {
 
   // Prepare for Write
   //
-  // @param  : file id, content data len
+  // @param  : file id, content data offset, content data len
   // @return : {falg of success, pointer to File}
   //
   // internal use only
   std::pair<bool, std::unique_ptr<File> *> PrepareWrite(
-      const std::string &fileId, size_t len, time_t mtime);
+      const std::string &fileId, off_t offset, size_t len, time_t mtime);
+
+  // Keep file within quota
+  //
+  // @param  : file id, content data offset, content data len
+  // @return : void
+  //
+  // Discard the least recently accessed pages of the file to make room for
+  // the content data within the quota.
+  void RecycleOverQuota(const std::string &fileId, off_t offset, size_t len);
 
   // Free cache space
   //
   // @param  : size need to be freed, file should not be freed
   // @return : bool
   //
-  // Discard the least recently used File to make sure
-  // there will be number of size avaiable cache space.
+  // Demote the least recently used Files into disk tier if it's enabled, or
+  // discard them if there is no space in disk tier, to make sure there will
+  // be number of size avaiable cache space.
+  // Open files and dirty files are never discarded.
   bool Free(size_t size, const std::string &fileUnfreeable);  // size in byte
 
-  // Remove disk files used to cache file content
+  // Demote cache files into disk tier
+  //
+  // @param  : size need to be freed, file should not be demoted
+  // @return : bool
+  //
+  // Move the pages in memory of the least recently used Files into disk file
+  // to make sure there will be number of size available cache space. The
+  // disk tier makes space by itself when it's full.
+  bool Demote(size_t size, const std::string &fileUndemotable);
+
+  // Compress cache files
+  //
+  // @param  : size need to be freed, file should not be compressed
+  // @return : bool
+  //
+  // Compress the least recently used Files to make sure there will be
+  // number of size available cache space, before discarding them.
+  bool Compress(size_t size, const std::string &fileUncompressible);
+
+  // Free space of disk tier
   //
   // @param  : disk folder path, size need to be freed, file should not be freed
   // @return : bool
   //
-  // Discard the least recently used File which cache data in disk file to make
-  // sure there will be number of size avaiable disk free space in disk foler.
+  // Remove the pages in disk file of the least recently used File to make
+  // sure there will be number of size avaiable space in disk tier, the pages
+  // in memory are kept. Open files and dirty files are never freed.
   bool FreeDiskCacheFiles(const std::string &diskfolder, size_t size,
                          const std::string &fileUnfreeable);
 
@@ -212,6 +382,81 @@ class Cache {
   // @return : void
   void SetFileOpen(const std::string &fileId, bool open);
 
+  // Change etag of the object which file content belongs to
+  //
+  // @param  : file id, etag, object size
+  // @return : void
+  //
+  // Set an empty etag when file content is modified locally, and a non
+  // empty etag when file content is uploaded, which makes it clean.
+  void SetETag(const std::string &fileId, const std::string &eTag,
+               uint64_t objectSize);
+
+  // Change etag of the object which file content is uploaded to
+  //
+  // @param  : file id, etag, object size, dirty generation of file when
+  //           upload started
+  // @return : true if file is clean now
+  //
+  // The file written during uploading is kept dirty and its etag is not
+  // changed, as its content is newer than the uploaded object.
+  bool SetUploadedETag(const std::string &fileId, const std::string &eTag,
+                       uint64_t objectSize, uint64_t dirtyGeneration);
+
+  // Share the content of a cached file of the same object content
+  //
+  // @param  : file id, etag, object size, file mtime
+  // @return : true if any content is shared
+  //
+  // If a clean file in cache has the same etag and object size, its pages
+  // in memory are shared copy-on-write with the file, instead of
+  // downloading them again. The file should have no content in cache.
+  // Shared pages are counted in cache size once, charged to the file they
+  // are shared from, so sharing takes no cache capacity. The charge moves
+  // to a file sharing them when the others release them.
+  bool ShareContent(const std::string &fileId, const std::string &eTag,
+                    uint64_t objectSize, time_t mtime);
+
+  // Load the index of disk cache files kept from last mount
+  //
+  // @param  : disk folder path
+  // @return : bool
+  //
+  // Kept files are not put into cache until they are adopted.
+  bool LoadDiskCacheIndex(const std::string &diskfolder);
+
+  // Save the index of disk cache files for next mount
+  //
+  // @param  : disk folder path
+  // @return : bool
+  //
+  // Only the content in disk file of files not modified locally is kept,
+  // as well as the kept files not adopted yet. The disk files of kept files
+  // will not be removed when cache is destructed.
+  bool SaveDiskCacheIndex(const std::string &diskfolder);
+
+  // Adopt the disk cache file kept from last mount
+  //
+  // @param  : file id, object etag, object size
+  // @return : bool
+  //
+  // The kept file is put into cache only if it matches with the object's
+  // etag and size, otherwise its disk file is removed.
+  bool AdoptDiskCacheFile(const std::string &fileId, const std::string &eTag,
+                          uint64_t objectSize);
+
+  // Validate file cache against the object's etag and size
+  //
+  // @param  : file id, object etag, object size
+  // @return : false if file cache is out of date and erased
+  //
+  // File content is keyed by the etag and size of the object it belongs to,
+  // so it is only invalidated when the object content really changed, not
+  // when just the object mtime changed. File modified locally has no etag
+  // and is always valid.
+  bool Validate(const std::string &fileId, const std::string &eTag,
+                uint64_t objectSize);
+
   // Resize a file
   //
   // @param  : file id, new file size, mtime
@@ -224,6 +469,15 @@ class Cache {
   CacheListIterator UnguardedNewEmptyFile(const std::string &fileId,
                                           time_t mtime);
 
+  // Remove the kept disk file of fileId which is not adopted yet.
+  void UnguardedDiscardKeptDiskFile(const std::string &fileId);
+
+  // Remove the etag index entry pointing to the file, if any.
+  void UnguardedRemoveETagIndex(const std::string &fileId, const File &file);
+
+  // Charge the files sharing pages for the ones released by the others.
+  void UnguardedChargeSharedPages();
+
   // Erase the file denoted by pos, without checking input.
   CacheListIterator UnguardedErase(FileIdToCacheListIteratorMap::iterator pos);
 
@@ -232,18 +486,63 @@ class Cache {
   CacheListIterator UnguardedMakeFileMostRecentlyUsed(
       CacheListConstIterator pos);
 
+  // Update cache status with the size of pages decompressed when reading.
+  void UnguardedAddDecompressedSize(const std::string &fileId, size_t size);
+
+  // Promote the hot pages of file in disk tier into memory, if disk tier is
+  // enabled and there is space in memory after demoting other files.
+  void UnguardedPromoteHotPages(const std::string &fileId, File *file);
+
+  // Adapt capacity to the memory status if it's elastic.
+  void AdaptCapacity();
+
  private:
   // Record sum of the cache files' size, not including disk file
   uint64_t m_size = 0;
 
+  // Record sum of the cache files' dirty size, including disk file
+  std::atomic<uint64_t> m_dirtySize{0};
+
+  // Record size of bytes read from each tier
+  CacheTierStats m_tierStats;
+
   uint64_t m_capacity = 0;  // in bytes
 
+  // Record sum of the cache files' size in disk file
+  uint64_t m_diskSize = 0;
+
+  uint64_t m_diskCapacity = 0;  // in bytes, 0 if disk tier is disabled
+
+  // Free space of the disk where disk folder is located, and the disk size
+  // of cache, at the time it's checked
+  mutable std::string m_diskSpaceFolder;
+  mutable uint64_t m_diskFreeSpace = 0;
+  mutable uint64_t m_diskSizeWhenChecked = 0;
+  mutable time_t m_diskSpaceCheckedTime = 0;
+
+  uint64_t m_maxCapacity = 0;  // in bytes, used when capacity is elastic
+  std::unique_ptr<MemoryPressure> m_memoryPressure;  // null if not elastic
+  time_t m_capacityAdaptedTime = 0;  // time of last adapting capacity
+  std::unique_ptr<CachePolicy> m_cachePolicy;  // null if no rules
+  std::unique_ptr<FrequencySketch> m_sketch;  // null if admit all
+  uint64_t m_fileQuota = 0;  // in bytes or percent, 0 if no limit
+  bool m_fileQuotaInPercent = false;
+
   // Most recently used File is put at front,
   // Least recently used File is put at back.
   CacheList m_cache;
 
   FileIdToCacheListIteratorMap m_map;
 
+  // Files with clean content of objects, to share the content by etag
+  ETagToFileIdMap m_eTagIndex;
+
+  // Files holding shared pages which are not charged to them
+  std::unordered_set<std::string, HashUtils::StringHash> m_sharingFileIds;
+
+  // Disk cache files kept from last mount which are not adopted yet
+  std::unique_ptr<DiskCacheIndex> m_diskCacheIndex;
+
   friend class QS::Client::QSClient;
   friend class QS::FileSystem::Drive;
   friend class CacheTest;
@@ -0,0 +1,112 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_DATA_CACHEPOLICY_H_
+#define INCLUDE_DATA_CACHEPOLICY_H_
+
+#include <stdint.h>
+
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace QS {
+
+namespace Data {
+
+// Tier of cache which a file is stored in
+enum class CacheTier {
+  Default,  // in memory, moved into disk when memory is full
+  Memory,   // in memory only, never demoted into disk tier
+  Disk      // in disk file only, never promoted into memory
+};
+
+// Size of prefetch to read the whole file
+constexpr uint64_t kPrefetchWhole = std::numeric_limits<uint64_t>::max();
+
+// Rule of cache policy for the files matching the pattern
+struct CacheRule {
+  std::string pattern;
+  bool pin = false;      // never discarded from cache
+  bool noCache = false;  // read through without caching
+  uint64_t prefetchSize = kPrefetchWhole;  // size to read ahead
+  CacheTier tier = CacheTier::Default;
+};
+
+// Cache policy of path pattern rules
+//
+// The policy file contains one rule per line, in the form of
+//   <pattern> <action> [<action> ...]
+// with actions of pin, nocache, prefetch=<size[K|M|G]|whole> and
+// tier=<memory|disk>, e.g.
+//   *.idx          pin tier=memory
+//   /video/**      nocache
+//   /models/       prefetch=whole
+// Lines starting with '#' are comments. A pattern without '/' matches the
+// file name, otherwise it matches the path from root. In a pattern, '*'
+// matches any characters except '/', '**' matches any characters, '?'
+// matches one character except '/', and a trailing '/' matches everything
+// under the directory. The first matching rule applies.
+class CachePolicy {
+ public:
+  CachePolicy() = default;
+
+  CachePolicy(CachePolicy &&) = default;
+  CachePolicy(const CachePolicy &) = delete;
+  CachePolicy &operator=(CachePolicy &&) = default;
+  CachePolicy &operator=(const CachePolicy &) = delete;
+  ~CachePolicy() = default;
+
+ public:
+  // Load rules from policy file
+  //
+  // @param  : policy file path
+  // @return : {success, error message}
+  //
+  // Rules are replaced only if all the lines are valid.
+  std::pair<bool, std::string> Load(const std::string &file);
+
+  // Add a rule
+  //
+  // @param  : line of rule
+  // @return : {success, error message}
+  std::pair<bool, std::string> AddRule(const std::string &line);
+
+  // Get the rule matching the file
+  //
+  // @param  : file path
+  // @return : the first matching rule, or default rule if none matches
+  CacheRule Match(const std::string &filePath) const;
+
+  size_t GetNumRules() const { return m_rules.size(); }
+
+  // Match a path with pattern
+  //
+  // @param  : pattern, file path
+  // @return : bool
+  static bool MatchPattern(const std::string &pattern,
+                           const std::string &filePath);
+
+ private:
+  std::vector<CacheRule> m_rules;
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_CACHEPOLICY_H_
@@ -25,15 +25,15 @@
 
 #include <deque>
 #include <memory>
-#include <mutex>  // NOLINT
 #include <set>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
-#include "base/HashUtils.h"
+#include "base/SharedMutex.h"
 #include "data/FileMetaData.h"
+#include "data/PathName.h"
 
 namespace QS {
 
@@ -53,17 +53,17 @@ class File;
 class DirectoryTree;
 class Node;
 
+// Nodes are keyed by their interned path names, which share the dir path
+// among all children of a dir instead of storing it once again for each.
 using FilePathToNodeUnorderedMap =
-    std::unordered_map<std::string, std::shared_ptr<Node>,
-                       HashUtils::StringHash>;
+    std::unordered_map<PathName, std::shared_ptr<Node>, PathNameHash>;
 using FilePathToWeakNodeUnorderedMap =
-    std::unordered_map<std::string, std::weak_ptr<Node>, HashUtils::StringHash>;
-using ParentFilePathToChildrenMultiMap =
-    std::unordered_multimap<std::string, std::weak_ptr<Node>,
-                            HashUtils::StringHash>;
-using ChildrenMultiMapIterator = ParentFilePathToChildrenMultiMap::iterator;
-using ChildrenMultiMapConstIterator =
-    ParentFilePathToChildrenMultiMap::const_iterator;
+    std::unordered_map<PathName, std::weak_ptr<Node>, PathNameHash>;
+using ParentFilePathToChildrenMap =
+    std::unordered_map<PathName, std::vector<std::weak_ptr<Node>>,
+                       PathNameHash>;
+using ChildrenMapIterator = ParentFilePathToChildrenMap::iterator;
+using ChildrenMapConstIterator = ParentFilePathToChildrenMap::const_iterator;
 
 class Entry {
  public:
@@ -89,7 +89,7 @@ class Entry {
   // invoke its member functions
   operator bool() const {
     auto meta = m_metaData.lock();
-    return meta ? !meta->m_filePath.empty() : false;
+    return meta ? !meta->m_filePath.IsEmpty() : false;
   }
 
   bool IsDirectory() const {
@@ -101,15 +101,15 @@ class Entry {
 
   // accessor
   const std::weak_ptr<FileMetaData> &GetMetaData() const { return m_metaData; }
-  const std::string &GetFilePath() const {
-    return m_metaData.lock()->m_filePath;
-  }
+  std::string GetFilePath() const { return m_metaData.lock()->GetFilePath(); }
+  PathName GetPathName() const { return m_metaData.lock()->m_filePath; }
   uint64_t GetFileSize() const { return m_metaData.lock()->m_fileSize; }
   int GetNumLink() const { return m_metaData.lock()->m_numLink; }
   FileType GetFileType() const { return m_metaData.lock()->m_fileType; }
   mode_t GetFileMode() const { return m_metaData.lock()->m_fileMode; }
   time_t GetMTime() const { return m_metaData.lock()->m_mtime; }
   time_t GetCachedTime() const { return m_metaData.lock()->m_cachedTime; }
+  const std::string &GetETag() const { return m_metaData.lock()->m_eTag; }
   uid_t GetUID() const { return m_metaData.lock()->m_uid; }
   bool IsNeedUpload() const { return m_metaData.lock()->m_needUpload; }
   bool IsFileOpen() const { return m_metaData.lock()->m_fileOpen; }
@@ -183,7 +183,7 @@ class Node {
   bool HaveChild(const std::string &childFilePath) const;
   std::shared_ptr<Node> Find(const std::string &childFilePath) const;
 
-  // Get Children
+  // Get Children keyed by their path names
   const FilePathToNodeUnorderedMap &GetChildren()
       const;  // DO NOT store the map
 
@@ -200,7 +200,12 @@ class Node {
   std::shared_ptr<Node> Insert(const std::shared_ptr<Node> &child);
   void Remove(const std::shared_ptr<Node> &child);
   void Remove(const std::string &childFilePath);
-  void RenameChild(const std::string &oldFilePath,
+
+  // Rename a child in this dir
+  //
+  // @param  : old file path, new file path in this dir
+  // @return : false if child not exist or target exists
+  bool RenameChild(const std::string &oldFilePath,
                    const std::string &newFilePath);
 
   // accessor
@@ -218,6 +223,9 @@ class Node {
   mode_t GetFileMode() const { return m_entry ? m_entry.GetFileMode() : 0; }
   time_t GetMTime() const { return m_entry ? m_entry.GetMTime() : 0; }
   time_t GetCachedTime() const { return m_entry ? m_entry.GetCachedTime() : 0; }
+  std::string GetETag() const {
+    return m_entry ? m_entry.GetETag() : std::string();
+  }
   uid_t GetUID() const { return m_entry ? m_entry.GetUID() : -1; }
   bool IsNeedUpload() const { return m_entry ? m_entry.IsNeedUpload() : false; }
   bool IsFileOpen() const { return m_entry ? m_entry.IsFileOpen() : false; }
@@ -233,9 +241,17 @@ class Node {
     return m_entry ? m_entry.FileAccess(uid, gid, amode) : false;
   }
 
+  // Time when the children of the directory are listed completely, 0 if
+  // they are not, i.e. a file not found among them does not exist
+  time_t GetListedTime() const { return m_listedTime; }
+
  private:
   Entry &GetEntry() { return m_entry; }
 
+  // Find a child of this dir by its file path
+  FilePathToNodeUnorderedMap::const_iterator FindChild(
+      const std::string &childFilePath) const;
+
   void SetNeedUpload(bool needUpload) {
     if (m_entry) {
       m_entry.SetNeedUpload(needUpload);
@@ -264,6 +280,7 @@ class Node {
   void SetParent(const std::shared_ptr<Node> &parent) { m_parent = parent; }
   void SetSymbolicLink(const std::string &symLnk) { m_symbolicLink = symLnk; }
   void SetHardLink(bool isHardLink) { m_hardLink = isHardLink; }
+  void SetListedTime(time_t listedTime) { m_listedTime = listedTime; }
 
   void IncreaseNumLink() {
     if (m_entry) {
@@ -271,11 +288,18 @@ class Node {
     }
   }
 
+  void DecreaseNumLink() {
+    if (m_entry) {
+      m_entry.DecreaseNumLink();
+    }
+  }
+
  private:
   Entry m_entry;
   std::weak_ptr<Node> m_parent;
   std::string m_symbolicLink;
   bool m_hardLink = false;
+  time_t m_listedTime = 0;  // 0 if children are not listed completely
   // Node will control the life of its children, so only Node hold a shared_ptr
   // to its children, others should use weak_ptr instead
   FilePathToNodeUnorderedMap m_children;
@@ -326,10 +350,10 @@ class DirectoryTree {
       const std::string &dirName) const;
 
   // Const iterator point to begin of the parent to children map
-  ChildrenMultiMapConstIterator CBeginParentToChildrenMap() const;
+  ChildrenMapConstIterator CBeginParentToChildrenMap() const;
 
   // Const iterator point to end of the parent to children map
-  ChildrenMultiMapConstIterator CEndParentToChildrenMap() const;
+  ChildrenMapConstIterator CEndParentToChildrenMap() const;
 
  private:
   // Grow the directory tree
@@ -379,10 +403,30 @@ class DirectoryTree {
   std::shared_ptr<Node> HardLink(const std::string &filePath,
                                  const std::string &hardlinkPath);
 
+  // Mark a directory as listed completely or not
+  //
+  // @param  : dir path, child file paths listed, flag of listed completely
+  // @return : void
+  //
+  // The directory is marked as listed completely only if all the child
+  // file paths listed are in the tree. Files created locally are added
+  // into the tree, so the directory stays listed completely.
+  void SetDirectoryListed(const std::string &dirPath,
+                          const std::vector<std::string> &childPaths,
+                          bool complete);
+
+ private:
+  // internal use only, the caller should hold the lock
+  std::weak_ptr<Node> FindNoLock(const PathName &filePath) const;
+  std::vector<std::weak_ptr<Node>> FindChildrenNoLock(
+      const PathName &dirName) const;
+  std::shared_ptr<Node> GrowNoLock(std::shared_ptr<FileMetaData> &&fileMeta);
+
  private:
   std::shared_ptr<Node> m_root;
   // std::shared_ptr<Node> m_currentNode;
-  mutable std::recursive_mutex m_mutex;
+  // Lookups share the lock, so they do not block each other
+  mutable QS::Threading::SharedMutex m_mutex;
   FilePathToWeakNodeUnorderedMap m_map;  // record all nodes map
 
   // As we grow directory tree gradually, that means the directory tree can
@@ -390,10 +434,11 @@ class DirectoryTree {
   // built the reference to its parent or children because which have not been
   // added to the tree yet.
   // So, the dirName to children map which will help to update these references.
-  ParentFilePathToChildrenMultiMap m_parentToChildrenMap;
+  ParentFilePathToChildrenMap m_parentToChildrenMap;
 
   friend class QS::Client::QSClient;
   friend class QS::FileSystem::Drive;
+  friend class DirectoryTreeTest;
 };
 
 }  // namespace Data
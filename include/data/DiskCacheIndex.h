@@ -0,0 +1,129 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#ifndef INCLUDE_DATA_DISKCACHEINDEX_H_
+#define INCLUDE_DATA_DISKCACHEINDEX_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/HashUtils.h"
+#include "data/File.h"
+
+namespace QS {
+
+namespace Data {
+
+// Record of a file whose content is kept in disk cache
+struct DiskCacheRecord {
+  std::string fileId;        // object key (absolute path)
+  std::string diskFile;      // disk file base name in disk cache dir
+  std::string eTag;          // etag of the object the content belongs to
+  uint64_t size = 0;         // object size
+  time_t mtime = 0;          // object modification time
+  std::vector<bool> blocks;  // bitmap of blocks present in disk file
+};
+
+using FileIdToDiskCacheRecordMap =
+    std::unordered_map<std::string, DiskCacheRecord, HashUtils::StringHash>;
+
+// Index of the files kept in disk cache dir across mounts
+//
+// The index is persisted into a file in the disk cache dir when unmounting,
+// and loaded at mount. A file is described by a bitmap of fixed size blocks,
+// a block is present only if all of its bytes are stored in the disk file.
+class DiskCacheIndex {
+ public:
+  DiskCacheIndex(const std::string &diskfolder, uint64_t blockSize);
+
+  DiskCacheIndex(DiskCacheIndex &&) = default;
+  DiskCacheIndex(const DiskCacheIndex &) = delete;
+  DiskCacheIndex &operator=(DiskCacheIndex &&) = default;
+  DiskCacheIndex &operator=(const DiskCacheIndex &) = delete;
+  ~DiskCacheIndex() = default;
+
+ public:
+  // Return the index file path
+  std::string GetIndexFilePath() const;
+
+  uint64_t GetBlockSize() const { return m_blockSize; }
+  size_t GetNumRecords() const { return m_records.size(); }
+  bool HasRecord(const std::string &fileId) const;
+
+  // Load index from index file
+  //
+  // @param  : void
+  // @return : bool
+  //
+  // The index file is removed after loading, so a crash before next Save
+  // will not make stale files be reused. Files in disk cache dir which are
+  // not referenced by the index are removed.
+  bool Load();
+
+  // Save index to index file
+  //
+  // @param  : void
+  // @return : bool
+  bool Save() const;
+
+  // Add a record, replace the old one if exists
+  void Put(DiskCacheRecord &&record);
+
+  // Take out the record of the file
+  //
+  // @param  : file id
+  // @return : {true, record} or {false, empty record} if not found
+  std::pair<bool, DiskCacheRecord> Take(const std::string &fileId);
+
+  // Remove the disk files of all records, and clear the index
+  //
+  // @param  : void
+  // @return : size of bytes freed
+  uint64_t RemoveAll();
+
+  // Build the present-block bitmap
+  //
+  // @param  : content ranges stored in disk file, file size, block size
+  // @return : bitmap
+  static std::vector<bool> BuildBlockBitmap(const ContentRangeDeque &ranges,
+                                            uint64_t fileSize,
+                                            uint64_t blockSize);
+
+  // Build the content ranges from present-block bitmap
+  //
+  // @param  : bitmap, file size, block size
+  // @return : content ranges, successive blocks are merged into one range
+  static ContentRangeDeque BuildContentRanges(const std::vector<bool> &blocks,
+                                              uint64_t fileSize,
+                                              uint64_t blockSize);
+
+ private:
+  DiskCacheIndex() = default;
+
+  std::string m_diskFolder;  // ending with "/"
+  uint64_t m_blockSize = 0;
+  FileIdToDiskCacheRecordMap m_records;
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_DISKCACHEINDEX_H_
@@ -0,0 +1,108 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#ifndef INCLUDE_DATA_DISKFILE_H_
+#define INCLUDE_DATA_DISKFILE_H_
+
+#include <stddef.h>  // for size_t
+
+#include <sys/types.h>  // for off_t
+
+#include <string>
+
+namespace QS {
+
+namespace Data {
+
+// Sparse disk file which stores the content of one cached object
+//
+// The file descriptor is opened once and kept until destruction, so pages
+// sharing the disk file do read/write at the object offset by pread/pwrite
+// without reopening it. The disk file is not removed in destructor, the owner
+// manage its life cycle.
+//
+// With direct io, the file is opened with O_DIRECT so the bytes are not cached
+// again in kernel page cache. Unaligned read/write are done through an aligned
+// bounce buffer, and an unaligned write reads the partial blocks at the edges
+// before writing them back.
+class DiskFile {
+ public:
+  // Open the disk file, create it if not exist
+  //
+  // @param  : disk file absolute path, flag to use direct io
+  // @return :
+  //
+  // If the file system does not support direct io, fall back to buffered io.
+  explicit DiskFile(const std::string &path, bool directIO = false);
+
+  DiskFile(DiskFile &&) = delete;
+  DiskFile(const DiskFile &) = delete;
+  DiskFile &operator=(DiskFile &&) = delete;
+  DiskFile &operator=(const DiskFile &) = delete;
+  ~DiskFile();
+
+ public:
+  const std::string &GetPath() const { return m_path; }
+  bool IsOpen() const { return m_fd >= 0; }
+  bool IsDirectIO() const { return m_directIO; }
+  int GetFd() const { return m_fd; }
+
+  // Whether the range and buffer could be read/write by the file descriptor
+  // directly, always true if not use direct io.
+  bool IsAligned(off_t offset, size_t len, const char *buffer) const;
+
+  // Read from disk file
+  //
+  // @param  : file offset, len of bytes, buffer
+  // @return : size of readed bytes
+  //
+  // Bytes in a hole are read as zeros.
+  size_t Read(off_t offset, size_t len, char *buffer) const;
+
+  // Write to disk file
+  //
+  // @param  : file offset, len of bytes, buffer
+  // @return : size of written bytes
+  size_t Write(off_t offset, size_t len, const char *buffer);
+
+  // Deallocate the disk space of a range, file size is not changed
+  //
+  // @param  : file offset, len of bytes
+  // @return : bool
+  //
+  // Return false if the file system does not support to punch hole.
+  bool PunchHole(off_t offset, size_t len);
+
+ private:
+  // Read/write by the file descriptor directly, the range and buffer must be
+  // aligned if the file is opened for direct io
+  size_t DirectRead(off_t offset, size_t len, char *buffer) const;
+  size_t DirectWrite(off_t offset, size_t len, const char *buffer);
+
+  // Read/write through an aligned bounce buffer, for direct io only
+  size_t BounceRead(off_t offset, size_t len, char *buffer) const;
+  size_t BounceWrite(off_t offset, size_t len, const char *buffer);
+
+ private:
+  std::string m_path;       // absolute file path
+  int m_fd = -1;            // file descriptor, -1 if fail to open
+  bool m_directIO = false;  // file is opened with O_DIRECT
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_DISKFILE_H_
@@ -0,0 +1,131 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#ifndef INCLUDE_DATA_DISKIOENGINE_H_
+#define INCLUDE_DATA_DISKIOENGINE_H_
+
+#include <stddef.h>  // for size_t
+
+#include <sys/types.h>  // for off_t
+
+#include <memory>
+#include <vector>
+
+namespace QS {
+
+namespace Threading {
+class ThreadPool;
+}  // namespace Threading
+
+namespace Data {
+
+class DiskFile;
+
+// Read request of a batch submitted to DiskIOEngine
+struct DiskIORequest {
+  DiskFile *file = nullptr;  // disk file to read from
+  off_t offset = 0;          // file offset
+  size_t len = 0;            // len of bytes to read
+  char *buffer = nullptr;    // buffer to store the bytes
+  size_t result = 0;         // size of readed bytes, set by engine
+
+  DiskIORequest(DiskFile *file_, off_t offset_, size_t len_, char *buffer_)
+      : file(file_), offset(offset_), len(len_), buffer(buffer_) {}
+};
+
+using DiskIORequestVec = std::vector<DiskIORequest>;
+
+// Add a read request into a batch
+//
+// @param  : batch, disk file, file offset, len of bytes to read, buffer
+// @return : void
+//
+// The request is merged into the last one of the batch if they are
+// successive both in disk file and in buffer.
+void AddDiskReadRequest(DiskIORequestVec *requests, DiskFile *file,
+                        off_t offset, size_t len, char *buffer);
+
+// Engine to do disk cache io
+//
+// A batch of requests is submitted at once, e.g. one FUSE read spanning
+// several disk pages, so the requests are served in parallel instead of one
+// blocking call after another.
+class DiskIOEngine {
+ public:
+  DiskIOEngine() = default;
+  DiskIOEngine(DiskIOEngine &&) = delete;
+  DiskIOEngine(const DiskIOEngine &) = delete;
+  DiskIOEngine &operator=(DiskIOEngine &&) = delete;
+  DiskIOEngine &operator=(const DiskIOEngine &) = delete;
+  virtual ~DiskIOEngine() = default;
+
+ public:
+  // Return the engine shared by disk cache, which use io_uring if it is
+  // supported by the kernel, otherwise use a thread pool.
+  static DiskIOEngine &Instance();
+
+  // Read a batch of requests, block until all of them complete
+  //
+  // @param  : requests
+  // @return : total size of readed bytes
+  //
+  // The readed size of each request is set in its 'result'.
+  virtual size_t Read(DiskIORequestVec *requests) = 0;
+
+  // Return the engine name
+  virtual const char *GetName() const = 0;
+};
+
+// Engine which serves a batch with a thread pool
+class ThreadPoolDiskIOEngine : public DiskIOEngine {
+ public:
+  explicit ThreadPoolDiskIOEngine(size_t poolSize);
+  ~ThreadPoolDiskIOEngine();
+
+ public:
+  size_t Read(DiskIORequestVec *requests) override;
+  const char *GetName() const override { return "threadpool"; }
+
+ private:
+  std::unique_ptr<QS::Threading::ThreadPool> m_threadPool;
+};
+
+// Engine which submits a batch to io_uring with a single system call
+//
+// Each thread has its own ring, so threads do not wait for each other.
+// Requests which could not be served by io_uring (e.g. unaligned direct io)
+// are served by reading disk file directly.
+class IoUringDiskIOEngine : public DiskIOEngine {
+ public:
+  // @param  : num of entries of each ring
+  explicit IoUringDiskIOEngine(unsigned entries);
+  ~IoUringDiskIOEngine() = default;
+
+ public:
+  // Whether io_uring is supported by the kernel
+  static bool IsSupported();
+
+  size_t Read(DiskIORequestVec *requests) override;
+  const char *GetName() const override { return "io_uring"; }
+
+ private:
+  unsigned m_entries;
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_DISKIOENGINE_H_
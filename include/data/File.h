@@ -18,28 +18,60 @@
 #define INCLUDE_DATA_FILE_H_
 
 #include <stddef.h>  // for size_t
+#include <stdint.h>
 #include <time.h>
 
 #include <atomic>  // NOLINT
 #include <deque>
 #include <iostream>
-#include <list>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <string>
 #include <tuple>
 #include <utility>
+#include <vector>
 
+#include "data/CachePolicy.h"
 #include "data/Page.h"
 
 namespace QS {
 
 namespace Data {
 class Cache;
+class DiskFile;
 
 // Range represented by a pair of {offset, size}
 using ContentRangeDeque = std::deque<std::pair<off_t, size_t>>;
 
+// Slice of file content, like fuse_buf it refers to either bytes in memory
+// or bytes stored in disk file at the file offset, a slice of hole refers to
+// neither of them.
+struct FileSlice {
+  off_t offset = 0;              // file offset
+  size_t len = 0;                // len of bytes
+  const char *data = nullptr;    // bytes in memory, null if not in memory
+  DiskFile *diskFile = nullptr;  // disk file, null if not in disk file
+  bool zero = false;             // bytes are all zero in a hole page
+
+  FileSlice(off_t offset_, size_t len_, const char *data_, DiskFile *diskFile_,
+            bool zero_ = false)
+      : offset(offset_),
+        len(len_),
+        data(data_),
+        diskFile(diskFile_),
+        zero(zero_) {}
+};
+
+using FileSliceVec = std::vector<FileSlice>;
+
+// Size of bytes read from each tier of cache
+struct CacheTierStats {
+  std::atomic<uint64_t> memory{0};      // uncompressed pages in memory
+  std::atomic<uint64_t> compressed{0};  // compressed pages in memory
+  std::atomic<uint64_t> disk{0};        // pages in disk file
+  std::atomic<uint64_t> missed{0};      // bytes not present
+};
+
 class File {
  public:
   explicit File(const std::string &baseName, time_t mtime, size_t size = 0)
@@ -47,8 +79,18 @@ class File {
         m_mtime(mtime),
         m_size(size),
         m_cacheSize(size),
+        m_compressedSavedSize(0),
+        m_holeSize(0),
+        m_unchargedSize(0),
+        m_dirtySize(0),
+        m_dirtyGeneration(0),
+        m_hotDiskSize(0),
         m_useDiskFile(false),
-        m_open(false) {}
+        m_open(false),
+        m_keepDiskFile(false),
+        m_pinned(false),
+        m_tier(CacheTier::Default),
+        m_objectSize(0) {}
 
   File(File &&) = delete;
   File(const File &) = delete;
@@ -59,10 +101,26 @@ class File {
  public:
   std::string GetBaseName() const { return m_baseName; }
   size_t GetSize() const { return m_size.load(); }
-  size_t GetCachedSize() const { return m_cacheSize.load(); }
+  // Size of bytes charged in cache, which does not include the size of pages
+  // shared from other files
+  size_t GetCachedSize() const {
+    return m_cacheSize.load() - m_compressedSavedSize.load() -
+           m_holeSize.load() - m_unchargedSize.load();
+  }
+  size_t GetHoleSize() const { return m_holeSize.load(); }
+  size_t GetUnchargedSize() const { return m_unchargedSize.load(); }
+  size_t GetDiskSize() const { return m_size.load() - m_cacheSize.load(); }
+  size_t GetHotDiskSize() const { return m_hotDiskSize.load(); }
   time_t GetTime() const { return m_mtime.load(); }
   bool UseDiskFile() const { return m_useDiskFile.load(); }
   bool IsOpen() const { return m_open.load(); }
+  size_t GetDirtySize() const { return m_dirtySize.load(); }
+  bool IsDirty() const { return m_dirtySize.load() > 0; }
+  uint64_t GetDirtyGeneration() const { return m_dirtyGeneration.load(); }
+  bool IsPinned() const { return m_pinned.load(); }
+  CacheTier GetTier() const { return m_tier.load(); }
+  std::string GetETag() const;
+  uint64_t GetObjectSize() const { return m_objectSize.load(); }
 
   // return disk file path
   std::string AskDiskFilePath() const;
@@ -97,21 +155,105 @@ class File {
   // Return num of pages
   size_t GetNumPages() const;
 
+  // Return the content ranges stored in disk file
+  //
+  // @param  : void
+  // @return : a list of pair {range start, range size} sorted by start
+  ContentRangeDeque GetDiskFileRanges() const;
+
+  // Return the content ranges modified locally and not uploaded yet
+  //
+  // @param  : void
+  // @return : a list of pair {range start, range size} sorted by start
+  ContentRangeDeque GetDirtyRanges() const;
+
  private:
-  // Read from the cache (file pages)
+  // Read from the cache (file pages) into a buffer
+  //
+  // @param  : file offset, len of bytes, buffer, modified time since from,
+  //           unloaded ranges (could be null)
+  // @return : size of readed bytes
+  //
+  // Bytes of pages are copied into buffer directly and bytes not present
+  // are zeroed, pages using disk file are read in one batch. It does not
+  // allocate when unloaded ranges is null.
+  // Compressed pages are decompressed into memory, and the size of bytes
+  // read from each tier is added to stats if it's not null.
+  size_t Read(off_t offset, size_t len, char *buffer, time_t mtimeSince,
+              ContentRangeDeque *unloadedRanges,
+              CacheTierStats *stats = nullptr);
+
+  // Get slices of the cache (file pages)
+  //
+  // @param  : file offset, len of bytes, slices, modified time since from,
+  //           unloaded ranges (could be null)
+  // @return : size of bytes in the slices, not including holes
+  //
+  // Slices are appended sorted by offset, ending at the last page in range.
+  // They point into the pages, so they are valid only until the file is
+  // written, resized, demoted, promoted or erased from cache.
+  size_t ReadSlices(off_t offset, size_t len, FileSliceVec *slices,
+                    time_t mtimeSince, ContentRangeDeque *unloadedRanges,
+                    CacheTierStats *stats = nullptr);
+
+  // Compress the pages in memory
+  //
+  // @param  : void
+  // @return : size of bytes saved
+  size_t Compress();
+
+  // Demote the pages in memory into disk file
+  //
+  // @param  : size of bytes in memory need to be freed
+  // @return : size of bytes freed in memory
   //
-  // @param  : file offset, len of bytes, modified time since from
-  // @return : a pair of {read size, page list containing data, unloaded ranges}
+  // Pages are demoted until the given size of bytes in memory are freed.
+  // The disk cache directory is supposed to exist.
+  size_t Demote(size_t size);
+
+  // Promote the hot pages in disk file into memory
+  //
+  // @param  : void
+  // @return : size of bytes promoted
   //
-  // If the file mtime is newer than m_mtime, clear cache and download file.
-  // If any bytes is not present, download it as a new page.
-  // Pagelist of outcome is sorted by page offset.
+  // A page in disk file becomes hot once it's read for a few times.
+  size_t PromoteHotPages();
+
+  // Remove the pages in disk file and deallocate their disk space
+  //
+  // @param  : void
+  // @return : size of bytes removed
+  size_t DropDiskPages();
+
+  // Discard the least recently accessed pages in memory
   //
-  // Notes: the pagelist of outcome could containing more bytes than given
-  // input asking for, for example, the 1st page of outcome could has a
-  // offset which is ahead of input 'offset'.
-  std::tuple<size_t, std::list<std::shared_ptr<Page>>, ContentRangeDeque> Read(
-      off_t offset, size_t len, time_t mtimeSince = 0);
+  // @param  : size of bytes in memory need to be freed, range start, range
+  //           stop of the pages to keep
+  // @return : size of bytes freed in memory
+  //
+  // Pages are discarded until the given size of bytes in memory are freed.
+  // Pages intersecting with range [start, stop) or with dirty ranges are
+  // kept, so are the pages in disk file.
+  size_t Recycle(size_t size, off_t start, off_t stop);
+
+  // Share the in-memory pages of a file with the same content
+  //
+  // @param  : source file
+  // @return : size of bytes shared
+  //
+  // Only a file without pages shares pages. Pages of the source in disk file
+  // or compressed are not shared. A shared page is copied before it's
+  // written or resized, and it's never compressed or demoted.
+  //
+  // The shared pages stay charged to the source, so they are not counted in
+  // the cached size of this file until ChargeSharedPages.
+  size_t ShareFrom(File *source);
+
+  // Charge the shared pages which are no longer held by other files
+  //
+  // @param  : void
+  // @return : size of bytes charged, added to the cached size
+  size_t ChargeSharedPages();
 
   // Write a block of bytes into pages
   //
@@ -134,12 +276,72 @@ class File {
       off_t offset, size_t len, std::shared_ptr<std::iostream> &&stream,
       time_t mtime);
 
+  // Write a block of bytes into pages without merging pages
+  // internal use only
+  std::tuple<bool, size_t, size_t> UnguardedWrite(off_t offset, size_t len,
+                                                  const char *buffer,
+                                                  time_t mtime);
+
+  // Check file is not modified since mtime, update mtime if not set yet
+  // internal use only
+  bool UnguardedCheckTime(time_t mtimeSince);
+
+  // Append slices of pages intersecting with range [offset, offset + len)
+  // Return size of bytes in the slices, not including holes.
+  // Compressed pages are decompressed into memory.
+  // internal use only
+  size_t UnguardedGetSlices(off_t offset, size_t len, FileSliceVec *slices,
+                            ContentRangeDeque *unloadedRanges,
+                            CacheTierStats *stats);
+
+  // Decompress the pages intersecting with range [start, stop) into memory
+  // Return size of bytes regained in cache.
+  // internal use only
+  size_t UnguardedDecompressPages(off_t start, off_t stop);
+
+  // Replace the shared pages intersecting with range [start, stop) with
+  // copies of them, so they could be modified.
+  // internal use only
+  void UnguardedUnsharePages(off_t start, off_t stop);
+
+  // Fill the hole pages intersecting with range [start, stop) in memory
+  // Return size of bytes added in cache.
+  // internal use only
+  size_t UnguardedFillHoles(off_t start, off_t stop);
+
+  // Merge successive pages around the range [start, stop) into larger pages
+  //
+  // @param  : range start, range stop
+  // @return : void
+  //
+  // Small writes and chunked downloads leave many small successive pages,
+  // when there are too many pages for the file size, they are merged into
+  // pages up to the max page extent size. Pages using disk file are merged
+  // without copying as the bytes are already in place. Pages in memory are
+  // merged only with a page of similar size, so each byte is copied for
+  // a few times only no matter how many small writes happened.
+  // internal use only
+  void UnguardedMergePages(off_t start, off_t stop);
+
+  // Mark the content range as modified locally
+  //
+  // @param  : range start, range size
+  // @return : size of bytes becoming dirty
+  //
+  // Dirty ranges are cleared when the file content is set with an etag,
+  // i.e. it's the same as the object again.
+  size_t AddDirtyRange(off_t offset, size_t len);
+
   // Resize the total pages' size to a smaller size.
   void ResizeToSmallerSize(size_t smallerSize);
 
   // Remove disk file
   void RemoveDiskFileIfExists(bool logOn = true) const;
 
+  // Return the disk file shared by pages, open it if not opened yet.
+  // internal use only
+  const std::shared_ptr<DiskFile> &UnguardedGetDiskFile();
+
   // Clear pages and reset attributes.
   void Clear();
 
@@ -152,6 +354,34 @@ class File {
   // Set file open state
   void SetOpen(bool open) { m_open.store(open); }
 
+  // Set etag and size of the object which the file content belongs to
+  void SetETag(const std::string &eTag, uint64_t objectSize);
+
+  // Set etag and size of the uploaded object, only if the file is not
+  // modified since the dirty generation the upload started with
+  //
+  // @param  : etag, object size, dirty generation when upload started
+  // @return : true if the etag is set and the file is clean
+  bool SetUploadedETag(const std::string &eTag, uint64_t objectSize,
+                       uint64_t dirtyGeneration);
+
+  // Set flag to keep disk file when destructing
+  void SetKeepDiskFile(bool keep) { m_keepDiskFile.store(keep); }
+
+  // Set cache policy of pin and tier
+  void SetPolicy(const CacheRule &rule) {
+    m_pinned.store(rule.pin);
+    m_tier.store(rule.tier);
+  }
+
+  // Add pages for the content already stored in disk file
+  //
+  // @param  : content ranges
+  // @return : added size
+  //
+  // Used to adopt the disk file kept from last mount.
+  size_t AdoptDiskFileRanges(const ContentRangeDeque &ranges);
+
   // Returns an iterator pointing to the first Page that is not ahead of offset.
   // If no such Page is found, a past-the-end iterator is returned.
   PageSetConstIterator LowerBoundPage(off_t offset) const;
@@ -189,19 +419,47 @@ class File {
   std::tuple<PageSetConstIterator, bool, size_t, size_t> UnguardedAddPage(
       off_t offset, size_t len, std::shared_ptr<std::iostream> &&stream);
 
+  // Add a new hole page of zero bytes without checking input.
+  // Return {pointer to addedpage, success, added size in cache, added size}
+  // internal use only
+  std::tuple<PageSetConstIterator, bool, size_t, size_t> UnguardedAddHole(
+      off_t offset, size_t len);
+
+  // Put a page into the index at the position of its offset.
+  // Return {pointer to the page, success}, fail if there is already a page
+  // with the same offset.
+  // internal use only
+  std::pair<PageSetConstIterator, bool> UnguardedInsertPage(
+      std::shared_ptr<Page> &&page);
+
  private:
   std::string m_baseName;           // file base name
   std::atomic<time_t> m_mtime;      // time of last modification
   std::atomic<size_t> m_size;       // record sum of all pages' size
   std::atomic<size_t> m_cacheSize;  // record sum of all pages' size
                                     // stored in cache not including disk file
+  std::atomic<size_t> m_compressedSavedSize;  // size saved by compression
+  std::atomic<size_t> m_holeSize;  // sum of hole pages' size, not stored
+  std::atomic<size_t> m_unchargedSize;  // sum of uncharged pages' size
+  std::atomic<size_t> m_dirtySize;  // sum of dirty ranges' size
+  std::atomic<uint64_t> m_dirtyGeneration;  // increased by every modification
+  std::atomic<size_t> m_hotDiskSize;  // sum of hot pages' size in disk file
 
   std::atomic<bool> m_useDiskFile;  // use disk file when no free cache space
   std::atomic<bool> m_open;         // file open/close state
+  std::atomic<bool> m_keepDiskFile;  // keep disk file for next mount
+  std::atomic<bool> m_pinned;        // never discarded from cache
+  std::atomic<CacheTier> m_tier;     // tier the file is stored in
+  std::atomic<uint64_t> m_objectSize;  // size of object with m_eTag
+  std::string m_eTag;  // etag of object, empty if content is modified locally
   mutable std::recursive_mutex m_mutex;
-  PageSet m_pages;              // a set of pages suppose to be successive
+  PageSet m_pages;  // pages sorted by offset, suppose to be successive
+  uint64_t m_accessTicks = 0;  // num of page accesses, ordering the accesses
+  std::shared_ptr<DiskFile> m_diskFile;  // opened disk file shared by pages
+  ContentRangeDeque m_dirtyRanges;  // modified locally, sorted and disjoint
 
   friend class Cache;
+  friend class CacheTest;
   friend class FileTest;
 };
 
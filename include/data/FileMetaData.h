@@ -28,6 +28,8 @@
 #include <mutex>  // NOLINT
 #include <string>
 
+#include "data/PathName.h"
+
 namespace QS {
 
 namespace Data {
@@ -83,15 +85,18 @@ class FileMetaData {
   bool FileAccess(uid_t uid, gid_t gid, int amode) const;
 
   // accessor
-  const std::string &GetFilePath() const { return m_filePath; }
+  // Build the file path
+  std::string GetFilePath() const { return m_filePath.ToString(); }
+  const PathName &GetPathName() const { return m_filePath; }
   time_t GetMTime() const { return m_mtime; }
+  const std::string &GetETag() const { return m_eTag; }
   bool IsFileOpen() const { return m_fileOpen; }
 
  private:
   FileMetaData() = default;
 
   // file full path name
-  std::string m_filePath;  // For a directory, this will be ending with "/"
+  PathName m_filePath;  // For a directory, this will be ending with "/"
   uint64_t m_fileSize;
   // Notice: file creation time is not stored in unix
   time_t m_atime;  // time of last access
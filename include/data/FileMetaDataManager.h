@@ -19,17 +19,18 @@
 
 #include <assert.h>
 
+#include <atomic>  // NOLINT
 #include <list>
 #include <memory>
-#include <mutex>  // NOLINT
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 
-#include "base/HashUtils.h"
+#include "base/SharedMutex.h"
 #include "data/FileMetaData.h"
+#include "data/PathName.h"
 
 namespace QS {
 
@@ -39,13 +40,23 @@ class Entry;
 class Node;
 
 using FileIdToMetaDataPair =
-    std::pair<std::string, std::shared_ptr<FileMetaData>>;
+    std::pair<PathName, std::shared_ptr<FileMetaData>>;
 using MetaDataList = std::list<FileIdToMetaDataPair>;
 using MetaDataListIterator = MetaDataList::iterator;
 using MetaDataListConstIterator = MetaDataList::const_iterator;
-using FileIdToMetaDataListIteratorMap =
-    std::unordered_map<std::string, MetaDataListIterator,
-                       HashUtils::StringHash>;
+
+// Position of a meta data in list, along with a flag denoting if the meta
+// data is referenced since it was checked by the eviction last time
+struct MetaDataListPosition {
+  explicit MetaDataListPosition(MetaDataListIterator it)
+      : pos(it), referenced(false) {}
+
+  MetaDataListIterator pos;
+  mutable std::atomic<bool> referenced;
+};
+
+using FileIdToMetaDataListPositionMap =
+    std::unordered_map<PathName, MetaDataListPosition, PathNameHash>;
 
 class FileMetaDataManager {
  public:
@@ -61,6 +72,10 @@ class FileMetaDataManager {
 
  public:
   // Get file meta data
+  //
+  // Get only marks the meta data referenced instead of moving it to front,
+  // so lookups share the lock. A referenced meta data gets a second chance
+  // when it comes to be discarded.
   MetaDataListConstIterator Get(const std::string &filePath) const;
 
   // Return begin of meta data list
@@ -114,19 +129,19 @@ class FileMetaDataManager {
   MetaDataListIterator UnguardedMakeMetaDataMostRecentlyUsed(
       MetaDataListConstIterator pos);
   bool HasFreeSpaceNoLock(size_t needCount) const;
-  bool FreeNoLock(size_t needCount, const std::string fileUnfreeable);
+  bool FreeNoLock(size_t needCount, const PathName &fileUnfreeable);
   MetaDataListIterator AddNoLock(std::shared_ptr<FileMetaData> &&fileMetaData);
 
  private:
   explicit FileMetaDataManager(size_t maxCount = 0);
 
-  // Most recently used meta data is put at front,
-  // Least recently used meta data in put at back.
+  // Most recently added or referenced meta data is put at front,
+  // Least recently added or referenced meta data in put at back.
   MetaDataList m_metaDatas;
-  FileIdToMetaDataListIteratorMap m_map;
+  FileIdToMetaDataListPositionMap m_map;
   size_t m_maxCount;  // max count of meta datas
 
-  mutable std::recursive_mutex m_mutex;
+  mutable QS::Threading::SharedMutex m_mutex;
 
   friend class QS::Data::Entry;
   friend class QS::Data::Node;
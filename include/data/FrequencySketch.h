@@ -0,0 +1,77 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_DATA_FREQUENCYSKETCH_H_
+#define INCLUDE_DATA_FREQUENCYSKETCH_H_
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace QS {
+
+namespace Data {
+
+// Count-min sketch estimating the access frequency of keys
+//
+// Counters are 4 bits, so the estimated frequency is at most 15. All the
+// counters are halved once the number of increments reaches ten times the
+// number of counters, so the sketch favors recent accesses and keeps a
+// fixed size regardless of the number of keys. Not thread safe.
+class FrequencySketch {
+ public:
+  // @param  : number of counters, rounded up to a power of 2
+  explicit FrequencySketch(size_t numCounters);
+
+  FrequencySketch(FrequencySketch &&) = default;
+  FrequencySketch(const FrequencySketch &) = delete;
+  FrequencySketch &operator=(FrequencySketch &&) = default;
+  FrequencySketch &operator=(const FrequencySketch &) = delete;
+  ~FrequencySketch() = default;
+
+ public:
+  // Record an access of key
+  void Increment(const std::string &key);
+
+  // Get estimated access frequency of key
+  unsigned Estimate(const std::string &key) const;
+
+  size_t GetNumCounters() const { return m_numCounters; }
+
+ private:
+  // Get index of counter for key hash in the given row
+  size_t IndexOf(uint64_t hash, unsigned row) const;
+
+  // Get value of counter
+  unsigned GetCounter(size_t index) const;
+
+  // Halve all counters
+  void Age();
+
+ private:
+  std::vector<uint64_t> m_table;  // 16 counters per word
+  size_t m_numCounters = 0;
+  size_t m_sampleSize = 0;  // number of increments to age counters
+  size_t m_additions = 0;   // number of increments since last aging
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_FREQUENCYSKETCH_H_
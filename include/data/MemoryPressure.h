@@ -0,0 +1,94 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_DATA_MEMORYPRESSURE_H_
+#define INCLUDE_DATA_MEMORYPRESSURE_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+namespace QS {
+
+namespace Data {
+
+// Memory status of the cgroup which qsfs is running in
+struct MemoryStatus {
+  uint64_t current = 0;  // memory.current, in bytes
+  uint64_t limit = 0;    // memory.high or memory.max, 0 if no limit
+  double pressure = 0;   // PSI memory "some avg10", in percent
+};
+
+// Watcher of cgroup v2 memory usage and PSI memory pressure
+//
+// It is used to make the cache capacity elastic: shrink the cache when the
+// cgroup nears its memory limit or the memory is under pressure, and grow it
+// back to the configured max cache size when the pressure subsides.
+class MemoryPressure {
+ public:
+  // Construct with the cgroup dir and the PSI memory pressure file
+  MemoryPressure(const std::string &cgroupDir, const std::string &psiFile);
+
+  MemoryPressure(MemoryPressure &&) = default;
+  MemoryPressure(const MemoryPressure &) = delete;
+  MemoryPressure &operator=(MemoryPressure &&) = default;
+  MemoryPressure &operator=(const MemoryPressure &) = delete;
+  ~MemoryPressure() = default;
+
+ public:
+  // Detect the cgroup v2 dir of this process
+  //
+  // @param  : void
+  // @return : memory pressure watcher, null if cgroup v2 memory controller
+  //           is not available
+  //
+  // The system-wide /proc/pressure/memory is watched instead only if the
+  // cgroup has no memory.pressure but has a memory limit.
+  static std::unique_ptr<MemoryPressure> Detect();
+
+  // Read memory status
+  //
+  // @param  : memory status
+  // @return : bool
+  bool ReadStatus(MemoryStatus *status) const;
+
+  // Calculate cache capacity for the memory status
+  //
+  // @param  : max capacity, current capacity, memory status
+  // @return : new capacity, between 1/16 of max capacity and max capacity
+  //
+  // Capacity shrinks when the headroom below the limit is less than 10% of
+  // the limit or the pressure is high, and grows back gradually when the
+  // headroom is more than 25% of the limit and the pressure is low.
+  static uint64_t AdaptCapacity(uint64_t maxCapacity, uint64_t capacity,
+                                const MemoryStatus &status);
+
+  const std::string &GetCgroupDir() const { return m_cgroupDir; }
+
+ private:
+  MemoryPressure() = default;
+
+  std::string m_cgroupDir;  // ending with "/"
+  std::string m_psiFile;    // memory.pressure of cgroup or /proc/pressure,
+                            // empty if pressure is not watched
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_MEMORYPRESSURE_H_
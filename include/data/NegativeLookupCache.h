@@ -0,0 +1,105 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_DATA_NEGATIVELOOKUPCACHE_H_
+#define INCLUDE_DATA_NEGATIVELOOKUPCACHE_H_
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "base/HashUtils.h"
+
+namespace QS {
+
+namespace Data {
+
+// Cache of the paths known not to exist
+//
+// A path is cached after the object storage reports it's not existing, so
+// that probing it again within the expire time costs no round trip. The
+// oldest paths are discarded when it's full. Thread safe.
+class NegativeLookupCache {
+ public:
+  // @param  : max count of paths, expire time in seconds
+  NegativeLookupCache(size_t maxCount, time_t expireInSec)
+      : m_maxCount(maxCount), m_expireInSec(expireInSec) {}
+
+  NegativeLookupCache(NegativeLookupCache &&) = delete;
+  NegativeLookupCache(const NegativeLookupCache &) = delete;
+  NegativeLookupCache &operator=(NegativeLookupCache &&) = delete;
+  NegativeLookupCache &operator=(const NegativeLookupCache &) = delete;
+  ~NegativeLookupCache() = default;
+
+ public:
+  // Whether the path is known not to exist
+  //
+  // @param  : path
+  // @return : bool
+  //
+  // An expired path is removed and counted as a miss.
+  bool Has(const std::string &path);
+
+  // Add a path not existing
+  void Add(const std::string &path);
+
+  // Remove a path which is created
+  //
+  // @param  : path
+  // @return : void
+  //
+  // The path is removed in both forms of file and dir, along with its
+  // ancestor dirs, which exist as well.
+  void Erase(const std::string &path);
+
+  // Remove all paths
+  void Clear();
+
+  size_t GetSize() const;
+  uint64_t GetHits() const { return m_hits.load(); }
+  uint64_t GetMisses() const { return m_misses.load(); }
+
+ private:
+  // Remove a path in both forms of file and dir, without locking
+  void UnguardedErase(const std::string &path);
+
+ private:
+  using PathList = std::list<std::string>;  // oldest path at front
+  using PathToExpireTimeMap =
+      std::unordered_map<std::string, std::pair<time_t, PathList::iterator>,
+                         HashUtils::StringHash>;
+
+  size_t m_maxCount = 0;
+  time_t m_expireInSec = 0;
+  PathList m_paths;
+  PathToExpireTimeMap m_map;
+  std::atomic<uint64_t> m_hits{0};
+  std::atomic<uint64_t> m_misses{0};
+  mutable std::mutex m_mutex;
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_NEGATIVELOOKUPCACHE_H_
@@ -18,20 +18,24 @@
 #define INCLUDE_DATA_PAGE_H_
 
 #include <stddef.h>  // for size_t
+#include <stdint.h>
 
 #include <sys/types.h>  // for off_t
 
 #include <iostream>
 #include <memory>
 #include <mutex>  // NOLINT
-#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "data/DiskIOEngine.h"
 
 namespace QS {
 
 namespace Data {
 
+class DiskFile;
 class File;
 
 class Page {
@@ -58,16 +62,24 @@ class Page {
   size_t m_size = 0;   // size of bytes this page contains
 
   // NOTICE: body stream should be QS::Data::IOStream which associated with
-  // QS::Data::StreamBuf when not use disk file; otherwise body stream is a
-  // fstream assoicated to a disk file.
-  // With the asssoicated stream buf or disk file, the body stream support to
-  // be read/write for multiple times, but keep in mind following things:
-  // 1) always seek to the right postion before to read/write body stream;
-  // 2) if use disk file, always use RAII FileOpener to open it for read/write
+  // QS::Data::StreamBuf when not use disk file; otherwise body stream is null
+  // and the bytes are stored in disk file at the file offset.
+  // With the asssoicated stream buf, the body stream support to be read/write
+  // for multiple times, but always seek to the right postion before to
+  // read/write body stream.
   std::shared_ptr<std::iostream> m_body;  // stream storing the bytes
 
-  std::string m_diskFile;  // disk file is used when in-memory cache is not
-                           // available, it is an absolute file path
+  // disk file is used when in-memory cache is not available, it is shared
+  // by all the pages of the owning File
+  std::shared_ptr<DiskFile> m_diskFile;
+  unsigned m_diskHits = 0;  // num of reads since stored in disk file
+
+  // compressed bytes, body stream is null when page is compressed
+  std::vector<char> m_compressed;
+  bool m_incompressible = false;  // not to compress the page again
+
+  // all bytes are zero, stored neither in memory nor in disk file
+  bool m_hole = false;
 
   mutable std::recursive_mutex m_mutex;
 
@@ -83,10 +95,10 @@ class Page {
 
   // Construct Page from a block of bytes (store it in disk file)
   //
-  // @param  : file offset, len, buffer, disk file path
+  // @param  : file offset, len, buffer, disk file
   // @return :
   Page(off_t offset, size_t len, const char *buffer,
-       const std::string &diskfile);
+       const std::shared_ptr<DiskFile> &diskfile);
 
   // Construct Page from a stream
   //
@@ -102,7 +114,24 @@ class Page {
   // @param  : file offset, len of bytes, stream, disk file
   // @return :
   Page(off_t offset, size_t len, const std::shared_ptr<std::iostream> &stream,
-       const std::string &diskfile);
+       const std::shared_ptr<DiskFile> &diskfile);
+
+  // Construct Page from the data already stored in disk file
+  //
+  // @param  : file offset, len of bytes, disk file
+  // @return :
+  //
+  // The disk file is supposed to contain len of bytes at the file offset,
+  // e.g. a disk file kept from last mount.
+  Page(off_t offset, size_t len, const std::shared_ptr<DiskFile> &diskfile);
+
+  // Construct Page of a hole in which all bytes are zero
+  //
+  // @param  : file offset, len of bytes
+  // @return :
+  //
+  // The bytes are not stored, reads of them are served by zero filling.
+  Page(off_t offset, size_t len);
 
   // Construct Page from a stream by moving
   //
@@ -130,9 +159,67 @@ class Page {
   // Return the offset
   off_t Offset() const { return m_offset; }
 
-  // Return body
+  // Return body, which is null if page use disk file
   const std::shared_ptr<std::iostream> &GetBody() const { return m_body; }
 
+  // Return the in-memory bytes at file offset, which is null if page use
+  // disk file. It is only valid until the page is refreshed or resized.
+  const char *GetData(off_t offset) const;
+
+  // Return disk file, which is null if page not use disk file
+  DiskFile *GetDiskFile() const { return m_diskFile.get(); }
+
+  // Return if page is compressed
+  bool IsCompressed();
+
+  // Return size of bytes saved by compressing the page
+  size_t GetCompressedSavedSize();
+
+  // Return if page is a hole of zero bytes
+  bool IsHole();
+
+  // Return size of bytes saved by the hole, 0 if page is not a hole
+  size_t GetHoleSize();
+
+  // Fill the hole with zero bytes in memory
+  //
+  // @param  : void
+  // @return : size of bytes stored in memory, 0 if page is not a hole
+  size_t FillHole();
+
+  // Compress the page's in-memory bytes
+  //
+  // @param  : void
+  // @return : size of bytes saved, 0 if page is not compressed
+  //
+  // Page using disk file, already compressed or incompressible is skipped.
+  // Incompressible bytes are detected by compressing a sample of them first.
+  size_t Compress();
+
+  // Decompress the page back into memory
+  //
+  // @param  : void
+  // @return : size of bytes regained
+  size_t Decompress();
+
+  // Move the page's in-memory bytes into disk file
+  //
+  // @param  : disk file
+  // @return : bool
+  //
+  // Compressed bytes are decompressed into disk file. Page already using
+  // disk file is skipped.
+  bool Demote(const std::shared_ptr<DiskFile> &diskfile);
+
+  // Move the page's bytes in disk file back into memory
+  //
+  // @param  : void
+  // @return : bool
+  //
+  // The disk space of the bytes is deallocated. Page not using disk file
+  // is skipped.
+  bool Promote();
+
   // Return if page use disk file
   bool UseDiskFile();
   bool UseDiskFileNoLock();
@@ -146,7 +233,7 @@ class Page {
   // is larger than page's size and using disk file, then all page's data
   // will be put to disk file.
   bool Refresh(off_t offset, size_t len, const char *buffer,
-               const std::string &diskfile = std::string());
+               const std::shared_ptr<DiskFile> &diskfile = nullptr);
 
   // Refresh the page's entire content with bytes from buffer,
   // without checking.
@@ -175,18 +262,32 @@ class Page {
   // Read the page's entire content to buffer.
   size_t Read(char *buffer) { return Read(m_offset, m_size, buffer); }
 
+  // Add a request to read the page's content into a batch
+  //
+  // @param  : file offset, len of bytes to read, buffer, batch
+  // @return : false if page not use disk file, nothing added
+  //
+  // The request is merged into the last one of the batch if they are
+  // successive both in disk file and in buffer.
+  bool AddDiskReadRequest(off_t offset, size_t len, char *buffer,
+                          DiskIORequestVec *requests);
+
  private:
   // Set stream
+  // If use disk file, the stream content is put into disk file.
   void SetStream(std::shared_ptr<std::iostream> &&stream);
 
-  // Setup disk file on disk
-  // - open the disk file
-  // - set stream to fstream assocating with disk file
+  // Check disk file is available
   bool SetupDiskFile();
 
   // Do a lazy resize for page.
+  // If use disk file, the disk space of the removed bytes is deallocated.
   void ResizeToSmallerSize(size_t smallerSize);
 
+  // Deallocate the disk space of the page's content if use disk file.
+  // Used when the page is removed from the owning File.
+  void PunchHole();
+
   // Put data to body
   // For internal use only
   void UnguardedPutToBody(off_t offset, size_t len, const char *buffer);
@@ -197,7 +298,7 @@ class Page {
   // Starting from file offset, len of bytes will be updated.
   // For internal use only.
   bool UnguardedRefresh(off_t offset, size_t len, const char *buffer,
-                        const std::string &diskfile = std::string());
+                        const std::shared_ptr<DiskFile> &diskfile = nullptr);
 
   // Refresh the page's partial content without checking.
   // Starting from file offset, all the page's remaining size will be updated.
@@ -241,14 +342,30 @@ class Page {
   friend class PageTest;
 };
 
-struct PageCmp {
-  bool operator()(const std::shared_ptr<Page> &a,
-                  const std::shared_ptr<Page> &b) const {
-    return a->Offset() < b->Offset();
-  }
+// Record of the page index owned by File
+//
+// The page's offset and size are kept inline, so lookups in the index never
+// dereference the page itself. File keeps 'size' in sync with the page.
+struct PageEntry {
+  off_t offset = 0;  // same as page->Offset()
+  size_t size = 0;   // same as page->Size()
+  std::shared_ptr<Page> page;
+  // order of the last access among the pages of owning File, it's updated
+  // by reads through const iterators
+  mutable uint64_t accessTick = 0;
+  // shared from another file, which is charged for the page in cache size
+  bool uncharged = false;
+
+  PageEntry(off_t off, size_t sz, std::shared_ptr<Page> &&pg,
+            uint64_t tick = 0)
+      : offset(off), size(sz), page(std::move(pg)), accessTick(tick) {}
+
+  // Return the offset of the next successive page.
+  off_t Next() const { return offset + static_cast<off_t>(size); }
 };
 
-using PageSet = std::set<std::shared_ptr<Page>, PageCmp>;
+// A flat index of pages sorted by offset, pages do not overlap.
+using PageSet = std::vector<PageEntry>;
 using PageSetConstIterator = PageSet::const_iterator;
 
 std::string ToStringLine(const std::string &fileId, off_t offset, size_t len,
@@ -256,6 +373,14 @@ std::string ToStringLine(const std::string &fileId, off_t offset, size_t len,
 std::string ToStringLine(off_t offset, size_t len, const char *buffer);
 std::string ToStringLine(off_t offset, size_t size);
 
+// Whether all the bytes are zero
+//
+// @param  : buffer, len of bytes
+// @return : bool
+//
+// Compare 64 bytes at a time with SSE2 if available.
+bool IsAllZero(const char *buffer, size_t len);
+
 }  // namespace Data
 }  // namespace QS
 
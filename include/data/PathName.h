@@ -0,0 +1,103 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#ifndef INCLUDE_DATA_PATHNAME_H_
+#define INCLUDE_DATA_PATHNAME_H_
+
+#include <stddef.h>  // for size_t
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace QS {
+
+namespace Data {
+
+struct PathComponent;
+
+// Interned file path
+//
+// A path is split after each "/", e.g. "/dir/sub/file" into "/", "dir/",
+// "sub/" and "file". Each component keeps its name along with its parent
+// component, and is shared by all the paths starting with it, so a dir
+// path is stored once however many files are under it. The full path is
+// built on demand.
+//
+// Equal paths always share the same component, so path names are compared
+// and hashed by pointer. A component is released with the last path name
+// referencing it. Thread safe.
+class PathName {
+ public:
+  PathName() = default;
+  // Intern the path
+  explicit PathName(const std::string &path);
+
+  PathName(PathName &&) = default;
+  PathName(const PathName &) = default;
+  PathName &operator=(PathName &&) = default;
+  PathName &operator=(const PathName &) = default;
+  ~PathName() = default;
+
+ public:
+  // Find the interned path without interning it
+  //
+  // @param  : path
+  // @return : the path name, or an empty one if the path is not interned
+  static PathName Find(const std::string &path);
+
+  // Count of interned components, for test
+  static size_t GetComponentCount();
+
+  bool operator==(const PathName &rhs) const {
+    return m_component == rhs.m_component;
+  }
+  bool operator!=(const PathName &rhs) const {
+    return m_component != rhs.m_component;
+  }
+
+  bool IsEmpty() const { return !m_component; }
+  size_t Hash() const {
+    return std::hash<const PathComponent *>()(m_component.get());
+  }
+
+  // Build the full path
+  std::string ToString() const;
+
+  // Get the name in dir, e.g. "file" for "/dir/file", "sub/" for "/dir/sub/"
+  const std::string &GetName() const;
+
+  // Get the dir path name, which is empty for "/" or a relative name
+  PathName GetParent() const;
+
+ private:
+  explicit PathName(std::shared_ptr<const PathComponent> &&component)
+      : m_component(std::move(component)) {}
+
+  std::shared_ptr<const PathComponent> m_component;
+};
+
+struct PathNameHash {
+  size_t operator()(const PathName &pathName) const {
+    return pathName.Hash();
+  }
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_PATHNAME_H_
@@ -0,0 +1,123 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#ifndef INCLUDE_DATA_SHAREDCACHE_H_
+#define INCLUDE_DATA_SHAREDCACHE_H_
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>
+
+#include <sys/types.h>  // for off_t
+
+#include <functional>
+#include <string>
+
+namespace QS {
+
+namespace Data {
+
+// Cache of object content shared by the qsfs processes on one host
+//
+// Each complete object is stored in one file of the shared directory, named
+// by the hash of bucket and key, the hash of ETag and the object size, so
+// the mounts of the same bucket find the same object content. Using a
+// directory in tmpfs such as /dev/shm makes it a shared memory segment,
+// and using a directory in local disk makes it a shared disk cache.
+//
+// Objects are published by renaming a complete temporary file, so readers
+// never see partial content. Eviction and the reservation of temporary
+// files are serialized among processes by flock of the lock file in the
+// directory, which is released even if the process holding it crashes. A
+// temporary file is locked by flock while its content is copied, so the
+// one left by a crashed process is told apart and removed. A removed file
+// which is still opened by a reader stays readable until it's closed.
+class SharedCache {
+ public:
+  // Construct shared cache
+  //
+  // @param  : shared directory, bucket, capacity in bytes
+  // @return :
+  //
+  // The directory is created if not exists.
+  SharedCache(const std::string &dir, const std::string &bucket,
+              uint64_t capacity);
+
+  SharedCache(SharedCache &&) = default;
+  SharedCache(const SharedCache &) = delete;
+  SharedCache &operator=(SharedCache &&) = default;
+  SharedCache &operator=(const SharedCache &) = delete;
+  ~SharedCache() = default;
+
+ public:
+  // Function to read object content, return size of bytes read
+  using ContentReader = std::function<size_t(off_t, size_t, char *)>;
+
+  const std::string &GetDirectory() const { return m_dir; }
+  uint64_t GetCapacity() const { return m_capacity; }
+
+  // Whether the object content is in shared cache
+  //
+  // @param  : object key, etag, object size
+  // @return : bool
+  bool Has(const std::string &key, const std::string &eTag,
+           uint64_t objectSize) const;
+
+  // Read object content from shared cache
+  //
+  // @param  : object key, etag, object size, offset, len, buffer
+  // @return : size of bytes read, 0 if object is not in shared cache
+  size_t Read(const std::string &key, const std::string &eTag,
+              uint64_t objectSize, off_t offset, size_t len,
+              char *buffer) const;
+
+  // Store object content into shared cache
+  //
+  // @param  : object key, etag, object size, reader of object content
+  // @return : bool
+  //
+  // The least recently used objects are removed to make space if needed.
+  // The lock file is held only to make space and reserve the temporary
+  // file, not while copying the content.
+  bool Store(const std::string &key, const std::string &eTag,
+             uint64_t objectSize, const ContentReader &reader);
+
+  // Get size of all objects in shared cache
+  uint64_t GetSize() const;
+
+ private:
+  // Build file path of the object
+  std::string BuildFilePath(const std::string &key, const std::string &eTag,
+                            uint64_t objectSize) const;
+
+  // Remove the least recently used objects to make space
+  //
+  // @param  : size need to be freed
+  // @return : bool
+  //
+  // Should be called with the lock file locked.
+  bool Evict(uint64_t size);
+
+ private:
+  std::string m_dir;     // shared directory, ending with "/"
+  std::string m_bucket;
+  uint64_t m_capacity = 0;  // in bytes
+};
+
+}  // namespace Data
+}  // namespace QS
+
+#endif  // INCLUDE_DATA_SHAREDCACHE_H_
@@ -27,6 +27,7 @@ namespace Data {
 namespace Size {
 
 static const uint64_t KB1 = 1 * 1024;
+static const uint64_t KB4 = 4 * 1024;
 static const uint64_t KB8 = 8 * 1024;
 static const uint64_t KB10 = 10 * 1024;
 static const uint64_t KB100 = 100 * 1024;
@@ -21,9 +21,13 @@
 #include <sys/statvfs.h>
 
 #include <atomic>  // NOLINT
+#include <condition_variable>  // NOLINT
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -43,9 +47,12 @@ class TransferManager;
 }
 
 namespace Data {
+class AccessHistory;
 class DirectoryTree;
 class FileMetaData;
+class NegativeLookupCache;
 class Node;
+class SharedCache;
 }
 
 namespace FileSystem {
@@ -85,6 +92,16 @@ class Drive {
   // asynchornizely
   bool Connect() const;
 
+  // Prefetch the hottest files in access history in background
+  //
+  // @param  : void
+  // @return : void
+  //
+  // The files are prefetched one by one in a single background task, which
+  // stops once the cache is full, so as not to compete with the foreground
+  // reads for transfers and cache space.
+  void WarmUp();
+
   // Return the drive root node.
   std::shared_ptr<QS::Data::Node> GetRoot();
 
@@ -105,6 +122,20 @@ class Drive {
       const std::string &path, bool updateIfDirectory = false,
       bool updateDirAsync = false);
 
+  // Get the node of a file or a directory
+  //
+  // @param  : path, flag update if is dir, flag update dir async
+  // @return : {node, modified, path_}
+  //          - 1st and 2nd members are the same as GetNode;
+  //          - 3rd member is the path maybe appended with "/"
+  //
+  // LookupNode resolves a path missing in the local dir tree as a file or a
+  // dir with one request to object storage, instead of getting the node of
+  // path and then of path appended with "/" one after another.
+  std::tuple<std::weak_ptr<QS::Data::Node>, bool, std::string> LookupNode(
+      const std::string &path, bool updateIfDirectory = false,
+      bool updateDirAsync = false);
+
   // Get the node from local dir tree
   // @param  : file path
   // @return : node
@@ -216,6 +247,15 @@ class Drive {
   void RenameDir(const std::string &dirPath, const std::string &newDirPath,
                  bool async = false);
 
+  // Share a file with other qsfs processes on the host
+  //
+  // @param  : file path, flag asynchornizely
+  // @return : void
+  //
+  // The file content is stored into shared cache if shared cache is enabled,
+  // and the content is complete in cache and not modified locally.
+  void ShareFile(const std::string &filePath, bool async = false);
+
   // Create a symbolic link to a file
   //
   // @param  : file path to link to, link path
@@ -234,9 +274,14 @@ class Drive {
 
   // Upload a file
   //
-  // @param  : file path
+  // @param  : file path, asynchronously or synchronizely, release the file
   // @return : void
-  void UploadFile(const std::string &filePath, bool async = false);
+  //
+  // A file is uploaded when it's released, or it's written back in background
+  // without being released when there are too many dirty bytes in cache. If
+  // the file is written again during a writeback, it stays dirty.
+  void UploadFile(const std::string &filePath, bool async = false,
+                  bool release = true);
 
   // Change access and modification times of a file
   //
@@ -248,6 +293,12 @@ class Drive {
   //
   // @param  : file path to write data to, buf containing data, size, offset
   // @return : number of bytes has been wrote
+  //
+  // Like the kernel's dirty_background_ratio and dirty_ratio, the dirty files
+  // are written back in background when the dirty bytes are above the dirty
+  // background ratio of cache, and the writer waits for the writebacks when
+  // the dirty bytes are above the dirty ratio of cache. If there is no space
+  // in cache, the writer waits for the writebacks to make space and retry.
   int WriteFile(const std::string &filePath, off_t offset, size_t size,
                 const char *buf);
 
@@ -260,6 +311,34 @@ class Drive {
                                  const QS::Data::ContentRangeDeque &ranges,
                                  time_t mtime, bool async = false);
 
+  // Fill cache with file content from shared cache
+  //
+  // @param  : file node, file path, offset, len
+  // @return : bool, false if the content is not in shared cache
+  bool ReadSharedCache(const std::shared_ptr<QS::Data::Node> &node,
+                       const std::string &filePath, off_t offset, size_t len);
+
+  // Write back dirty files in background
+  //
+  // @param  : file being written, size of dirty bytes to write back
+  // @return : void
+  void WritebackDirtyFiles(const std::string &fileBeingWritten, uint64_t size);
+
+  // Wait for writebacks until the dirty bytes are not above the limit
+  //
+  // @param  : dirty bytes limit
+  // @return : void
+  //
+  // Return when there is no writeback in progress.
+  void WaitForWriteback(uint64_t dirtyLimit);
+
+  // Whether the path is missing in its parent dir listed completely
+  //
+  // @param  : path, expire duration in minutes of the listing
+  // @return : bool
+  bool IsMissingInListedDir(const std::string &path,
+                            int32_t expireDurationInMin) const;
+
  private:
   std::shared_ptr<QS::Client::Client> &GetClient() { return m_client; }
   std::unique_ptr<QS::Client::TransferManager> &GetTransferManager() {
@@ -285,10 +364,18 @@ class Drive {
   std::shared_ptr<QS::Client::Client> m_client;
   std::unique_ptr<QS::Client::TransferManager> m_transferManager;
   std::unique_ptr<QS::Data::Cache> m_cache;
+  std::unique_ptr<QS::Data::SharedCache> m_sharedCache;  // null if disabled
+  std::unique_ptr<QS::Data::AccessHistory> m_accessHistory;  // null if disabled
   std::unique_ptr<QS::Data::DirectoryTree> m_directoryTree;
+  // paths not existing, null if disabled
+  std::unique_ptr<QS::Data::NegativeLookupCache> m_negativeLookupCache;
   std::unordered_map<std::string, std::shared_ptr<QS::Client::TransferHandle>,
                      HashUtils::StringHash>
       m_unfinishedMultipartUploadHandles;
+  std::mutex m_writebackMutex;
+  std::condition_variable m_writebackDone;  // notified by writeback callback
+  std::unordered_set<std::string, HashUtils::StringHash>
+      m_writebackFiles;  // files being written back
 
   friend class QS::Client::QSClient;
   friend class QS::Client::QSTransferManager;  // for cache
@@ -111,6 +111,10 @@ ClientError<QSError> NullClient::Stat(const std::string &path,
   return GoodState();
 }
 
+ClientError<QSError> NullClient::Lookup(const std::string &path) {
+  return GoodState();
+}
+
 ClientError<QSError> NullClient::Statvfs(struct statvfs *stvfs) {
   return GoodState();
 }
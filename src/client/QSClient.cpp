@@ -19,8 +19,10 @@
 #include <assert.h>
 #include <stdint.h>  // for uint64_t
 
+#include <algorithm>
 #include <chrono>  // NOLINT
 #include <cmath>
+#include <future>  // NOLINT
 #include <iostream>
 #include <memory>
 #include <mutex>  // NOLINT
@@ -94,6 +96,7 @@ using std::shared_ptr;
 using std::string;
 using std::stringstream;
 using std::unique_ptr;
+using std::vector;
 
 namespace {
 
@@ -713,11 +716,13 @@ ClientError<QSError> QSClient::ListDirectory(const string &dirPath,
 
   bool resultTruncated = false;
   uint64_t resCount = 0;
+  vector<string> childPaths;  // to check if the dir is listed completely
   do {
     uint64_t countPerList = 0;
     auto outcome = ListObjects(dirPath, &resultTruncated, &countPerList,
                                maxCountPerList, useThreadPool);
     if (!outcome.IsSuccess()) {
+      dirTree->SetDirectoryListed(dirPath, childPaths, false);
       return outcome.GetError();
     }
 
@@ -728,11 +733,17 @@ ClientError<QSError> QSClient::ListDirectory(const string &dirPath,
         auto fileMetaDatas =
             QSClientConverter::ListObjectsOutputToFileMetaDatas(
                 listObjOutput, true);  // add dir itself
+        for (auto &meta : fileMetaDatas) {
+          childPaths.push_back(meta->GetFilePath());
+        }
         dirTree->Grow(std::move(fileMetaDatas));
       } else {  // directory existing
         auto fileMetaDatas =
             QSClientConverter::ListObjectsOutputToFileMetaDatas(
                 listObjOutput, false);  // not add dir itself
+        for (auto &meta : fileMetaDatas) {
+          childPaths.push_back(meta->GetFilePath());
+        }
         if (dirNode->IsEmpty()) {
           dirTree->Grow(std::move(fileMetaDatas));
         } else {
@@ -742,6 +753,9 @@ ClientError<QSError> QSClient::ListDirectory(const string &dirPath,
     }  // for list object output
   } while (resultTruncated && (listAll || resCount < maxListCount));
 
+  // a lookup of the file not listed in the dir needs no round trip, unless
+  // the listing is truncated
+  dirTree->SetDirectoryListed(dirPath, childPaths, !resultTruncated);
   return ClientError<QSError>(QSError::GOOD, false);
 }
 
@@ -879,6 +893,58 @@ ClientError<QSError> QSClient::Stat(const string &path, time_t modifiedSince,
   }
 }
 
+// --------------------------------------------------------------------------
+ClientError<QSError> QSClient::Lookup(const string &path) {
+  if (IsRootDirectory(path) || path.back() == '/') {
+    return Stat(path);
+  }
+
+  // List the dir prefix while heading the file. With a limit of 1, the dir
+  // object (if exists) is the listed key as it sorts first under the prefix.
+  auto dirPath = AppendPathDelim(path);
+  auto DoListDirPrefix = [this, dirPath]() {
+    ListObjectsInput listObjInput;
+    listObjInput.SetLimit(1);
+    listObjInput.SetDelimiter(QS::Utils::GetPathDelimiter());
+    listObjInput.SetPrefix(LTrim(dirPath, '/'));
+    return GetQSClientImpl()->ListObjects(&listObjInput, nullptr, nullptr, 1);
+  };
+  auto fListOutcome = GetExecutor()->SubmitCallablePrioritized(DoListDirPrefix);
+
+  auto err = Stat(path);  // head the file
+  auto listOutcome = fListOutcome.get();
+  if (IsGoodQSError(err) || err.GetError() != QSError::KEY_NOT_EXIST) {
+    return err;
+  }
+  if (!listOutcome.IsSuccess()) {
+    return listOutcome.GetError();
+  }
+
+  for (auto &listObjOutput : listOutcome.GetResult()) {
+    if (listObjOutput.GetKeys().empty() &&
+        listObjOutput.GetCommonPrefixes().empty()) {
+      continue;
+    }
+    // the dir meta is built from the dir object, or by default for a dir
+    // existing only as a prefix of other objects
+    auto metas = QSClientConverter::ListObjectsOutputToFileMetaDatas(
+        listObjOutput, true);
+    auto it = std::find_if(
+        metas.begin(), metas.end(),
+        [&dirPath](const shared_ptr<QS::Data::FileMetaData> &meta) {
+          return meta->GetFilePath() == dirPath;
+        });
+    if (it != metas.end()) {
+      auto &dirTree = Drive::Instance().GetDirectoryTree();
+      assert(dirTree);
+      dirTree->Grow(std::move(*it));  // add dir node
+      return ClientError<QSError>(QSError::GOOD, false);
+    }
+  }
+
+  return err;
+}
+
 // --------------------------------------------------------------------------
 ClientError<QSError> QSClient::Statvfs(struct statvfs *stvfs) {
   assert(stvfs != nullptr);
@@ -429,7 +429,7 @@ void QSTransferManager::DoSinglePartUpload(
   auto &dirTree = drive.GetDirectoryTree();
   auto node = dirTree->Find(objKey).lock();
   assert(node && *node);
-  auto res = cache->Read(objKey, 0, fileSize, &(*buf)[0], node->GetMTime());
+  auto res = cache->Read(objKey, 0, fileSize, &(*buf)[0]);
   auto readSize = std::get<0>(res);
   if (readSize != fileSize) {
     DebugError("Fail to read cache [file:offset:len:readsize=" + objKey +
@@ -506,7 +506,7 @@ void QSTransferManager::DoMultiPartUpload(
     }
 
     auto res = cache->Read(objKey, part->GetRangeBegin(), part->GetSize(),
-                           &(*buffer)[0], node->GetMTime());
+                           &(*buffer)[0]);
     auto readSize = std::get<0>(res);
     if (readSize != part->GetSize()) {
       DebugError("Fail to read cache [file:offset:len:readsize=" + objKey +
@@ -38,6 +38,7 @@ using std::vector;
 static const char* const PROGRAM_NAME = "qsfs";
 static const char* const QSFS_DEFAULT_CREDENTIALS = "/opt/qsfs/qsfs.cred";
 static const char* const QSFS_DEFAULT_DISK_CACHE_DIR = "/tmp/qsfs_cache/";
+static const char* const QSFS_DISK_CACHE_INDEX_FILE = ".qsfs_cache_index";
 static uint16_t const    QSFS_DEFAULT_MAX_RETRIES = 3;
 static const char* const QSFS_DEFAULT_LOG_DIR = "/opt/qsfs/qsfs_log/";
 static const char* const QSFS_DEFAULT_LOGLEVEL_NAME = "INFO";
@@ -52,6 +53,7 @@ const char* GetProgramName() { return PROGRAM_NAME; }
 
 string GetDefaultCredentialsFile() { return QSFS_DEFAULT_CREDENTIALS; }
 string GetDefaultDiskCacheDirectory() { return QSFS_DEFAULT_DISK_CACHE_DIR; }
+string GetDiskCacheIndexFileName() { return QSFS_DISK_CACHE_INDEX_FILE; }
 uint16_t GetDefaultMaxRetries() { return QSFS_DEFAULT_MAX_RETRIES; }
 string GetDefaultLogDirectory() { return QSFS_DEFAULT_LOG_DIR; }
 string GetDefaultLogLevelName() { return QSFS_DEFAULT_LOGLEVEL_NAME; }
@@ -104,10 +106,38 @@ uint64_t GetMaxCacheSize() {
   return QS::Data::Size::MB100;  // default value
 }
 
+uint64_t GetMaxDiskCacheSize() {
+  return 0;  // default value, disk tier is disabled
+}
+
+uint64_t GetMaxSharedCacheSize() {
+  return QS::Data::Size::GB1;  // default value
+}
+
+uint64_t GetDiskCacheBlockSize() {
+  return 64 * QS::Data::Size::KB1;  // default value
+}
+
+uint64_t GetMaxPageExtentSize() {
+  return QS::Data::Size::MB1;  // default value
+}
+
+uint16_t GetDefaultDirtyRatio() {
+  return 40;  // default value
+}
+
+uint16_t GetDefaultDirtyBackgroundRatio() {
+  return 10;  // default value
+}
+
 size_t GetMaxStatCount() {
   return QS::Data::Size::K20;  // default value
 }
 
+uint32_t GetDefaultNegativeExpireInSec() {
+  return 5;  // default value
+}
+
 uint16_t GetMaxListObjectsCount() {
   return QS::Data::Size::K1;  // default value
 }
@@ -32,17 +32,22 @@ namespace Configure {
 
 using QS::Configure::Default::GetClientDefaultPoolSize;
 using QS::Configure::Default::GetDefaultCredentialsFile;
+using QS::Configure::Default::GetDefaultDirtyBackgroundRatio;
+using QS::Configure::Default::GetDefaultDirtyRatio;
 using QS::Configure::Default::GetDefaultDiskCacheDirectory;
 using QS::Configure::Default::GetDefaultLogDirectory;
 using QS::Configure::Default::GetDefaultLogLevelName;
 using QS::Configure::Default::GetDefaultHostName;
 using QS::Configure::Default::GetDefaultMaxRetries;
+using QS::Configure::Default::GetDefaultNegativeExpireInSec;
 using QS::Configure::Default::GetDefaultPort;
 using QS::Configure::Default::GetDefaultProtocolName;
 using QS::Configure::Default::GetDefaultParallelTransfers;
 using QS::Configure::Default::GetDefaultTransferBufSize;
 using QS::Configure::Default::GetDefaultZone;
 using QS::Configure::Default::GetMaxCacheSize;
+using QS::Configure::Default::GetMaxDiskCacheSize;
+using QS::Configure::Default::GetMaxSharedCacheSize;
 using QS::Configure::Default::GetMaxListObjectsCount;
 using QS::Configure::Default::GetMaxStatCount;
 using QS::Configure::Default::GetTransactionDefaultTimeDuration;
@@ -70,10 +75,26 @@ Options::Options()
       m_retries(GetDefaultMaxRetries()),
       m_requestTimeOut(GetTransactionDefaultTimeDuration()),
       m_maxCacheSizeInMB(GetMaxCacheSize() / QS::Data::Size::MB1),
+      m_maxDiskCacheSizeInMB(GetMaxDiskCacheSize() / QS::Data::Size::MB1),
       m_diskCacheDir(GetDefaultDiskCacheDirectory()),
+      m_keepDiskCache(false),
+      m_diskDirectIO(false),
+      m_compressCache(false),
+      m_admissionFilter(false),
+      m_memoryPressure(false),
+      m_cachePolicyFile(),
+      m_sharedCacheDir(),
+      m_maxSharedCacheSizeInMB(GetMaxSharedCacheSize() / QS::Data::Size::MB1),
+      m_accessLogFile(),
+      m_warmUpCount(0),
+      m_fileQuota(0),
+      m_fileQuotaInPercent(false),
+      m_dirtyRatio(GetDefaultDirtyRatio()),
+      m_dirtyBackgroundRatio(GetDefaultDirtyBackgroundRatio()),
       m_maxStatCountInK(GetMaxStatCount() / QS::Data::Size::K1),
       m_maxListCount(GetMaxListObjectsCount()),
       m_statExpireInMin(-1),  // default disable state expire
+      m_negativeExpireInSec(GetDefaultNegativeExpireInSec()),
       m_parallelTransfers(GetDefaultParallelTransfers()),
       m_transferBufferSizeInMB(GetDefaultTransferBufSize() /
                                QS::Data::Size::MB1),
@@ -114,10 +135,32 @@ ostream &operator<<(ostream &os, const Options &opts) {
          << "[retries: " << to_string(opts.m_retries) << "] "
          << "[req timeout(ms): " << to_string(opts.m_requestTimeOut) << "] "
          << "[max cache(MB): " << to_string(opts.m_maxCacheSizeInMB) << "] "
+         << "[max disk cache(MB): " << to_string(opts.m_maxDiskCacheSizeInMB)
+         << "] "
          << "[disk cache dir: " << opts.m_diskCacheDir << "] "
+         << "[keep disk cache: " << std::boolalpha << opts.m_keepDiskCache
+         << "] "
+         << "[disk direct io: " << opts.m_diskDirectIO << "] "
+         << "[compress cache: " << opts.m_compressCache << "] "
+         << "[admission filter: " << opts.m_admissionFilter << "] "
+         << "[memory pressure: " << opts.m_memoryPressure << "] "
+         << std::noboolalpha
+         << "[cache policy file: " << opts.m_cachePolicyFile << "] "
+         << "[shared cache dir: " << opts.m_sharedCacheDir << "] "
+         << "[max shared cache(MB): "
+         << to_string(opts.m_maxSharedCacheSizeInMB) << "] "
+         << "[access log file: " << opts.m_accessLogFile << "] "
+         << "[warm up count: " << to_string(opts.m_warmUpCount) << "] "
+         << "[file quota: " << to_string(opts.m_fileQuota)
+         << (opts.m_fileQuotaInPercent ? "%" : "MB") << "] "
+         << "[dirty ratio(%): " << to_string(opts.m_dirtyRatio) << "] "
+         << "[dirty background ratio(%): "
+         << to_string(opts.m_dirtyBackgroundRatio) << "] "
          << "[max stat(K): " << to_string(opts.m_maxStatCountInK) << "] "
          << "[max list: " << to_string(opts.m_maxListCount) << "] "
          << "[stat expire(min): " << to_string(opts.m_statExpireInMin) << "] "
+         << "[negative expire(sec): " << to_string(opts.m_negativeExpireInSec)
+         << "] "
          << "[num transfers: " << to_string(opts.m_parallelTransfers) << "] "
          << "[transfer buf(MB): " << to_string(opts.m_transferBufferSizeInMB) <<"] "  // NOLINT
          << "[pool size: " << to_string(opts.m_clientPoolSize) << "] "
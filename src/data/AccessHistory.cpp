@@ -0,0 +1,240 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/AccessHistory.h"
+
+#include <math.h>  // for exp2
+#include <stdio.h>  // for rename
+#include <time.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>  // NOLINT
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/LogMacros.h"
+#include "base/StringUtils.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::StringUtils::FormatPath;
+using std::ifstream;
+using std::istringstream;
+using std::lock_guard;
+using std::mutex;
+using std::ofstream;
+using std::string;
+using std::vector;
+
+namespace {
+
+constexpr double kHeatHalfLifeInSec = 3600;
+constexpr time_t kRecordIntervalInSec = 1;
+constexpr time_t kSaveIntervalInSec = 60;
+constexpr const char *kTmpFileSuffix = ".tmp";
+
+// --------------------------------------------------------------------------
+double DecayedHeat(const AccessRecord &record, time_t now) {
+  if (now <= record.time) {
+    return record.heat;
+  }
+  return record.heat * exp2(-static_cast<double>(now - record.time) /
+                            kHeatHalfLifeInSec);
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+AccessHistory::AccessHistory(const string &file, size_t maxNumRecords)
+    : m_file(file), m_maxNumRecords(maxNumRecords), m_savedTime(time(NULL)) {}
+
+// --------------------------------------------------------------------------
+bool AccessHistory::Load() {
+  ifstream in(m_file);
+  if (!in) {
+    DebugInfo("No access history " + FormatPath(m_file));
+    return false;
+  }
+
+  lock_guard<mutex> lock(m_mutex);
+  string line;
+  while (std::getline(in, line)) {
+    istringstream ss(line);
+    AccessRecord record;
+    if (!(ss >> record.heat >> record.time >> record.offset >> record.size) ||
+        ss.get() != ' ' || !std::getline(ss, record.path) ||
+        record.path.empty() || record.offset < 0) {
+      DebugWarning("Skip invalid access record [" + line + "]");
+      continue;
+    }
+    auto path = record.path;
+    m_records[path] = std::move(record);
+  }
+  UnguardedPrune(time(NULL));
+  return true;
+}
+
+// --------------------------------------------------------------------------
+bool AccessHistory::Save() {
+  auto now = time(NULL);
+  vector<AccessRecord> records;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_savedTime = now;
+    records.reserve(m_records.size());
+    for (auto &item : m_records) {
+      records.push_back(item.second);
+    }
+  }
+  return SaveRecords(records, now);
+}
+
+// --------------------------------------------------------------------------
+bool AccessHistory::Record(const string &path, off_t offset, size_t len) {
+  if (m_maxNumRecords == 0) {
+    return false;
+  }
+  auto now = time(NULL);
+  lock_guard<mutex> lock(m_mutex);
+  auto it = m_records.find(path);
+  bool isNew = it == m_records.end();
+  if (isNew) {
+    if (m_records.size() >= m_maxNumRecords) {
+      UnguardedRemoveColdest(now);
+    }
+    it = m_records.emplace(path, AccessRecord()).first;
+  }
+  auto &record = it->second;
+  if (isNew) {
+    record.path = path;
+    record.offset = offset;
+    record.size = len;
+  } else {
+    auto stop = std::max(record.offset + static_cast<off_t>(record.size),
+                         offset + static_cast<off_t>(len));
+    record.offset = std::min(record.offset, offset);
+    record.size = static_cast<size_t>(stop - record.offset);
+  }
+  if (record.heat == 0 || now - record.time >= kRecordIntervalInSec) {
+    record.heat = DecayedHeat(record, now) + 1;
+    record.time = now;
+  }
+
+  if (now - m_savedTime >= kSaveIntervalInSec) {
+    m_savedTime = now;  // leave the saving to the only caller
+    return true;
+  }
+  return false;
+}
+
+// --------------------------------------------------------------------------
+vector<AccessRecord> AccessHistory::GetHottest(size_t num) const {
+  auto now = time(NULL);
+  vector<AccessRecord> records;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    records.reserve(m_records.size());
+    for (auto &item : m_records) {
+      records.push_back(item.second);
+      records.back().heat = DecayedHeat(item.second, now);
+    }
+  }
+  auto Hotter = [](const AccessRecord &a, const AccessRecord &b) {
+    return a.heat > b.heat;
+  };
+  if (num < records.size()) {
+    std::partial_sort(records.begin(), records.begin() + num, records.end(),
+                      Hotter);
+    records.resize(num);
+  } else {
+    std::sort(records.begin(), records.end(), Hotter);
+  }
+  return records;
+}
+
+// --------------------------------------------------------------------------
+size_t AccessHistory::GetNumRecords() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_records.size();
+}
+
+// --------------------------------------------------------------------------
+bool AccessHistory::SaveRecords(const vector<AccessRecord> &records,
+                                time_t now) {
+  lock_guard<mutex> lock(m_saveMutex);
+  auto tmpFile = m_file + kTmpFileSuffix;
+  {
+    ofstream out(tmpFile, std::ios_base::trunc);
+    for (auto &record : records) {
+      out << std::setprecision(6) << DecayedHeat(record, now) << ' ' << now
+          << ' ' << record.offset << ' ' << record.size << ' ' << record.path
+          << '\n';
+    }
+    out.flush();
+    if (!out) {
+      DebugError("Fail to write access history " + FormatPath(tmpFile));
+      return false;
+    }
+  }
+  if (rename(tmpFile.c_str(), m_file.c_str()) != 0) {
+    DebugError("Fail to save access history " + FormatPath(m_file));
+    return false;
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------
+void AccessHistory::UnguardedPrune(time_t now) {
+  if (m_records.size() <= m_maxNumRecords) {
+    return;
+  }
+  vector<std::pair<double, string>> heats;
+  heats.reserve(m_records.size());
+  for (auto &item : m_records) {
+    heats.emplace_back(DecayedHeat(item.second, now), item.first);
+  }
+  auto coldest = heats.begin() + (heats.size() - m_maxNumRecords);
+  std::nth_element(heats.begin(), coldest, heats.end());
+  for (auto it = heats.begin(); it != coldest; ++it) {
+    m_records.erase(it->second);
+  }
+}
+
+// --------------------------------------------------------------------------
+void AccessHistory::UnguardedRemoveColdest(time_t now) {
+  auto coldest = m_records.end();
+  double coldestHeat = 0;
+  for (auto it = m_records.begin(); it != m_records.end(); ++it) {
+    auto heat = DecayedHeat(it->second, now);
+    if (coldest == m_records.end() || heat < coldestHeat) {
+      coldest = it;
+      coldestHeat = heat;
+    }
+  }
+  if (coldest != m_records.end()) {
+    m_records.erase(coldest);
+  }
+}
+
+}  // namespace Data
+}  // namespace QS
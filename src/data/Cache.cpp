@@ -27,10 +27,12 @@
 #include <utility>
 #include <vector>
 
+#include "base/HashUtils.h"
 #include "base/LogMacros.h"
 #include "base/StringUtils.h"
 #include "base/TimeUtils.h"
 #include "base/Utils.h"
+#include "configure/Default.h"
 #include "configure/Options.h"
 #include "data/StreamUtils.h"
 
@@ -38,13 +40,16 @@ namespace QS {
 
 namespace Data {
 
+using QS::Configure::Default::GetDiskCacheBlockSize;
 using QS::Data::StreamUtils::GetStreamSize;
+using QS::HashUtils::StableHash64;
 using QS::StringUtils::FormatPath;
 using QS::StringUtils::PointerAddress;
 using QS::TimeUtils::SecondsToRFC822GMT;
 using QS::Utils::CreateDirectoryIfNotExists;
 using QS::Utils::GetBaseName;
-using QS::Utils::IsSafeDiskSpace;
+using QS::Utils::GetFreeDiskSpace;
+using QS::Utils::RemoveFileIfExists;
 using std::deque;
 using std::iostream;
 using std::make_shared;
@@ -55,11 +60,63 @@ using std::to_string;
 using std::unique_ptr;
 using std::vector;
 
+namespace {
+
+// Interval to check the free space of disk by statvfs
+constexpr time_t kDiskSpaceCheckIntervalInSec = 5;
+
+// Build the key of object content in etag index
+string BuildETagKey(const string &eTag, uint64_t objectSize) {
+  return eTag + ":" + to_string(objectSize);
+}
+
+// Build the disk file name for a file
+//
+// @param  : file id
+// @return : string
+//
+// Files with same base name in different dirs should not share a disk file,
+// so the name is prefixed with a hash of the file id.
+string BuildDiskFileName(const string &fileId) {
+  uint64_t hash = StableHash64(fileId);
+  static const char *const hexDigits = "0123456789abcdef";
+  string name(16, '0');
+  for (int i = 15; i >= 0; --i) {
+    name[i] = hexDigits[hash & 0xf];
+    hash >>= 4;
+  }
+  // keep name within max file name length
+  return name + "_" + GetBaseName(fileId).substr(0, 200);
+}
+
+}  // namespace
+
 // --------------------------------------------------------------------------
 bool Cache::HasFreeSpace(size_t size) const {
   return GetSize() + size <= GetCapacity();
 }
 
+// --------------------------------------------------------------------------
+bool Cache::HasFreeDiskSpace(const string &diskfolder, size_t size) const {
+  if (m_diskCapacity > 0 && m_diskSize + size > m_diskCapacity) {
+    return false;
+  }
+  time_t now = time(NULL);
+  if (diskfolder != m_diskSpaceFolder ||
+      now - m_diskSpaceCheckedTime >= kDiskSpaceCheckIntervalInSec ||
+      now < m_diskSpaceCheckedTime) {
+    m_diskSpaceFolder = diskfolder;
+    m_diskFreeSpace = GetFreeDiskSpace(diskfolder, true);
+    m_diskSizeWhenChecked = m_diskSize;
+    m_diskSpaceCheckedTime = now;
+  }
+  // bytes added into disk cache since last check are taken from free space
+  auto freeSpace = static_cast<int64_t>(m_diskFreeSpace) -
+                   (static_cast<int64_t>(m_diskSize) -
+                    static_cast<int64_t>(m_diskSizeWhenChecked));
+  return freeSpace > static_cast<int64_t>(size);
+}
+
 // --------------------------------------------------------------------------
 bool Cache::IsLastFileOpen() const {
   if (m_cache.empty()) {
@@ -117,6 +174,23 @@ time_t Cache::GetTime(const string &fileId) const {
   }
 }
 
+// --------------------------------------------------------------------------
+string Cache::GetETag(const string &fileId) const {
+  auto it = m_map.find(fileId);
+  if (it != m_map.end()) {
+    auto pfile = &(it->second->second);
+    return (*pfile)->GetETag();
+  } else {
+    return string();
+  }
+}
+
+// --------------------------------------------------------------------------
+uint64_t Cache::GetDirtyGeneration(const string &fileId) const {
+  auto it = m_map.find(fileId);
+  return it != m_map.end() ? it->second->second->GetDirtyGeneration() : 0;
+}
+
 // --------------------------------------------------------------------------
 uint64_t Cache::GetFileSize(const std::string &filePath) const {
   auto it = m_map.find(filePath);
@@ -128,6 +202,101 @@ uint64_t Cache::GetFileSize(const std::string &filePath) const {
   }
 }
 
+// --------------------------------------------------------------------------
+vector<string> Cache::GetDirtyFiles(uint64_t size,
+                                    const string &fileExcluded) const {
+  vector<string> files;
+  uint64_t dirtySize = 0;
+  for (auto it = m_cache.rbegin(); it != m_cache.rend() && dirtySize < size;
+       ++it) {
+    auto &file = it->second;
+    if (file && file->IsDirty() && it->first != fileExcluded) {
+      files.push_back(it->first);
+      dirtySize += file->GetDirtySize();
+    }
+  }
+  return files;
+}
+
+// --------------------------------------------------------------------------
+void Cache::SetMemoryPressure(unique_ptr<MemoryPressure> memoryPressure) {
+  m_memoryPressure = std::move(memoryPressure);
+  m_maxCapacity = m_capacity;
+  m_capacityAdaptedTime = 0;
+}
+
+// --------------------------------------------------------------------------
+void Cache::SetCachePolicy(unique_ptr<CachePolicy> cachePolicy) {
+  m_cachePolicy = std::move(cachePolicy);
+  for (auto &item : m_cache) {
+    if (item.second) {
+      item.second->SetPolicy(GetCacheRule(item.first));
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+CacheRule Cache::GetCacheRule(const string &fileId) const {
+  return m_cachePolicy ? m_cachePolicy->Match(fileId) : CacheRule();
+}
+
+// --------------------------------------------------------------------------
+void Cache::SetFrequencySketch(unique_ptr<FrequencySketch> sketch) {
+  m_sketch = std::move(sketch);
+}
+
+// --------------------------------------------------------------------------
+void Cache::SetFileQuota(uint64_t quota, bool inPercent) {
+  m_fileQuota = inPercent ? std::min<uint64_t>(quota, 100) : quota;
+  m_fileQuotaInPercent = inPercent;
+}
+
+// --------------------------------------------------------------------------
+uint64_t Cache::GetFileQuota() const {
+  if (m_fileQuotaInPercent) {
+    // the capacity may be elastic, so the quota follows it
+    return m_fileQuota == 100 ? 0 : GetCapacity() * m_fileQuota / 100;
+  }
+  return m_fileQuota;
+}
+
+// --------------------------------------------------------------------------
+void Cache::RecordAccess(const string &fileId) {
+  if (m_sketch) {
+    m_sketch->Increment(fileId);
+  }
+}
+
+// --------------------------------------------------------------------------
+bool Cache::Admit(const string &fileId, size_t size) const {
+  if (!m_sketch || HasFile(fileId) || HasFreeSpace(size)) {
+    return true;
+  }
+  // Compare with the victim which Free would discard first
+  for (auto it = m_cache.rbegin(); it != m_cache.rend(); ++it) {
+    auto &file = it->second;
+    if (file && !file->IsOpen() && !file->IsDirty() && !file->IsPinned() &&
+        file->GetCachedSize() > 0) {
+      return m_sketch->Estimate(fileId) > m_sketch->Estimate(it->first);
+    }
+  }
+  return true;  // nothing to displace
+}
+
+// --------------------------------------------------------------------------
+string Cache::GetTierHitRatios() const {
+  uint64_t memory = m_tierStats.memory;
+  uint64_t compressed = m_tierStats.compressed;
+  uint64_t disk = m_tierStats.disk;
+  uint64_t missed = m_tierStats.missed;
+  uint64_t total = memory + compressed + disk + missed;
+  auto Ratio = [total](uint64_t size) -> string {
+    return total == 0 ? "0%" : to_string(size * 100 / total) + "%";
+  };
+  return "[memory: " + Ratio(memory) + "] [compressed: " + Ratio(compressed) +
+         "] [disk: " + Ratio(disk) + "] [missed: " + Ratio(missed) + "]";
+}
+
 // --------------------------------------------------------------------------
 CacheListIterator Cache::Find(const string &filePath) {
   auto it = m_map.find(filePath);
@@ -145,9 +314,18 @@ pair<size_t, ContentRangeDeque> Cache::Read(const string &fileId, off_t offset,
                                             size_t len, char *buffer,
                                             time_t mtimeSince) {
   ContentRangeDeque unloadedRanges;
+  auto readSize =
+      Read(fileId, offset, len, buffer, mtimeSince, &unloadedRanges);
+  return {readSize, std::move(unloadedRanges)};
+}
+
+// --------------------------------------------------------------------------
+size_t Cache::Read(const string &fileId, off_t offset, size_t len,
+                   char *buffer, time_t mtimeSince,
+                   ContentRangeDeque *unloadedRanges) {
   if (len == 0) {
-    return {0, unloadedRanges};  // do nothing, this case could happen for
-                                 // truncate file to empty
+    return 0;  // do nothing, this case could happen for
+               // truncate file to empty
   }
 
   bool validInput =
@@ -156,84 +334,81 @@ pair<size_t, ContentRangeDeque> Cache::Read(const string &fileId, off_t offset,
   if (!validInput) {
     DebugError("Try to read cache with invalid input " +
                ToStringLine(fileId, offset, len, buffer));
-    return {0, unloadedRanges};
+    return 0;
   }
 
   DebugInfo("Read cache [offset:len=" + to_string(offset) + ":" +
             to_string(len) + "] " + FormatPath(fileId));
-  memset(buffer, 0, len);  // Clear input buffer.
-  size_t cachedSizeBegin = 0;
-  auto pos = m_cache.begin();
+  AdaptCapacity();
   auto it = m_map.find(fileId);
-  if (it != m_map.end()) {
-    pos = UnguardedMakeFileMostRecentlyUsed(it->second);
-    cachedSizeBegin = pos->second->GetCachedSize();
-  } else {
+  if (it == m_map.end()) {
     DebugInfo("File not exist in cache. Create new one" + fileId);
-    pos = UnguardedNewEmptyFile(fileId, mtimeSince);
-    unloadedRanges.emplace_back(offset, len);
-    return {0, unloadedRanges};
+    UnguardedNewEmptyFile(fileId, mtimeSince);
+    m_tierStats.missed += len;
+    memset(buffer, 0, len);
+    if (unloadedRanges != nullptr) {
+      unloadedRanges->emplace_back(offset, len);
+    }
+    return 0;
   }
 
-  assert(pos != m_cache.end());
-  auto pfile = &(pos->second);
-  if (mtimeSince > (*pfile)->GetTime()) {
+  auto pos = UnguardedMakeFileMostRecentlyUsed(it->second);
+  auto &file = pos->second;
+  if (mtimeSince > file->GetTime()) {
     DebugWarning("File too old, read no bytes " + FormatPath(fileId) +
                  "[mtime]" + SecondsToRFC822GMT(mtimeSince) + " [file time]" +
-                 SecondsToRFC822GMT((*pfile)->GetTime()));
-    unloadedRanges.emplace_back(offset, len);
-    return {0, unloadedRanges};
-  }
-  auto outcome = (*pfile)->Read(offset, len, mtimeSince);
-  auto readedFileSize = std::get<0>(outcome);
-  auto &pagelist = std::get<1>(outcome);
-  unloadedRanges = std::move(std::get<2>(outcome));
-  if (readedFileSize == 0 || pagelist.empty()) {
-    DebugWarning("Read no bytes from file [offset:len=" + to_string(offset) +
-                 ":" + to_string(len) + "] " + FormatPath(fileId));
-    return {0, unloadedRanges};
-  }
-
-  size_t addedCacheSize = (*pfile)->GetCachedSize() - cachedSizeBegin;
-  if (addedCacheSize > 0) {
-    // Update cache status.
-    bool success = Free(addedCacheSize, fileId);
-    if (!success) {
-      DebugWarning("Cache is full. Unable to free added" +
-                   to_string(addedCacheSize) + " bytes when reading file " +
-                   FormatPath(fileId));
+                 SecondsToRFC822GMT(file->GetTime()));
+    m_tierStats.missed += len;
+    memset(buffer, 0, len);
+    if (unloadedRanges != nullptr) {
+      unloadedRanges->emplace_back(offset, len);
     }
-    m_size += addedCacheSize;
-  }
-
-  // Notice outcome pagelist could has more content than required
-  auto page = pagelist.front();  // copy instead use reference
-  pagelist.pop_front();
-  if (pagelist.empty()) {  // Only a single page.
-    auto sz = std::min(len, readedFileSize);
-    return {page->Read(offset, sz, buffer), unloadedRanges};
-  } else {  // Have Multipule pages.
-    // read first page
-    auto readSize = page->Read(static_cast<off_t>(offset), buffer);
-    page = pagelist.front();
-    pagelist.pop_front();
-    // read middle pages
-    while (!pagelist.empty()) {
-      readSize += page->Read(buffer + page->Offset() - offset);
-      page = pagelist.front();
-      pagelist.pop_front();
-    }
-    // read last page
-    auto sz = std::min(readedFileSize - readSize, len - readSize);
-    readSize +=
-        page->Read(static_cast<size_t>(sz), buffer + page->Offset() - offset);
-    return {readSize, unloadedRanges};
+    return 0;
+  }
+
+  UnguardedPromoteHotPages(fileId, file.get());
+  auto cachedSizeBegin = file->GetCachedSize();
+  auto readSize = file->Read(offset, len, buffer, mtimeSince, unloadedRanges,
+                             &m_tierStats);
+  UnguardedAddDecompressedSize(fileId, file->GetCachedSize() - cachedSizeBegin);
+  DebugWarningIf(readSize == 0,
+                 "Read no bytes from file [offset:len=" + to_string(offset) +
+                     ":" + to_string(len) + "] " + FormatPath(fileId));
+  return readSize;
+}
+
+// --------------------------------------------------------------------------
+size_t Cache::ReadSlices(const string &fileId, off_t offset, size_t len,
+                         FileSliceVec *slices, time_t mtimeSince) {
+  bool validInput = !fileId.empty() && offset >= 0 && slices != nullptr;
+  assert(validInput);
+  if (!validInput) {
+    DebugError("Try to read cache slices with invalid input " +
+               ToStringLine(fileId, offset, len, nullptr));
+    return 0;
+  }
+
+  auto it = m_map.find(fileId);
+  if (it == m_map.end()) {
+    return 0;
+  }
+  auto pos = UnguardedMakeFileMostRecentlyUsed(it->second);
+  auto &file = pos->second;
+  if (mtimeSince > file->GetTime()) {
+    DebugWarning("File too old, read no slices " + FormatPath(fileId));
+    return 0;
   }
+  UnguardedPromoteHotPages(fileId, file.get());
+  auto cachedSizeBegin = file->GetCachedSize();
+  auto size =
+      file->ReadSlices(offset, len, slices, mtimeSince, nullptr, &m_tierStats);
+  UnguardedAddDecompressedSize(fileId, file->GetCachedSize() - cachedSizeBegin);
+  return size;
 }
 
 // --------------------------------------------------------------------------
 bool Cache::Write(const string &fileId, off_t offset, size_t len,
-                  const char *buffer, time_t mtime) {
+                  const char *buffer, time_t mtime, bool dirty) {
   if (len == 0) {
     auto it = m_map.find(fileId);
     if (it != m_map.end()) {
@@ -255,15 +430,21 @@ bool Cache::Write(const string &fileId, off_t offset, size_t len,
 
   DebugInfo("Write cache [offset:len=" + to_string(offset) + ":" +
             to_string(len) + "] " + FormatPath(fileId));
-  auto res = PrepareWrite(fileId, len, mtime);
+  auto res = PrepareWrite(fileId, offset, len, mtime);
   auto success = res.first;
   if (success) {
     auto file = res.second;
     assert(file != nullptr);
+    auto cachedSizeBegin = (*file)->GetCachedSize();
+    auto diskSizeBegin = (*file)->GetDiskSize();
     auto res = (*file)->Write(offset, len, buffer, mtime);
     success = std::get<0>(res);
-    if (success) {
-      m_size += std::get<1>(res);  // added size in cache
+    // added size in cache, including the size of decompressed pages
+    m_size += (*file)->GetCachedSize() - cachedSizeBegin;
+    m_diskSize += (*file)->GetDiskSize() - diskSizeBegin;
+    UnguardedChargeSharedPages();  // written pages are unshared
+    if (success && dirty) {
+      m_dirtySize += (*file)->AddDirtyRange(offset, len);
     }
   }
   return success;
@@ -302,26 +483,40 @@ bool Cache::Write(const string &fileId, off_t offset, size_t len,
 
   DebugInfo("Write cache [offset:len=" + to_string(offset) + ":" +
             to_string(len) + "] " + FormatPath(fileId));
-  auto res = PrepareWrite(fileId, len, mtime);
+  auto res = PrepareWrite(fileId, offset, len, mtime);
   auto success = res.first;
   if (success) {
     auto file = res.second;
     assert(file != nullptr);
+    auto cachedSizeBegin = (*file)->GetCachedSize();
+    auto diskSizeBegin = (*file)->GetDiskSize();
     auto res = (*file)->Write(offset, len, std::move(stream), mtime);
     success = std::get<0>(res);
-    if (success) {
-      m_size += std::get<1>(res);  // added size in cache
-    }
+    // added size in cache, including the size of decompressed pages
+    m_size += (*file)->GetCachedSize() - cachedSizeBegin;
+    m_diskSize += (*file)->GetDiskSize() - diskSizeBegin;
+    UnguardedChargeSharedPages();  // written pages are unshared
   }
   return success;
 }
 
 // --------------------------------------------------------------------------
 pair<bool, unique_ptr<File> *> Cache::PrepareWrite(const string &fileId,
-                                                   size_t len, time_t mtime) {
-  bool availableFreeSpace = true;
-  if (!HasFreeSpace(len)) {
-    availableFreeSpace = Free(len, fileId);
+                                                   off_t offset, size_t len,
+                                                   time_t mtime) {
+  AdaptCapacity();
+  RecycleOverQuota(fileId, offset, len);
+  auto it = m_map.find(fileId);
+  // file of disk tier is stored in disk file directly
+  auto tier = it != m_map.end() ? it->second->second->GetTier()
+                                : GetCacheRule(fileId).tier;
+  if (tier != CacheTier::Disk && !HasFreeSpace(len) &&
+      QS::Configure::Options::Instance().IsCompressCache()) {
+    Compress(len, fileId);
+  }
+  bool availableFreeSpace = tier != CacheTier::Disk;
+  if (!availableFreeSpace || !HasFreeSpace(len)) {
+    availableFreeSpace = availableFreeSpace && Free(len, fileId);
 
     if (!availableFreeSpace) {
       auto diskfolder =
@@ -330,7 +525,7 @@ pair<bool, unique_ptr<File> *> Cache::PrepareWrite(const string &fileId,
         DebugError("Unable to mkdir for folder " + FormatPath(diskfolder));
         return {false, nullptr};
       }
-      if (!IsSafeDiskSpace(diskfolder, len, true)) {
+      if (!HasFreeDiskSpace(diskfolder, len)) {
         if (!FreeDiskCacheFiles(diskfolder, len, fileId)) {
           DebugError("No available free space (" + to_string(len) +
                      "bytes) for folder " + FormatPath(diskfolder));
@@ -341,7 +536,6 @@ pair<bool, unique_ptr<File> *> Cache::PrepareWrite(const string &fileId,
   }
 
   auto pos = m_cache.begin();
-  auto it = m_map.find(fileId);
   if (it != m_map.end()) {
     pos = UnguardedMakeFileMostRecentlyUsed(it->second);
   } else {
@@ -359,6 +553,32 @@ pair<bool, unique_ptr<File> *> Cache::PrepareWrite(const string &fileId,
   return {true, pfile};
 }
 
+// --------------------------------------------------------------------------
+void Cache::RecycleOverQuota(const string &fileId, off_t offset, size_t len) {
+  auto quota = GetFileQuota();
+  if (quota == 0) {
+    return;
+  }
+  auto it = m_map.find(fileId);
+  if (it == m_map.end() || !it->second->second) {
+    return;
+  }
+  auto &file = it->second->second;
+  if (file->IsPinned() || file->GetTier() == CacheTier::Disk ||
+      file->GetCachedSize() + len <= quota) {
+    return;
+  }
+  auto needSize = file->GetCachedSize() + std::min<uint64_t>(len, quota) -
+                  quota;
+  auto recycledSize = file->Recycle(static_cast<size_t>(needSize), offset,
+                                    offset + static_cast<off_t>(len));
+  m_size -= recycledSize;
+  UnguardedChargeSharedPages();
+  DebugInfoIf(recycledSize > 0, "Has recycled cache of " +
+                                    to_string(recycledSize) +
+                                    " bytes over quota " + FormatPath(fileId));
+}
+
 // --------------------------------------------------------------------------
 bool Cache::Free(size_t size, const string &fileUnfreeable) {
   if (size > GetCapacity()) {
@@ -374,6 +594,11 @@ bool Cache::Free(size_t size, const string &fileUnfreeable) {
   }
 
   assert(!m_cache.empty());
+  // Move pages into disk tier first, discard files only when it's full.
+  if (Demote(size, fileUnfreeable)) {
+    return true;
+  }
+
   size_t freedSpace = 0;
   size_t freedDiskSpace = 0;
 
@@ -382,18 +607,26 @@ bool Cache::Free(size_t size, const string &fileUnfreeable) {
   while (it != m_cache.rend() && !HasFreeSpace(size)) {
     // Notice do NOT store a reference of the File supposed to be removed.
     auto fileId = it->first;
-    if (fileId != fileUnfreeable && it->second && !it->second->IsOpen()) {
+    if (fileId != fileUnfreeable && it->second && !it->second->IsOpen() &&
+        !it->second->IsDirty() && !it->second->IsPinned()) {
       auto fileCacheSz = it->second->GetCachedSize();
       freedSpace += fileCacheSz;
-      freedDiskSpace += it->second->GetSize() - fileCacheSz;
+      freedDiskSpace += it->second->GetDiskSize();
       m_size -= fileCacheSz;
+      m_diskSize -= it->second->GetDiskSize();
+      UnguardedRemoveETagIndex(fileId, *it->second);
       it->second->Clear();
-      m_cache.erase((++it).base());
+      it = CacheList::reverse_iterator(m_cache.erase(std::next(it).base()));
       m_map.erase(fileId);
+      // pages still shared by other files are not freed, they are charged
+      // to the files now
+      auto sizeBeforeCharge = GetSize();
+      UnguardedChargeSharedPages();
+      freedSpace -= GetSize() - sizeBeforeCharge;
     } else {
       if (!it->second) {
         DebugInfo("file in cache is null " + FormatPath(fileId));
-        m_cache.erase((++it).base());
+        it = CacheList::reverse_iterator(m_cache.erase(std::next(it).base()));
         m_map.erase(fileId);
       } else {
         ++it;
@@ -412,53 +645,110 @@ bool Cache::Free(size_t size, const string &fileUnfreeable) {
   return HasFreeSpace(size);
 }
 
+// --------------------------------------------------------------------------
+bool Cache::Compress(size_t size, const string &fileUncompressible) {
+  size_t savedSpace = 0;
+  // Compress the least recently used File first, which is put at back.
+  for (auto it = m_cache.rbegin(); it != m_cache.rend() && !HasFreeSpace(size);
+       ++it) {
+    if (it->first != fileUncompressible && it->second &&
+        !it->second->IsPinned()) {
+      auto savedSz = it->second->Compress();
+      savedSpace += savedSz;
+      m_size -= savedSz;
+    }
+  }
+
+  if (savedSpace > 0) {
+    DebugInfo("Has saved cache of " + to_string(savedSpace) +
+              " bytes by compression");
+  }
+  return HasFreeSpace(size);
+}
+
 // --------------------------------------------------------------------------
 bool Cache::FreeDiskCacheFiles(const string &diskfolder, size_t size,
                               const string &fileUnfreeable) {
   assert(diskfolder ==
          QS::Configure::Options::Instance().GetDiskCacheDirectory());
   // diskfolder should be cache disk dir
-  if (IsSafeDiskSpace(diskfolder, size, true)) {
+  if (HasFreeDiskSpace(diskfolder, size)) {
     return true;
   }
 
-  assert(!m_cache.empty());
-  size_t freedSpace = 0;
-  size_t freedDiskSpace = 0;
-
-  auto it = m_cache.rbegin();
-  // Discards the least recently used File first, which is put at back.
-  while (it != m_cache.rend() && !IsSafeDiskSpace(diskfolder, size, true)) {
-    // Notice do NOT store a reference of the File supposed to be removed.
-    auto fileId = it->first;
-    if (fileId != fileUnfreeable && it->second && !it->second->IsOpen()) {
-      auto fileCacheSz = it->second->GetCachedSize();
-      freedSpace += fileCacheSz;
-      freedDiskSpace += it->second->GetSize() - fileCacheSz;
-      m_size -= fileCacheSz;
-      it->second->Clear();
-      m_cache.erase((++it).base());
-      m_map.erase(fileId);
-    } else {
-      if (!it->second) {
-        DebugInfo("file in cache is null " + FormatPath(fileId));
-        m_cache.erase((++it).base());
-        m_map.erase(fileId);
-      } else {
-        ++it;
-      }
+  // Discards the kept disk files from last mount first, which are not used
+  // since mount.
+  if (m_diskCacheIndex && m_diskCacheIndex->GetNumRecords() > 0) {
+    auto freedKeptSpace = m_diskCacheIndex->RemoveAll();
+    m_diskSpaceCheckedTime = 0;  // not counted in disk size, check it again
+    DebugInfo("Has freed kept disk file of " + to_string(freedKeptSpace) +
+              " bytes" + FormatPath(diskfolder));
+    if (HasFreeDiskSpace(diskfolder, size)) {
+      return true;
     }
   }
 
-  if (freedSpace > 0) {
-    DebugInfo("Has freed cache of " + to_string(freedSpace) + " bytes");
+  size_t freedDiskSpace = 0;
+  // Drops the disk pages of the least recently used File first, which is put
+  // at back. The File itself is kept in cache with its pages in memory.
+  for (auto it = m_cache.rbegin();
+       it != m_cache.rend() && !HasFreeDiskSpace(diskfolder, size); ++it) {
+    auto &file = it->second;
+    if (it->first != fileUnfreeable && file && !file->IsOpen() &&
+        !file->IsDirty() && !file->IsPinned() && file->GetDiskSize() > 0) {
+      auto droppedSize = file->DropDiskPages();
+      UnguardedRemoveETagIndex(it->first, *file);
+      freedDiskSpace += droppedSize;
+      m_diskSize -= droppedSize;
+    }
   }
+
   if (freedDiskSpace > 0) {
-    DebugInfo(
-        "Has freed disk file of " + to_string(freedDiskSpace) + " bytes" +
-        FormatPath(QS::Configure::Options::Instance().GetDiskCacheDirectory()));
+    DebugInfo("Has freed disk file of " + to_string(freedDiskSpace) +
+              " bytes" + FormatPath(diskfolder));
+  }
+  return HasFreeDiskSpace(diskfolder, size);
+}
+
+// --------------------------------------------------------------------------
+bool Cache::Demote(size_t size, const string &fileUndemotable) {
+  if (m_diskCapacity == 0) {
+    return false;  // disk tier is disabled
+  }
+  auto diskfolder = QS::Configure::Options::Instance().GetDiskCacheDirectory();
+  if (!CreateDirectoryIfNotExists(diskfolder)) {
+    DebugError("Unable to mkdir for folder " + FormatPath(diskfolder));
+    return false;
   }
-  return IsSafeDiskSpace(diskfolder, size, true);
+
+  size_t demotedSpace = 0;
+  // Demotes the least recently used File first, which is put at back.
+  // Open and dirty files are demoted too, as their content is kept.
+  for (auto it = m_cache.rbegin(); it != m_cache.rend() && !HasFreeSpace(size);
+       ++it) {
+    auto &file = it->second;
+    if (it->first == fileUndemotable || !file || file->GetCachedSize() == 0 ||
+        file->IsPinned() || file->GetTier() == CacheTier::Memory) {
+      continue;
+    }
+    auto needSize = static_cast<size_t>(GetSize() + size - GetCapacity());
+    auto demoteSize = std::min(needSize, file->GetCachedSize());
+    if (!HasFreeDiskSpace(diskfolder, demoteSize) &&
+        !FreeDiskCacheFiles(diskfolder, demoteSize, it->first)) {
+      break;  // no space in disk tier
+    }
+    auto diskSizeBegin = file->GetDiskSize();
+    auto demotedSize = file->Demote(demoteSize);
+    demotedSpace += demotedSize;
+    m_size -= demotedSize;
+    m_diskSize += file->GetDiskSize() - diskSizeBegin;
+  }
+
+  if (demotedSpace > 0) {
+    DebugInfo("Has demoted cache of " + to_string(demotedSpace) +
+              " bytes into disk file" + FormatPath(diskfolder));
+  }
+  return HasFreeSpace(size);
 }
 
 // --------------------------------------------------------------------------
@@ -468,6 +758,7 @@ CacheListIterator Cache::Erase(const string &fileId) {
     DebugInfo("Erase cache " + FormatPath(fileId));
     return UnguardedErase(it);
   } else {
+    UnguardedDiscardKeptDiskFile(fileId);
     DebugInfo("File not exist, no remove " + FormatPath(fileId));
     return m_cache.end();
   }
@@ -479,6 +770,8 @@ void Cache::Rename(const string &oldFileId, const string &newFileId) {
     DebugInfo("File exists, no rename " + FormatPath(oldFileId));
     return;
   }
+  UnguardedDiscardKeptDiskFile(oldFileId);
+  UnguardedDiscardKeptDiskFile(newFileId);
 
   auto iter = m_map.find(newFileId);
   if (iter != m_map.end()) {
@@ -490,10 +783,19 @@ void Cache::Rename(const string &oldFileId, const string &newFileId) {
   auto it = m_map.find(oldFileId);
   if (it != m_map.end()) {
     it->second->first = newFileId;
+    it->second->second->SetPolicy(GetCacheRule(newFileId));
     auto pos = UnguardedMakeFileMostRecentlyUsed(it->second);
 
     m_map.emplace(newFileId, pos);
     m_map.erase(it);
+    if (m_sharingFileIds.erase(oldFileId) > 0) {
+      m_sharingFileIds.insert(newFileId);
+    }
+    auto eTag = pos->second->GetETag();
+    if (!eTag.empty()) {
+      m_eTagIndex[BuildETagKey(eTag, pos->second->GetObjectSize())] =
+          newFileId;
+    }
   } else {
     DebugInfo("File not exists, no rename " + FormatPath(oldFileId));
   }
@@ -521,6 +823,277 @@ void Cache::SetFileOpen(const std::string &fileId, bool open) {
   }
 }
 
+// --------------------------------------------------------------------------
+void Cache::SetETag(const string &fileId, const string &eTag,
+                    uint64_t objectSize) {
+  auto it = m_map.find(fileId);
+  if (it != m_map.end()) {
+    auto pfile = &(it->second->second);
+    auto dirtySize = (*pfile)->GetDirtySize();
+    (*pfile)->SetETag(eTag, objectSize);
+    m_dirtySize -= dirtySize - (*pfile)->GetDirtySize();
+    if (!eTag.empty()) {
+      m_eTagIndex[BuildETagKey(eTag, objectSize)] = fileId;
+    }
+  } else {
+    DebugInfo("File not exists, no set etag " + FormatPath(fileId));
+  }
+}
+
+// --------------------------------------------------------------------------
+bool Cache::SetUploadedETag(const string &fileId, const string &eTag,
+                            uint64_t objectSize, uint64_t dirtyGeneration) {
+  auto it = m_map.find(fileId);
+  if (it == m_map.end()) {
+    DebugInfo("File not exists, no set etag " + FormatPath(fileId));
+    return false;
+  }
+  auto pfile = &(it->second->second);
+  auto dirtySize = (*pfile)->GetDirtySize();
+  if (!(*pfile)->SetUploadedETag(eTag, objectSize, dirtyGeneration)) {
+    DebugInfo("File modified during uploading, keep it dirty " +
+              FormatPath(fileId));
+    return false;
+  }
+  m_dirtySize -= dirtySize;
+  m_eTagIndex[BuildETagKey(eTag, objectSize)] = fileId;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+bool Cache::LoadDiskCacheIndex(const string &diskfolder) {
+  assert(diskfolder ==
+         QS::Configure::Options::Instance().GetDiskCacheDirectory());
+  m_diskCacheIndex.reset(
+      new DiskCacheIndex(diskfolder, GetDiskCacheBlockSize()));
+  return m_diskCacheIndex->Load();
+}
+
+// --------------------------------------------------------------------------
+bool Cache::SaveDiskCacheIndex(const string &diskfolder) {
+  assert(diskfolder ==
+         QS::Configure::Options::Instance().GetDiskCacheDirectory());
+  if (!m_diskCacheIndex) {
+    m_diskCacheIndex.reset(
+        new DiskCacheIndex(diskfolder, GetDiskCacheBlockSize()));
+  }
+
+  vector<File *> keptFiles;
+  for (auto &fileIdToFile : m_cache) {
+    auto &fileId = fileIdToFile.first;
+    auto &file = fileIdToFile.second;
+    if (!file) {
+      continue;
+    }
+    auto eTag = file->GetETag();
+    // Skip the file modified locally, and the renamed file whose disk file
+    // could be taken by another file at next mount.
+    if (eTag.empty() || file->GetBaseName() != BuildDiskFileName(fileId)) {
+      continue;
+    }
+    auto ranges = file->GetDiskFileRanges();
+    if (ranges.empty()) {
+      continue;
+    }
+    DiskCacheRecord record;
+    record.fileId = fileId;
+    record.diskFile = file->GetBaseName();
+    record.eTag = eTag;
+    record.size = file->GetObjectSize();
+    record.mtime = file->GetTime();
+    record.blocks = DiskCacheIndex::BuildBlockBitmap(
+        ranges, record.size, m_diskCacheIndex->GetBlockSize());
+    m_diskCacheIndex->Put(std::move(record));
+    keptFiles.push_back(file.get());
+  }
+
+  if (!m_diskCacheIndex->Save()) {
+    return false;
+  }
+  for (auto file : keptFiles) {
+    file->SetKeepDiskFile(true);
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------
+bool Cache::ShareContent(const string &fileId, const string &eTag,
+                         uint64_t objectSize, time_t mtime) {
+  if (eTag.empty()) {
+    return false;
+  }
+  auto it = m_map.find(fileId);
+  if (it != m_map.end() && it->second->second->GetSize() > 0) {
+    return false;  // file has its own content
+  }
+  auto index = m_eTagIndex.find(BuildETagKey(eTag, objectSize));
+  if (index == m_eTagIndex.end() || index->second == fileId) {
+    return false;
+  }
+  auto rule = GetCacheRule(fileId);
+  if (rule.noCache || rule.tier == CacheTier::Disk) {
+    return false;
+  }
+  auto sourceId = index->second;
+  auto source = m_map.find(sourceId);
+  if (source == m_map.end() || source->second->second->IsDirty() ||
+      source->second->second->GetETag() != eTag ||
+      source->second->second->GetObjectSize() != objectSize) {
+    m_eTagIndex.erase(index);  // out of date
+    return false;
+  }
+  auto sourceFile = source->second->second.get();
+  if (sourceFile->GetCachedSize() + sourceFile->GetUnchargedSize() == 0) {
+    return false;
+  }
+
+  // shared pages take no space, as they are charged to the source
+  auto pos = it != m_map.end() ? UnguardedMakeFileMostRecentlyUsed(it->second)
+                               : UnguardedNewEmptyFile(fileId, mtime);
+  if (pos == m_cache.end()) {
+    return false;
+  }
+  auto &file = pos->second;
+  auto cachedSizeBegin = file->GetCachedSize();
+  auto sharedSize = file->ShareFrom(sourceFile);
+  m_size += file->GetCachedSize() - cachedSizeBegin;
+  if (sharedSize == 0) {
+    return false;
+  }
+  if (file->GetUnchargedSize() > 0) {
+    m_sharingFileIds.insert(fileId);
+  }
+  if (file->GetTime() < mtime) {
+    file->SetTime(mtime);
+  }
+  file->SetETag(eTag, objectSize);
+  DebugInfo("Share " + to_string(sharedSize) + " bytes of " +
+            FormatPath(sourceId) + " with " + FormatPath(fileId));
+  return true;
+}
+
+// --------------------------------------------------------------------------
+bool Cache::AdoptDiskCacheFile(const string &fileId, const string &eTag,
+                               uint64_t objectSize) {
+  if (!m_diskCacheIndex || !m_diskCacheIndex->HasRecord(fileId)) {
+    return false;
+  }
+  if (HasFile(fileId) || eTag.empty()) {
+    UnguardedDiscardKeptDiskFile(fileId);
+    return false;
+  }
+
+  auto res = m_diskCacheIndex->Take(fileId);
+  auto &record = res.second;
+  if (record.eTag != eTag || record.size != objectSize) {
+    DebugInfo("Kept disk file is out of date [etag:size=" + record.eTag + ":" +
+              to_string(record.size) + "], remove it " + FormatPath(fileId));
+    RemoveFileIfExists(
+        QS::Configure::Options::Instance().GetDiskCacheDirectory() +
+        record.diskFile);
+    return false;
+  }
+
+  m_cache.emplace_front(
+      fileId, unique_ptr<File>(new File(record.diskFile, record.mtime)));
+  m_map.emplace(fileId, m_cache.begin());
+  auto pfile = &(m_cache.begin()->second);
+  (*pfile)->SetPolicy(GetCacheRule(fileId));
+  (*pfile)->SetETag(eTag, objectSize);
+  auto adoptedSize = (*pfile)->AdoptDiskFileRanges(
+      DiskCacheIndex::BuildContentRanges(record.blocks, record.size,
+                                         m_diskCacheIndex->GetBlockSize()));
+  m_diskSize += adoptedSize;
+  DebugInfo("Adopt kept disk file of " + to_string(adoptedSize) + " bytes " +
+            FormatPath(fileId));
+  return true;
+}
+
+// --------------------------------------------------------------------------
+void Cache::UnguardedAddDecompressedSize(const string &fileId, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (!Free(size, fileId)) {
+    DebugWarning("Cache is full. Unable to free added " + to_string(size) +
+                 " bytes when decompressing file " + FormatPath(fileId));
+  }
+  m_size += size;
+}
+
+// --------------------------------------------------------------------------
+void Cache::UnguardedPromoteHotPages(const string &fileId, File *file) {
+  auto hotSize = file->GetHotDiskSize();
+  if (m_diskCapacity == 0 || hotSize == 0 ||
+      file->GetTier() == CacheTier::Disk) {
+    return;
+  }
+  if (!HasFreeSpace(hotSize) && !Free(hotSize, fileId)) {
+    return;  // keep the pages in disk tier
+  }
+  auto diskSizeBegin = file->GetDiskSize();
+  auto promotedSize = file->PromoteHotPages();
+  m_size += promotedSize;
+  m_diskSize -= diskSizeBegin - file->GetDiskSize();
+  DebugInfo("Promote hot pages of " + to_string(promotedSize) +
+            " bytes into memory " + FormatPath(fileId));
+}
+
+// --------------------------------------------------------------------------
+void Cache::AdaptCapacity() {
+  if (!m_memoryPressure) {
+    return;
+  }
+  time_t now = time(NULL);
+  if (now == m_capacityAdaptedTime) {
+    return;
+  }
+  m_capacityAdaptedTime = now;
+
+  MemoryStatus status;
+  if (!m_memoryPressure->ReadStatus(&status)) {
+    return;
+  }
+  auto capacity =
+      MemoryPressure::AdaptCapacity(m_maxCapacity, m_capacity, status);
+  if (capacity == m_capacity) {
+    return;
+  }
+  DebugInfo("Adapt cache capacity from " + to_string(m_capacity) + " to " +
+            to_string(capacity) + " bytes [memory current:limit=" +
+            to_string(status.current) + ":" + to_string(status.limit) +
+            "] [pressure=" + to_string(status.pressure) + "]");
+  m_capacity = capacity;
+  if (m_size > m_capacity) {
+    // proactively discard files to fit in the shrinked capacity
+    if (QS::Configure::Options::Instance().IsCompressCache()) {
+      Compress(0, string());
+    }
+    Free(0, string());
+  }
+}
+
+// --------------------------------------------------------------------------
+bool Cache::Validate(const string &fileId, const string &eTag,
+                     uint64_t objectSize) {
+  auto it = m_map.find(fileId);
+  if (it == m_map.end()) {
+    return true;
+  }
+  auto pfile = &(it->second->second);
+  auto fileETag = (*pfile)->GetETag();
+  if (fileETag.empty() ||
+      (fileETag == eTag && (*pfile)->GetObjectSize() == objectSize)) {
+    return true;
+  }
+
+  DebugInfo("File cache is out of date [etag:size=" + fileETag + ":" +
+            to_string((*pfile)->GetObjectSize()) + "], erase it " +
+            FormatPath(fileId));
+  UnguardedErase(it);
+  return false;
+}
+
 // --------------------------------------------------------------------------
 void Cache::Resize(const string &fileId, size_t newFileSize, time_t mtime) {
   auto it = m_map.find(fileId);
@@ -528,6 +1101,7 @@ void Cache::Resize(const string &fileId, size_t newFileSize, time_t mtime) {
     auto pfile = &(it->second->second);
     auto oldFileSize = (*pfile)->GetSize();
     auto oldFileCacheSize = (*pfile)->GetCachedSize();
+    auto oldFileDiskSize = (*pfile)->GetDiskSize();
     if (newFileSize == oldFileSize) {
       return;  // do nothing
     } else if (newFileSize > oldFileSize) {
@@ -536,12 +1110,17 @@ void Cache::Resize(const string &fileId, size_t newFileSize, time_t mtime) {
       vector<char> hole(holeSize);  // value initialization with '\0'
       DebugInfo("Fill hole [offset:len=" + to_string(oldFileSize) + ":" +
                 to_string(holeSize) + "] " + FormatPath(fileId));
-      Write(fileId, oldFileSize, holeSize, &hole[0], mtime);
+      // cache size and dirty size are updated by Write
+      Write(fileId, oldFileSize, holeSize, &hole[0], mtime, true);
     } else {
+      auto dirtySize = (*pfile)->GetDirtySize();
       (*pfile)->ResizeToSmallerSize(newFileSize);
       (*pfile)->SetTime(mtime);
+      m_dirtySize -= dirtySize - (*pfile)->GetDirtySize();
+      m_size -= oldFileCacheSize - (*pfile)->GetCachedSize();
+      m_diskSize -= oldFileDiskSize - (*pfile)->GetDiskSize();
+      UnguardedChargeSharedPages();
     }
-    m_size += (*pfile)->GetCachedSize() - oldFileCacheSize;
 
     DebugInfoIf((*pfile)->GetSize() != newFileSize,
                 "Try to resize file from size " + to_string(oldFileSize) +
@@ -556,10 +1135,12 @@ void Cache::Resize(const string &fileId, size_t newFileSize, time_t mtime) {
 // --------------------------------------------------------------------------
 CacheListIterator Cache::UnguardedNewEmptyFile(const string &fileId,
                                                time_t mtime) {
-  m_cache.emplace_front(fileId,
-                        unique_ptr<File>(new File(GetBaseName(fileId), mtime)));
+  UnguardedDiscardKeptDiskFile(fileId);
+  m_cache.emplace_front(
+      fileId, unique_ptr<File>(new File(BuildDiskFileName(fileId), mtime)));
   if (m_cache.begin()->first == fileId) {  // insert to cache sucessfully
     m_map.emplace(fileId, m_cache.begin());
+    m_cache.begin()->second->SetPolicy(GetCacheRule(fileId));
     return m_cache.begin();
   } else {
     DebugError("Fail to create empty file in cache : " + FormatPath(fileId));
@@ -567,18 +1148,62 @@ CacheListIterator Cache::UnguardedNewEmptyFile(const string &fileId,
   }
 }
 
+// --------------------------------------------------------------------------
+void Cache::UnguardedDiscardKeptDiskFile(const string &fileId) {
+  if (!m_diskCacheIndex) {
+    return;
+  }
+  auto res = m_diskCacheIndex->Take(fileId);
+  if (res.first) {
+    RemoveFileIfExists(
+        QS::Configure::Options::Instance().GetDiskCacheDirectory() +
+        res.second.diskFile);
+  }
+}
+
+// --------------------------------------------------------------------------
+void Cache::UnguardedRemoveETagIndex(const string &fileId, const File &file) {
+  auto eTag = file.GetETag();
+  if (eTag.empty()) {
+    return;
+  }
+  auto index = m_eTagIndex.find(BuildETagKey(eTag, file.GetObjectSize()));
+  if (index != m_eTagIndex.end() && index->second == fileId) {
+    m_eTagIndex.erase(index);
+  }
+}
+
 // --------------------------------------------------------------------------
 CacheListIterator Cache::UnguardedErase(
     FileIdToCacheListIteratorMap::iterator pos) {
   auto cachePos = pos->second;
   auto pfile = &(cachePos->second);
   m_size -= (*pfile)->GetCachedSize();
+  m_dirtySize -= (*pfile)->GetDirtySize();
+  m_diskSize -= (*pfile)->GetDiskSize();
+  UnguardedRemoveETagIndex(pos->first, **pfile);
   (*pfile)->Clear();
   auto next = m_cache.erase(cachePos);
   m_map.erase(pos);
+  UnguardedChargeSharedPages();
   return next;
 }
 
+// --------------------------------------------------------------------------
+void Cache::UnguardedChargeSharedPages() {
+  for (auto it = m_sharingFileIds.begin(); it != m_sharingFileIds.end();) {
+    auto pos = m_map.find(*it);
+    if (pos == m_map.end() || !pos->second->second) {
+      it = m_sharingFileIds.erase(it);
+      continue;
+    }
+    auto &file = pos->second->second;
+    m_size += file->ChargeSharedPages();
+    it = file->GetUnchargedSize() == 0 ? m_sharingFileIds.erase(it)
+                                       : std::next(it);
+  }
+}
+
 // --------------------------------------------------------------------------
 CacheListIterator Cache::UnguardedMakeFileMostRecentlyUsed(
     CacheListConstIterator pos) {
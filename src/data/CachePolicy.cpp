@@ -0,0 +1,190 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/CachePolicy.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>  // for strtoull
+#include <string.h>  // for strerror
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/StringUtils.h"
+#include "data/Size.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::StringUtils::FormatPath;
+using std::ifstream;
+using std::istringstream;
+using std::pair;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+// --------------------------------------------------------------------------
+pair<bool, string> ErrorOut(string &&str) { return {false, str}; }
+
+// --------------------------------------------------------------------------
+// Match the remaining path from s with the remaining pattern from p
+bool GlobMatch(const char *p, const char *s) {
+  while (*p != '\0') {
+    if (*p == '*') {
+      bool crossDir = *(p + 1) == '*';
+      p += crossDir ? 2 : 1;
+      for (;; ++s) {
+        if (GlobMatch(p, s)) {
+          return true;
+        }
+        if (*s == '\0' || (!crossDir && *s == '/')) {
+          return false;
+        }
+      }
+    }
+    if (*s == '\0' || (*p == '?' ? *s == '/' : *p != *s)) {
+      return false;
+    }
+    ++p;
+    ++s;
+  }
+  return *s == '\0';
+}
+
+// --------------------------------------------------------------------------
+// Parse size with optional unit of K, M or G
+bool ParseSize(const string &str, uint64_t *size) {
+  if (str == "whole") {
+    *size = kPrefetchWhole;
+    return true;
+  }
+  if (str.empty() || str.front() < '0' || str.front() > '9') {
+    return false;
+  }
+  char *end = nullptr;
+  uint64_t value = strtoull(str.c_str(), &end, 10);
+  string unit(end);
+  if (unit.empty()) {
+    *size = value;
+  } else if (unit == "K") {
+    *size = value * Size::KB1;
+  } else if (unit == "M") {
+    *size = value * Size::MB1;
+  } else if (unit == "G") {
+    *size = value * Size::GB1;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+pair<bool, string> CachePolicy::Load(const string &file) {
+  ifstream is(file);
+  if (!is) {
+    return ErrorOut("Fail to read cache policy file : " +
+                    string(strerror(errno)) + FormatPath(file));
+  }
+
+  CachePolicy policy;
+  string line;
+  unsigned lineNo = 0;
+  while (std::getline(is, line)) {
+    ++lineNo;
+    auto res = policy.AddRule(line);
+    if (!res.first) {
+      return ErrorOut(res.second + " at line " + to_string(lineNo) +
+                      " of cache policy file " + FormatPath(file));
+    }
+  }
+  m_rules.swap(policy.m_rules);
+  return {true, string()};
+}
+
+// --------------------------------------------------------------------------
+pair<bool, string> CachePolicy::AddRule(const string &line) {
+  istringstream is(line);
+  CacheRule rule;
+  if (!(is >> rule.pattern) || rule.pattern.front() == '#') {
+    return {true, string()};  // empty line or comment
+  }
+  if (rule.pattern.back() == '/') {
+    rule.pattern += "**";
+  }
+
+  string action;
+  bool hasAction = false;
+  while (is >> action) {
+    hasAction = true;
+    if (action == "pin") {
+      rule.pin = true;
+    } else if (action == "nocache") {
+      rule.noCache = true;
+    } else if (action.compare(0, 9, "prefetch=") == 0) {
+      if (!ParseSize(action.substr(9), &rule.prefetchSize)) {
+        return ErrorOut("Invalid prefetch size \"" + action + "\"");
+      }
+    } else if (action == "tier=memory") {
+      rule.tier = CacheTier::Memory;
+    } else if (action == "tier=disk") {
+      rule.tier = CacheTier::Disk;
+    } else {
+      return ErrorOut("Invalid action \"" + action + "\"");
+    }
+  }
+  if (!hasAction) {
+    return ErrorOut("No action for pattern \"" + rule.pattern + "\"");
+  }
+  m_rules.push_back(std::move(rule));
+  return {true, string()};
+}
+
+// --------------------------------------------------------------------------
+CacheRule CachePolicy::Match(const string &filePath) const {
+  for (auto &rule : m_rules) {
+    if (MatchPattern(rule.pattern, filePath)) {
+      return rule;
+    }
+  }
+  return CacheRule();
+}
+
+// --------------------------------------------------------------------------
+bool CachePolicy::MatchPattern(const string &pattern, const string &filePath) {
+  if (pattern.find('/') == string::npos) {
+    auto pos = filePath.find_last_of('/');
+    auto fileName = pos == string::npos ? filePath : filePath.substr(pos + 1);
+    return GlobMatch(pattern.c_str(), fileName.c_str());
+  }
+  if (pattern.front() != '/' && !filePath.empty() && filePath.front() == '/') {
+    return GlobMatch(pattern.c_str(), filePath.c_str() + 1);
+  }
+  return GlobMatch(pattern.c_str(), filePath.c_str());
+}
+
+}  // namespace Data
+}  // namespace QS
@@ -22,6 +22,7 @@
 #include <deque>
 #include <iterator>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <queue>
 #include <set>
 #include <string>
@@ -29,6 +30,7 @@
 #include <vector>
 
 #include "base/LogMacros.h"
+#include "base/SharedMutex.h"
 #include "base/StringUtils.h"
 #include "base/Utils.h"
 #include "data/FileMetaDataManager.h"
@@ -38,13 +40,14 @@ namespace QS {
 namespace Data {
 
 using QS::StringUtils::FormatPath;
+using QS::Threading::SharedLock;
+using QS::Threading::SharedMutex;
 using QS::Utils::AppendPathDelim;
 using QS::Utils::IsRootDirectory;
 using std::deque;
 using std::lock_guard;
 using std::make_shared;
 using std::queue;
-using std::recursive_mutex;
 using std::set;
 using std::string;
 using std::shared_ptr;
@@ -54,6 +57,20 @@ using std::weak_ptr;
 
 static const char *const ROOT_PATH = "/";
 
+namespace {
+
+// --------------------------------------------------------------------------
+// Get the dir of a file, which is ending with "/"
+string GetDirInPath(const string &filePath) {
+  if (filePath.size() < 2) {
+    return string();
+  }
+  auto pos = filePath.rfind('/', filePath.size() - 2);
+  return pos == string::npos ? string() : filePath.substr(0, pos + 1);
+}
+
+}  // namespace
+
 // --------------------------------------------------------------------------
 Entry::Entry(const std::string &filePath, uint64_t fileSize, time_t atime,
              time_t mtime, uid_t uid, gid_t gid, mode_t fileMode,
@@ -113,7 +130,7 @@ Node::~Node() {
 
 // --------------------------------------------------------------------------
 shared_ptr<Node> Node::Find(const string &childFileName) const {
-  auto child = m_children.find(childFileName);
+  auto child = FindChild(childFileName);
   if (child != m_children.end()) {
     return child->second;
   }
@@ -122,7 +139,16 @@ shared_ptr<Node> Node::Find(const string &childFileName) const {
 
 // --------------------------------------------------------------------------
 bool Node::HaveChild(const std::string &childFilePath) const {
-  return m_children.find(childFilePath) != m_children.end();
+  return FindChild(childFilePath) != m_children.end();
+}
+
+// --------------------------------------------------------------------------
+FilePathToNodeUnorderedMap::const_iterator Node::FindChild(
+    const string &childFilePath) const {
+  if (m_children.empty()) {
+    return m_children.end();
+  }
+  return m_children.find(PathName::Find(childFilePath));
 }
 
 // --------------------------------------------------------------------------
@@ -134,7 +160,7 @@ const FilePathToNodeUnorderedMap &Node::GetChildren() const {
 set<string> Node::GetChildrenIds() const {
   set<string> ids;
   for (const auto &pair : m_children) {
-    ids.emplace(pair.first);
+    ids.emplace(pair.first.ToString());
   }
   return ids;
 }
@@ -145,8 +171,8 @@ deque<string> Node::GetChildrenIdsRecursively() const {
   deque<shared_ptr<Node>> childs;
 
   for (const auto &pair : m_children) {
-    ids.emplace_back(pair.first);
-    childs.push_back(pair.second);
+    ids.emplace_back(pair.first.ToString());
+    childs.emplace_back(pair.second);
   }
 
   while (!childs.empty()) {
@@ -155,8 +181,8 @@ deque<string> Node::GetChildrenIdsRecursively() const {
 
     if (child->IsDirectory()) {
       for (const auto &pair : child->GetChildren()) {
-        ids.emplace_back(pair.first);
-        childs.push_back(pair.second);
+        ids.emplace_back(pair.first.ToString());
+        childs.emplace_back(pair.second);
       }
     }
   }
@@ -167,8 +193,8 @@ deque<string> Node::GetChildrenIdsRecursively() const {
 // --------------------------------------------------------------------------
 shared_ptr<Node> Node::Insert(const shared_ptr<Node> &child) {
   assert(IsDirectory());
-  if (child) {
-    auto res = m_children.emplace(child->GetFilePath(), child);
+  if (child && *child) {
+    auto res = m_children.emplace(child->GetEntry().GetPathName(), child);
     if (res.second) {
       if (child->IsDirectory()) {
         m_entry.IncreaseNumLink();
@@ -197,7 +223,7 @@ void Node::Remove(const std::string &childFilePath) {
   if (childFilePath.empty()) return;
 
   bool reset = m_children.size() == 1 ? true : false;
-  auto it = m_children.find(childFilePath);
+  auto it = FindChild(childFilePath);
   if (it != m_children.end()) {
     m_children.erase(it);
     if (reset) m_children.clear();
@@ -207,33 +233,38 @@ void Node::Remove(const std::string &childFilePath) {
 }
 
 // --------------------------------------------------------------------------
-void Node::RenameChild(const string &oldFilePath, const string &newFilePath) {
+bool Node::RenameChild(const string &oldFilePath, const string &newFilePath) {
   if (oldFilePath == newFilePath) {
     DebugInfo("Same file name, no rename " + FormatPath(oldFilePath));
-    return;
+    return false;
   }
-
-  if (m_children.find(newFilePath) != m_children.end()) {
-    DebugWarning("Cannot rename, target node already exist " +
+  if (GetDirInPath(newFilePath) != GetDirInPath(oldFilePath)) {
+    DebugWarning("Cannot rename child into another dir " +
                  FormatPath(oldFilePath, newFilePath));
-    return;
+    return false;
   }
 
-  auto it = m_children.find(oldFilePath);
-  if (it != m_children.end()) {
-    auto child = it->second;
-    child->Rename(newFilePath);
-
-    auto hint = m_children.erase(it);
-    m_children.emplace_hint(hint, newFilePath, child);
-  } else {
+  auto it = FindChild(oldFilePath);
+  if (it == m_children.end()) {
     DebugWarning("Node not exist, no rename " + FormatPath(oldFilePath));
+    return false;
+  }
+  if (FindChild(newFilePath) != m_children.end()) {
+    DebugWarning("Cannot rename, target node already exist " +
+                 FormatPath(oldFilePath, newFilePath));
+    return false;
   }
+
+  auto child = it->second;
+  child->Rename(newFilePath);
+  m_children.erase(it);
+  m_children.emplace(child->GetEntry().GetPathName(), child);
+  return true;
 }
 
 // --------------------------------------------------------------------------
 shared_ptr<Node> DirectoryTree::GetRoot() const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   return m_root;
 }
 
@@ -245,7 +276,13 @@ shared_ptr<Node> DirectoryTree::GetRoot() const {
 
 // --------------------------------------------------------------------------
 weak_ptr<Node> DirectoryTree::Find(const string &filePath) const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  auto pathName = PathName::Find(filePath);
+  SharedLock lock(m_mutex);
+  return FindNoLock(pathName);
+}
+
+// --------------------------------------------------------------------------
+weak_ptr<Node> DirectoryTree::FindNoLock(const PathName &filePath) const {
   auto it = m_map.find(filePath);
   if (it != m_map.end()) {
     return it->second;
@@ -258,69 +295,81 @@ weak_ptr<Node> DirectoryTree::Find(const string &filePath) const {
 
 // --------------------------------------------------------------------------
 bool DirectoryTree::Has(const std::string &filePath) const {
-  lock_guard<recursive_mutex> lock(m_mutex);
-  return m_map.find(filePath) != m_map.end();
+  auto pathName = PathName::Find(filePath);
+  SharedLock lock(m_mutex);
+  return m_map.find(pathName) != m_map.end();
 }
 
 // --------------------------------------------------------------------------
 vector<weak_ptr<Node>> DirectoryTree::FindChildren(
     const string &dirName) const {
-  lock_guard<recursive_mutex> lock(m_mutex);
-  auto range = m_parentToChildrenMap.equal_range(dirName);
-  vector<weak_ptr<Node>> childs;
-  for (auto it = range.first; it != range.second; ++it) {
-    childs.emplace_back(it->second);
+  auto pathName = PathName::Find(dirName);
+  SharedLock lock(m_mutex);
+  return FindChildrenNoLock(pathName);
+}
+
+// --------------------------------------------------------------------------
+vector<weak_ptr<Node>> DirectoryTree::FindChildrenNoLock(
+    const PathName &dirName) const {
+  auto it = m_parentToChildrenMap.find(dirName);
+  if (it != m_parentToChildrenMap.end()) {
+    return it->second;
   }
-  return childs;
+  return vector<weak_ptr<Node>>();
 }
 
 // --------------------------------------------------------------------------
-ChildrenMultiMapConstIterator DirectoryTree::CBeginParentToChildrenMap() const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+ChildrenMapConstIterator DirectoryTree::CBeginParentToChildrenMap() const {
+  SharedLock lock(m_mutex);
   return m_parentToChildrenMap.cbegin();
 }
 
 // --------------------------------------------------------------------------
-ChildrenMultiMapConstIterator DirectoryTree::CEndParentToChildrenMap() const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+ChildrenMapConstIterator DirectoryTree::CEndParentToChildrenMap() const {
+  SharedLock lock(m_mutex);
   return m_parentToChildrenMap.cend();
 }
 
 // --------------------------------------------------------------------------
 shared_ptr<Node> DirectoryTree::Grow(shared_ptr<FileMetaData> &&fileMeta) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
+  return GrowNoLock(std::move(fileMeta));
+}
+
+// --------------------------------------------------------------------------
+shared_ptr<Node> DirectoryTree::GrowNoLock(
+    shared_ptr<FileMetaData> &&fileMeta) {
   if (!fileMeta) return nullptr;
 
-  string filePath = fileMeta->GetFilePath();
+  auto filePath = fileMeta->GetPathName();
 
-  auto node = Find(filePath).lock();
+  auto node = FindNoLock(filePath).lock();
   if (node && *node) {
     if (fileMeta->GetMTime() > node->GetMTime()) {
-      DebugInfo("Update Node " + FormatPath(filePath));
+      DebugInfo("Update Node " + FormatPath(filePath.ToString()));
       node->SetEntry(Entry(std::move(fileMeta)));  // update entry
     }
   } else {
-    DebugInfo("Add Node " + FormatPath(filePath));
+    DebugInfo("Add Node " + FormatPath(filePath.ToString()));
     bool isDir = fileMeta->IsDirectory();
-    auto dirName = fileMeta->MyDirName();
+    auto dirName = filePath.GetParent();
     node = make_shared<Node>(Entry(std::move(fileMeta)));
     m_map.emplace(filePath, node);
 
     // hook up with parent
-    assert(!dirName.empty());
     auto it = m_map.find(dirName);
     if (it != m_map.end()) {
       if (auto parent = it->second.lock()) {
         parent->Insert(node);
         node->SetParent(parent);
       } else {
-        DebugInfo("Parent node not exist " + FormatPath(filePath));
+        DebugInfo("Parent node not exist " + FormatPath(filePath.ToString()));
       }
     }
 
     // hook up with children
     if (isDir) {
-      auto childs = FindChildren(filePath);
+      auto childs = FindChildrenNoLock(filePath);
       for (auto &child : childs) {
         auto childNode = child.lock();
         if (childNode) {
@@ -330,8 +379,17 @@ shared_ptr<Node> DirectoryTree::Grow(shared_ptr<FileMetaData> &&fileMeta) {
       }
     }
 
-    // record parent to children map
-    m_parentToChildrenMap.emplace(dirName, node);
+    // record parent to children map, drop the removed children before the
+    // list grows
+    auto &childs = m_parentToChildrenMap[dirName];
+    if (childs.size() == childs.capacity()) {
+      childs.erase(std::remove_if(childs.begin(), childs.end(),
+                                  [](const weak_ptr<Node> &child) {
+                                    return child.expired();
+                                  }),
+                   childs.end());
+    }
+    childs.push_back(node);
   }
   // m_currentNode = node;
 
@@ -340,9 +398,9 @@ shared_ptr<Node> DirectoryTree::Grow(shared_ptr<FileMetaData> &&fileMeta) {
 
 // --------------------------------------------------------------------------
 void DirectoryTree::Grow(vector<shared_ptr<FileMetaData>> &&fileMetas) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   for (auto &meta : fileMetas) {
-    Grow(std::move(meta));
+    GrowNoLock(std::move(meta));
   }
 }
 
@@ -360,7 +418,7 @@ shared_ptr<Node> DirectoryTree::UpdateDirectory(
   }
 
   DebugInfo("Update directory " + FormatPath(dirPath));
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   // Check children metas and collect valid ones
   vector<shared_ptr<FileMetaData>> newChildrenMetas;
   set<string> newChildrenIds;
@@ -382,7 +440,8 @@ shared_ptr<Node> DirectoryTree::UpdateDirectory(
   }
 
   // Update
-  auto node = Find(path).lock();
+  auto pathName = PathName::Find(path);
+  auto node = FindNoLock(pathName).lock();
   if (node && *node) {
     if (!node->IsDirectory()) {
       DebugWarning("Not a directory " + FormatPath(path));
@@ -397,28 +456,32 @@ shared_ptr<Node> DirectoryTree::UpdateDirectory(
         newChildrenIds.end(),
         std::inserter(deleteChildrenIds, deleteChildrenIds.end()));
     if (!deleteChildrenIds.empty()) {
-      auto childs = FindChildren(path);
-      m_parentToChildrenMap.erase(path);
+      auto childs = FindChildrenNoLock(pathName);
+      m_parentToChildrenMap.erase(pathName);
+      vector<weak_ptr<Node>> keptChilds;
       for (auto &child : childs) {
         auto childNode = child.lock();
         if (childNode && (*childNode)) {
           if (deleteChildrenIds.find(childNode->GetFilePath()) ==
               deleteChildrenIds.end()) {
-            m_parentToChildrenMap.emplace(path, std::move(child));
+            keptChilds.push_back(std::move(child));
           }
         }
       }
+      if (!keptChilds.empty()) {
+        m_parentToChildrenMap.emplace(pathName, std::move(keptChilds));
+      }
       for (auto &childId : deleteChildrenIds) {
-        m_map.erase(childId);
+        m_map.erase(PathName::Find(childId));
         node->Remove(childId);
       }
     }
-
-    // Do updating
-    Grow(std::move(newChildrenMetas));
   } else {  // directory not existing
-    node = Grow(std::move(BuildDefaultDirectoryMeta(path)));
-    Grow(std::move(newChildrenMetas));
+    node = GrowNoLock(std::move(BuildDefaultDirectoryMeta(path)));
+  }
+  // Do updating
+  for (auto &meta : newChildrenMetas) {
+    GrowNoLock(std::move(meta));
   }
 
   // m_currentNode = node;
@@ -437,11 +500,12 @@ shared_ptr<Node> DirectoryTree::Rename(const string &oldFilePath,
     return shared_ptr<Node>(nullptr);
   }
 
-  lock_guard<recursive_mutex> lock(m_mutex);
-  auto node = Find(oldFilePath).lock();
+  auto oldPathName = PathName::Find(oldFilePath);
+  lock_guard<SharedMutex> lock(m_mutex);
+  auto node = FindNoLock(oldPathName).lock();
   if (node && *node) {
     // Check parameter
-    if (Find(newFilePath).lock()) {
+    if (FindNoLock(PathName::Find(newFilePath)).lock()) {
       DebugWarning("Node exist, no rename " + FormatPath(newFilePath));
       return node;
     }
@@ -452,20 +516,54 @@ shared_ptr<Node> DirectoryTree::Rename(const string &oldFilePath,
 
     // Do Renaming
     DebugInfo("Rename Node " + FormatPath(oldFilePath, newFilePath));
-    auto parentName = node->MyDirName();
-    node->Rename(newFilePath);  // still need as parent maybe not added yet
     auto parent = node->GetParent();
-    if (parent && *parent) {
-      parent->RenameChild(oldFilePath, newFilePath);
+    auto oldDirName = oldPathName.GetParent();
+    PathName newDirName(GetDirInPath(newFilePath));
+    if (oldDirName == newDirName) {
+      if (!(parent && *parent)) {
+        node->Rename(newFilePath);  // parent maybe not added yet
+      } else if (!parent->RenameChild(oldFilePath, newFilePath)) {
+        return node;
+      }
+    } else {
+      // move the node from old dir to new dir
+      if (parent && *parent) {
+        parent->Remove(oldFilePath);
+        if (node->IsDirectory()) {
+          parent->DecreaseNumLink();
+        }
+      }
+      node->Rename(newFilePath);
+      auto newParent = FindNoLock(newDirName).lock();
+      if (newParent && *newParent) {
+        newParent->Insert(node);
+        node->SetParent(newParent);
+      } else {
+        node->SetParent(shared_ptr<Node>(nullptr));  // new dir not added yet
+      }
+
+      auto oldChilds = m_parentToChildrenMap.find(oldDirName);
+      if (oldChilds != m_parentToChildrenMap.end()) {
+        auto &childs = oldChilds->second;
+        childs.erase(std::remove_if(childs.begin(), childs.end(),
+                                    [&node](const weak_ptr<Node> &child) {
+                                      auto childNode = child.lock();
+                                      return !childNode || childNode == node;
+                                    }),
+                     childs.end());
+      }
+      m_parentToChildrenMap[newDirName].push_back(node);
     }
-    m_map.emplace(newFilePath, node);
-    m_map.erase(oldFilePath);
+    auto newPathName = node->GetEntry().GetPathName();
+    m_map.emplace(newPathName, node);
+    m_map.erase(oldPathName);
     if (node->IsDirectory()) {
-      auto childs = FindChildren(oldFilePath);
+      auto childs = FindChildrenNoLock(oldPathName);
+      auto &newChilds = m_parentToChildrenMap[newPathName];
       for (auto &child : childs) {
-        m_parentToChildrenMap.emplace(newFilePath, std::move(child));
+        newChilds.push_back(std::move(child));
       }
-      m_parentToChildrenMap.erase(oldFilePath);
+      m_parentToChildrenMap.erase(oldPathName);
     }
     // m_currentNode = node;
   } else {
@@ -482,8 +580,9 @@ void DirectoryTree::Remove(const string &path) {
     return;
   }
 
-  lock_guard<recursive_mutex> lock(m_mutex);
-  auto node = Find(path).lock();
+  auto pathName = PathName::Find(path);
+  lock_guard<SharedMutex> lock(m_mutex);
+  auto node = FindNoLock(pathName).lock();
   if (!(node && *node)) {
     DebugInfo("No such file or directory, no remove " + FormatPath(path));
     return;
@@ -497,30 +596,31 @@ void DirectoryTree::Remove(const string &path) {
     // to the node now.
     parent->Remove(path);
   }
-  m_map.erase(path);
-  m_parentToChildrenMap.erase(path);
+  m_map.erase(pathName);
+  m_parentToChildrenMap.erase(pathName);
 
   if (!node->IsDirectory()) {
     node.reset();
     return;
   }
 
-  std::queue<shared_ptr<Node>> deleteNodes;
+  // children are keyed by path names, which are still there even if the
+  // meta data of the children are discarded
+  std::queue<std::pair<PathName, shared_ptr<Node>>> deleteNodes;
   for (auto &pair : node->GetChildren()) {
-    deleteNodes.push(std::move(pair.second));
+    deleteNodes.push(pair);
   }
   // recursively remove all children references
   while (!deleteNodes.empty()) {
-    auto node_ = deleteNodes.front();
+    auto pair = std::move(deleteNodes.front());
     deleteNodes.pop();
 
-    auto path_ = node_->GetFilePath();
-    m_map.erase(path_);
-    m_parentToChildrenMap.erase(path_);
+    m_map.erase(pair.first);
+    m_parentToChildrenMap.erase(pair.first);
 
-    if (node->IsDirectory()) {
-      for (auto &pair : node_->GetChildren()) {
-        deleteNodes.push(std::move(pair.second));
+    if (pair.second->IsDirectory()) {
+      for (auto &child : pair.second->GetChildren()) {
+        deleteNodes.push(child);
       }
     }
   }
@@ -534,8 +634,8 @@ shared_ptr<Node> DirectoryTree::HardLink(const string &filePath,
   // Still need to synchronize with target file, to support this we may need
   // to refactory Node to contain a shared_ptr<Entry>.
   DebugInfo("Hard link " + FormatPath(filePath, hardlinkPath));
-  lock_guard<recursive_mutex> lock(m_mutex);
-  auto node = Find(filePath).lock();
+  lock_guard<SharedMutex> lock(m_mutex);
+  auto node = FindNoLock(PathName::Find(filePath)).lock();
   if (!(node && *node)) {
     DebugWarning("No such file " + FormatPath(filePath));
     return shared_ptr<Node>(nullptr);
@@ -554,19 +654,41 @@ shared_ptr<Node> DirectoryTree::HardLink(const string &filePath,
   lnkNode->SetHardLink(true);
   node->Insert(lnkNode);
   node->IncreaseNumLink();
-  m_map.emplace(hardlinkPath, lnkNode);
-  m_parentToChildrenMap.emplace(node->GetFilePath(), lnkNode);
+  m_map.emplace(PathName(hardlinkPath), lnkNode);
+  m_parentToChildrenMap[node->GetEntry().GetPathName()].push_back(lnkNode);
   // m_currentNode = lnkNode;
   return lnkNode;
 }
 
+// --------------------------------------------------------------------------
+void DirectoryTree::SetDirectoryListed(const string &dirPath,
+                                       const vector<string> &childPaths,
+                                       bool complete) {
+  lock_guard<SharedMutex> lock(m_mutex);
+  auto node = FindNoLock(PathName::Find(AppendPathDelim(dirPath))).lock();
+  if (!(node && *node && node->IsDirectory())) {
+    return;
+  }
+  if (complete) {
+    // child may be not added as the stats kept are limited
+    for (auto &path : childPaths) {
+      auto child = FindNoLock(PathName::Find(path)).lock();
+      if (!(child && *child)) {
+        complete = false;
+        break;
+      }
+    }
+  }
+  node->SetListedTime(complete ? time(NULL) : 0);
+}
+
 // --------------------------------------------------------------------------
 DirectoryTree::DirectoryTree(time_t mtime, uid_t uid, gid_t gid, mode_t mode) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   m_root = make_shared<Node>(
       Entry(ROOT_PATH, 0, mtime, mtime, uid, gid, mode, FileType::Directory));
   // m_currentNode = m_root;
-  m_map.emplace(ROOT_PATH, m_root);
+  m_map.emplace(m_root->GetEntry().GetPathName(), m_root);
 }
 
 }  // namespace Data
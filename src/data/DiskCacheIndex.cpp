@@ -0,0 +1,371 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#include "data/DiskCacheIndex.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>  // for rename
+#include <string.h>
+
+#include <dirent.h>  // for opendir readdir
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "base/LogMacros.h"
+#include "base/StringUtils.h"
+#include "base/Utils.h"
+#include "configure/Default.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::Configure::Default::GetDiskCacheIndexFileName;
+using QS::StringUtils::FormatPath;
+using QS::Utils::AppendPathDelim;
+using QS::Utils::FileExists;
+using QS::Utils::RemoveFileIfExists;
+using std::ifstream;
+using std::ofstream;
+using std::pair;
+using std::string;
+using std::to_string;
+using std::unique_ptr;
+using std::unordered_set;
+using std::vector;
+
+namespace {
+
+const char *const INDEX_MAGIC = "qsfs-disk-cache-index";
+const int INDEX_VERSION = 1;
+const char *const HEX_DIGITS = "0123456789abcdef";
+
+// --------------------------------------------------------------------------
+uint64_t NumBlocks(uint64_t fileSize, uint64_t blockSize) {
+  return blockSize == 0 ? 0 : (fileSize + blockSize - 1) / blockSize;
+}
+
+// --------------------------------------------------------------------------
+// Bitmap is encoded as hex digits, each digit holds 4 blocks with the
+// lowest bit as the first block. An empty bitmap is encoded as "-".
+string BitmapToHex(const vector<bool> &blocks) {
+  if (blocks.empty()) {
+    return "-";
+  }
+  string hex;
+  hex.reserve((blocks.size() + 3) / 4);
+  for (size_t i = 0; i < blocks.size(); i += 4) {
+    int nibble = 0;
+    for (size_t j = 0; j < 4 && i + j < blocks.size(); ++j) {
+      if (blocks[i + j]) {
+        nibble |= 1 << j;
+      }
+    }
+    hex.append(1, HEX_DIGITS[nibble]);
+  }
+  return hex;
+}
+
+// --------------------------------------------------------------------------
+bool HexToBitmap(const string &hex, size_t numBlocks, vector<bool> *blocks) {
+  blocks->assign(numBlocks, false);
+  if (hex == "-") {
+    return true;
+  }
+  if (hex.size() != (numBlocks + 3) / 4) {
+    return false;
+  }
+  for (size_t i = 0; i < hex.size(); ++i) {
+    auto pos = strchr(HEX_DIGITS, hex[i]);
+    if (pos == nullptr || *pos == '\0') {
+      return false;
+    }
+    int nibble = static_cast<int>(pos - HEX_DIGITS);
+    for (size_t j = 0; j < 4 && i * 4 + j < numBlocks; ++j) {
+      (*blocks)[i * 4 + j] = (nibble >> j) & 1;
+    }
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------
+// Strings are written as "<len>:<bytes>", as object key could contain
+// any character.
+void WriteString(ofstream &os, const string &str) {
+  os << ' ' << str.size() << ':' << str;
+}
+
+// --------------------------------------------------------------------------
+bool ReadString(ifstream &is, string *str) {
+  size_t len = 0;
+  if (!(is >> len) || is.get() != ':') {
+    return false;
+  }
+  str->resize(len);
+  if (len > 0) {
+    is.read(&(*str)[0], len);
+  }
+  return static_cast<bool>(is);
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+DiskCacheIndex::DiskCacheIndex(const string &diskfolder, uint64_t blockSize)
+    : m_diskFolder(AppendPathDelim(diskfolder)), m_blockSize(blockSize) {
+  assert(blockSize > 0);
+}
+
+// --------------------------------------------------------------------------
+string DiskCacheIndex::GetIndexFilePath() const {
+  return m_diskFolder + GetDiskCacheIndexFileName();
+}
+
+// --------------------------------------------------------------------------
+bool DiskCacheIndex::HasRecord(const string &fileId) const {
+  return m_records.find(fileId) != m_records.end();
+}
+
+// --------------------------------------------------------------------------
+bool DiskCacheIndex::Load() {
+  m_records.clear();
+  auto indexFile = GetIndexFilePath();
+  bool success = true;
+  if (FileExists(indexFile, false)) {
+    ifstream is(indexFile, std::ios_base::binary | std::ios_base::in);
+    string magic;
+    int version = 0;
+    uint64_t blockSize = 0;
+    if (!(is >> magic >> version >> blockSize) || magic != INDEX_MAGIC ||
+        version != INDEX_VERSION || blockSize == 0) {
+      DebugWarning("Invalid disk cache index, discard it " +
+                   FormatPath(indexFile));
+      success = false;
+    } else {
+      uint64_t size = 0;
+      int64_t mtime = 0;
+      string hex;
+      while (is >> size >> mtime >> hex) {
+        DiskCacheRecord record;
+        record.size = size;
+        record.mtime = static_cast<time_t>(mtime);
+        if (!(ReadString(is, &record.fileId) &&
+              ReadString(is, &record.diskFile) &&
+              ReadString(is, &record.eTag)) ||
+            !HexToBitmap(hex, NumBlocks(size, blockSize), &record.blocks)) {
+          DebugWarning("Corrupted disk cache index, stop loading at record " +
+                       to_string(m_records.size()) + FormatPath(indexFile));
+          success = false;
+          break;
+        }
+        if (blockSize != m_blockSize) {
+          record.blocks = BuildBlockBitmap(
+              BuildContentRanges(record.blocks, size, blockSize), size,
+              m_blockSize);
+        }
+        if (record.diskFile.empty() ||
+            !FileExists(m_diskFolder + record.diskFile, false)) {
+          continue;
+        }
+        auto fileId = record.fileId;
+        m_records[fileId] = std::move(record);
+      }
+    }
+    is.close();
+    // Remove the index, it will be saved again when unmounting.
+    RemoveFileIfExists(indexFile);
+  }
+
+  // Remove files not referenced by the index.
+  unordered_set<string> diskFiles;
+  for (auto &fileIdToRecord : m_records) {
+    diskFiles.emplace(fileIdToRecord.second.diskFile);
+  }
+  unique_ptr<DIR, decltype(&closedir)> dir(opendir(m_diskFolder.c_str()),
+                                           &closedir);
+  if (dir) {
+    struct dirent *nextEntry = nullptr;
+    while ((nextEntry = readdir(dir.get())) != nullptr) {
+      string name(nextEntry->d_name);
+      if (name == "." || name == ".." ||
+          diskFiles.find(name) != diskFiles.end()) {
+        continue;
+      }
+      string fullPath = m_diskFolder + name;
+      struct stat st;
+      if (lstat(fullPath.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        RemoveFileIfExists(fullPath);
+      }
+    }
+  }
+
+  DebugInfo("Load disk cache index with " + to_string(m_records.size()) +
+            " files " + FormatPath(m_diskFolder));
+  return success;
+}
+
+// --------------------------------------------------------------------------
+bool DiskCacheIndex::Save() const {
+  auto indexFile = GetIndexFilePath();
+  auto tmpFile = indexFile + ".tmp";
+  {
+    ofstream os(tmpFile, std::ios_base::binary | std::ios_base::out |
+                             std::ios_base::trunc);
+    if (!os.is_open()) {
+      DebugError("Fail to open file " + FormatPath(tmpFile));
+      return false;
+    }
+    os << INDEX_MAGIC << ' ' << INDEX_VERSION << ' ' << m_blockSize << '\n';
+    for (auto &fileIdToRecord : m_records) {
+      auto &record = fileIdToRecord.second;
+      os << record.size << ' ' << static_cast<int64_t>(record.mtime) << ' '
+         << BitmapToHex(record.blocks);
+      WriteString(os, record.fileId);
+      WriteString(os, record.diskFile);
+      WriteString(os, record.eTag);
+      os << '\n';
+    }
+    os.flush();
+    if (!os.good()) {
+      DebugError("Fail to write disk cache index " + FormatPath(tmpFile));
+      os.close();
+      RemoveFileIfExists(tmpFile);
+      return false;
+    }
+  }
+
+  // Replace the index at once, so a partially written index is never loaded.
+  if (rename(tmpFile.c_str(), indexFile.c_str()) != 0) {
+    DebugError("Fail to rename file " + FormatPath(tmpFile, indexFile) +
+               " " + strerror(errno));
+    RemoveFileIfExists(tmpFile);
+    return false;
+  }
+  DebugInfo("Save disk cache index with " + to_string(m_records.size()) +
+            " files " + FormatPath(indexFile));
+  return true;
+}
+
+// --------------------------------------------------------------------------
+void DiskCacheIndex::Put(DiskCacheRecord &&record) {
+  auto fileId = record.fileId;
+  m_records[fileId] = std::move(record);
+}
+
+// --------------------------------------------------------------------------
+pair<bool, DiskCacheRecord> DiskCacheIndex::Take(const string &fileId) {
+  auto it = m_records.find(fileId);
+  if (it == m_records.end()) {
+    return {false, DiskCacheRecord()};
+  }
+  auto record = std::move(it->second);
+  m_records.erase(it);
+  return {true, std::move(record)};
+}
+
+// --------------------------------------------------------------------------
+uint64_t DiskCacheIndex::RemoveAll() {
+  uint64_t freedSize = 0;
+  for (auto &fileIdToRecord : m_records) {
+    auto diskFile = m_diskFolder + fileIdToRecord.second.diskFile;
+    struct stat st;
+    if (stat(diskFile.c_str(), &st) == 0) {
+      freedSize += static_cast<uint64_t>(st.st_blocks) * 512;
+    }
+    RemoveFileIfExists(diskFile);
+  }
+  m_records.clear();
+  return freedSize;
+}
+
+// --------------------------------------------------------------------------
+vector<bool> DiskCacheIndex::BuildBlockBitmap(const ContentRangeDeque &ranges,
+                                              uint64_t fileSize,
+                                              uint64_t blockSize) {
+  vector<bool> blocks(NumBlocks(fileSize, blockSize), false);
+  // Ranges are sorted by offset, merge successive ones before marking blocks,
+  // as a block could be covered by several ranges.
+  auto MarkBlocks = [&blocks, fileSize, blockSize](uint64_t start,
+                                                   uint64_t stop) {
+    stop = stop < fileSize ? stop : fileSize;
+    uint64_t first = (start + blockSize - 1) / blockSize;
+    // The last block of file is present once it is covered up to file size.
+    uint64_t last = stop == fileSize ? blocks.size() : stop / blockSize;
+    for (uint64_t i = first; i < last; ++i) {
+      blocks[i] = true;
+    }
+  };
+
+  bool hasRange = false;
+  uint64_t start = 0;
+  uint64_t stop = 0;
+  for (auto &range : ranges) {
+    auto off = static_cast<uint64_t>(range.first);
+    if (hasRange && off <= stop) {
+      stop = std::max(stop, off + range.second);
+      continue;
+    }
+    if (hasRange) {
+      MarkBlocks(start, stop);
+    }
+    hasRange = true;
+    start = off;
+    stop = off + range.second;
+  }
+  if (hasRange) {
+    MarkBlocks(start, stop);
+  }
+  return blocks;
+}
+
+// --------------------------------------------------------------------------
+ContentRangeDeque DiskCacheIndex::BuildContentRanges(
+    const vector<bool> &blocks, uint64_t fileSize, uint64_t blockSize) {
+  ContentRangeDeque ranges;
+  size_t i = 0;
+  while (i < blocks.size()) {
+    if (!blocks[i]) {
+      ++i;
+      continue;
+    }
+    size_t j = i;
+    while (j < blocks.size() && blocks[j]) {
+      ++j;
+    }
+    uint64_t start = i * blockSize;
+    uint64_t stop = j * blockSize;
+    stop = stop < fileSize ? stop : fileSize;
+    if (start < stop) {
+      ranges.emplace_back(static_cast<off_t>(start),
+                          static_cast<size_t>(stop - start));
+    }
+    i = j;
+  }
+  return ranges;
+}
+
+}  // namespace Data
+}  // namespace QS
@@ -0,0 +1,275 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#include "data/DiskFile.h"
+
+#include <errno.h>
+#include <fcntl.h>  // for open fallocate
+#include <stdint.h>
+#include <stdlib.h>  // for posix_memalign
+#include <string.h>  // for strerror
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "base/LogMacros.h"
+#include "base/StringUtils.h"
+#include "base/Utils.h"
+#include "data/Page.h"
+#include "data/Size.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::StringUtils::FormatPath;
+using QS::Utils::CreateDirectoryIfNotExists;
+using QS::Utils::GetDirName;
+using std::string;
+using std::unique_ptr;
+
+namespace {
+
+// Alignment of offset, len and buffer for direct io
+constexpr size_t kDirectIOAlignment = QS::Data::Size::KB4;
+
+// --------------------------------------------------------------------------
+off_t AlignDown(off_t offset) {
+  return offset & ~static_cast<off_t>(kDirectIOAlignment - 1);
+}
+
+// --------------------------------------------------------------------------
+off_t AlignUp(off_t offset) {
+  return AlignDown(offset + static_cast<off_t>(kDirectIOAlignment - 1));
+}
+
+// --------------------------------------------------------------------------
+int OpenFile(const string &path, int flags) {
+  int fd = -1;
+  do {
+    fd = ::open(path.c_str(), flags, 0600);
+  } while (fd < 0 && errno == EINTR);
+  return fd;
+}
+
+// Aligned buffer allocated by posix_memalign
+struct FreeDeleter {
+  void operator()(char *p) const { free(p); }
+};
+using AlignedBuffer = unique_ptr<char, FreeDeleter>;
+
+// --------------------------------------------------------------------------
+AlignedBuffer AllocateAlignedBuffer(size_t len) {
+  void *p = nullptr;
+  if (posix_memalign(&p, kDirectIOAlignment, len) != 0) {
+    return AlignedBuffer(nullptr);
+  }
+  return AlignedBuffer(static_cast<char *>(p));
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+DiskFile::DiskFile(const string &path, bool directIO) : m_path(path) {
+  CreateDirectoryIfNotExists(GetDirName(m_path));
+  int flags = O_RDWR | O_CREAT | O_CLOEXEC;
+#ifdef O_DIRECT
+  if (directIO) {
+    m_fd = OpenFile(m_path, flags | O_DIRECT);
+    if (m_fd >= 0) {
+      m_directIO = true;
+    } else {
+      DebugWarning("Unable to open file with direct io, use buffered io " +
+                   FormatPath(m_path) + " " + strerror(errno));
+    }
+  }
+#endif
+  if (m_fd < 0) {
+    m_fd = OpenFile(m_path, flags);
+  }
+  if (m_fd < 0) {
+    DebugError("Fail to open file " + FormatPath(m_path) + " " +
+               strerror(errno));
+  } else {
+    DebugInfo("Open file " + FormatPath(m_path));
+  }
+}
+
+// --------------------------------------------------------------------------
+DiskFile::~DiskFile() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
+
+// --------------------------------------------------------------------------
+bool DiskFile::IsAligned(off_t offset, size_t len, const char *buffer) const {
+  if (!m_directIO) {
+    return true;
+  }
+  auto mask = kDirectIOAlignment - 1;
+  return (static_cast<size_t>(offset) & mask) == 0 && (len & mask) == 0 &&
+         (reinterpret_cast<uintptr_t>(buffer) & mask) == 0;
+}
+
+// --------------------------------------------------------------------------
+size_t DiskFile::Read(off_t offset, size_t len, char *buffer) const {
+  if (m_fd < 0) {
+    DebugError("Disk file not open " + FormatPath(m_path));
+    return 0;
+  }
+  if (!IsAligned(offset, len, buffer)) {
+    return BounceRead(offset, len, buffer);
+  }
+  return DirectRead(offset, len, buffer);
+}
+
+// --------------------------------------------------------------------------
+size_t DiskFile::DirectRead(off_t offset, size_t len, char *buffer) const {
+  size_t readSize = 0;
+  while (readSize < len) {
+    auto n = ::pread(m_fd, buffer + readSize, len - readSize,
+                     offset + static_cast<off_t>(readSize));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      DebugError("Fail to read file " + FormatPath(m_path) + " " +
+                 ToStringLine(offset, len) + " " + strerror(errno));
+      break;
+    } else if (n == 0) {
+      break;  // end of file
+    }
+    readSize += static_cast<size_t>(n);
+  }
+  return readSize;
+}
+
+// --------------------------------------------------------------------------
+size_t DiskFile::Write(off_t offset, size_t len, const char *buffer) {
+  if (m_fd < 0) {
+    DebugError("Disk file not open " + FormatPath(m_path));
+    return 0;
+  }
+  if (!IsAligned(offset, len, buffer)) {
+    return BounceWrite(offset, len, buffer);
+  }
+  return DirectWrite(offset, len, buffer);
+}
+
+// --------------------------------------------------------------------------
+size_t DiskFile::DirectWrite(off_t offset, size_t len, const char *buffer) {
+  size_t writtenSize = 0;
+  while (writtenSize < len) {
+    auto n = ::pwrite(m_fd, buffer + writtenSize, len - writtenSize,
+                      offset + static_cast<off_t>(writtenSize));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      DebugError("Fail to write file " + FormatPath(m_path) + " " +
+                 ToStringLine(offset, len) + " " + strerror(errno));
+      break;
+    }
+    writtenSize += static_cast<size_t>(n);
+  }
+  return writtenSize;
+}
+
+// --------------------------------------------------------------------------
+size_t DiskFile::BounceRead(off_t offset, size_t len, char *buffer) const {
+  auto start = AlignDown(offset);
+  auto stop = AlignUp(offset + static_cast<off_t>(len));
+  auto bounceLen = static_cast<size_t>(stop - start);
+  auto bounce = AllocateAlignedBuffer(bounceLen);
+  if (!bounce) {
+    DebugError("Fail to allocate aligned buffer " + ToStringLine(offset, len));
+    return 0;
+  }
+  // a short read happens at the end of file
+  auto readSize = DirectRead(start, bounceLen, bounce.get());
+  auto head = static_cast<size_t>(offset - start);
+  if (readSize <= head) {
+    return 0;
+  }
+  auto copySize = std::min(len, readSize - head);
+  memcpy(buffer, bounce.get() + head, copySize);
+  return copySize;
+}
+
+// --------------------------------------------------------------------------
+size_t DiskFile::BounceWrite(off_t offset, size_t len, const char *buffer) {
+  auto start = AlignDown(offset);
+  auto stop = AlignUp(offset + static_cast<off_t>(len));
+  auto bounceLen = static_cast<size_t>(stop - start);
+  auto bounce = AllocateAlignedBuffer(bounceLen);
+  if (!bounce) {
+    DebugError("Fail to allocate aligned buffer " + ToStringLine(offset, len));
+    return 0;
+  }
+  // Keep the bytes of the partial blocks at the edges, the bytes beyond the
+  // end of file are zeros.
+  memset(bounce.get(), 0, bounceLen);
+  auto head = static_cast<size_t>(offset - start);
+  if (head > 0) {
+    DirectRead(start, kDirectIOAlignment, bounce.get());
+  }
+  auto lastBlock = stop - static_cast<off_t>(kDirectIOAlignment);
+  if (offset + static_cast<off_t>(len) < stop &&
+      (head == 0 || lastBlock > start)) {
+    DirectRead(lastBlock, kDirectIOAlignment,
+                  bounce.get() + (lastBlock - start));
+  }
+  memcpy(bounce.get() + head, buffer, len);
+
+  auto writtenSize = DirectWrite(start, bounceLen, bounce.get());
+  if (writtenSize <= head) {
+    return 0;
+  }
+  return std::min(len, writtenSize - head);
+}
+
+// --------------------------------------------------------------------------
+bool DiskFile::PunchHole(off_t offset, size_t len) {
+  if (m_fd < 0 || len == 0) {
+    return false;
+  }
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+  int ret = 0;
+  do {
+    ret = ::fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      offset, static_cast<off_t>(len));
+  } while (ret != 0 && errno == EINTR);
+  if (ret != 0) {
+    DebugWarningIf(errno != EOPNOTSUPP,
+                   "Fail to punch hole in file " + FormatPath(m_path) + " " +
+                       ToStringLine(offset, len) + " " + strerror(errno));
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+}  // namespace Data
+}  // namespace QS
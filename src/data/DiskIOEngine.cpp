@@ -0,0 +1,434 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#include "data/DiskIOEngine.h"
+
+#include <errno.h>
+#include <string.h>  // for memset strerror
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>  // for iovec
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <future>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "base/LogMacros.h"
+#include "base/ThreadPool.h"
+#include "data/DiskFile.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::Threading::ThreadPool;
+using std::future;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+// Num of worker threads of the thread pool engine
+constexpr size_t kDiskIOThreadPoolSize = 4;
+
+// Num of entries of each io_uring ring
+constexpr unsigned kDiskIORingEntries = 64;
+
+// --------------------------------------------------------------------------
+// Read a request from disk file directly
+void ReadRequest(DiskIORequest *request) {
+  request->result =
+      request->file->Read(request->offset, request->len, request->buffer);
+}
+
+// --------------------------------------------------------------------------
+size_t SumResults(const DiskIORequestVec &requests) {
+  size_t readSize = 0;
+  for (auto &request : requests) {
+    readSize += request.result;
+  }
+  return readSize;
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+// A io_uring instance set up by system calls directly
+class IoUring {
+ public:
+  explicit IoUring(unsigned entries);
+  IoUring(IoUring &&) = delete;
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(IoUring &&) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+  ~IoUring();
+
+ public:
+  bool IsValid() const { return m_ringFd >= 0; }
+  bool IsFull() const { return m_requests.size() == m_sqEntries; }
+
+  // Put a request into submission queue, return false if queue is full
+  bool Add(DiskIORequest *request);
+
+  // Submit the queued requests and wait all of them complete
+  //
+  // Requests which fail or read partially are completed by reading the disk
+  // file directly. Return false if the ring is broken.
+  bool Submit();
+
+ private:
+  void Close();
+
+ private:
+  int m_ringFd = -1;
+  unsigned m_sqEntries = 0;
+
+  void *m_sqRing = MAP_FAILED;
+  size_t m_sqRingSize = 0;
+  void *m_cqRing = MAP_FAILED;
+  size_t m_cqRingSize = 0;
+  struct io_uring_sqe *m_sqes = nullptr;
+  size_t m_sqesSize = 0;
+
+  unsigned *m_sqTail = nullptr;
+  unsigned *m_sqMask = nullptr;
+  unsigned *m_sqArray = nullptr;
+  unsigned *m_cqHead = nullptr;
+  unsigned *m_cqTail = nullptr;
+  unsigned *m_cqMask = nullptr;
+  struct io_uring_cqe *m_cqes = nullptr;
+
+  std::vector<DiskIORequest *> m_requests;  // queued requests
+  std::vector<struct iovec> m_iovecs;       // iovec of queued requests
+};
+
+// --------------------------------------------------------------------------
+int IoUringSetup(unsigned entries, struct io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+// --------------------------------------------------------------------------
+int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit,
+                                  minComplete, IORING_ENTER_GETEVENTS,
+                                  nullptr, 0));
+}
+
+// --------------------------------------------------------------------------
+IoUring::IoUring(unsigned entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  m_ringFd = IoUringSetup(entries, &params);
+  if (m_ringFd < 0) {
+    DebugWarning(string("Fail to set up io_uring ") + strerror(errno));
+    return;
+  }
+  m_sqEntries = params.sq_entries;
+  m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool singleMmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+  singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMmap) {
+    m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+  }
+#endif
+  m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+  if (m_sqRing != MAP_FAILED) {
+    m_cqRing = singleMmap ? m_sqRing
+                          : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, m_ringFd,
+                                 IORING_OFF_CQ_RING);
+  }
+  m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = MAP_FAILED;
+  if (m_cqRing != MAP_FAILED) {
+    sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+  }
+  if (sqes == MAP_FAILED) {
+    DebugWarning(string("Fail to map io_uring ") + strerror(errno));
+    Close();
+    return;
+  }
+  m_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+  auto sq = static_cast<char *>(m_sqRing);
+  m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  m_sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  auto cq = static_cast<char *>(m_cqRing);
+  m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  m_cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  m_requests.reserve(m_sqEntries);
+  m_iovecs.resize(m_sqEntries);
+}
+
+// --------------------------------------------------------------------------
+IoUring::~IoUring() { Close(); }
+
+// --------------------------------------------------------------------------
+void IoUring::Close() {
+  if (m_sqes != nullptr) {
+    munmap(m_sqes, m_sqesSize);
+    m_sqes = nullptr;
+  }
+  if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+    munmap(m_cqRing, m_cqRingSize);
+  }
+  m_cqRing = MAP_FAILED;
+  if (m_sqRing != MAP_FAILED) {
+    munmap(m_sqRing, m_sqRingSize);
+    m_sqRing = MAP_FAILED;
+  }
+  if (m_ringFd >= 0) {
+    ::close(m_ringFd);
+    m_ringFd = -1;
+  }
+}
+
+// --------------------------------------------------------------------------
+bool IoUring::Add(DiskIORequest *request) {
+  if (IsFull()) {
+    return false;
+  }
+  auto index = static_cast<unsigned>(m_requests.size());
+  m_requests.push_back(request);
+  m_iovecs[index].iov_base = request->buffer;
+  m_iovecs[index].iov_len = request->len;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+bool IoUring::Submit() {
+  auto count = static_cast<unsigned>(m_requests.size());
+  if (count == 0) {
+    return true;
+  }
+
+  // Only this thread produces submissions, so the tail is not changed by
+  // others.
+  unsigned tail = *m_sqTail;
+  auto mask = *m_sqMask;
+  for (unsigned i = 0; i < count; ++i) {
+    auto index = tail & mask;
+    auto sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = m_requests[i]->file->GetFd();
+    sqe->off = static_cast<uint64_t>(m_requests[i]->offset);
+    sqe->addr = reinterpret_cast<uint64_t>(&m_iovecs[i]);
+    sqe->len = 1;
+    sqe->user_data = i;
+    m_sqArray[index] = index;
+    ++tail;
+  }
+  __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+  unsigned submitted = 0;
+  unsigned completed = 0;
+  bool broken = false;
+  bool waitFailed = false;
+  while (completed < count) {
+    if (waitFailed) {
+      // The submitted reads are still in flight and write into the caller
+      // buffers, so poll the mapped completion ring until all of them are
+      // reaped before falling back to reading the buffers again.
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } else {
+      auto toSubmit = broken ? 0 : count - submitted;
+      auto ret = IoUringEnter(m_ringFd, toSubmit, 1);
+      if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+          // reap completions to make room before retry
+        } else if (!broken && submitted < count) {
+          DebugError(string("Fail to submit io_uring ") + strerror(errno));
+          broken = true;
+          if (submitted == completed) {
+            break;
+          }
+          continue;
+        } else {
+          DebugError(string("Fail to wait io_uring ") + strerror(errno));
+          broken = true;
+          waitFailed = true;
+        }
+      } else if (!broken) {
+        submitted += static_cast<unsigned>(ret);
+      }
+    }
+
+    auto head = *m_cqHead;
+    while (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+      auto &cqe = m_cqes[head & *m_cqMask];
+      auto request = m_requests[static_cast<size_t>(cqe.user_data)];
+      request->result = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+      ++head;
+      ++completed;
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    if (broken && completed >= submitted) {
+      break;
+    }
+  }
+
+  // complete the failed or partial requests
+  for (auto request : m_requests) {
+    if (request->result < request->len) {
+      request->result += request->file->Read(
+          request->offset + static_cast<off_t>(request->result),
+          request->len - request->result, request->buffer + request->result);
+    }
+  }
+  m_requests.clear();
+  if (broken) {
+    Close();
+  }
+  return !broken;
+}
+
+#endif  // HAVE_LINUX_IO_URING_H
+
+static unique_ptr<DiskIOEngine> instance(nullptr);
+static std::once_flag flag;
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+void AddDiskReadRequest(DiskIORequestVec *requests, DiskFile *file,
+                        off_t offset, size_t len, char *buffer) {
+  if (!requests->empty()) {
+    auto &last = requests->back();
+    if (last.file == file &&
+        last.offset + static_cast<off_t>(last.len) == offset &&
+        last.buffer + last.len == buffer) {
+      last.len += len;
+      return;
+    }
+  }
+  requests->emplace_back(file, offset, len, buffer);
+}
+
+// --------------------------------------------------------------------------
+DiskIOEngine &DiskIOEngine::Instance() {
+  std::call_once(flag, [] {
+    if (IoUringDiskIOEngine::IsSupported()) {
+      instance.reset(new IoUringDiskIOEngine(kDiskIORingEntries));
+    } else {
+      instance.reset(new ThreadPoolDiskIOEngine(kDiskIOThreadPoolSize));
+    }
+    DebugInfo(string("Use disk io engine ") + instance->GetName());
+  });
+  return *instance.get();
+}
+
+// --------------------------------------------------------------------------
+ThreadPoolDiskIOEngine::ThreadPoolDiskIOEngine(size_t poolSize)
+    : m_threadPool(new ThreadPool(poolSize)) {
+  m_threadPool->Initialize();
+}
+
+// --------------------------------------------------------------------------
+ThreadPoolDiskIOEngine::~ThreadPoolDiskIOEngine() = default;
+
+// --------------------------------------------------------------------------
+size_t ThreadPoolDiskIOEngine::Read(DiskIORequestVec *requests) {
+  if (requests == nullptr || requests->empty()) {
+    return 0;
+  }
+  // Read the first request in calling thread, and the others in the pool.
+  vector<future<void>> futures;
+  futures.reserve(requests->size() - 1);
+  for (size_t i = 1; i < requests->size(); ++i) {
+    futures.push_back(
+        m_threadPool->SubmitCallable(ReadRequest, &(*requests)[i]));
+  }
+  ReadRequest(&requests->front());
+  for (auto &f : futures) {
+    f.wait();
+  }
+  return SumResults(*requests);
+}
+
+// --------------------------------------------------------------------------
+IoUringDiskIOEngine::IoUringDiskIOEngine(unsigned entries)
+    : m_entries(entries) {}
+
+// --------------------------------------------------------------------------
+bool IoUringDiskIOEngine::IsSupported() {
+#ifdef HAVE_LINUX_IO_URING_H
+  static bool supported = [] {
+    IoUring ring(1);
+    return ring.IsValid();
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+// --------------------------------------------------------------------------
+size_t IoUringDiskIOEngine::Read(DiskIORequestVec *requests) {
+  if (requests == nullptr || requests->empty()) {
+    return 0;
+  }
+#ifdef HAVE_LINUX_IO_URING_H
+  thread_local unique_ptr<IoUring> ring;
+  if (!ring) {
+    ring.reset(new IoUring(m_entries));
+  }
+  for (auto &request : *requests) {
+    // io_uring does not handle the alignment required by direct io
+    if (!ring->IsValid() || !request.file->IsOpen() ||
+        !request.file->IsAligned(request.offset, request.len,
+                                 request.buffer)) {
+      ReadRequest(&request);
+      continue;
+    }
+    if (ring->IsFull() && !ring->Submit()) {
+      ReadRequest(&request);  // ring is broken
+      continue;
+    }
+    ring->Add(&request);
+  }
+  if (ring->IsValid()) {
+    ring->Submit();
+  }
+#else
+  for (auto &request : *requests) {
+    ReadRequest(&request);
+  }
+#endif
+  return SumResults(*requests);
+}
+
+}  // namespace Data
+}  // namespace QS
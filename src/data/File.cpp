@@ -17,10 +17,12 @@
 #include "data/File.h"
 
 #include <assert.h>
+#include <stddef.h>  // for ptrdiff_t
 #include <stdio.h>  // for pclose
+#include <string.h>  // for memcpy memset
 
+#include <algorithm>
 #include <iterator>
-#include <list>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -30,25 +32,28 @@
 #include "base/LogMacros.h"
 #include "base/StringUtils.h"
 #include "base/Utils.h"
+#include "configure/Default.h"
 #include "configure/Options.h"
+#include "data/DiskFile.h"
+#include "data/DiskIOEngine.h"
 #include "data/IOStream.h"
+#include "data/StreamBuf.h"
 
 namespace QS {
 
 namespace Data {
 
+using QS::Configure::Default::GetMaxPageExtentSize;
 using QS::StringUtils::PointerAddress;
 using QS::Utils::FileExists;
 using QS::Utils::RemoveFileIfExists;
 using QS::Utils::RemoveFileIfExistsNoLog;
 using std::iostream;
-using std::list;
 using std::lock_guard;
 using std::make_shared;
 using std::make_tuple;
 using std::pair;
 using std::recursive_mutex;
-using std::reverse_iterator;
 using std::shared_ptr;
 using std::string;
 using std::to_string;
@@ -58,6 +63,16 @@ using std::vector;
 
 namespace {
 
+// Num of pages a file could have without merging pages, besides one page
+// for each max page extent size of the file
+constexpr size_t kNumPagesNotToMerge = 32;
+
+// Num of reads which make a page in disk file hot to be promoted
+constexpr unsigned kNumDiskHitsToPromote = 2;
+
+// Min size of a page to be stored as a hole when all its bytes are zero
+constexpr size_t kMinHoleSize = 4096;
+
 // Build a disk file absolute path
 //
 // @param  : file base name
@@ -72,18 +87,44 @@ string BuildDiskFilePath(const string &basename) {
 // --------------------------------------------------------------------------
 string PrintFileName(const string &file) { return "[file=" + file + "]"; }
 
+// --------------------------------------------------------------------------
+// Whether the len of bytes are all zero, so they could be stored as a hole
+bool IsHole(const char *buffer, size_t len) {
+  return buffer != nullptr && len >= kMinHoleSize && IsAllZero(buffer, len);
+}
+
+// --------------------------------------------------------------------------
+// Return the bytes of an in-memory stream, null if not available
+const char *GetStreamData(const shared_ptr<iostream> &stream, size_t len) {
+  auto streambuf =
+      stream ? dynamic_cast<const StreamBuf *>(stream->rdbuf()) : nullptr;
+  if (streambuf == nullptr || !streambuf->GetBuffer() ||
+      streambuf->GetBuffer()->size() < len) {
+    return nullptr;
+  }
+  return streambuf->GetBuffer()->data();
+}
+
 }  // namespace
 
 // --------------------------------------------------------------------------
 File::~File() {
   // As pages using disk file will reference to the same disk file, so File
   // should manage the life cycle of the disk file.
-  RemoveDiskFileIfExists(true);  // log on
+  if (!m_keepDiskFile) {
+    RemoveDiskFileIfExists(true);  // log on
+  }
 }
 
 // --------------------------------------------------------------------------
 string File::AskDiskFilePath() const { return BuildDiskFilePath(m_baseName); }
 
+// --------------------------------------------------------------------------
+string File::GetETag() const {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  return m_eTag;
+}
+
 // --------------------------------------------------------------------------
 pair<PageSetConstIterator, PageSetConstIterator>
 File::ConsecutivePageRangeAtFront() const {
@@ -94,7 +135,7 @@ File::ConsecutivePageRangeAtFront() const {
   auto cur = m_pages.begin();
   auto next = m_pages.begin();
   while (++next != m_pages.end()) {
-    if ((*cur)->Next() < (*next)->Offset()) {
+    if (cur->Next() < next->offset) {
       break;
     }
     ++cur;
@@ -120,13 +161,13 @@ bool File::HasData(off_t start, size_t size) const {
   auto cur = beg;
   auto next = beg;
   while (++next != range.second) {
-    if ((*cur)->Next() < (*next)->Offset()) {
+    if (cur->Next() < next->offset) {
       break;
     }
     ++cur;
   }
 
-  return ((*beg)->Offset() <= start && stop <= (*cur)->Next());
+  return (beg->offset <= start && stop <= cur->Next());
 }
 
 // --------------------------------------------------------------------------
@@ -147,19 +188,19 @@ ContentRangeDeque File::GetUnloadedRanges(off_t start, size_t size) const {
   auto cur = range.first;
   auto next = range.first;
   while (++next != range.second) {
-    if ((*cur)->Next() < (*next)->Offset()) {
-      if ((*next)->Offset() > static_cast<off_t>(size)) {
+    if (cur->Next() < next->offset) {
+      if (next->offset > static_cast<off_t>(size)) {
         break;
       }
-      off_t off = (*cur)->Next();
-      size_t size = static_cast<size_t>((*next)->Offset() - off);
+      off_t off = cur->Next();
+      size_t size = static_cast<size_t>(next->offset - off);
       ranges.emplace_back(off, size);
     }
     ++cur;
   }
 
-  if ((*cur)->Next() < stop) {
-    off_t off = (*cur)->Next();
+  if (cur->Next() < stop) {
+    off_t off = cur->Next();
     size_t size = static_cast<size_t>(stop - off);
     ranges.emplace_back(off, size);
   }
@@ -186,93 +227,432 @@ size_t File::GetNumPages() const {
 }
 
 // --------------------------------------------------------------------------
-tuple<size_t, list<shared_ptr<Page>>, ContentRangeDeque> File::Read(
-    off_t offset, size_t len, time_t mtimeSince) {
-  // Cache already check input.
-  // bool isValidInput = offset >= 0 && len > 0 && entry != nullptr && (*entry);
-  // assert(isValidInput);
-  // if (!isValidInput) {
-  //   DebugError("Fail to read file with invalid input " +
-  //              ToStringLine(offset, len));
-  //   return {0, list<shared_ptr<Page>>()};
-  // }
+ContentRangeDeque File::GetDiskFileRanges() const {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  ContentRangeDeque ranges;
+  for (auto &entry : m_pages) {
+    if (!entry.page->UseDiskFile()) {
+      continue;
+    }
+    if (!ranges.empty() &&
+        ranges.back().first + static_cast<off_t>(ranges.back().second) ==
+            entry.offset) {
+      ranges.back().second += entry.size;
+    } else {
+      ranges.emplace_back(entry.offset, entry.size);
+    }
+  }
+  return ranges;
+}
 
-  ContentRangeDeque unloadedRanges;
-  auto AddUnloadedPages = [&unloadedRanges](off_t offset, size_t len) {
-    unloadedRanges.emplace_back(offset, len);
-  };
+// --------------------------------------------------------------------------
+ContentRangeDeque File::GetDirtyRanges() const {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  return m_dirtyRanges;
+}
 
-  size_t outcomeSize = 0;
-  list<shared_ptr<Page>> outcomePages;
+// --------------------------------------------------------------------------
+size_t File::Read(off_t offset, size_t len, char *buffer, time_t mtimeSince,
+                  ContentRangeDeque *unloadedRanges, CacheTierStats *stats) {
+  // Reuse the containers of this thread, so no allocation after warming up.
+  static thread_local FileSliceVec slices;
+  static thread_local DiskIORequestVec diskReads;
+  slices.clear();
+  diskReads.clear();
 
-  if (len == 0) {
-    AddUnloadedPages(offset, len);
-    return make_tuple(outcomeSize, outcomePages, unloadedRanges);
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (!UnguardedCheckTime(mtimeSince)) {
+    // Detected modification in the file
+    if (unloadedRanges != nullptr) {
+      unloadedRanges->emplace_back(offset, len);
+    }
+    if (stats != nullptr) {
+      stats->missed += len;
+    }
+    memset(buffer, 0, len);
+    return 0;
   }
 
-  {
-    lock_guard<recursive_mutex> lock(m_mutex);
-
-    if (mtimeSince > 0) {
-      // File is just created, update mtime.
-      if (m_mtime == 0) {
-        SetTime(mtimeSince);
-      } else if (mtimeSince > m_mtime) {
-        // Detected modification in the file
-        AddUnloadedPages(offset, len);
-        return make_tuple(outcomeSize, outcomePages, unloadedRanges);
+  UnguardedGetSlices(offset, len, &slices, unloadedRanges, stats);
+  size_t readSize = 0;
+  size_t expectedSize = 0;
+  off_t stop = offset;
+  for (auto &slice : slices) {
+    char *buf = buffer + (slice.offset - offset);
+    if (slice.data != nullptr) {
+      memcpy(buf, slice.data, slice.len);
+      readSize += slice.len;
+    } else if (slice.diskFile != nullptr) {
+      AddDiskReadRequest(&diskReads, slice.diskFile, slice.offset, slice.len,
+                         buf);
+      expectedSize += slice.len;
+    } else {
+      memset(buf, 0, slice.len);
+      if (slice.zero) {
+        readSize += slice.len;
       }
     }
+    stop = slice.offset + static_cast<off_t>(slice.len);
+  }
+  auto zeroLen = len - static_cast<size_t>(stop - offset);
+  if (zeroLen > 0) {
+    memset(buffer + (stop - offset), 0, zeroLen);
+  }
+  // Disk reads are done with file locked, which keeps the disk file alive.
+  if (!diskReads.empty()) {
+    size_t diskReadSize = DiskIOEngine::Instance().Read(&diskReads);
+    DebugWarningIf(diskReadSize != expectedSize,
+                   "Read " + to_string(diskReadSize) + " bytes, expect " +
+                       to_string(expectedSize) + " bytes from disk file " +
+                       PrintFileName(m_baseName));
+    readSize += diskReadSize;
+  }
+  return readSize;
+}
 
-    // If pages is empty.
-    if (m_pages.empty()) {
-      AddUnloadedPages(offset, len);
-      return make_tuple(outcomeSize, outcomePages, unloadedRanges);
-    }
-
-    auto range = IntesectingRange(offset, offset + len);
-    auto it1 = range.first;
-    auto it2 = range.second;
-    auto offset_ = offset;
-    size_t len_ = len;
-    // For pages which are not completely ahead of 'offset'
-    // but ahead of 'offset + len'.
-    while (it1 != it2) {
-      if (len_ <= 0) break;
-      auto &page = *it1;
-      if (offset_ <
-          page->m_offset) {  // Add unloaded page for bytes not present.
-        auto lenNewPage = page->m_offset - offset_;
-        AddUnloadedPages(offset_, lenNewPage);
-        offset_ = page->m_offset;
-        len_ -= lenNewPage;
-      } else {  // Collect existing pages.
-        if (len_ <= static_cast<size_t>(page->Next() - offset_)) {
-          outcomePages.emplace_back(page);
-          outcomeSize += page->m_size;
-          return make_tuple(outcomeSize, outcomePages, unloadedRanges);
-        } else {
-          outcomePages.emplace_back(page);
-          outcomeSize += page->m_size;
+// --------------------------------------------------------------------------
+size_t File::ReadSlices(off_t offset, size_t len, FileSliceVec *slices,
+                        time_t mtimeSince, ContentRangeDeque *unloadedRanges,
+                        CacheTierStats *stats) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (!UnguardedCheckTime(mtimeSince)) {
+    // Detected modification in the file
+    if (unloadedRanges != nullptr) {
+      unloadedRanges->emplace_back(offset, len);
+    }
+    if (stats != nullptr) {
+      stats->missed += len;
+    }
+    return 0;
+  }
+  return UnguardedGetSlices(offset, len, slices, unloadedRanges, stats);
+}
+
+// --------------------------------------------------------------------------
+size_t File::Compress() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  size_t savedSize = 0;
+  for (auto &entry : m_pages) {
+    // shared page is never compressed
+    if (entry.page.use_count() <= 1 && !entry.uncharged) {
+      savedSize += entry.page->Compress();
+    }
+  }
+  m_compressedSavedSize += savedSize;
+  return savedSize;
+}
 
-          len_ -= page->Next() - offset_;
-          offset_ = page->Next();
-          ++it1;
+// --------------------------------------------------------------------------
+size_t File::Demote(size_t size) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  auto cachedSizeBegin = GetCachedSize();
+  for (auto &entry : m_pages) {
+    if (cachedSizeBegin - GetCachedSize() >= size) {
+      break;
+    }
+    auto &page = entry.page;
+    if (page->UseDiskFile() || page->IsHole() || page.use_count() > 1 ||
+        entry.uncharged) {
+      continue;
+    }
+    auto savedSize = page->GetCompressedSavedSize();
+    if (!page->Demote(UnguardedGetDiskFile())) {
+      break;  // disk file is not available
+    }
+    m_cacheSize -= entry.size;
+    m_compressedSavedSize -= savedSize;
+  }
+  return cachedSizeBegin - GetCachedSize();
+}
+
+// --------------------------------------------------------------------------
+size_t File::PromoteHotPages() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  size_t promotedSize = 0;
+  for (auto &entry : m_pages) {
+    auto &page = entry.page;
+    if (page->UseDiskFile() && page->m_diskHits >= kNumDiskHitsToPromote &&
+        page->Promote()) {
+      m_cacheSize += entry.size;
+      promotedSize += entry.size;
+    }
+  }
+  m_hotDiskSize.store(0);
+  return promotedSize;
+}
+
+// --------------------------------------------------------------------------
+size_t File::DropDiskPages() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  size_t droppedSize = 0;
+  auto it = std::remove_if(
+      m_pages.begin(), m_pages.end(), [&droppedSize](const PageEntry &entry) {
+        if (!entry.page->UseDiskFile()) {
+          return false;
         }
+        entry.page->PunchHole();
+        droppedSize += entry.size;
+        return true;
+      });
+  m_pages.erase(it, m_pages.end());
+  m_size -= droppedSize;
+  m_hotDiskSize.store(0);
+  return droppedSize;
+}
+
+// --------------------------------------------------------------------------
+size_t File::Recycle(size_t size, off_t start, off_t stop) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  auto IsDirty = [this](const PageEntry &entry) {
+    auto it = std::lower_bound(
+        m_dirtyRanges.begin(), m_dirtyRanges.end(), entry.offset,
+        [](const pair<off_t, size_t> &range, off_t offset) {
+          return range.first + static_cast<off_t>(range.second) <= offset;
+        });
+    return it != m_dirtyRanges.end() && it->first < entry.Next();
+  };
+
+  // pages could be recycled, least recently accessed first
+  vector<pair<uint64_t, size_t>> candidates;
+  for (size_t i = 0; i < m_pages.size(); ++i) {
+    auto &entry = m_pages[i];
+    if (entry.page->UseDiskFile() || entry.page->IsHole() || entry.uncharged ||
+        (entry.offset < stop && start < entry.Next()) || IsDirty(entry)) {
+      continue;
+    }
+    candidates.emplace_back(entry.accessTick, i);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  size_t recycledSize = 0;
+  vector<bool> recycled(m_pages.size(), false);
+  for (auto &candidate : candidates) {
+    if (recycledSize >= size) {
+      break;
+    }
+    auto &entry = m_pages[candidate.second];
+    auto savedSize = entry.page->GetCompressedSavedSize();
+    recycledSize += entry.size - savedSize;
+    m_compressedSavedSize -= savedSize;
+    m_cacheSize -= entry.size;
+    m_size -= entry.size;
+    recycled[candidate.second] = true;
+  }
+  size_t pos = 0;
+  for (size_t i = 0; i < m_pages.size(); ++i) {
+    if (!recycled[i]) {
+      if (pos != i) {
+        m_pages[pos] = std::move(m_pages[i]);
       }
-    }  // end of while
-    // Add unloaded range for bytes not present.
-    if (len_ > 0) {
-      AddUnloadedPages(offset_, len_);
+      ++pos;
     }
-  }  // end of lock_guard
+  }
+  m_pages.erase(m_pages.begin() + static_cast<ptrdiff_t>(pos), m_pages.end());
+  return recycledSize;
+}
+
+// --------------------------------------------------------------------------
+size_t File::ShareFrom(File *source) {
+  if (source == nullptr || source == this) {
+    return 0;
+  }
+  std::lock(m_mutex, source->m_mutex);
+  lock_guard<recursive_mutex> lock(m_mutex, std::adopt_lock);
+  lock_guard<recursive_mutex> sourceLock(source->m_mutex, std::adopt_lock);
+  if (!m_pages.empty()) {
+    return 0;
+  }
+
+  size_t sharedSize = 0;
+  for (auto &entry : source->m_pages) {
+    auto &page = entry.page;
+    if (page->UseDiskFile() || page->IsCompressed()) {
+      continue;
+    }
+    m_pages.emplace_back(entry.offset, entry.size, shared_ptr<Page>(page));
+    if (page->IsHole()) {
+      m_holeSize += entry.size;
+    } else {
+      m_pages.back().uncharged = true;
+      m_unchargedSize += entry.size;
+    }
+    m_size += entry.size;
+    m_cacheSize += entry.size;
+    sharedSize += entry.size;
+  }
+  return sharedSize;
+}
+
+// --------------------------------------------------------------------------
+size_t File::ChargeSharedPages() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (m_unchargedSize == 0) {
+    return 0;
+  }
+  size_t chargedSize = 0;
+  for (auto &entry : m_pages) {
+    // the files shared the page with have released it
+    if (entry.uncharged && entry.page.use_count() <= 1) {
+      entry.uncharged = false;
+      chargedSize += entry.size;
+    }
+  }
+  m_unchargedSize -= chargedSize;
+  return chargedSize;
+}
 
-  return make_tuple(outcomeSize, outcomePages, unloadedRanges);
+// --------------------------------------------------------------------------
+bool File::UnguardedCheckTime(time_t mtimeSince) {
+  if (mtimeSince > 0) {
+    // File is just created, update mtime.
+    if (m_mtime == 0) {
+      SetTime(mtimeSince);
+    } else if (mtimeSince > m_mtime) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------
+size_t File::UnguardedGetSlices(off_t offset, size_t len, FileSliceVec *slices,
+                                ContentRangeDeque *unloadedRanges,
+                                CacheTierStats *stats) {
+  auto AddUnloadedRange = [unloadedRanges, stats](off_t off, size_t sz) {
+    if (unloadedRanges != nullptr) {
+      unloadedRanges->emplace_back(off, sz);
+    }
+    if (stats != nullptr) {
+      stats->missed += sz;
+    }
+  };
+  if (len == 0) {
+    return 0;
+  }
+
+  size_t size = 0;
+  off_t offset_ = offset;
+  off_t stop = offset + static_cast<off_t>(len);
+  auto range = IntesectingRange(offset, stop);
+  for (auto it = range.first; it != range.second && offset_ < stop; ++it) {
+    auto &entry = *it;
+    if (offset_ < entry.offset) {  // hole of bytes not present
+      auto holeLen = static_cast<size_t>(entry.offset - offset_);
+      AddUnloadedRange(offset_, holeLen);
+      slices->emplace_back(offset_, holeLen, nullptr, nullptr);
+      offset_ = entry.offset;
+    }
+    auto sliceLen =
+        static_cast<size_t>(std::min(entry.Next(), stop) - offset_);
+    if (sliceLen == 0) {
+      continue;
+    }
+    entry.accessTick = ++m_accessTicks;
+    auto &page = entry.page;
+    bool hole = page->IsHole();
+    bool compressed = page->IsCompressed();
+    if (compressed) {
+      m_compressedSavedSize -= page->Decompress();
+    }
+    auto data = page->GetData(offset_);
+    auto diskFile = page->GetDiskFile();
+    if (stats != nullptr) {
+      auto &tierSize = compressed ? stats->compressed
+                                  : (data != nullptr || hole ? stats->memory
+                                                             : stats->disk);
+      tierSize += sliceLen;
+    }
+    if (diskFile != nullptr && ++page->m_diskHits == kNumDiskHitsToPromote) {
+      m_hotDiskSize += entry.size;
+    }
+    DebugErrorIf(data == nullptr && diskFile == nullptr && !hole,
+                 "Page has no content " + ToStringLine(offset_, sliceLen) +
+                     PrintFileName(m_baseName));
+    slices->emplace_back(offset_, sliceLen, data, diskFile, hole);
+    if (data != nullptr || diskFile != nullptr || hole) {
+      size += sliceLen;
+    }
+    offset_ += sliceLen;
+  }
+  if (offset_ < stop) {
+    AddUnloadedRange(offset_, static_cast<size_t>(stop - offset_));
+  }
+  return size;
+}
+
+// --------------------------------------------------------------------------
+size_t File::UnguardedDecompressPages(off_t start, off_t stop) {
+  if (m_compressedSavedSize == 0) {
+    return 0;
+  }
+  size_t regainedSize = 0;
+  auto range = IntesectingRange(start, stop);
+  for (auto it = range.first; it != range.second; ++it) {
+    regainedSize += it->page->Decompress();
+  }
+  m_compressedSavedSize -= regainedSize;
+  return regainedSize;
+}
+
+// --------------------------------------------------------------------------
+void File::UnguardedUnsharePages(off_t start, off_t stop) {
+  auto range = IntesectingRange(start, stop);
+  auto pos = static_cast<size_t>(range.first - m_pages.begin());
+  auto end = static_cast<size_t>(range.second - m_pages.begin());
+  for (; pos < end; ++pos) {
+    auto &entry = m_pages[pos];
+    // the copy is charged to this file
+    if (entry.uncharged) {
+      entry.uncharged = false;
+      m_unchargedSize -= entry.size;
+    }
+    if (entry.page.use_count() <= 1) {
+      continue;
+    }
+    if (entry.page->IsHole()) {
+      entry.page = make_shared<Page>(entry.offset, entry.size);
+    } else {
+      Buffer buf(new vector<char>(entry.size));
+      entry.page->Read(&(*buf)[0]);
+      entry.page = make_shared<Page>(
+          entry.offset, entry.size,
+          shared_ptr<iostream>(new IOStream(std::move(buf), entry.size)));
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+size_t File::UnguardedFillHoles(off_t start, off_t stop) {
+  if (m_holeSize == 0) {
+    return 0;
+  }
+  size_t filledSize = 0;
+  auto range = IntesectingRange(start, stop);
+  for (auto it = range.first; it != range.second; ++it) {
+    filledSize += it->page->FillHole();
+  }
+  m_holeSize -= filledSize;
+  return filledSize;
 }
 
 // --------------------------------------------------------------------------
 tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
                                         const char *buffer, time_t mtime) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  UnguardedUnsharePages(offset, offset + static_cast<off_t>(len));
+  UnguardedDecompressPages(offset, offset + static_cast<off_t>(len));
+  UnguardedFillHoles(offset, offset + static_cast<off_t>(len));
+  auto res = UnguardedWrite(offset, len, buffer, mtime);
+  if (std::get<0>(res)) {
+    UnguardedMergePages(offset, offset + static_cast<off_t>(len));
+  }
+  return res;
+}
+
+// --------------------------------------------------------------------------
+tuple<bool, size_t, size_t> File::UnguardedWrite(off_t offset, size_t len,
+                                                 const char *buffer,
+                                                 time_t mtime) {
   // Cache has checked input.
   // bool isValidInput = = offset >= 0 && len > 0 &&  buffer != NULL;
   // assert(isValidInput);
@@ -297,7 +677,6 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
     return std::get<1>(res);
   };
 
-  lock_guard<recursive_mutex> lock(m_mutex);
   // If pages is empty.
   if (m_pages.empty()) {
     return make_tuple(AddPageAndUpdateTime(offset, len, buffer),
@@ -306,16 +685,18 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
 
   bool success = true;
   auto range = IntesectingRange(offset, offset + len);
-  auto it1 = range.first;
-  auto it2 = range.second;
+  // Use positions instead of iterators, as adding a page into the index
+  // invalidates iterators.
+  auto pos1 = static_cast<size_t>(range.first - m_pages.begin());
+  auto pos2 = static_cast<size_t>(range.second - m_pages.begin());
   auto offset_ = offset;
   size_t start_ = 0;
   size_t len_ = len;
   // For pages which are not completely ahead of 'offset'
   // but ahead of 'offset + len'.
-  while (it1 != it2) {
+  while (pos1 != pos2) {
     if (len_ <= 0) break;
-    auto &page = *it1;
+    Page *page = m_pages[pos1].page.get();
     if (offset_ < page->m_offset) {  // Insert new page for bytes not present.
       auto lenNewPage = page->m_offset - offset_;
       auto res = UnguardedAddPage(offset_, lenNewPage, buffer + start_);
@@ -325,6 +706,9 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
       } else {
         addedSizeInCache += std::get<2>(res);
         addedSize += std::get<3>(res);
+        // new page is put ahead of the current one
+        ++pos1;
+        ++pos2;
       }
 
       offset_ = page->m_offset;
@@ -342,9 +726,11 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
           return make_tuple(true, addedSizeInCache, addedSize);
         }
       } else {
+        // the range could start in the middle of the page
+        auto lenRefresh = static_cast<size_t>(page->Next() - offset_);
         if (mtime >= m_mtime) {
-          // refresh entire page
-          auto refresh = page->Refresh(buffer + start_);
+          // refresh the rest of page
+          auto refresh = page->Refresh(offset_, lenRefresh, buffer + start_);
           if (!refresh) {
             success = false;
             return make_tuple(false, addedSizeInCache, addedSize);
@@ -353,9 +739,9 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
           SetTime(mtime);
         }
         offset_ = page->Next();
-        start_ += page->m_size;
-        len_ -= page->m_size;
-        ++it1;
+        start_ += lenRefresh;
+        len_ -= lenRefresh;
+        ++pos1;
       }
     }
   }  // end of while
@@ -386,24 +772,29 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
       off_t offset, size_t len,
       shared_ptr<iostream> &&stream) -> tuple<bool, size_t, size_t> {
     auto res = this->UnguardedAddPage(offset, len, std::move(stream));
-    if (std::get<1>(res) && mtime > m_mtime) {
-      this->SetTime(mtime);
+    if (std::get<1>(res)) {
+      if (mtime > m_mtime) {
+        this->SetTime(mtime);
+      }
+      this->UnguardedMergePages(offset, offset + static_cast<off_t>(len));
     }
     return make_tuple(std::get<1>(res), std::get<2>(res), std::get<3>(res));
   };
 
   lock_guard<recursive_mutex> lock(m_mutex);
+  UnguardedUnsharePages(offset, offset + static_cast<off_t>(len));
+  UnguardedDecompressPages(offset, offset + static_cast<off_t>(len));
+  UnguardedFillHoles(offset, offset + static_cast<off_t>(len));
   if (m_pages.empty()) {
     return AddPageAndUpdateTime(offset, len, std::move(stream));
   } else {
     auto it = LowerBoundPage(offset);
-    auto &page = *it;
     if (it == m_pages.end()) {
       return AddPageAndUpdateTime(offset, len, std::move(stream));
-    } else if (page->Offset() == offset && page->Size() == len) {
+    } else if (it->offset == offset && it->size == len) {
       if (mtime >= m_mtime) {
         // replace old stream
-        page->SetStream(std::move(stream));
+        it->page->SetStream(std::move(stream));
         SetTime(mtime);
       }
       return make_tuple(true, 0, 0);
@@ -417,6 +808,105 @@ tuple<bool, size_t, size_t> File::Write(off_t offset, size_t len,
   }
 }
 
+// --------------------------------------------------------------------------
+void File::UnguardedMergePages(off_t start, off_t stop) {
+  auto maxExtentSize = static_cast<size_t>(GetMaxPageExtentSize());
+  auto maxNumPages = m_size / maxExtentSize + kNumPagesNotToMerge;
+  if (m_pages.size() <= maxNumPages) {
+    return;
+  }
+
+  auto CanMerge = [maxExtentSize](const PageEntry &a, const PageEntry &b) {
+    if (a.Next() != b.offset || a.size + b.size > maxExtentSize) {
+      return false;
+    }
+    if (a.page->UseDiskFile() || b.page->UseDiskFile()) {
+      return a.page->m_diskFile == b.page->m_diskFile;
+    }
+    if (a.page->IsHole() || b.page->IsHole()) {
+      return a.page->IsHole() && b.page->IsHole();
+    }
+    if (a.page->IsCompressed() || b.page->IsCompressed() || a.uncharged ||
+        b.uncharged) {
+      return false;
+    }
+    return std::min(a.size, b.size) * 2 >= std::max(a.size, b.size);
+  };
+
+  // Include the pages just ahead of and behind of the range.
+  auto range = IntesectingRange(start, stop);
+  auto pos = static_cast<size_t>(range.first - m_pages.begin());
+  auto end = static_cast<size_t>(range.second - m_pages.begin());
+  if (pos > 0) {
+    --pos;
+  }
+  if (end < m_pages.size()) {
+    ++end;
+  }
+  while (pos + 1 < end) {
+    auto &a = m_pages[pos];
+    auto &b = m_pages[pos + 1];
+    if (!CanMerge(a, b)) {
+      ++pos;
+      continue;
+    }
+
+    auto size = a.size + b.size;
+    shared_ptr<Page> page;
+    if (a.page->UseDiskFile()) {
+      page = make_shared<Page>(a.offset, size, a.page->m_diskFile);
+    } else if (a.page->IsHole()) {
+      page = make_shared<Page>(a.offset, size);
+    } else {
+      Buffer buf(new vector<char>(size));
+      a.page->Read(&(*buf)[0]);
+      b.page->Read(&(*buf)[a.size]);
+      page = make_shared<Page>(
+          a.offset, size,
+          shared_ptr<iostream>(new IOStream(std::move(buf), size)));
+    }
+    a.page = std::move(page);
+    a.size = size;
+    a.accessTick = std::max(a.accessTick, b.accessTick);
+    m_pages.erase(m_pages.begin() + static_cast<ptrdiff_t>(pos + 1));
+    --end;
+    // the merged page may be merged with the page ahead of it
+    if (pos > 0) {
+      --pos;
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+size_t File::AddDirtyRange(off_t offset, size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  lock_guard<recursive_mutex> lock(m_mutex);
+  auto start = offset;
+  auto stop = offset + static_cast<off_t>(len);
+  // the first range not completely ahead of 'offset'
+  auto first = std::lower_bound(
+      m_dirtyRanges.begin(), m_dirtyRanges.end(), start,
+      [](const pair<off_t, size_t> &range, off_t off) {
+        return range.first + static_cast<off_t>(range.second) < off;
+      });
+  // merge the ranges overlapping or adjacent with [start, stop)
+  size_t mergedSize = 0;
+  auto last = first;
+  for (; last != m_dirtyRanges.end() && last->first <= stop; ++last) {
+    start = std::min(start, last->first);
+    stop = std::max(stop, last->first + static_cast<off_t>(last->second));
+    mergedSize += last->second;
+  }
+  auto pos = m_dirtyRanges.erase(first, last);
+  m_dirtyRanges.emplace(pos, start, static_cast<size_t>(stop - start));
+  auto addedSize = static_cast<size_t>(stop - start) - mergedSize;
+  m_dirtySize += addedSize;
+  ++m_dirtyGeneration;
+  return addedSize;
+}
+
 // --------------------------------------------------------------------------
 void File::ResizeToSmallerSize(size_t smallerSize) {
   auto curSize = GetSize();
@@ -435,32 +925,62 @@ void File::ResizeToSmallerSize(size_t smallerSize) {
     lock_guard<recursive_mutex> lock(m_mutex);
 
     while (!m_pages.empty() && smallerSize < m_size) {
-      auto lastPage = --m_pages.end();
-      auto lastPageSize = (*lastPage)->Size();
+      auto &lastPage = m_pages.back();
+      auto lastPageSize = lastPage.size;
       if (smallerSize + lastPageSize <= m_size) {
-        if (!(*lastPage)->UseDiskFile()) {
+        if (!lastPage.page->UseDiskFile()) {
           m_cacheSize -= lastPageSize;
+          m_compressedSavedSize -= lastPage.page->GetCompressedSavedSize();
+          m_holeSize -= lastPage.page->GetHoleSize();
+          if (lastPage.uncharged) {
+            m_unchargedSize -= lastPageSize;
+          }
+        } else {
+          lastPage.page->PunchHole();
         }
         m_size -= lastPageSize;
-        m_pages.erase(lastPage);
+        m_pages.pop_back();
       } else {
         auto newSize = lastPageSize - (m_size - smallerSize);
+        UnguardedUnsharePages(lastPage.offset, lastPage.Next());
+        m_compressedSavedSize -= lastPage.page->Decompress();
         // Do a lazy remove for last page.
-        (*lastPage)->ResizeToSmallerSize(newSize);
-        if (!(*lastPage)->UseDiskFile()) {
+        lastPage.page->ResizeToSmallerSize(newSize);
+        lastPage.size = newSize;
+        if (!lastPage.page->UseDiskFile()) {
           m_cacheSize -= lastPageSize - newSize;
         }
+        if (lastPage.page->IsHole()) {
+          m_holeSize -= lastPageSize - newSize;
+        }
         m_size -= lastPageSize - newSize;
         break;
       }
     }
+
+    // drop the dirty ranges beyond the new size
+    ++m_dirtyGeneration;
+    auto stop = static_cast<off_t>(smallerSize);
+    while (!m_dirtyRanges.empty()) {
+      auto &range = m_dirtyRanges.back();
+      if (range.first >= stop) {
+        m_dirtySize -= range.second;
+        m_dirtyRanges.pop_back();
+        continue;
+      }
+      auto newSize =
+          std::min(range.second, static_cast<size_t>(stop - range.first));
+      m_dirtySize -= range.second - newSize;
+      range.second = newSize;
+      break;
+    }
   }
 }
 
 // --------------------------------------------------------------------------
 void File::RemoveDiskFileIfExists(bool logOn) const {
   lock_guard<recursive_mutex> lock(m_mutex);
-  if (UseDiskFile()) {
+  if (UseDiskFile() || m_diskFile) {
     auto diskFile = AskDiskFilePath();
     if (FileExists(diskFile, logOn)) {
       if (logOn) {
@@ -472,16 +992,81 @@ void File::RemoveDiskFileIfExists(bool logOn) const {
   }
 }
 
+// --------------------------------------------------------------------------
+const shared_ptr<DiskFile> &File::UnguardedGetDiskFile() {
+  if (!m_diskFile) {
+    m_diskFile = make_shared<DiskFile>(
+        AskDiskFilePath(), QS::Configure::Options::Instance().IsDiskDirectIO());
+  }
+  return m_diskFile;
+}
+
+// --------------------------------------------------------------------------
+void File::SetETag(const string &eTag, uint64_t objectSize) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  m_eTag = eTag;
+  m_objectSize.store(objectSize);
+  if (!eTag.empty()) {
+    // content is the same as the object
+    m_dirtyRanges.clear();
+    m_dirtySize.store(0);
+  }
+}
+
+// --------------------------------------------------------------------------
+bool File::SetUploadedETag(const string &eTag, uint64_t objectSize,
+                           uint64_t dirtyGeneration) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (eTag.empty() || m_dirtyGeneration.load() != dirtyGeneration) {
+    return false;  // modified during uploading, the content is newer
+  }
+  SetETag(eTag, objectSize);
+  return true;
+}
+
+// --------------------------------------------------------------------------
+size_t File::AdoptDiskFileRanges(const ContentRangeDeque &ranges) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  SetUseDiskFile(true);
+  auto &diskFile = UnguardedGetDiskFile();
+  size_t addedSize = 0;
+  for (auto &range : ranges) {
+    if (range.second == 0) {
+      continue;
+    }
+    auto res = UnguardedInsertPage(
+        make_shared<Page>(range.first, range.second, diskFile));
+    if (res.second) {
+      addedSize += range.second;
+    } else {
+      DebugWarning("Fail to adopt disk file range " +
+                   ToStringLine(range.first, range.second) +
+                   PrintFileName(m_baseName));
+    }
+  }
+  m_size += addedSize;
+  return addedSize;
+}
+
 // --------------------------------------------------------------------------
 void File::Clear() {
   {
     lock_guard<recursive_mutex> lock(m_mutex);
+    RemoveDiskFileIfExists(true);
     m_pages.clear();
+    m_diskFile.reset();
+    m_eTag.clear();
+    m_dirtyRanges.clear();
   }
+  m_objectSize.store(0);
   m_mtime.store(0);
   m_size.store(0);
   m_cacheSize.store(0);
-  RemoveDiskFileIfExists(true);
+  m_compressedSavedSize.store(0);
+  m_holeSize.store(0);
+  m_unchargedSize.store(0);
+  m_dirtySize.store(0);
+  m_hotDiskSize.store(0);
   m_useDiskFile.store(false);
 }
 
@@ -493,8 +1078,9 @@ PageSetConstIterator File::LowerBoundPage(off_t offset) const {
 
 // --------------------------------------------------------------------------
 PageSetConstIterator File::LowerBoundPageNoLock(off_t offset) const {
-  auto tmpPage = make_shared<Page>(offset, 0, make_shared<IOStream>(0));
-  return m_pages.lower_bound(tmpPage);
+  return std::lower_bound(
+      m_pages.begin(), m_pages.end(), offset,
+      [](const PageEntry &entry, off_t off) { return entry.offset < off; });
 }
 
 // --------------------------------------------------------------------------
@@ -505,8 +1091,9 @@ PageSetConstIterator File::UpperBoundPage(off_t offset) const {
 
 // --------------------------------------------------------------------------
 PageSetConstIterator File::UpperBoundPageNoLock(off_t offset) const {
-  auto tmpPage = make_shared<Page>(offset, 0, make_shared<IOStream>(0));
-  return m_pages.upper_bound(tmpPage);
+  return std::upper_bound(
+      m_pages.begin(), m_pages.end(), offset,
+      [](off_t off, const PageEntry &entry) { return off < entry.offset; });
 }
 
 // --------------------------------------------------------------------------
@@ -515,13 +1102,14 @@ pair<PageSetConstIterator, PageSetConstIterator> File::IntesectingRange(
   assert(off1 <= off2);
   lock_guard<recursive_mutex> lock(m_mutex);
   auto it1 = LowerBoundPageNoLock(off1);
-  auto it2 = LowerBoundPageNoLock(off2);
+  auto it2 = std::lower_bound(
+      it1, m_pages.cend(), off2,
+      [](const PageEntry &entry, off_t off) { return entry.offset < off; });
   // Move backward it1 to pointing to the page which maybe intersect with
   // 'offset'.
-  reverse_iterator<PageSetConstIterator> reverseIt(it1);
-  it1 = (reverseIt == m_pages.crend() || (*reverseIt)->Next() <= off1)
-            ? it1
-            : (++reverseIt).base();
+  if (it1 != m_pages.cbegin() && std::prev(it1)->Next() > off1) {
+    --it1;
+  }
 
   return {it1, it2};
 }
@@ -530,27 +1118,31 @@ pair<PageSetConstIterator, PageSetConstIterator> File::IntesectingRange(
 const std::shared_ptr<Page> &File::Front() {
   lock_guard<recursive_mutex> lock(m_mutex);
   assert(!m_pages.empty());
-  return *(m_pages.begin());
+  return m_pages.front().page;
 }
 
 // --------------------------------------------------------------------------
 const std::shared_ptr<Page> &File::Back() {
   lock_guard<recursive_mutex> lock(m_mutex);
   assert(!m_pages.empty());
-  return *(m_pages.rbegin());
+  return m_pages.back().page;
 }
 
 // --------------------------------------------------------------------------
 tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddPage(
     off_t offset, size_t len, const char *buffer) {
+  if (IsHole(buffer, len)) {
+    return UnguardedAddHole(offset, len);
+  }
   pair<PageSetConstIterator, bool> res;
   size_t addedSize = 0;
   size_t addedSizeInCache = 0;
   if (UseDiskFile()) {
-    res = m_pages.emplace(new Page(offset, len, buffer, AskDiskFilePath()));
+    res = UnguardedInsertPage(
+        make_shared<Page>(offset, len, buffer, UnguardedGetDiskFile()));
     // do not count size of data stored in disk file
   } else {
-    res = m_pages.emplace(new Page(offset, len, buffer));
+    res = UnguardedInsertPage(make_shared<Page>(offset, len, buffer));
     if (res.second) {
       addedSizeInCache = len;
       m_cacheSize += len;  // count size of data stored in cache
@@ -570,13 +1162,17 @@ tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddPage(
 // --------------------------------------------------------------------------
 tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddPage(
     off_t offset, size_t len, const shared_ptr<iostream> &stream) {
+  if (IsHole(GetStreamData(stream, len), len)) {
+    return UnguardedAddHole(offset, len);
+  }
   pair<PageSetConstIterator, bool> res;
   size_t addedSize = 0;
   size_t addedSizeInCache = 0;
   if (UseDiskFile()) {
-    res = m_pages.emplace(new Page(offset, len, stream, AskDiskFilePath()));
+    res = UnguardedInsertPage(
+        make_shared<Page>(offset, len, stream, UnguardedGetDiskFile()));
   } else {
-    res = m_pages.emplace(new Page(offset, len, stream));
+    res = UnguardedInsertPage(make_shared<Page>(offset, len, stream));
     if (res.second) {
       addedSizeInCache = len;
       m_cacheSize += len;
@@ -596,13 +1192,18 @@ tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddPage(
 // --------------------------------------------------------------------------
 tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddPage(
     off_t offset, size_t len, shared_ptr<iostream> &&stream) {
+  if (IsHole(GetStreamData(stream, len), len)) {
+    return UnguardedAddHole(offset, len);
+  }
   pair<PageSetConstIterator, bool> res;
   size_t addedSize = 0;
   size_t addedSizeInCache = 0;
   if (UseDiskFile()) {
-    res = m_pages.emplace(new Page(offset, len, stream, AskDiskFilePath()));
+    res = UnguardedInsertPage(
+        make_shared<Page>(offset, len, stream, UnguardedGetDiskFile()));
   } else {
-    res = m_pages.emplace(new Page(offset, len, std::move(stream)));
+    res = UnguardedInsertPage(
+        make_shared<Page>(offset, len, std::move(stream)));
     if (res.second) {
       addedSizeInCache = len;
       m_cacheSize += len;
@@ -619,5 +1220,34 @@ tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddPage(
   return make_tuple(res.first, res.second, addedSizeInCache, addedSize);
 }
 
+// --------------------------------------------------------------------------
+tuple<PageSetConstIterator, bool, size_t, size_t> File::UnguardedAddHole(
+    off_t offset, size_t len) {
+  auto res = UnguardedInsertPage(make_shared<Page>(offset, len));
+  if (!res.second) {
+    DebugError("Fail to new a hole page " + ToStringLine(offset, len) +
+               PrintFileName(m_baseName));
+    return make_tuple(res.first, false, 0, 0);
+  }
+  // hole is counted in cache as an in-memory page which saves all its size
+  m_cacheSize += len;
+  m_holeSize += len;
+  m_size += len;
+  return make_tuple(res.first, true, 0, len);
+}
+
+// --------------------------------------------------------------------------
+pair<PageSetConstIterator, bool> File::UnguardedInsertPage(
+    shared_ptr<Page> &&page) {
+  auto it = LowerBoundPageNoLock(page->Offset());
+  if (it != m_pages.end() && it->offset == page->Offset()) {
+    return {it, false};
+  }
+  auto offset = page->Offset();
+  auto size = page->Size();
+  return {m_pages.emplace(it, offset, size, std::move(page), ++m_accessTicks),
+          true};
+}
+
 }  // namespace Data
 }  // namespace QS
@@ -90,7 +90,8 @@ FileMetaData::FileMetaData(const string &filePath, uint64_t fileSize,
                            mode_t fileMode, FileType fileType,
                            const string &mimeType, const string &eTag,
                            bool encrypted, dev_t dev)
-    : m_filePath(filePath),
+    : m_filePath(fileType == FileType::Directory ? AppendPathDelim(filePath)
+                                                 : filePath),
       m_fileSize(fileSize),
       m_atime(atime),
       m_mtime(mtime),
@@ -107,9 +108,6 @@ FileMetaData::FileMetaData(const string &filePath, uint64_t fileSize,
       m_needUpload(false),
       m_fileOpen(false) {
   m_numLink = fileType == FileType::Directory ? 2 : 1;
-  if (fileType == FileType::Directory) {
-    m_filePath = AppendPathDelim(m_filePath);
-  }
 }
 
 // --------------------------------------------------------------------------
@@ -177,12 +175,12 @@ mode_t FileMetaData::GetFileTypeAndMode() const {
 
 // --------------------------------------------------------------------------
 string FileMetaData::MyDirName() const {
-  return QS::Utils::GetDirName(m_filePath);
+  return QS::Utils::GetDirName(m_filePath.ToString());
 }
 
 // --------------------------------------------------------------------------
 string FileMetaData::MyBaseName() const {
-  return QS::Utils::GetBaseName(m_filePath);
+  return QS::Utils::GetBaseName(m_filePath.ToString());
 }
 
 // --------------------------------------------------------------------------
@@ -193,7 +191,7 @@ bool FileMetaData::FileAccess(uid_t uid, gid_t gid, int amode) const {
   //          ", file=" + to_string(m_uid) + ":" + to_string(m_gid) +
   //          ":" + ModeToString(m_fileMode) + "]");
 
-  if (m_filePath.empty()) {
+  if (m_filePath.IsEmpty()) {
     DebugWarning("object file path is empty");
     return false;
   }
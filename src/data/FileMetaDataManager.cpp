@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "base/LogMacros.h"
+#include "base/SharedMutex.h"
 #include "base/StringUtils.h"
 #include "configure/Options.h"
 #include "data/Size.h"
@@ -32,8 +33,9 @@ namespace QS {
 namespace Data {
 
 using QS::StringUtils::FormatPath;
+using QS::Threading::SharedLock;
+using QS::Threading::SharedMutex;
 using std::lock_guard;
-using std::recursive_mutex;
 using std::string;
 using std::to_string;
 using std::shared_ptr;
@@ -56,17 +58,18 @@ FileMetaDataManager &FileMetaDataManager::Instance() {
 // --------------------------------------------------------------------------
 MetaDataListConstIterator FileMetaDataManager::Get(
     const std::string &filePath) const {
-  lock_guard<recursive_mutex> lock(m_mutex);
   return const_cast<FileMetaDataManager *>(this)->Get(filePath);
 }
 
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::Get(const std::string &filePath) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   auto pos = m_metaDatas.end();
-  auto it = m_map.find(filePath);
+  auto it = m_map.find(PathName::Find(filePath));
   if (it != m_map.end()) {
-    pos = UnguardedMakeMetaDataMostRecentlyUsed(it->second);
+    // mark it instead of moving it to front, which needs the exclusive lock
+    it->second.referenced.store(true, std::memory_order_relaxed);
+    pos = it->second.pos;
   } else {
     DebugInfo("File not exist " + FormatPath(filePath));
   }
@@ -75,44 +78,49 @@ MetaDataListIterator FileMetaDataManager::Get(const std::string &filePath) {
 
 // --------------------------------------------------------------------------
 MetaDataListConstIterator FileMetaDataManager::Begin() const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   return m_metaDatas.cbegin();
 }
 
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::Begin() {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   return m_metaDatas.begin();
 }
 
 // --------------------------------------------------------------------------
 MetaDataListConstIterator FileMetaDataManager::End() const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   return m_metaDatas.cend();
 }
 
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::End() {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   return m_metaDatas.end();
 }
 
 // --------------------------------------------------------------------------
 bool FileMetaDataManager::Has(const std::string &filePath) const {
-  lock_guard<recursive_mutex> lock(m_mutex);
-  return this->Get(filePath) != m_metaDatas.cend();
+  SharedLock lock(m_mutex);
+  auto it = m_map.find(PathName::Find(filePath));
+  if (it != m_map.end()) {
+    it->second.referenced.store(true, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
 }
 
 // --------------------------------------------------------------------------
 bool FileMetaDataManager::HasFreeSpace(size_t needCount) const {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  SharedLock lock(m_mutex);
   return m_metaDatas.size() + needCount <= GetMaxCount();
 }
 
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::AddNoLock(
     shared_ptr<FileMetaData> &&fileMetaData) {
-  const auto &filePath = fileMetaData->GetFilePath();
+  const auto &filePath = fileMetaData->GetPathName();
   auto it = m_map.find(filePath);
   if (it == m_map.end()) {  // not exist in manager
     if (!HasFreeSpaceNoLock(1)) {
@@ -124,11 +132,11 @@ MetaDataListIterator FileMetaDataManager::AddNoLock(
       m_map.emplace(filePath, m_metaDatas.begin());
       return m_metaDatas.begin();
     } else {
-      DebugWarning("Fail to add file " + FormatPath(filePath));
+      DebugWarning("Fail to add file " + FormatPath(filePath.ToString()));
       return m_metaDatas.end();
     }
   } else {  // exist already, update it
-    auto pos = UnguardedMakeMetaDataMostRecentlyUsed(it->second);
+    auto pos = UnguardedMakeMetaDataMostRecentlyUsed(it->second.pos);
     pos->second = std::move(fileMetaData);
     return pos;
   }
@@ -137,14 +145,14 @@ MetaDataListIterator FileMetaDataManager::AddNoLock(
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::Add(
     shared_ptr<FileMetaData> &&fileMetaData) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   return AddNoLock(std::move(fileMetaData));
 }
 
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::Add(
     std::vector<std::shared_ptr<FileMetaData>> &&fileMetaDatas) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   auto pos = m_metaDatas.end();
   for (auto &meta : fileMetaDatas) {
     pos = AddNoLock(std::move(meta));
@@ -155,11 +163,11 @@ MetaDataListIterator FileMetaDataManager::Add(
 
 // --------------------------------------------------------------------------
 MetaDataListIterator FileMetaDataManager::Erase(const std::string &filePath) {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   auto next = m_metaDatas.end();
-  auto it = m_map.find(filePath);
+  auto it = m_map.find(PathName::Find(filePath));
   if (it != m_map.end()) {
-    next = m_metaDatas.erase(it->second);
+    next = m_metaDatas.erase(it->second.pos);
     m_map.erase(it);
   } else {
     DebugWarning("File not exist, no remove " + FormatPath(filePath));
@@ -169,7 +177,7 @@ MetaDataListIterator FileMetaDataManager::Erase(const std::string &filePath) {
 
 // --------------------------------------------------------------------------
 void FileMetaDataManager::Clear() {
-  lock_guard<recursive_mutex> lock(m_mutex);
+  lock_guard<SharedMutex> lock(m_mutex);
   m_map.clear();
   m_metaDatas.clear();
 }
@@ -183,19 +191,20 @@ void FileMetaDataManager::Rename(const string &oldFilePath,
     return;
   }
 
-  lock_guard<recursive_mutex> lock(m_mutex);
-  if (m_map.find(newFilePath) != m_map.end()) {
+  PathName newPathName(newFilePath);
+  lock_guard<SharedMutex> lock(m_mutex);
+  if (m_map.find(newPathName) != m_map.end()) {
     DebugWarning("File exist, no rename " +
                  FormatPath(oldFilePath, newFilePath));
     return;
   }
 
-  auto it = m_map.find(oldFilePath);
+  auto it = m_map.find(PathName::Find(oldFilePath));
   if (it != m_map.end()) {
-    it->second->first = newFilePath;
-    it->second->second->m_filePath = newFilePath;
-    auto pos = UnguardedMakeMetaDataMostRecentlyUsed(it->second);
-    m_map.emplace(newFilePath, pos);
+    it->second.pos->first = newPathName;
+    it->second.pos->second->m_filePath = newPathName;
+    auto pos = UnguardedMakeMetaDataMostRecentlyUsed(it->second.pos);
+    m_map.emplace(newPathName, pos);
     m_map.erase(it);
   } else {
     DebugWarning("File not exist, no rename " + FormatPath(oldFilePath));
@@ -216,7 +225,8 @@ bool FileMetaDataManager::HasFreeSpaceNoLock(size_t needCount) const {
 }
 
 // --------------------------------------------------------------------------
-bool FileMetaDataManager::FreeNoLock(size_t needCount, string fileUnfreeable) {
+bool FileMetaDataManager::FreeNoLock(size_t needCount,
+                                     const PathName &fileUnfreeable) {
   if (needCount > GetMaxCount()) {
     DebugError("Try to free file meta data manager of " + to_string(needCount) +
                " items which surpass the maximum file meta data count (" +
@@ -234,6 +244,12 @@ bool FileMetaDataManager::FreeNoLock(size_t needCount, string fileUnfreeable) {
   while (!HasFreeSpaceNoLock(needCount) && !m_metaDatas.empty()) {
     // Discards the least recently used meta first, which is put at back
     auto fileId = m_metaDatas.back().first;
+    // Give the meta referenced since the last check a second chance
+    auto it = m_map.find(fileId);
+    if (it != m_map.end() && it->second.referenced.exchange(false)) {
+      UnguardedMakeMetaDataMostRecentlyUsed(it->second.pos);
+      continue;
+    }
     if (m_metaDatas.back().second) {
       if (m_metaDatas.back().second->IsFileOpen()) {
         return false;
@@ -0,0 +1,120 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/FrequencySketch.h"
+
+#include <stddef.h>  // for size_t
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+namespace QS {
+
+namespace Data {
+
+using std::string;
+
+namespace {
+
+constexpr unsigned kNumRows = 4;
+constexpr unsigned kMaxCount = 15;
+constexpr size_t kCountersPerWord = 16;
+constexpr size_t kMinNumCounters = 64;
+constexpr size_t kSampleFactor = 10;
+constexpr uint64_t kSeeds[kNumRows] = {
+    0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+    0xcbf29ce484222325ULL};
+
+// --------------------------------------------------------------------------
+uint64_t HashOf(const string &key) {
+  return static_cast<uint64_t>(std::hash<string>()(key));
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+FrequencySketch::FrequencySketch(size_t numCounters) {
+  m_numCounters = kMinNumCounters;
+  while (m_numCounters < numCounters) {
+    m_numCounters <<= 1;
+  }
+  m_table.assign(m_numCounters / kCountersPerWord, 0);
+  m_sampleSize = kSampleFactor * m_numCounters;
+}
+
+// --------------------------------------------------------------------------
+void FrequencySketch::Increment(const string &key) {
+  if (++m_additions >= m_sampleSize) {
+    Age();
+  }
+  auto hash = HashOf(key);
+  size_t indexes[kNumRows];
+  unsigned minCount = kMaxCount;
+  for (unsigned row = 0; row < kNumRows; ++row) {
+    indexes[row] = IndexOf(hash, row);
+    minCount = std::min(minCount, GetCounter(indexes[row]));
+  }
+  if (minCount == kMaxCount) {
+    return;
+  }
+
+  // Conservative update: only the smallest counters are increased, which
+  // reduces the over-estimation caused by collisions.
+  for (unsigned row = 0; row < kNumRows; ++row) {
+    if (GetCounter(indexes[row]) == minCount) {
+      auto shift = (indexes[row] % kCountersPerWord) * 4;
+      m_table[indexes[row] / kCountersPerWord] += uint64_t(1) << shift;
+    }
+  }
+}
+
+// --------------------------------------------------------------------------
+unsigned FrequencySketch::Estimate(const string &key) const {
+  auto hash = HashOf(key);
+  unsigned minCount = kMaxCount;
+  for (unsigned row = 0; row < kNumRows; ++row) {
+    minCount = std::min(minCount, GetCounter(IndexOf(hash, row)));
+  }
+  return minCount;
+}
+
+// --------------------------------------------------------------------------
+size_t FrequencySketch::IndexOf(uint64_t hash, unsigned row) const {
+  uint64_t h = (hash ^ kSeeds[row]) * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 32;
+  return static_cast<size_t>(h & (m_numCounters - 1));
+}
+
+// --------------------------------------------------------------------------
+unsigned FrequencySketch::GetCounter(size_t index) const {
+  auto shift = (index % kCountersPerWord) * 4;
+  return static_cast<unsigned>(
+      (m_table[index / kCountersPerWord] >> shift) & 0xf);
+}
+
+// --------------------------------------------------------------------------
+void FrequencySketch::Age() {
+  for (auto &word : m_table) {
+    word = (word >> 1) & 0x7777777777777777ULL;
+  }
+  m_additions /= 2;
+}
+
+}  // namespace Data
+}  // namespace QS
@@ -0,0 +1,222 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/MemoryPressure.h"
+
+#include <stdint.h>
+#include <stdlib.h>  // for strtod strtoull
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "base/LogMacros.h"
+#include "base/StringUtils.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::StringUtils::FormatPath;
+using std::ifstream;
+using std::istringstream;
+using std::string;
+using std::unique_ptr;
+
+namespace {
+
+// Capacity shrinks when headroom is less than limit / kLowHeadroomDivisor
+constexpr uint64_t kLowHeadroomDivisor = 10;
+// Capacity grows when headroom is more than limit / kHighHeadroomDivisor
+constexpr uint64_t kHighHeadroomDivisor = 4;
+// Capacity never shrinks below max capacity / kMinCapacityDivisor
+constexpr uint64_t kMinCapacityDivisor = 16;
+// Capacity grows by max capacity / kGrowStepDivisor at most each time
+constexpr uint64_t kGrowStepDivisor = 8;
+// Capacity shrinks by capacity / kShrinkStepDivisor at least each time
+constexpr uint64_t kShrinkStepDivisor = 4;
+// PSI memory "some avg10" in percent
+constexpr double kHighPressure = 10.0;
+constexpr double kLowPressure = 1.0;
+
+// --------------------------------------------------------------------------
+// Read the first line of a file
+bool ReadFirstLine(const string &path, string *line) {
+  ifstream is(path);
+  return is && std::getline(is, *line);
+}
+
+// --------------------------------------------------------------------------
+// Read a memory size or "max" from cgroup file, "max" is read as 0
+bool ReadMemorySize(const string &path, uint64_t *size) {
+  string line;
+  if (!ReadFirstLine(path, &line)) {
+    return false;
+  }
+  *size = line == "max" ? 0 : strtoull(line.c_str(), nullptr, 10);
+  return true;
+}
+
+// --------------------------------------------------------------------------
+// Read memory.high, or memory.max if memory.high is "max", 0 if no limit
+bool ReadMemoryLimit(const string &cgroupDir, uint64_t *limit) {
+  *limit = 0;
+  if (ReadMemorySize(cgroupDir + "memory.high", limit) && *limit > 0) {
+    return true;
+  }
+  return ReadMemorySize(cgroupDir + "memory.max", limit);
+}
+
+// --------------------------------------------------------------------------
+// Read "some avg10" from PSI file
+bool ReadPressure(const string &path, double *pressure) {
+  ifstream is(path);
+  string line;
+  while (is && std::getline(is, line)) {
+    if (line.compare(0, 5, "some ") != 0) {
+      continue;
+    }
+    auto pos = line.find("avg10=");
+    if (pos == string::npos) {
+      return false;
+    }
+    *pressure = strtod(line.c_str() + pos + 6, nullptr);
+    return true;
+  }
+  return false;
+}
+
+// --------------------------------------------------------------------------
+// Return the mount point of cgroup v2, or empty string if not mounted
+string FindCgroup2MountPoint() {
+  ifstream is("/proc/self/mountinfo");
+  string line;
+  while (is && std::getline(is, line)) {
+    auto sep = line.find(" - ");
+    if (sep == string::npos || line.compare(sep + 3, 8, "cgroup2 ") != 0) {
+      continue;
+    }
+    // fields: id, parent id, major:minor, root, mount point, ...
+    istringstream fields(line.substr(0, sep));
+    string field;
+    for (int i = 0; i < 5; ++i) {
+      fields >> field;
+    }
+    return field;
+  }
+  return string();
+}
+
+// --------------------------------------------------------------------------
+// Return cgroup v2 path of this process, such as "/user.slice"
+string FindCgroup2Path() {
+  ifstream is("/proc/self/cgroup");
+  string line;
+  while (is && std::getline(is, line)) {
+    if (line.compare(0, 3, "0::") == 0) {
+      return line.substr(3);
+    }
+  }
+  return string();
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+MemoryPressure::MemoryPressure(const string &cgroupDir, const string &psiFile)
+    : m_cgroupDir(cgroupDir), m_psiFile(psiFile) {
+  if (!m_cgroupDir.empty() && m_cgroupDir.back() != '/') {
+    m_cgroupDir += "/";
+  }
+}
+
+// --------------------------------------------------------------------------
+unique_ptr<MemoryPressure> MemoryPressure::Detect() {
+  auto mountPoint = FindCgroup2MountPoint();
+  auto cgroupPath = FindCgroup2Path();
+  if (mountPoint.empty() || cgroupPath.empty()) {
+    DebugInfo("cgroup v2 is not available");
+    return nullptr;
+  }
+
+  string cgroupDir = mountPoint + cgroupPath;
+  uint64_t current = 0;
+  if (!ReadMemorySize(cgroupDir + "/memory.current", &current)) {
+    DebugInfo("cgroup v2 memory controller is not available " +
+              FormatPath(cgroupDir));
+    return nullptr;
+  }
+
+  string psiFile = cgroupDir + "/memory.pressure";
+  double pressure = 0;
+  if (!ReadPressure(psiFile, &pressure)) {
+    // system-wide pressure says little about an unlimited cgroup
+    uint64_t limit = 0;
+    ReadMemoryLimit(cgroupDir + "/", &limit);
+    psiFile = limit > 0 ? "/proc/pressure/memory" : string();
+  }
+  return unique_ptr<MemoryPressure>(new MemoryPressure(cgroupDir, psiFile));
+}
+
+// --------------------------------------------------------------------------
+bool MemoryPressure::ReadStatus(MemoryStatus *status) const {
+  if (!ReadMemorySize(m_cgroupDir + "memory.current", &status->current)) {
+    DebugWarning("Fail to read memory.current " + FormatPath(m_cgroupDir));
+    return false;
+  }
+  ReadMemoryLimit(m_cgroupDir, &status->limit);
+  status->pressure = 0;
+  if (!m_psiFile.empty()) {
+    ReadPressure(m_psiFile, &status->pressure);  // PSI could be disabled
+  }
+  return true;
+}
+
+// --------------------------------------------------------------------------
+uint64_t MemoryPressure::AdaptCapacity(uint64_t maxCapacity, uint64_t capacity,
+                                       const MemoryStatus &status) {
+  auto minCapacity = maxCapacity / kMinCapacityDivisor;
+  bool hasLimit = status.limit > 0;
+  uint64_t headroom =
+      status.limit > status.current ? status.limit - status.current : 0;
+
+  bool nearLimit = hasLimit && headroom < status.limit / kLowHeadroomDivisor;
+  if (nearLimit || status.pressure >= kHighPressure) {
+    // give back the missing headroom, and a step more under pressure
+    uint64_t shrink = nearLimit
+                          ? status.limit / kLowHeadroomDivisor - headroom
+                          : 0;
+    shrink = std::max(shrink, capacity / kShrinkStepDivisor);
+    return capacity > minCapacity + shrink ? capacity - shrink : minCapacity;
+  }
+
+  bool farFromLimit =
+      !hasLimit || headroom > status.limit / kHighHeadroomDivisor;
+  if (farFromLimit && status.pressure < kLowPressure) {
+    uint64_t grow = maxCapacity / kGrowStepDivisor;
+    if (hasLimit) {
+      grow = std::min(grow, headroom - status.limit / kHighHeadroomDivisor);
+    }
+    return std::min(maxCapacity, capacity + grow);
+  }
+  return std::max(std::min(capacity, maxCapacity), minCapacity);
+}
+
+}  // namespace Data
+}  // namespace QS
@@ -0,0 +1,120 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/NegativeLookupCache.h"
+
+#include <time.h>
+
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+
+namespace QS {
+
+namespace Data {
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+// --------------------------------------------------------------------------
+bool NegativeLookupCache::Has(const string &path) {
+  lock_guard<mutex> lock(m_mutex);
+  auto it = m_map.find(path);
+  if (it == m_map.end()) {
+    ++m_misses;
+    return false;
+  }
+  if (time(NULL) >= it->second.first) {
+    m_paths.erase(it->second.second);
+    m_map.erase(it);
+    ++m_misses;
+    return false;
+  }
+  ++m_hits;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+void NegativeLookupCache::Add(const string &path) {
+  if (m_maxCount == 0 || m_expireInSec <= 0 || path.empty()) {
+    return;
+  }
+  auto expireTime = time(NULL) + m_expireInSec;
+  lock_guard<mutex> lock(m_mutex);
+  auto it = m_map.find(path);
+  if (it != m_map.end()) {
+    it->second.first = expireTime;
+    m_paths.splice(m_paths.end(), m_paths, it->second.second);
+    return;
+  }
+  while (m_map.size() >= m_maxCount && !m_paths.empty()) {
+    m_map.erase(m_paths.front());
+    m_paths.pop_front();
+  }
+  auto pos = m_paths.insert(m_paths.end(), path);
+  m_map.emplace(path, std::make_pair(expireTime, pos));
+}
+
+// --------------------------------------------------------------------------
+void NegativeLookupCache::Erase(const string &path) {
+  lock_guard<mutex> lock(m_mutex);
+  if (m_map.empty()) {
+    return;
+  }
+  auto path_ = path;
+  while (!path_.empty() && path_ != "/") {
+    UnguardedErase(path_);
+    if (path_.back() == '/') {
+      path_.pop_back();
+    }
+    auto pos = path_.rfind('/');
+    if (pos == string::npos) {
+      break;
+    }
+    path_.resize(pos + 1);  // parent dir
+  }
+}
+
+// --------------------------------------------------------------------------
+void NegativeLookupCache::Clear() {
+  lock_guard<mutex> lock(m_mutex);
+  m_map.clear();
+  m_paths.clear();
+}
+
+// --------------------------------------------------------------------------
+size_t NegativeLookupCache::GetSize() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_map.size();
+}
+
+// --------------------------------------------------------------------------
+void NegativeLookupCache::UnguardedErase(const string &path) {
+  auto other = path.back() == '/' ? path.substr(0, path.size() - 1)
+                                  : path + '/';
+  for (auto &path_ : {path, other}) {
+    auto it = m_map.find(path_);
+    if (it != m_map.end()) {
+      m_paths.erase(it->second.second);
+      m_map.erase(it);
+    }
+  }
+}
+
+}  // namespace Data
+}  // namespace QS
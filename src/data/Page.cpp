@@ -17,19 +17,27 @@
 #include "data/Page.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>  // for memcpy
+#include <zlib.h>
 
-#include <fstream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include <algorithm>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "base/LogMacros.h"
 #include "base/StringUtils.h"
-#include "base/Utils.h"
-#include "configure/Options.h"
+#include "data/DiskFile.h"
 #include "data/IOStream.h"
+#include "data/StreamBuf.h"
 #include "data/StreamUtils.h"
 
 namespace QS {
@@ -40,10 +48,6 @@ using QS::Data::IOStream;
 using QS::Data::StreamUtils::GetStreamSize;
 using QS::StringUtils::FormatPath;
 using QS::StringUtils::PointerAddress;
-using QS::Utils::CreateDirectoryIfNotExists;
-using QS::Utils::FileExists;
-using QS::Utils::GetDirName;
-using std::fstream;
 using std::lock_guard;
 using std::make_shared;
 using std::iostream;
@@ -52,44 +56,43 @@ using std::shared_ptr;
 using std::stringstream;
 using std::string;
 using std::to_string;
+using std::vector;
 
 namespace {
 
-// RAII class to open file and close it in destructor
-class FileOpener {
- public:
-  explicit FileOpener(const shared_ptr<iostream> &body) {
-    m_file = dynamic_cast<fstream *>(body.get());
-  }
+// Chunk size to copy a stream into disk file
+constexpr size_t kCopyChunkSize = 64 * 1024;
 
-  FileOpener(const FileOpener &) = delete;
-  FileOpener(FileOpener &&) = delete;
-  FileOpener& operator=(const FileOpener &) = delete;
-  FileOpener& operator=(FileOpener &&) = delete;
+// Size of the sample to detect incompressible bytes
+constexpr size_t kCompressSampleSize = 4 * 1024;
 
-  ~FileOpener() {
-    if (m_file != nullptr && m_file->is_open()) {
-      m_file->flush();
-      m_file->close();
-    }
-  }
+// --------------------------------------------------------------------------
+// Compressing is worth only if it saves one eighth of the size at least
+bool IsWorthCompressing(size_t size, size_t compressedSize) {
+  return compressedSize <= size - size / 8;
+}
 
-  void DoOpen(const string &filename, std::ios_base::openmode mode) {
-    if (m_file != nullptr && !filename.empty()) {
-      m_file->open(filename, mode);
-      if (!m_file->is_open()) {
-        DebugError("Fail to open file " + FormatPath(filename));
-      }
-    } else {
-      DebugError("Invalid parameter");
-    }
+// --------------------------------------------------------------------------
+bool CompressBytes(const char *data, size_t len, vector<char> *out) {
+  uLongf outLen = compressBound(len);
+  out->resize(outLen);
+  if (compress2(reinterpret_cast<Bytef *>(&(*out)[0]), &outLen,
+                reinterpret_cast<const Bytef *>(data), len,
+                Z_BEST_SPEED) != Z_OK) {
+    return false;
   }
+  out->resize(outLen);
+  return true;
+}
 
- private:
-  FileOpener() = default;
-
-  fstream *m_file = nullptr;
-};
+// --------------------------------------------------------------------------
+bool DecompressBytes(const vector<char> &in, char *data, size_t len) {
+  uLongf outLen = len;
+  return uncompress(reinterpret_cast<Bytef *>(data), &outLen,
+                    reinterpret_cast<const Bytef *>(in.data()),
+                    in.size()) == Z_OK &&
+         outLen == len;
+}
 
 }  // namespace
 
@@ -109,7 +112,8 @@ Page::Page(off_t offset, size_t len, const char *buffer)
 }
 
 // --------------------------------------------------------------------------
-Page::Page(off_t offset, size_t len, const char *buffer, const string &diskfile)
+Page::Page(off_t offset, size_t len, const char *buffer,
+           const shared_ptr<DiskFile> &diskfile)
     : m_offset(offset), m_size(len), m_diskFile(diskfile) {
   bool isValidInput = offset >= 0 && len >= 0 && buffer != nullptr;
   assert(isValidInput);
@@ -142,7 +146,7 @@ Page::Page(off_t offset, size_t len, const shared_ptr<iostream> &instream)
 
 // --------------------------------------------------------------------------
 Page::Page(off_t offset, size_t len, const shared_ptr<iostream> &instream,
-           const string &diskfile)
+           const shared_ptr<DiskFile> &diskfile)
     : m_offset(offset), m_size(len), m_diskFile(diskfile) {
   bool isValidInput = offset >= 0 && len > 0 && instream;
   assert(isValidInput);
@@ -158,6 +162,27 @@ Page::Page(off_t offset, size_t len, const shared_ptr<iostream> &instream,
   }
 }
 
+// --------------------------------------------------------------------------
+Page::Page(off_t offset, size_t len, const shared_ptr<DiskFile> &diskfile)
+    : m_offset(offset), m_size(len), m_diskFile(diskfile) {
+  bool isValidInput = offset >= 0 && diskfile;
+  assert(isValidInput);
+  if (!isValidInput) {
+    DebugError("Try to new a page with invalid input " +
+               ToStringLine(offset, len));
+    return;
+  }
+
+  lock_guard<recursive_mutex> lock(m_mutex);
+  SetupDiskFile();
+}
+
+// --------------------------------------------------------------------------
+Page::Page(off_t offset, size_t len)
+    : m_offset(offset), m_size(len), m_hole(true) {
+  assert(offset >= 0);
+}
+
 // --------------------------------------------------------------------------
 Page::Page(off_t offset, size_t len, shared_ptr<iostream> &&body)
     : m_offset(offset), m_size(len) {
@@ -185,30 +210,127 @@ Page::Page(off_t offset, size_t len, shared_ptr<iostream> &&body)
 // --------------------------------------------------------------------------
 bool Page::UseDiskFile() {
   lock_guard<recursive_mutex> lock(m_mutex);
-  return !m_diskFile.empty();
+  return static_cast<bool>(m_diskFile);
 }
 
 // --------------------------------------------------------------------------
 bool Page::UseDiskFileNoLock() {
-  return !m_diskFile.empty();
+  return static_cast<bool>(m_diskFile);
+}
+
+// --------------------------------------------------------------------------
+const char *Page::GetData(off_t offset) const {
+  if (m_diskFile || !m_body) {
+    return nullptr;
+  }
+  auto streambuf = dynamic_cast<const StreamBuf *>(m_body->rdbuf());
+  if (streambuf == nullptr || !streambuf->GetBuffer()) {
+    return nullptr;
+  }
+  return streambuf->GetBuffer()->data() + (offset - m_offset);
+}
+
+// --------------------------------------------------------------------------
+bool Page::IsCompressed() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  return !m_compressed.empty();
+}
+
+// --------------------------------------------------------------------------
+size_t Page::GetCompressedSavedSize() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  return m_compressed.empty() ? 0 : m_size - m_compressed.size();
+}
+
+// --------------------------------------------------------------------------
+bool Page::IsHole() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  return m_hole;
+}
+
+// --------------------------------------------------------------------------
+size_t Page::GetHoleSize() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  return m_hole ? m_size : 0;
+}
+
+// --------------------------------------------------------------------------
+size_t Page::FillHole() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (!m_hole) {
+    return 0;
+  }
+  m_body = make_shared<IOStream>(Buffer(new vector<char>(m_size)), m_size);
+  m_hole = false;
+  return m_size;
+}
+
+// --------------------------------------------------------------------------
+size_t Page::Compress() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (m_diskFile || m_incompressible || !m_compressed.empty() || m_size == 0) {
+    return 0;
+  }
+  auto data = GetData(m_offset);
+  if (data == nullptr) {
+    return 0;
+  }
+
+  vector<char> compressed;
+  // Try a sample in the middle of the page first.
+  auto sampleLen = std::min(m_size, kCompressSampleSize);
+  if (sampleLen < m_size) {
+    auto sampleOff = (m_size - sampleLen) / 2;
+    if (!CompressBytes(data + sampleOff, sampleLen, &compressed) ||
+        !IsWorthCompressing(sampleLen, compressed.size())) {
+      m_incompressible = true;
+      return 0;
+    }
+  }
+  if (!CompressBytes(data, m_size, &compressed) ||
+      !IsWorthCompressing(m_size, compressed.size())) {
+    m_incompressible = true;
+    return 0;
+  }
+
+  compressed.shrink_to_fit();
+  m_compressed = std::move(compressed);
+  m_body.reset();
+  return m_size - m_compressed.size();
+}
+
+// --------------------------------------------------------------------------
+size_t Page::Decompress() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (m_compressed.empty()) {
+    return 0;
+  }
+
+  Buffer buf(new vector<char>(m_size));
+  if (!DecompressBytes(m_compressed, &(*buf)[0], m_size)) {
+    DebugError("Fail to decompress page " + ToStringLine(m_offset, m_size));
+  }
+  auto regainedSize = m_size - m_compressed.size();
+  m_body = make_shared<IOStream>(std::move(buf), m_size);
+  vector<char>().swap(m_compressed);
+  return regainedSize;
 }
 
 // --------------------------------------------------------------------------
 void Page::UnguardedPutToBody(off_t offset, size_t len, const char *buffer) {
+  if (UseDiskFileNoLock()) {
+    if (m_diskFile->Write(m_offset, len, buffer) != len) {
+      DebugError("Fail to write buffer " + ToStringLine(offset, len, buffer) +
+                 FormatPath(m_diskFile->GetPath()));
+    }
+    return;
+  }
+
   if (!m_body) {
     DebugError("null body stream " + ToStringLine(offset, len, buffer));
     return;
   }
-  FileOpener opener(m_body);
-  if (UseDiskFileNoLock()) {
-    // Notice: need to open in both output and input mode to avoid truncate file
-    // as open in out mode only will actually truncate file.
-    opener.DoOpen(m_diskFile, std::ios_base::binary | std::ios_base::ate |
-                  std::ios_base::in | std::ios_base::out);  // open for write
-    m_body->seekp(m_offset, std::ios_base::beg);
-  } else {
-    m_body->seekp(0, std::ios_base::beg);
-  }
+  m_body->seekp(0, std::ios_base::beg);
   if (!m_body->good()) {
     DebugError("Fail to seek body " + ToStringLine(offset, len, buffer));
   } else {
@@ -219,6 +341,58 @@ void Page::UnguardedPutToBody(off_t offset, size_t len, const char *buffer) {
   }
 }
 
+// --------------------------------------------------------------------------
+bool Page::Demote(const shared_ptr<DiskFile> &diskfile) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (m_diskFile || m_hole) {
+    return false;
+  }
+  if (!diskfile || !diskfile->IsOpen()) {
+    DebugError("Disk file not available " + ToStringLine(m_offset, m_size));
+    return false;
+  }
+
+  auto data = GetData(m_offset);
+  vector<char> decompressed;
+  if (data == nullptr && m_size > 0) {
+    decompressed.resize(m_size);
+    if (UnguardedRead(m_offset, m_size, &decompressed[0]) != m_size) {
+      return false;
+    }
+    data = &decompressed[0];
+  }
+  if (diskfile->Write(m_offset, m_size, data) != m_size) {
+    DebugError("Fail to demote page " + ToStringLine(m_offset, m_size) +
+               FormatPath(diskfile->GetPath()));
+    return false;
+  }
+
+  m_body.reset();
+  vector<char>().swap(m_compressed);
+  m_incompressible = false;
+  m_diskFile = diskfile;
+  m_diskHits = 0;
+  return true;
+}
+
+// --------------------------------------------------------------------------
+bool Page::Promote() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (!m_diskFile) {
+    return false;
+  }
+
+  Buffer buf(new vector<char>(m_size));
+  if (m_size > 0 && UnguardedRead(m_offset, m_size, &(*buf)[0]) != m_size) {
+    return false;
+  }
+  m_diskFile->PunchHole(m_offset, m_size);
+  m_diskFile.reset();
+  m_diskHits = 0;
+  m_body = make_shared<IOStream>(std::move(buf), m_size);
+  return true;
+}
+
 // --------------------------------------------------------------------------
 void Page::UnguardedPutToBody(off_t offset, size_t len,
                               const shared_ptr<iostream> &instream) {
@@ -230,18 +404,30 @@ void Page::UnguardedPutToBody(off_t offset, size_t len,
     m_size = instreamLen;
   }
 
-  FileOpener opener(m_body);
+  instream->seekg(0, std::ios_base::beg);
   if (UseDiskFileNoLock()) {
-    opener.DoOpen(m_diskFile, std::ios_base::binary | std::ios_base::ate |
-                  std::ios_base::in | std::ios_base::out);  // open for write
-    m_body->seekp(m_offset, std::ios_base::beg);
-  } else {
-    m_body->seekp(0, std::ios_base::beg);
+    // copy the stream into disk file chunk by chunk
+    vector<char> chunk(std::min(len, kCopyChunkSize));
+    size_t copied = 0;
+    while (copied < len) {
+      auto chunkLen = std::min(len - copied, chunk.size());
+      instream->read(&chunk[0], chunkLen);
+      if (!instream->good() ||
+          m_diskFile->Write(m_offset + static_cast<off_t>(copied), chunkLen,
+                            &chunk[0]) != chunkLen) {
+        DebugError("Fail to write buffer " + ToStringLine(offset, len) +
+                   FormatPath(m_diskFile->GetPath()));
+        return;
+      }
+      copied += chunkLen;
+    }
+    return;
   }
+
+  m_body->seekp(0, std::ios_base::beg);
   if (!m_body->good()) {
     DebugError("Fail to seek body " + ToStringLine(offset, len));
   } else {
-    instream->seekg(0, std::ios_base::beg);
     if (len == instreamLen) {
       (*m_body) << instream->rdbuf();
     } else if (len < instreamLen) {
@@ -258,28 +444,27 @@ void Page::UnguardedPutToBody(off_t offset, size_t len,
 // --------------------------------------------------------------------------
 void Page::SetStream(shared_ptr<iostream> &&stream) {
   lock_guard<recursive_mutex> lock(m_mutex);
-  m_body = std::move(stream);
+  vector<char>().swap(m_compressed);  // replaced by the stream
+  m_hole = false;
+  if (UseDiskFileNoLock()) {
+    UnguardedPutToBody(m_offset, m_size, stream);
+  } else if (dynamic_cast<IOStream *>(stream.get()) != nullptr) {
+    m_body = std::move(stream);
+  } else {
+    // keep body as IOStream, so its bytes could be accessed directly
+    m_body = make_shared<IOStream>(m_size);
+    UnguardedPutToBody(m_offset, m_size, stream);
+  }
 }
 
 // --------------------------------------------------------------------------
 bool Page::SetupDiskFile() {
   lock_guard<recursive_mutex> lock(m_mutex);
-  CreateDirectoryIfNotExists(
-      QS::Configure::Options::Instance().GetDiskCacheDirectory());
-
-  std::ios_base::openmode mode = std::ios_base::binary | std::ios_base::ate |
-                                 std::ios_base::in | std::ios_base::out;
-  if (!FileExists(m_diskFile)) {
-    // Notice: set open mode with std::ios_base::out to create file in disk if
-    // it is not exist
-    mode = std::ios_base::binary | std::ios_base::out;
-  }
-  auto file = make_shared<fstream>(m_diskFile, mode);
-  if (file && file->is_open()) {
-    DebugInfo("Open file " + FormatPath(m_diskFile));
-  }
-  file->close();
-  m_body = std::move(file);
+  m_body.reset();  // bytes are stored in disk file
+  if (!m_diskFile || !m_diskFile->IsOpen()) {
+    DebugError("Disk file not available " + ToStringLine(m_offset, m_size));
+    return false;
+  }
   return true;
 }
 
@@ -287,20 +472,34 @@ bool Page::SetupDiskFile() {
 void Page::ResizeToSmallerSize(size_t smallerSize) {
   // Do a lazy resize:
   // 1. Change size to 'samllerSize'.
-  // 2. Set output position indicator to 'samllerSize'.
+  // 2. Set output position indicator to 'samllerSize', or deallocate the
+  //    removed bytes in disk file.
   assert(0 <= smallerSize && smallerSize <= m_size);
   lock_guard<recursive_mutex> lock(m_mutex);
-  m_size = smallerSize;
+  Decompress();
   if (UseDiskFileNoLock()) {
-    m_body->seekp(m_offset + smallerSize, std::ios_base::beg);
+    m_diskFile->PunchHole(m_offset + static_cast<off_t>(smallerSize),
+                          m_size - smallerSize);
+    m_size = smallerSize;
+  } else if (m_hole) {
+    m_size = smallerSize;
   } else {
+    m_size = smallerSize;
     m_body->seekp(smallerSize, std::ios_base::beg);
   }
 }
 
+// --------------------------------------------------------------------------
+void Page::PunchHole() {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (UseDiskFileNoLock()) {
+    m_diskFile->PunchHole(m_offset, m_size);
+  }
+}
+
 // --------------------------------------------------------------------------
 bool Page::Refresh(off_t offset, size_t len, const char *buffer,
-                   const string &diskfile) {
+                   const shared_ptr<DiskFile> &diskfile) {
   if (len == 0) {
     return true;  // do nothing
   }
@@ -319,22 +518,28 @@ bool Page::Refresh(off_t offset, size_t len, const char *buffer,
 
 // --------------------------------------------------------------------------
 bool Page::UnguardedRefresh(off_t offset, size_t len, const char *buffer,
-                            const string &diskfile) {
-  auto moreLen = offset + len - Next();
-  auto dataLen = moreLen > 0 ? m_size + moreLen : m_size;
-  auto data = make_shared<IOStream>(dataLen);
-  {
-    FileOpener opener(m_body);
-    if (UseDiskFileNoLock()) {
-      opener.DoOpen(m_diskFile,
-                    std::ios_base::binary | std::ios_base::in);  // for read
-      m_body->seekg(offset, std::ios_base::beg);
-    } else {
-      m_body->seekg(0, std::ios_base::beg);
+                            const shared_ptr<DiskFile> &diskfile) {
+  Decompress();
+  FillHole();
+  off_t moreLen = offset + static_cast<off_t>(len) - Next();
+  if (UseDiskFileNoLock()) {
+    // bytes are stored at file offset, so write the input in place
+    if (m_diskFile->Write(offset, len, buffer) != len) {
+      DebugError("Fail to refresh page(" + ToStringLine(m_offset, m_size) +
+                 ") with input " + ToStringLine(offset, len, buffer));
+      return false;
+    }
+    if (moreLen > 0) {
+      m_size += moreLen;
     }
-    (*data) << m_body->rdbuf();
+    return true;
   }
 
+  auto dataLen = moreLen > 0 ? m_size + moreLen : m_size;
+  auto data = make_shared<IOStream>(dataLen);
+  m_body->seekg(0, std::ios_base::beg);
+  (*data) << m_body->rdbuf();
+
   data->seekp(offset - m_offset, std::ios_base::beg);
   data->write(buffer, len);
 
@@ -344,40 +549,23 @@ bool Page::UnguardedRefresh(off_t offset, size_t len, const char *buffer,
     return false;
   }
 
-  if (!diskfile.empty()) {
+  if (moreLen > 0) {
+    m_size += moreLen;
+  }
+  data->seekg(0, std::ios_base::beg);
+  if (diskfile) {
+    // put pages' all content into disk file
     m_diskFile = diskfile;
     if (!SetupDiskFile()) {
-      DebugError("Unable to set up file " + FormatPath(m_diskFile));
+      m_diskFile.reset();
+      m_body = std::move(data);
       return false;
     }
-  }
-
-  FileOpener opener(m_body);
-  if (UseDiskFileNoLock()) {
-    opener.DoOpen(m_diskFile, std::ios_base::binary | std::ios_base::ate |
-                  std::ios_base::in | std::ios_base::out);  // open for write
-    m_body->seekp(m_offset, std::ios_base::beg);
-    if (!m_body->good()) {
-      DebugError("Fail to seek page(" + ToStringLine(m_offset, m_size) +
-                 ") with input " + ToStringLine(offset, len, buffer));
-      return false;
-    }
-    data->seekg(0, std::ios_base::beg);
-    (*m_body) << data->rdbuf();  // put pages' all content into disk file
+    UnguardedPutToBody(m_offset, m_size, data);
   } else {
-    data->seekg(0, std::ios_base::beg);
     m_body = std::move(data);
   }
-  if (moreLen > 0) {
-    m_size += moreLen;
-  }
-  if (m_body->good()) {
-    return true;
-  } else {
-    DebugError("Fail to refresh page(" + ToStringLine(m_offset, m_size) +
-               ") with input " + ToStringLine(offset, len, buffer));
-    return false;
-  }
+  return true;
 }
 
 // --------------------------------------------------------------------------
@@ -398,20 +586,66 @@ size_t Page::Read(off_t offset, size_t len, char *buffer) {
   return UnguardedRead(offset, len, buffer);
 }
 
+// --------------------------------------------------------------------------
+bool Page::AddDiskReadRequest(off_t offset, size_t len, char *buffer,
+                              DiskIORequestVec *requests) {
+  lock_guard<recursive_mutex> lock(m_mutex);
+  if (!UseDiskFileNoLock()) {
+    return false;
+  }
+  bool isValidInput =
+      (offset >= m_offset && buffer != nullptr && requests != nullptr &&
+       len <= static_cast<size_t>(Next() - offset));
+  assert(isValidInput);
+  if (!isValidInput) {
+    DebugError("Try to read page (" + ToStringLine(m_offset, m_size) +
+               ") with invalid input " + ToStringLine(offset, len, buffer));
+    return true;
+  }
+  if (len == 0) {
+    return true;  // do nothing
+  }
+
+  QS::Data::AddDiskReadRequest(requests, m_diskFile.get(), offset, len,
+                               buffer);
+  return true;
+}
+
 // --------------------------------------------------------------------------
 size_t Page::UnguardedRead(off_t offset, size_t len, char *buffer) {
+  if (m_hole) {
+    memset(buffer, 0, len);
+    return len;
+  }
+
+  if (UseDiskFileNoLock()) {
+    if (m_diskFile->Read(offset, len, buffer) != len) {
+      DebugError("Fail to read page(" + ToStringLine(m_offset, m_size) +
+                 ") with input " + ToStringLine(offset, len, buffer) +
+                 FormatPath(m_diskFile->GetPath()));
+      return 0;
+    }
+    return len;
+  }
+
+  if (!m_compressed.empty()) {
+    // decompress without keeping the bytes, it is up to the owning File to
+    // decompress the page into memory
+    vector<char> data(m_size);
+    if (!DecompressBytes(m_compressed, &data[0], m_size)) {
+      DebugError("Fail to decompress page(" + ToStringLine(m_offset, m_size) +
+                 ") with input " + ToStringLine(offset, len, buffer));
+      return 0;
+    }
+    memcpy(buffer, &data[offset - m_offset], len);
+    return len;
+  }
+
   if (!m_body) {
     DebugError("null body stream " + ToStringLine(offset, len, buffer));
     return 0;
   }
-  FileOpener opener(m_body);
-  if (UseDiskFileNoLock()) {
-    opener.DoOpen(m_diskFile,
-                  std::ios_base::binary | std::ios_base::in);  // open for read
-    m_body->seekg(offset, std::ios_base::beg);
-  } else {
-    m_body->seekg(offset - m_offset, std::ios_base::beg);
-  }
+  m_body->seekg(offset - m_offset, std::ios_base::beg);
   if (!m_body->good()) {
     DebugError("Fail to seek page(" + ToStringLine(m_offset, m_size) +
                ") with input " + ToStringLine(offset, len, buffer));
@@ -428,6 +662,36 @@ size_t Page::UnguardedRead(off_t offset, size_t len, char *buffer) {
   }
 }
 
+// --------------------------------------------------------------------------
+bool IsAllZero(const char *buffer, size_t len) {
+  size_t pos = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; pos + 64 <= len; pos += 64) {
+    auto p = reinterpret_cast<const __m128i *>(buffer + pos);
+    auto bits = _mm_or_si128(
+        _mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+        _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bits, zero)) != 0xffff) {
+      return false;
+    }
+  }
+#endif  // __SSE2__
+  for (; pos + sizeof(uint64_t) <= len; pos += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, buffer + pos, sizeof(word));
+    if (word != 0) {
+      return false;
+    }
+  }
+  for (; pos < len; ++pos) {
+    if (buffer[pos] != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // --------------------------------------------------------------------------
 string ToStringLine(off_t offset, size_t len, const char *buffer) {
   return "[offset:size:buffer=" + to_string(offset) + ":" + to_string(len) +
@@ -0,0 +1,224 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/PathName.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "base/HashUtils.h"
+#include "base/SharedMutex.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::HashUtils::Hash64;
+using QS::Threading::SharedLock;
+using QS::Threading::SharedMutex;
+using std::lock_guard;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::weak_ptr;
+
+struct PathComponent {
+  PathComponent(const shared_ptr<const PathComponent> &parent_,
+                const char *name_, size_t len)
+      : parent(parent_), name(name_, len) {}
+  ~PathComponent();
+
+  shared_ptr<const PathComponent> parent;  // null for the first component
+  string name;                             // ending with "/" for a dir
+};
+
+namespace {
+
+// Key of a component, which references the name of the component instead of
+// copying it, so a lookup needs no string
+struct ComponentKey {
+  const PathComponent *parent;
+  const char *name;
+  size_t len;
+};
+
+struct ComponentKeyHash {
+  size_t operator()(const ComponentKey &key) const {
+    return static_cast<size_t>(
+        Hash64(key.name, key.len) +
+        0x9e3779b97f4a7c15ULL * reinterpret_cast<uintptr_t>(key.parent));
+  }
+};
+
+struct ComponentKeyEqual {
+  bool operator()(const ComponentKey &lhs, const ComponentKey &rhs) const {
+    return lhs.parent == rhs.parent && lhs.len == rhs.len &&
+           memcmp(lhs.name, rhs.name, lhs.len) == 0;
+  }
+};
+
+// --------------------------------------------------------------------------
+// Get the length of the component starting at pos, including the ending "/"
+size_t ComponentLength(const string &path, size_t pos) {
+  auto end = path.find('/', pos);
+  return end == string::npos ? path.size() - pos : end + 1 - pos;
+}
+
+// Components interned by their parents and names
+//
+// Notes: a component is released by its dtor, which takes the lock, so no
+// component may be released while holding the lock.
+class ComponentPool {
+ public:
+  // Find the last component of path, or null if it is not interned
+  shared_ptr<const PathComponent> Find(const string &path) const;
+
+  // Find the last component of path, interning the missing ones
+  shared_ptr<const PathComponent> Intern(const string &path);
+
+  // Remove the component which is released
+  void Erase(const PathComponent *component);
+
+  size_t GetSize() const {
+    SharedLock lock(m_mutex);
+    return m_components.size();
+  }
+
+ private:
+  using ComponentMap =
+      unordered_map<ComponentKey, weak_ptr<const PathComponent>,
+                    ComponentKeyHash, ComponentKeyEqual>;
+
+  ComponentMap m_components;
+  mutable SharedMutex m_mutex;
+};
+
+// --------------------------------------------------------------------------
+shared_ptr<const PathComponent> ComponentPool::Find(const string &path) const {
+  shared_ptr<const PathComponent> component;
+  bool found = true;
+  {
+    SharedLock lock(m_mutex);
+    for (size_t pos = 0, len = 0; pos < path.size(); pos += len) {
+      len = ComponentLength(path, pos);
+      auto it = m_components.find(
+          ComponentKey{component.get(), path.data() + pos, len});
+      auto child = it != m_components.end() ? it->second.lock() : nullptr;
+      if (!child) {
+        found = false;
+        break;
+      }
+      component = std::move(child);  // the child holds its parent
+    }
+  }
+  // may release the component, so out of the lock
+  return found ? component : nullptr;
+}
+
+// --------------------------------------------------------------------------
+shared_ptr<const PathComponent> ComponentPool::Intern(const string &path) {
+  shared_ptr<const PathComponent> component;
+  lock_guard<SharedMutex> lock(m_mutex);
+  for (size_t pos = 0, len = 0; pos < path.size(); pos += len) {
+    len = ComponentLength(path, pos);
+    ComponentKey key{component.get(), path.data() + pos, len};
+    auto it = m_components.find(key);
+    auto child = it != m_components.end() ? it->second.lock() : nullptr;
+    if (!child) {
+      if (it != m_components.end()) {
+        // the component is being released, its dtor will skip it
+        m_components.erase(it);
+      }
+      child = make_shared<PathComponent>(component, key.name, len);
+      key.name = child->name.data();
+      m_components.emplace(key, child);
+    }
+    component = std::move(child);  // the child holds its parent
+  }
+  return component;
+}
+
+// --------------------------------------------------------------------------
+void ComponentPool::Erase(const PathComponent *component) {
+  lock_guard<SharedMutex> lock(m_mutex);
+  auto it = m_components.find(ComponentKey{
+      component->parent.get(), component->name.data(), component->name.size()});
+  // the key may be taken by a new component of the same name already
+  if (it != m_components.end() && it->first.name == component->name.data()) {
+    m_components.erase(it);
+  }
+}
+
+// --------------------------------------------------------------------------
+ComponentPool &Pool() {
+  // never destroyed, as path names may be held by static objects
+  static ComponentPool *pool = new ComponentPool;
+  return *pool;
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+PathComponent::~PathComponent() { Pool().Erase(this); }
+
+// --------------------------------------------------------------------------
+PathName::PathName(const string &path) : m_component(Pool().Intern(path)) {}
+
+// --------------------------------------------------------------------------
+PathName PathName::Find(const string &path) {
+  return PathName(Pool().Find(path));
+}
+
+// --------------------------------------------------------------------------
+size_t PathName::GetComponentCount() { return Pool().GetSize(); }
+
+// --------------------------------------------------------------------------
+string PathName::ToString() const {
+  size_t len = 0;
+  for (auto c = m_component.get(); c != nullptr; c = c->parent.get()) {
+    len += c->name.size();
+  }
+  string path(len, '\0');
+  for (auto c = m_component.get(); c != nullptr; c = c->parent.get()) {
+    len -= c->name.size();
+    c->name.copy(&path[len], c->name.size());
+  }
+  return path;
+}
+
+// --------------------------------------------------------------------------
+const string &PathName::GetName() const {
+  static const string empty;
+  return m_component ? m_component->name : empty;
+}
+
+// --------------------------------------------------------------------------
+PathName PathName::GetParent() const {
+  return m_component ? PathName(shared_ptr<const PathComponent>(
+                           m_component->parent))
+                     : PathName();
+}
+
+}  // namespace Data
+}  // namespace QS
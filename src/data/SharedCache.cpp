@@ -0,0 +1,320 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include "data/SharedCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>  // for rename
+#include <string.h>
+
+#include <dirent.h>  // for opendir readdir
+#include <sys/file.h>  // for flock
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "base/HashUtils.h"
+#include "base/LogMacros.h"
+#include "base/StringUtils.h"
+#include "base/Utils.h"
+#include "data/Size.h"
+
+namespace QS {
+
+namespace Data {
+
+using QS::HashUtils::StableHash64;
+using QS::StringUtils::FormatPath;
+using QS::Utils::AppendPathDelim;
+using QS::Utils::CreateDirectoryIfNotExists;
+using QS::Utils::FileExists;
+using std::string;
+using std::stringstream;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+constexpr const char *kLockFileName = ".lock";
+constexpr const char *kTmpFileSuffix = ".tmp";
+constexpr size_t kChunkSize = QS::Data::Size::MB1;
+
+// --------------------------------------------------------------------------
+bool EndsWith(const string &str, const string &suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Exclusive lock of a file among processes, released when destructed
+class FileLock {
+ public:
+  explicit FileLock(const string &path)
+      : m_fd(open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) {
+    if (m_fd >= 0 && flock(m_fd, LOCK_EX) != 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+    DebugErrorIf(m_fd < 0, "Fail to lock file : " + string(strerror(errno)) +
+                               FormatPath(path));
+  }
+
+  FileLock(FileLock &&) = delete;
+  FileLock(const FileLock &) = delete;
+  FileLock &operator=(FileLock &&) = delete;
+  FileLock &operator=(const FileLock &) = delete;
+  ~FileLock() {
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  bool IsLocked() const { return m_fd >= 0; }
+
+ private:
+  int m_fd = -1;
+};
+
+// --------------------------------------------------------------------------
+// Whether the temporary file is still locked by the process storing it
+bool IsBeingStored(const string &tmpPath) {
+  int fd = open(tmpPath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool locked = flock(fd, LOCK_EX | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+  close(fd);
+  return locked;
+}
+
+}  // namespace
+
+// --------------------------------------------------------------------------
+SharedCache::SharedCache(const string &dir, const string &bucket,
+                         uint64_t capacity)
+    : m_dir(AppendPathDelim(dir)), m_bucket(bucket), m_capacity(capacity) {
+  if (!CreateDirectoryIfNotExists(m_dir)) {
+    DebugError("Unable to mkdir for shared cache " + FormatPath(m_dir));
+  }
+}
+
+// --------------------------------------------------------------------------
+bool SharedCache::Has(const string &key, const string &eTag,
+                      uint64_t objectSize) const {
+  return FileExists(BuildFilePath(key, eTag, objectSize), false);
+}
+
+// --------------------------------------------------------------------------
+size_t SharedCache::Read(const string &key, const string &eTag,
+                         uint64_t objectSize, off_t offset, size_t len,
+                         char *buffer) const {
+  if (offset < 0 || static_cast<uint64_t>(offset) + len > objectSize) {
+    return 0;
+  }
+  int fd = open(BuildFilePath(key, eTag, objectSize).c_str(),
+                O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;  // not in shared cache
+  }
+
+  size_t readSize = 0;
+  while (readSize < len) {
+    auto n = pread(fd, buffer + readSize, len - readSize, offset + readSize);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    readSize += n;
+  }
+  // update modification time as the time of last use, which is permitted
+  // only to the owner of the file as it's opened read only
+  if (futimens(fd, nullptr) != 0) {
+    DebugWarning("Fail to update the time of last use of shared cache : " +
+                 string(strerror(errno)) + FormatPath(key));
+  }
+  close(fd);
+  DebugErrorIf(readSize != len,
+               "Fail to read shared cache [offset:len=" + to_string(offset) +
+                   ":" + to_string(len) + "] " + FormatPath(key));
+  return readSize == len ? readSize : 0;
+}
+
+// --------------------------------------------------------------------------
+bool SharedCache::Store(const string &key, const string &eTag,
+                        uint64_t objectSize, const ContentReader &reader) {
+  if (eTag.empty() || objectSize == 0 || objectSize > m_capacity) {
+    return false;
+  }
+  auto path = BuildFilePath(key, eTag, objectSize);
+  if (FileExists(path, false)) {
+    return true;
+  }
+
+  // Hold the lock only to make space and reserve the temporary file, the
+  // content is copied without it
+  auto tmpPath = path + kTmpFileSuffix;
+  int fd = -1;
+  {
+    FileLock lock(m_dir + kLockFileName);
+    if (!lock.IsLocked()) {
+      return false;
+    }
+    if (FileExists(path, false)) {
+      return true;  // stored by other process
+    }
+    if (!Evict(objectSize)) {
+      DebugWarning("No space in shared cache for " + to_string(objectSize) +
+                   " bytes " + FormatPath(key));
+      return false;
+    }
+    fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      DebugErrorIf(errno != EEXIST, "Fail to create shared cache file : " +
+                                        string(strerror(errno)) +
+                                        FormatPath(tmpPath));
+      return false;  // being stored by other process if existing
+    }
+    // the lock of the temporary file tells Evict it's being stored, and its
+    // size reserves the space of the object
+    if (flock(fd, LOCK_EX) != 0 ||
+        ftruncate(fd, static_cast<off_t>(objectSize)) != 0) {
+      DebugError("Fail to reserve shared cache file : " +
+                 string(strerror(errno)) + FormatPath(tmpPath));
+      close(fd);
+      unlink(tmpPath.c_str());
+      return false;
+    }
+  }
+
+  vector<char> buf(std::min<uint64_t>(kChunkSize, objectSize));
+  uint64_t storedSize = 0;
+  while (storedSize < objectSize) {
+    auto len = std::min<uint64_t>(buf.size(), objectSize - storedSize);
+    if (reader(storedSize, len, &buf[0]) != len ||
+        pwrite(fd, &buf[0], len, storedSize) != static_cast<ssize_t>(len)) {
+      break;
+    }
+    storedSize += len;
+  }
+  bool success = storedSize == objectSize &&
+                 rename(tmpPath.c_str(), path.c_str()) == 0;
+  if (!success) {
+    DebugError("Fail to store shared cache " + FormatPath(key));
+    unlink(tmpPath.c_str());
+  }
+  close(fd);  // release the lock of temporary file after it's renamed
+  if (!success) {
+    return false;
+  }
+  DebugInfo("Store shared cache of " + to_string(objectSize) + " bytes " +
+            FormatPath(key));
+  return true;
+}
+
+// --------------------------------------------------------------------------
+uint64_t SharedCache::GetSize() const {
+  unique_ptr<DIR, decltype(&closedir)> dir(opendir(m_dir.c_str()), &closedir);
+  if (!dir) {
+    return 0;
+  }
+  uint64_t size = 0;
+  struct dirent *entry = nullptr;
+  while ((entry = readdir(dir.get())) != nullptr) {
+    struct stat st;
+    auto path = m_dir + entry->d_name;
+    if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      size += st.st_size;
+    }
+  }
+  return size;
+}
+
+// --------------------------------------------------------------------------
+string SharedCache::BuildFilePath(const string &key, const string &eTag,
+                                  uint64_t objectSize) const {
+  stringstream ss;
+  ss << m_dir << std::hex << std::setfill('0') << std::setw(16)
+     << StableHash64(m_bucket + '\0' + key) << "-" << std::setw(16)
+     << StableHash64(eTag) << "-" << std::dec << objectSize;
+  return ss.str();
+}
+
+// --------------------------------------------------------------------------
+bool SharedCache::Evict(uint64_t size) {
+  unique_ptr<DIR, decltype(&closedir)> dir(opendir(m_dir.c_str()), &closedir);
+  if (!dir) {
+    DebugError("Fail to open shared cache dir : " + string(strerror(errno)) +
+               FormatPath(m_dir));
+    return false;
+  }
+
+  // {modification time, size, path} of objects
+  vector<std::tuple<time_t, uint64_t, string>> objects;
+  uint64_t totalSize = 0;
+  struct dirent *entry = nullptr;
+  while ((entry = readdir(dir.get())) != nullptr) {
+    string name(entry->d_name);
+    auto path = m_dir + name;
+    struct stat st;
+    if (name == kLockFileName || stat(path.c_str(), &st) != 0 ||
+        !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (EndsWith(name, kTmpFileSuffix)) {
+      if (!IsBeingStored(path)) {
+        unlink(path.c_str());  // left by a crashed process
+        continue;
+      }
+      // the reserved space is in use, but it cannot be evicted
+      totalSize += st.st_size;
+      continue;
+    }
+    objects.emplace_back(st.st_mtime, st.st_size, path);
+    totalSize += st.st_size;
+  }
+
+  std::sort(objects.begin(), objects.end());
+  uint64_t freedSize = 0;
+  for (auto &object : objects) {
+    if (totalSize + size <= m_capacity) {
+      break;
+    }
+    if (unlink(std::get<2>(object).c_str()) == 0) {
+      totalSize -= std::get<1>(object);
+      freedSize += std::get<1>(object);
+    }
+  }
+  DebugInfoIf(freedSize > 0, "Has freed shared cache of " +
+                                 to_string(freedSize) + " bytes" +
+                                 FormatPath(m_dir));
+  return totalSize + size <= m_capacity;
+}
+
+}  // namespace Data
+}  // namespace QS
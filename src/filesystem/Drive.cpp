@@ -23,12 +23,15 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <deque>
 #include <future>  // NOLINT
 #include <memory>
 #include <mutex>  // NOLINT
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -47,10 +50,16 @@
 #include "client/TransferManagerFactory.h"
 #include "configure/Default.h"
 #include "configure/Options.h"
+#include "data/AccessHistory.h"
 #include "data/Cache.h"
+#include "data/CachePolicy.h"
 #include "data/Directory.h"
 #include "data/FileMetaData.h"
+#include "data/FrequencySketch.h"
 #include "data/IOStream.h"
+#include "data/MemoryPressure.h"
+#include "data/NegativeLookupCache.h"
+#include "data/SharedCache.h"
 #include "data/Size.h"
 
 namespace QS {
@@ -67,16 +76,23 @@ using QS::Client::TransferHandle;
 using QS::Client::TransferManager;
 using QS::Client::TransferManagerConfigure;
 using QS::Client::TransferManagerFactory;
+using QS::Data::AccessHistory;
+using QS::Data::AccessRecord;
 using QS::Data::Cache;
+using QS::Data::CachePolicy;
 using QS::Data::ContentRangeDeque;
-using QS::Data::ChildrenMultiMapConstIterator;
+using QS::Data::ChildrenMapConstIterator;
 using QS::Data::DirectoryTree;
 using QS::Data::Entry;
 using QS::Data::FileMetaData;
-using QS::Data::FileType;
 using QS::Data::FilePathToNodeUnorderedMap;
+using QS::Data::FileType;
+using QS::Data::FrequencySketch;
 using QS::Data::IOStream;
+using QS::Data::MemoryPressure;
+using QS::Data::NegativeLookupCache;
 using QS::Data::Node;
+using QS::Data::SharedCache;
 using QS::Exception::QSException;
 using QS::StringUtils::FormatPath;
 using QS::Utils::AppendPathDelim;
@@ -88,12 +104,15 @@ using QS::Utils::GetProcessEffectiveUserID;
 using QS::Utils::GetProcessEffectiveGroupID;
 using QS::Utils::IsRootDirectory;
 using std::deque;
+using std::lock_guard;
 using std::make_shared;
 using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::stringstream;
 using std::to_string;
+using std::tuple;
+using std::unique_lock;
 using std::unique_ptr;
 using std::vector;
 using std::weak_ptr;
@@ -117,13 +136,83 @@ Drive::Drive()
   uint64_t cacheSize = static_cast<uint64_t>(
       QS::Configure::Options::Instance().GetMaxCacheSizeInMB() *
       QS::Data::Size::MB1);
-  m_cache = std::move(unique_ptr<Cache>(new Cache(cacheSize)));
+  uint64_t diskCacheSize = static_cast<uint64_t>(
+      QS::Configure::Options::Instance().GetMaxDiskCacheSizeInMB() *
+      QS::Data::Size::MB1);
+  m_cache =
+      std::move(unique_ptr<Cache>(new Cache(cacheSize, diskCacheSize)));
+  if (QS::Configure::Options::Instance().IsMemoryPressure()) {
+    // shrink cache under memory pressure of the cgroup
+    m_cache->SetMemoryPressure(MemoryPressure::Detect());
+  }
+  auto policyFile = QS::Configure::Options::Instance().GetCachePolicyFile();
+  if (!policyFile.empty()) {
+    unique_ptr<CachePolicy> policy(new CachePolicy);
+    auto outcome = policy->Load(policyFile);
+    if (!outcome.first) {
+      throw QSException(outcome.second);
+    }
+    DebugInfo("Load " + to_string(policy->GetNumRules()) +
+              " cache policy rules " + FormatPath(policyFile));
+    m_cache->SetCachePolicy(std::move(policy));
+  }
+  if (QS::Configure::Options::Instance().IsAdmissionFilter()) {
+    // track about as many files as the stats kept in memory
+    m_cache->SetFrequencySketch(unique_ptr<FrequencySketch>(
+        new FrequencySketch(static_cast<size_t>(
+            QS::Configure::Options::Instance().GetMaxStatCountInK() *
+            QS::Data::Size::K1))));
+  }
+  auto fileQuota = QS::Configure::Options::Instance().GetFileQuota();
+  if (QS::Configure::Options::Instance().IsFileQuotaInPercent()) {
+    m_cache->SetFileQuota(fileQuota, true);
+  } else {
+    m_cache->SetFileQuota(static_cast<uint64_t>(fileQuota) *
+                          QS::Data::Size::MB1);
+  }
+  auto sharedDir = QS::Configure::Options::Instance().GetSharedCacheDirectory();
+  if (!sharedDir.empty()) {
+    m_sharedCache = unique_ptr<SharedCache>(new SharedCache(
+        sharedDir, QS::Configure::Options::Instance().GetBucket(),
+        static_cast<uint64_t>(
+            QS::Configure::Options::Instance().GetMaxSharedCacheSizeInMB() *
+            QS::Data::Size::MB1)));
+  }
+  auto accessLog = QS::Configure::Options::Instance().GetAccessLogFile();
+  if (!accessLog.empty()) {
+    // keep more records than to warm up, as the heat changes over time
+    m_accessHistory = unique_ptr<AccessHistory>(new AccessHistory(
+        accessLog, static_cast<size_t>(
+                       QS::Configure::Options::Instance().GetMaxStatCountInK() *
+                       QS::Data::Size::K1)));
+    if (m_accessHistory->Load()) {
+      DebugInfo("Load " + to_string(m_accessHistory->GetNumRecords()) +
+                " access records " + FormatPath(accessLog));
+    }
+  }
+  if (QS::Configure::Options::Instance().IsKeepDiskCache()) {
+    auto diskfolder =
+        QS::Configure::Options::Instance().GetDiskCacheDirectory();
+    if (FileExists(diskfolder, false) && IsDirectory(diskfolder, true)) {
+      m_cache->LoadDiskCacheIndex(diskfolder);
+    }
+  }
 
   uid_t uid = GetProcessEffectiveUserID();
   gid_t gid = GetProcessEffectiveGroupID();
 
   m_directoryTree = unique_ptr<DirectoryTree>(new DirectoryTree(
       time(NULL), uid, gid, QS::Configure::Default::GetRootMode()));
+  auto negativeExpire =
+      QS::Configure::Options::Instance().GetNegativeExpireInSec();
+  if (negativeExpire > 0) {
+    m_negativeLookupCache = unique_ptr<NegativeLookupCache>(
+        new NegativeLookupCache(
+            static_cast<size_t>(
+                QS::Configure::Options::Instance().GetMaxStatCountInK() *
+                QS::Data::Size::K1),
+            negativeExpire));
+  }
 
   m_transferManager->SetClient(m_client);
 }
@@ -134,24 +223,40 @@ Drive::~Drive() { CleanUp(); }
 // --------------------------------------------------------------------------
 void Drive::CleanUp() {
   if (!m_cleanup) {
+    if (m_cache) {
+      Info("Cache hit ratios " + m_cache->GetTierHitRatios());
+    }
+    if (m_negativeLookupCache) {
+      Info("Negative lookup cache [hits:misses=" +
+           to_string(m_negativeLookupCache->GetHits()) + ":" +
+           to_string(m_negativeLookupCache->GetMisses()) + "]");
+    }
+    if (m_accessHistory) {
+      m_accessHistory->Save();
+    }
     // abort unfinished multipart uploads
     if (!m_unfinishedMultipartUploadHandles.empty()) {
       for (auto &fileToHandle : m_unfinishedMultipartUploadHandles) {
         m_transferManager->AbortMultipartUpload(fileToHandle.second);
       }
     }
-    // remove disk cache folder if existing
+    // remove disk cache folder if existing, or keep it for next mount
     auto diskfolder =
         QS::Configure::Options::Instance().GetDiskCacheDirectory();
     if (FileExists(diskfolder, false) &&
-        IsDirectory(diskfolder, true)) {         // log on
-      DeleteFilesInDirectory(diskfolder, true);  // delete folder itself
+        IsDirectory(diskfolder, true)) {  // log on
+      if (!(QS::Configure::Options::Instance().IsKeepDiskCache() && m_cache &&
+            m_cache->SaveDiskCacheIndex(diskfolder))) {
+        DeleteFilesInDirectory(diskfolder, true);  // delete folder itself
+      }
     }
 
     m_client.reset();
     m_transferManager.reset();
     m_cache.reset();
+    m_accessHistory.reset();
     m_directoryTree.reset();
+    m_negativeLookupCache.reset();
     m_unfinishedMultipartUploadHandles.clear();
 
     m_cleanup.store(true);
@@ -206,6 +311,56 @@ bool Drive::Connect() const {
   return true;
 }
 
+// --------------------------------------------------------------------------
+void Drive::WarmUp() {
+  auto num = QS::Configure::Options::Instance().GetWarmUpCount();
+  if (!m_accessHistory || num == 0) {
+    return;
+  }
+  auto records = m_accessHistory->GetHottest(num);
+  if (records.empty()) {
+    return;
+  }
+
+  auto DoWarmUp = [this, records] {
+    size_t numWarmed = 0;
+    for (auto &record : records) {
+      if (m_cleanup || !m_cache || !m_cache->HasFreeSpace(record.size)) {
+        break;
+      }
+      auto node = GetNode(record.path, false).first.lock();
+      if (!(node && *node) || node->IsDirectory() || node->IsNeedUpload()) {
+        continue;
+      }
+      auto fileSize = node->GetFileSize();
+      if (static_cast<uint64_t>(record.offset) >= fileSize) {
+        continue;
+      }
+      auto size = std::min<uint64_t>(record.size, fileSize - record.offset);
+      m_cache->AdoptDiskCacheFile(record.path, node->GetETag(), fileSize);
+      m_cache->Validate(record.path, node->GetETag(), fileSize);
+      auto rule = m_cache->GetCacheRule(record.path);
+      if (rule.noCache) {
+        continue;
+      }
+      auto ranges =
+          m_cache->GetUnloadedRanges(record.path, record.offset, size);
+      if (!ranges.empty()) {
+        DownloadFileContentRanges(record.path, ranges, node->GetMTime(), false);
+        ++numWarmed;
+      }
+      if (m_cache->HasFile(record.path) &&
+          m_cache->GetETag(record.path).empty()) {
+        m_cache->SetETag(record.path, node->GetETag(), fileSize);
+      }
+    }
+    DebugInfo("Warm up cache with " + to_string(numWarmed) + " files");
+  };
+  // a single task fetching one file after another, to leave the other
+  // transfer threads to the foreground reads
+  GetTransferManager()->GetExecutor()->Submit(DoWarmUp);
+}
+
 // --------------------------------------------------------------------------
 shared_ptr<Node> Drive::GetRoot() {
   if (!Connect()) {
@@ -240,6 +395,9 @@ pair<weak_ptr<Node>, bool> Drive::GetNode(const string &path,
         if (m_cache->HasFile(path)) {
           m_cache->Erase(path);
         }
+        if (m_negativeLookupCache) {
+          m_negativeLookupCache->Add(path);
+        }
       } else {
         DebugError(GetMessageForQSError(err));
       }
@@ -253,6 +411,12 @@ pair<weak_ptr<Node>, bool> Drive::GetNode(const string &path,
                                 expireDurationInMin)) {
       UpdateNode(path, node);
     }
+  } else if (!node && IsMissingInListedDir(path, expireDurationInMin)) {
+    // not existing as the dir listing is authoritative, skip the round trip
+    return {weak_ptr<Node>(), false};
+  } else if (m_negativeLookupCache && m_negativeLookupCache->Has(path)) {
+    // known not existing, skip the round trip
+    return {weak_ptr<Node>(), false};
   } else {
     auto err = GetClient()->Stat(path);  // head it
     if (IsGoodQSError(err)) {
@@ -260,6 +424,9 @@ pair<weak_ptr<Node>, bool> Drive::GetNode(const string &path,
     } else {
       if (err.GetError() == QSError::KEY_NOT_EXIST) {
         DebugInfo("File not exist " + FormatPath(path));
+        if (m_negativeLookupCache) {
+          m_negativeLookupCache->Add(path);
+        }
       } else {
         DebugError(GetMessageForQSError(err));
       }
@@ -291,6 +458,50 @@ pair<weak_ptr<Node>, bool> Drive::GetNode(const string &path,
   return {node, modified};
 }
 
+// --------------------------------------------------------------------------
+tuple<weak_ptr<Node>, bool, string> Drive::LookupNode(const string &path,
+                                                      bool updateIfDirectory,
+                                                      bool updateDirAsync) {
+  auto dirPath = path.empty() ? path : AppendPathDelim(path);
+  if (path == dirPath) {  // a dir path or an empty path
+    auto res = GetNode(path, updateIfDirectory, updateDirAsync);
+    return std::make_tuple(res.first, res.second, path);
+  }
+  // found in local dir tree, connect to object storage to update it
+  for (const auto &path_ : {path, dirPath}) {
+    if (m_directoryTree->Find(path_).lock()) {
+      auto res = GetNode(path_, updateIfDirectory, updateDirAsync);
+      return std::make_tuple(res.first, res.second, path_);
+    }
+  }
+
+  auto expireDurationInMin =
+      QS::Configure::Options::Instance().GetStatExpireInMin();
+  bool knownMissing =
+      IsMissingInListedDir(path, expireDurationInMin) ||
+      (m_negativeLookupCache && m_negativeLookupCache->Has(path) &&
+       m_negativeLookupCache->Has(dirPath));
+  if (!knownMissing) {
+    auto err = GetClient()->Lookup(path);
+    if (IsGoodQSError(err)) {
+      // the node is grown into the tree as a file or a dir, go on with
+      // GetNode to update the dir if needed
+      auto foundPath = m_directoryTree->Find(path).lock() ? path : dirPath;
+      auto res = GetNode(foundPath, updateIfDirectory, updateDirAsync);
+      return std::make_tuple(res.first, res.second, foundPath);
+    } else if (err.GetError() == QSError::KEY_NOT_EXIST) {
+      DebugInfo("File not exist " + FormatPath(path));
+      if (m_negativeLookupCache) {
+        m_negativeLookupCache->Add(path);
+        m_negativeLookupCache->Add(dirPath);
+      }
+    } else {
+      DebugError(GetMessageForQSError(err));
+    }
+  }
+  return std::make_tuple(weak_ptr<Node>(), false, dirPath);
+}
+
 // --------------------------------------------------------------------------
 weak_ptr<Node> Drive::GetNodeSimple(const string &path) {
   return m_directoryTree->Find(path);
@@ -366,6 +577,9 @@ void Drive::HardLink(const string &filePath, const string &hardlinkPath) {
     return;
   }
 
+  if (m_negativeLookupCache) {
+    m_negativeLookupCache->Erase(hardlinkPath);
+  }
   m_directoryTree->HardLink(filePath, hardlinkPath);
 }
 
@@ -397,6 +611,9 @@ void Drive::MakeFile(const string &filePath, mode_t mode, dev_t dev) {
     }
 
     DebugInfo("Create file " + FormatPath(filePath));
+    if (m_negativeLookupCache) {
+      m_negativeLookupCache->Erase(filePath);
+    }
 
     // QSClient::MakeFile doesn't update directory tree (refer it for details)
     // with the created file node, So we call Stat synchronizely.
@@ -424,6 +641,9 @@ void Drive::MakeDir(const string &dirPath, mode_t mode) {
   }
 
   DebugInfo("Create dir " + FormatPath(dirPath));
+  if (m_negativeLookupCache) {
+    m_negativeLookupCache->Erase(dirPath);
+  }
 
   // QSClient::MakeDirectory doesn't grow directory tree with the created dir
   // node, So we call Stat synchronizely.
@@ -433,9 +653,7 @@ void Drive::MakeDir(const string &dirPath, mode_t mode) {
 
 // --------------------------------------------------------------------------
 void Drive::OpenFile(const string &filePath, bool async) {
-  auto res = GetNode(filePath, false);
-  auto node = res.first.lock();
-  bool modified = res.second;
+  auto node = GetNode(filePath, false).first.lock();
 
   if (!(node && *node)) {
     DebugWarning("File not exist " + FormatPath(filePath));
@@ -443,19 +661,35 @@ void Drive::OpenFile(const string &filePath, bool async) {
   }
 
   auto fileSize = node->GetFileSize();
+  m_cache->RecordAccess(filePath);
+  m_cache->AdoptDiskCacheFile(filePath, node->GetETag(), fileSize);
+  m_cache->Validate(filePath, node->GetETag(), fileSize);
+  // share content of the cached object with same etag instead of downloading
+  m_cache->ShareContent(filePath, node->GetETag(), fileSize, node->GetMTime());
+  // file content is prefetched as specified by cache policy, unless it's
+  // not admitted into cache
+  auto rule = m_cache->GetCacheRule(filePath);
+  uint64_t prefetchSize = std::min<uint64_t>(rule.prefetchSize, fileSize);
+  if (rule.noCache || !m_cache->Admit(filePath, prefetchSize)) {
+    prefetchSize = 0;
+  }
   assert(fileSize >= 0);
   if (fileSize == 0) {
     m_cache->Write(filePath, 0, 0, NULL, time(NULL));
-  } else if (fileSize > 0) {
-    bool fileContentExist = m_cache->HasFileData(filePath, 0, fileSize);
-    if (!fileContentExist || modified) {
-      auto ranges = m_cache->GetUnloadedRanges(filePath, 0, fileSize);
+  } else if (prefetchSize > 0) {
+    bool fileContentExist = m_cache->HasFileData(filePath, 0, prefetchSize);
+    if (!fileContentExist) {
+      auto ranges = m_cache->GetUnloadedRanges(filePath, 0, prefetchSize);
       if (!ranges.empty()) {
         time_t mtime = node->GetMTime();
         DownloadFileContentRanges(filePath, ranges, mtime, async);
       }
     }
   }
+  if (!node->IsNeedUpload() && m_cache->HasFile(filePath) &&
+      m_cache->GetETag(filePath).empty()) {
+    m_cache->SetETag(filePath, node->GetETag(), fileSize);
+  }
 
   node->SetFileOpen(true);
   m_cache->SetFileOpen(filePath, true);
@@ -464,9 +698,7 @@ void Drive::OpenFile(const string &filePath, bool async) {
 // --------------------------------------------------------------------------
 size_t Drive::ReadFile(const string &filePath, off_t offset, size_t size,
                        char *buf) {
-  auto res = GetNode(filePath, false);
-  auto node = res.first.lock();
-  bool modified = res.second;
+  auto node = GetNode(filePath, false).first.lock();
 
   if (!(node && *node)) {
     DebugWarning("File not exist " + FormatPath(filePath));
@@ -490,13 +722,26 @@ size_t Drive::ReadFile(const string &filePath, off_t offset, size_t size,
     return 0;
   }
 
-  time_t mtime = node->GetMTime();
-  if (mtime > m_cache->GetTime(filePath)) {
-    m_cache->Erase(filePath);
+  if (m_accessHistory &&
+      m_accessHistory->Record(filePath, offset, downloadSize)) {
+    // write history file out of the read path
+    GetClient()->GetExecutor()->Submit([this] { m_accessHistory->Save(); });
   }
-  // Download file if not found in cache or if cache need update
+  m_cache->AdoptDiskCacheFile(filePath, node->GetETag(), fileSize);
+  // Cache is erased if the object content changed
+  m_cache->Validate(filePath, node->GetETag(), fileSize);
+  time_t mtime = node->GetMTime();
+  m_cache->ShareContent(filePath, node->GetETag(), fileSize, mtime);
+  auto rule = m_cache->GetCacheRule(filePath);
+  // Read through without caching, unless file is modified in cache
+  bool readThrough = !m_cache->HasFile(filePath) &&
+                     (rule.noCache || !m_cache->Admit(filePath, downloadSize));
+  // Download file if not found in cache
   bool fileContentExist = m_cache->HasFileData(filePath, offset, downloadSize);
-  if (!fileContentExist || modified) {
+  if (!fileContentExist && !readThrough) {
+    fileContentExist = ReadSharedCache(node, filePath, offset, downloadSize);
+  }
+  if (!fileContentExist) {
     // download synchronizely for request file part
     auto stream = make_shared<IOStream>(downloadSize);
     auto handle =
@@ -508,6 +753,11 @@ size_t Drive::ReadFile(const string &filePath, off_t offset, size_t size,
       if (handle->DoneTransfer() && !handle->HasFailedParts()) {
         DebugInfo("Download file [offset:len=" + to_string(offset) + ":" +
                   to_string(downloadSize) + "] " + FormatPath(filePath));
+        if (readThrough) {
+          stream->seekg(0, std::ios_base::beg);
+          stream->read(buf, downloadSize);
+          return stream->gcount();
+        }
 
         bool success = m_cache->Write(filePath, offset, downloadSize,
                                       std::move(stream), mtime);
@@ -515,21 +765,29 @@ size_t Drive::ReadFile(const string &filePath, off_t offset, size_t size,
                      "Fail to write cache [offset:len=" + to_string(offset) +
                          ":" + to_string(downloadSize) + "] " +
                          FormatPath(filePath));
+        if (success && !node->IsNeedUpload() &&
+            m_cache->GetETag(filePath).empty()) {
+          m_cache->SetETag(filePath, node->GetETag(), fileSize);
+        }
       }
     }
   }
 
-  // download asynchronously for unloaded part
-  if (remainingSize > 0) {
-    auto ranges = m_cache->GetUnloadedRanges(filePath, 0, fileSize);
+  // download asynchronously for unloaded part as specified by cache policy
+  if (remainingSize > 0 && !readThrough && rule.prefetchSize > 0) {
+    auto ranges =
+        rule.prefetchSize == QS::Data::kPrefetchWhole
+            ? m_cache->GetUnloadedRanges(filePath, 0, fileSize)
+            : m_cache->GetUnloadedRanges(
+                  filePath, offset + downloadSize,
+                  std::min<uint64_t>(rule.prefetchSize, remainingSize));
     if (!ranges.empty()) {
       DownloadFileContentRanges(filePath, ranges, mtime, true);
     }
   }
 
   // Read from cache
-  auto outcome = m_cache->Read(filePath, offset, downloadSize, buf, mtime);
-  return std::get<0>(outcome);
+  return m_cache->Read(filePath, offset, downloadSize, buf, 0, nullptr);
 }
 
 // --------------------------------------------------------------------------
@@ -551,6 +809,12 @@ void Drive::RenameFile(const string &filePath, const string &newFilePath) {
 
   // Update meta(such as mtime, .etc)
   if (IsGoodQSError(err)) {
+    if (m_negativeLookupCache) {
+      m_negativeLookupCache->Erase(newFilePath);
+    }
+    // new file may be not in the listing of its dir yet
+    m_directoryTree->SetDirectoryListed(GetDirName(newFilePath),
+                                        vector<string>(), false);
     auto res = GetNode(newFilePath, false);
     auto node = res.first.lock();
     if (node) {
@@ -599,6 +863,15 @@ void Drive::RenameDir(const string &dirPath, const string &newDirPath,
       if (m_directoryTree) {
         m_directoryTree->Remove(dirPath);
       }
+      // the paths under new dir may be cached as not existing
+      if (m_negativeLookupCache) {
+        m_negativeLookupCache->Clear();
+      }
+      // new dir may be not in the listing of its dir yet
+      if (m_directoryTree) {
+        m_directoryTree->SetDirectoryListed(GetDirName(newDirPath),
+                                            vector<string>(), false);
+      }
 
       // Add new dir node to dir tree
       auto res = GetNode(newDirPath, true, false);  // update dir sync
@@ -623,6 +896,36 @@ void Drive::RenameDir(const string &dirPath, const string &newDirPath,
   }
 }
 
+// --------------------------------------------------------------------------
+void Drive::ShareFile(const string &filePath, bool async) {
+  if (!m_sharedCache) {
+    return;
+  }
+  if (async) {
+    // copying the whole content takes long, so keep it off the fuse thread
+    GetTransferManager()->GetExecutor()->Submit(
+        [this, filePath] { ShareFile(filePath, false); });
+    return;
+  }
+  auto node = GetNodeSimple(filePath).lock();
+  if (!(node && *node) || node->IsNeedUpload()) {
+    return;
+  }
+  auto eTag = node->GetETag();
+  auto fileSize = node->GetFileSize();
+  // only share the complete content of object
+  if (eTag.empty() || fileSize == 0 || m_cache->GetETag(filePath) != eTag ||
+      !m_cache->HasFileData(filePath, 0, fileSize) ||
+      m_sharedCache->Has(filePath, eTag, fileSize)) {
+    return;
+  }
+  m_sharedCache->Store(filePath, eTag, fileSize,
+                       [this, &filePath](off_t offset, size_t len, char *buf) {
+                         return m_cache->Read(filePath, offset, len, buf, 0,
+                                              nullptr);
+                       });
+}
+
 // --------------------------------------------------------------------------
 // Symbolic link is a file that contains a reference to another file or dir
 // in the form of an absolute path (in qsfs) or relative path and that affects
@@ -638,6 +941,9 @@ void Drive::SymLink(const string &filePath, const string &linkPath) {
   }
 
   DebugInfo("Create symlink " + FormatPath(filePath, linkPath));
+  if (m_negativeLookupCache) {
+    m_negativeLookupCache->Erase(linkPath);
+  }
 
   // QSClient::Symlink doesn't update directory tree (refer it for details)
   // with the created symlink node, So we call Stat synchronizely.
@@ -666,27 +972,42 @@ void Drive::TruncateFile(const string &filePath, size_t newSize) {
         "Truncate file [oldsize:newsize=" + to_string(node->GetFileSize()) +
         ":" + to_string(newSize) + "]" + FormatPath(filePath));
     m_cache->Resize(filePath, newSize, time(NULL));
+    m_cache->SetETag(filePath, string(), 0);  // modified locally
     node->SetFileSize(newSize);
     node->SetNeedUpload(true);
   }
 }
 
 // --------------------------------------------------------------------------
-void Drive::UploadFile(const string &filePath, bool async) {
+void Drive::UploadFile(const string &filePath, bool async, bool release) {
   auto res = GetNode(filePath, false);
   auto node = res.first.lock();
 
   if (!(node && *node)) {
     DebugWarning("File not exist " + FormatPath(filePath));
+    if (!release) {
+      lock_guard<std::mutex> lock(m_writebackMutex);
+      m_writebackFiles.erase(filePath);
+      m_writebackDone.notify_all();
+    }
     return;
   }
 
-  auto Callback = [this, node,
-                   filePath](const shared_ptr<TransferHandle> &handle) {
+  if (!release) {
+    // writes from now on make the file need upload again
+    node->SetNeedUpload(false);
+  }
+  // writes from now on are not known to be uploaded
+  auto dirtyGeneration = m_cache->GetDirtyGeneration(filePath);
+  auto Callback = [this, node, filePath, release,
+                   dirtyGeneration](const shared_ptr<TransferHandle> &handle) {
+    bool uploaded = false;
     if (handle) {
-      node->SetNeedUpload(false);
-      node->SetFileOpen(false);
-      m_cache->SetFileOpen(filePath, false);
+      if (release) {
+        node->SetNeedUpload(false);
+        node->SetFileOpen(false);
+        m_cache->SetFileOpen(filePath, false);
+      }
       if (handle->IsMultipart()) {
         m_unfinishedMultipartUploadHandles.emplace(handle->GetObjectKey(),
                                                    handle);
@@ -696,19 +1017,35 @@ void Drive::UploadFile(const string &filePath, bool async) {
 
       if (handle->DoneTransfer() && !handle->HasFailedParts()) {
         DebugInfo("Upload file " + FormatPath(filePath));
-        // update meta mtime
-        auto err = GetClient()->Stat(handle->GetObjectKey());
-        if (IsGoodQSError(err)) {
-          // update cache mtime
-          auto node = GetNodeSimple(handle->GetObjectKey()).lock();
-          if (node && *node) {
-            m_cache->SetTime(handle->GetObjectKey(), node->GetMTime());
+        uploaded = true;
+        // the file written during writeback is still dirty, and its local
+        // meta data should not be overwritten by the uploaded one
+        if (release || !node->IsNeedUpload()) {
+          // update meta mtime
+          auto err = GetClient()->Stat(handle->GetObjectKey());
+          if (IsGoodQSError(err)) {
+            // update cache mtime
+            auto node = GetNodeSimple(handle->GetObjectKey()).lock();
+            if (node && *node &&
+                m_cache->SetUploadedETag(handle->GetObjectKey(),
+                                         node->GetETag(), node->GetFileSize(),
+                                         dirtyGeneration)) {
+              m_cache->SetTime(handle->GetObjectKey(), node->GetMTime());
+            }
+          } else {
+            DebugErrorIf(!IsGoodQSError(err), GetMessageForQSError(err));
           }
-        } else {
-          DebugErrorIf(!IsGoodQSError(err), GetMessageForQSError(err));
         }
       }
     }
+    if (!release) {
+      if (!uploaded) {
+        node->SetNeedUpload(true);  // upload it again when release
+      }
+      lock_guard<std::mutex> lock(m_writebackMutex);
+      m_writebackFiles.erase(filePath);
+      m_writebackDone.notify_all();
+    }
   };
 
   auto fileSize = node->GetFileSize();
@@ -754,8 +1091,32 @@ int Drive::WriteFile(const string &filePath, off_t offset, size_t size,
     return 0;
   }
 
-  bool success = m_cache->Write(filePath, offset, size, buf, time(NULL));
+  auto &options = QS::Configure::Options::Instance();
+  auto capacity = m_cache->GetCapacity();
+  auto dirtyBackgroundLimit =
+      capacity * options.GetDirtyBackgroundRatio() / 100;
+  auto dirtyLimit = capacity * options.GetDirtyRatio() / 100;
+  auto dirtySize = m_cache->GetDirtySize();
+  if (dirtySize > dirtyBackgroundLimit) {
+    WritebackDirtyFiles(filePath, dirtySize - dirtyBackgroundLimit);
+  }
+  if (dirtySize > dirtyLimit) {
+    WaitForWriteback(dirtyLimit);
+  }
+
+  bool success =
+      m_cache->Write(filePath, offset, size, buf, time(NULL), true);
+  if (!success && m_cache->GetDirtySize() > 0) {
+    // the cache is full of dirty files, write them back to make space
+    DebugWarning("No space in cache, wait for dirty files written back " +
+                 FormatPath(filePath));
+    WritebackDirtyFiles(filePath, m_cache->GetDirtySize());
+    WaitForWriteback(0);
+    success =
+        m_cache->Write(filePath, offset, size, buf, time(NULL), true);
+  }
   if (success) {
+    m_cache->SetETag(filePath, string(), 0);  // modified locally
     node->SetNeedUpload(true);
     if (offset + size > node->GetFileSize()) {
       node->SetFileSize(offset + size);
@@ -765,11 +1126,54 @@ int Drive::WriteFile(const string &filePath, off_t offset, size_t size,
   return success ? size : 0;
 }
 
+// --------------------------------------------------------------------------
+void Drive::WritebackDirtyFiles(const string &fileBeingWritten,
+                                uint64_t size) {
+  auto files = m_cache->GetDirtyFiles(size, fileBeingWritten);
+  bool async = !QS::Configure::Options::Instance().IsQsfsSingleThread();
+  for (auto &file : files) {
+    {
+      lock_guard<std::mutex> lock(m_writebackMutex);
+      if (!m_writebackFiles.insert(file).second) {
+        continue;  // in progress
+      }
+    }
+    DebugInfo("Write back dirty file " + FormatPath(file));
+    UploadFile(file, async, false);
+  }
+}
+
+// --------------------------------------------------------------------------
+void Drive::WaitForWriteback(uint64_t dirtyLimit) {
+  unique_lock<std::mutex> lock(m_writebackMutex);
+  // the dirty size is also decreased by removing or truncating files, so
+  // check it periodically besides being notified
+  while (!m_writebackFiles.empty() && m_cache->GetDirtySize() > dirtyLimit) {
+    m_writebackDone.wait_for(lock, std::chrono::milliseconds(100));
+  }
+}
+
+// --------------------------------------------------------------------------
+bool Drive::IsMissingInListedDir(const string &path,
+                                 int32_t expireDurationInMin) const {
+  if (IsRootDirectory(path)) {
+    return false;
+  }
+  auto dirNode = m_directoryTree->Find(GetDirName(path)).lock();
+  if (!(dirNode && *dirNode)) {
+    return false;
+  }
+  auto listedTime = dirNode->GetListedTime();
+  return listedTime > 0 &&
+         !QS::TimeUtils::IsExpire(listedTime, expireDurationInMin);
+}
+
 // --------------------------------------------------------------------------
 void Drive::DownloadFileContentRanges(const string &filePath,
                                       const ContentRangeDeque &ranges,
                                       time_t mtime, bool async) {
-  auto DownloadRange = [this, filePath, async,
+  auto node = GetNodeSimple(filePath).lock();
+  auto DownloadRange = [this, node, filePath, async,
                         mtime](const pair<off_t, size_t> &range) {
     off_t offset = range.first;
     size_t size = range.second;
@@ -789,6 +1193,12 @@ void Drive::DownloadFileContentRanges(const string &filePath,
         if (downloadSize_ <= 0) {
           break;
         }
+        // read from shared cache synchronously, which is local
+        if (node && ReadSharedCache(node, filePath, offset_, downloadSize_)) {
+          downloadedSize += downloadSize_;
+          remainingSize -= downloadSize_;
+          continue;
+        }
 
         auto stream_ = make_shared<IOStream>(downloadSize_);
         auto Callback = [this, filePath, offset_, downloadSize_, stream_,
@@ -829,5 +1239,32 @@ void Drive::DownloadFileContentRanges(const string &filePath,
   }
 }
 
+// --------------------------------------------------------------------------
+bool Drive::ReadSharedCache(const shared_ptr<Node> &node,
+                            const string &filePath, off_t offset, size_t len) {
+  if (!m_sharedCache || len == 0 || node->IsNeedUpload()) {
+    return false;
+  }
+  auto eTag = node->GetETag();
+  auto fileSize = node->GetFileSize();
+  if (eTag.empty()) {
+    return false;
+  }
+  vector<char> buf(len);
+  if (m_sharedCache->Read(filePath, eTag, fileSize, offset, len, &buf[0]) !=
+      len) {
+    return false;
+  }
+  bool success =
+      m_cache->Write(filePath, offset, len, &buf[0], node->GetMTime());
+  DebugErrorIf(!success, "Fail to write cache [offset:len=" +
+                             to_string(offset) + ":" + to_string(len) + "] " +
+                             FormatPath(filePath));
+  if (success && m_cache->GetETag(filePath).empty()) {
+    m_cache->SetETag(filePath, eTag, fileSize);
+  }
+  return success;
+}
+
 }  // namespace FileSystem
 }  // namespace QS
@@ -30,14 +30,19 @@ namespace FileSystem {
 namespace HelpText {
 
 using QS::Configure::Default::GetDefaultCredentialsFile;
+using QS::Configure::Default::GetDefaultDirtyBackgroundRatio;
+using QS::Configure::Default::GetDefaultDirtyRatio;
 using QS::Configure::Default::GetDefaultDiskCacheDirectory;
 using QS::Configure::Default::GetDefaultLogDirectory;
+using QS::Configure::Default::GetDefaultNegativeExpireInSec;
 using QS::Configure::Default::GetDefaultHostName;
 using QS::Configure::Default::GetDefaultProtocolName;
 using QS::Configure::Default::GetDefaultParallelTransfers;
 using QS::Configure::Default::GetDefaultTransferBufSize;
 using QS::Configure::Default::GetDefaultZone;
 using QS::Configure::Default::GetMaxCacheSize;
+using QS::Configure::Default::GetMaxDiskCacheSize;
+using QS::Configure::Default::GetMaxSharedCacheSize;
 using QS::Configure::Default::GetMaxListObjectsCount;
 using QS::Configure::Default::GetMaxStatCount;
 using QS::Configure::Default::GetTransactionDefaultTimeDuration;
@@ -81,13 +86,57 @@ void ShowQSFSHelp() {
   "                     Default value is " << to_string(GetTransactionDefaultTimeDuration())
                                           << " milliseconds\n"
   "  -Z, --maxcache     Max in-memory cache size(MB) for files, default is "
-                        << to_string(GetMaxCacheSize() / QS::Data::Size::MB1) << "MB\n"
+                        << to_string(GetMaxCacheSize() / QS::Data::Size::MB1) << "MB;\n"
+  "                     The cache shrinks when the cgroup v2 memory limit is near or\n"
+  "                     the memory pressure is high, and grows back up to this size\n"
+  "  -Y, --maxdiskcache Max disk cache size(MB) for files, pages evicted from the\n"
+  "                     in-memory cache are moved into disk cache directory, and the\n"
+  "                     hot ones are moved back; Default is " << to_string(GetMaxDiskCacheSize() / QS::Data::Size::MB1)
+                                          << " which disables it\n"
   "  -D, --diskdir      Specify the directory to store file data when in-memory cache\n"
   "                     is not availabe, default is " << GetDefaultDiskCacheDirectory() << "\n"
+  "  -k, --keepcache    Keep file data in disk cache directory when unmounting, and\n"
+  "                     reuse it at next mount after validating it with the ETag\n"
+  "  -O, --directio     Use direct io (O_DIRECT) for disk cache files to bypass the\n"
+  "                     kernel page cache\n"
+  "  -x, --compress     Compress cold file data in memory cache before spilling it\n"
+  "                     to disk cache directory\n"
+  "  -A, --admission    Admit file data into a full cache only if the file is accessed\n"
+  "                     more frequently than the one to be discarded, otherwise read\n"
+  "                     it through, to keep large scans from flushing the cache\n"
+  "  -E, --mempressure  Shrink the in-memory cache when the cgroup of qsfs nears its\n"
+  "                     memory limit or is under memory pressure, and grow it back to\n"
+  "                     max cache size when the pressure subsides\n"
+  "  -y, --cachepolicy  Specify the cache policy file of path pattern rules, one rule\n"
+  "                     per line as \"<pattern> <action> ...\", actions are pin,\n"
+  "                     nocache, prefetch=<size[K|M|G]|whole> and tier=<memory|disk>,\n"
+  "                     e.g. \"*.idx pin\", \"/video/** nocache\"; Default is none\n"
+  "  -X, --sharedcache  Specify the directory to share file data with other qsfs\n"
+  "                     processes on the host, e.g. /dev/shm/qsfs_shared/ for shared\n"
+  "                     memory; Default is none which disables it\n"
+  "  -M, --maxsharedcache Max shared cache size(MB), default is "
+                        << to_string(GetMaxSharedCacheSize() / QS::Data::Size::MB1) << "MB\n"
+  "  -j, --accesslog    Specify the file to log file accesses with their heat across\n"
+  "                     mounts; Default is none which disables it\n"
+  "  -J, --warmup       Num of hottest files in access log to prefetch in background\n"
+  "                     at mount, default is 0 which disables it\n"
+  "  -q, --filequota    Max cache size of a single file, in MB, or in percent of max\n"
+  "                     cache size with suffix '%', e.g. 25%; a file beyond it drops\n"
+  "                     its own least recently read data instead of other files;\n"
+  "                     Default is 0 which disables it\n"
+  "  -w, --dirtyratio   Max size of file data written but not uploaded yet, in percent\n"
+  "                     of max cache size, writers wait for it to be uploaded above\n"
+  "                     this, default is " << to_string(GetDefaultDirtyRatio()) << "%\n"
+  "  -W, --dirtybgratio Start uploading files in background when the size of file\n"
+  "                     data not uploaded yet is above this percent of max cache\n"
+  "                     size, default is " << to_string(GetDefaultDirtyBackgroundRatio()) << "%\n"
   "  -t, --maxstat      Max count(K) of cached stat entrys, default is "
                         << to_string(GetMaxStatCount() / QS::Data::Size::K1) << "K\n"
   "  -e, --statexpire   Expire time(minutes) for stat entries, negative value will\n"
   "                     disable stat expire, default is no expire\n"
+  "  -g, --negexpire    Expire time(seconds) for caching the paths not existing, to\n"
+  "                     save the round trips of probing them again, 0 will disable\n"
+  "                     it, default is " << to_string(GetDefaultNegativeExpireInSec()) << "s\n"
   "  -i, --maxlist      Max count of files of ls operation, negative value will list\n"
   "                     all files, default is " << to_string(GetMaxListObjectsCount()) <<"\n"
   "  -n, --numtransfer  Max number file tranfers to run in parallel, you can increase\n"
@@ -125,8 +174,17 @@ void ShowQSFSUsage() {
   "       [-c|--credentials=[file path]] [-z|--zone=[value]]\n"
   "       [-l|--logdir=[dir]] [-L|--loglevel=[INFO|WARN|ERROR|FATAL]] \n"
   "       [-r|--retries=[value]] [-R|reqtimeout=[value]]\n"
-  "       [-Z|--maxcache=[value]] [-D|--diskdir=[value]]\n"
+  "       [-Z|--maxcache=[value]] [-Y|--maxdiskcache=[value]]\n"
+  "       [-D|--diskdir=[value]] [-k|--keepcache]\n"
+  "       [-O|--directio] [-x|--compress] [-A|--admission]\n"
+  "       [-E|--mempressure]\n"
+  "       [-y|--cachepolicy=[file]]\n"
+  "       [-X|--sharedcache=[dir]] [-M|--maxsharedcache=[value]]\n"
+  "       [-j|--accesslog=[file]] [-J|--warmup=[value]]\n"
+  "       [-q|--filequota=[value[%]]]\n"
+  "       [-w|--dirtyratio=[value]] [-W|--dirtybgratio=[value]]\n"
   "       [-t|--maxstat=[value]] [-e|--statexpire=[value]]\n"
+  "       [-g|--negexpire=[value]]\n"
   "       [-i|--maxlist=[value]]\n"
   "       [-n|--numtransfer=[value]] [-u|--bufsize=value]]\n"
   "       [-H|--host=[value]] [-p|--protocol=[value]]\n"
@@ -199,28 +199,12 @@ pair<weak_ptr<Node>, string> GetFileSimple(const char* path) {
 //          - 3rd member is the path maybe appended with "/"
 //
 // Note: GetFile will connect to object storage to retrive the object and
-// update the local dir tree if the object is modified.
+// update the local dir tree if the object is modified. A path not found in
+// the local dir tree is resolved as a file or a dir with one request.
 tuple<weak_ptr<Node>, bool, string> GetFile(const char* path,
                                             bool updateIfIsDir = false,
                                             bool updateDirAsync = false) {
-  auto& drive = Drive::Instance();
-  auto out = GetFileSimple(path);
-  if (out.first.lock()) {  // found node in local dir tree
-    // connect to object storage to update file
-    auto path_ = out.second;
-    auto res = drive.GetNode(path_, updateIfIsDir, updateDirAsync);
-    return std::make_tuple(res.first, res.second, path_);
-  } else {  // not found in local dir tree
-    // connect to object storage to retrive file
-    string appendPath = path;
-    auto res = drive.GetNode(path, updateIfIsDir, updateDirAsync);
-    auto node = res.first.lock();
-    if (!node && string(path).back() != '/') {
-      appendPath = AppendPathDelim(path);
-      res = drive.GetNode(appendPath, updateIfIsDir, updateDirAsync);
-    }
-    return std::make_tuple(res.first, res.second, appendPath);
-  }
+  return Drive::Instance().LookupNode(path, updateIfIsDir, updateDirAsync);
 }
 
 }  // namespace
@@ -1263,6 +1247,10 @@ int qsfs_release(const char* path, struct fuse_file_info* fi) {
         Error(err.get());
         return -EAGAIN;  // Try again
       }
+    } else {
+      // Share the file content with other mounts on the host
+      bool async = !QS::Configure::Options::Instance().IsQsfsSingleThread();
+      Drive::Instance().ShareFile(path_, async);
     }
   } catch (const QSException& err) {
     Error(err.get());
@@ -1475,7 +1463,13 @@ void* qsfs_init(struct fuse_conn_info* conn) {
   // before fuse_main will exit when the process goes into the background.
   QS::Threading::ThreadPoolInitializer::Instance().DoInitialize();
 
-  return static_cast<QS::FileSystem::Drive *>(fuse_get_context()->private_data);
+  auto drive =
+      static_cast<QS::FileSystem::Drive *>(fuse_get_context()->private_data);
+  if (drive != nullptr) {
+    // prefetch the hottest files of the last mounts
+    drive->WarmUp();
+  }
+  return drive;
 }
 
 // --------------------------------------------------------------------------
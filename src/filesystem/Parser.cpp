@@ -19,8 +19,10 @@
 #include <assert.h>
 #include <stddef.h>  // for offsetof
 #include <stdint.h>
+#include <stdlib.h>  // for strtol
 #include <string.h>  // for strdup
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -44,17 +46,22 @@ namespace {
 
 using QS::Configure::Default::GetClientDefaultPoolSize;
 using QS::Configure::Default::GetDefaultCredentialsFile;
+using QS::Configure::Default::GetDefaultDirtyBackgroundRatio;
+using QS::Configure::Default::GetDefaultDirtyRatio;
 using QS::Configure::Default::GetDefaultDiskCacheDirectory;
 using QS::Configure::Default::GetDefaultLogDirectory;
 using QS::Configure::Default::GetDefaultLogLevelName;
 using QS::Configure::Default::GetDefaultHostName;
 using QS::Configure::Default::GetDefaultMaxRetries;
+using QS::Configure::Default::GetDefaultNegativeExpireInSec;
 using QS::Configure::Default::GetDefaultPort;
 using QS::Configure::Default::GetDefaultProtocolName;
 using QS::Configure::Default::GetDefaultParallelTransfers;
 using QS::Configure::Default::GetDefaultTransferBufSize;
 using QS::Configure::Default::GetDefaultZone;
 using QS::Configure::Default::GetMaxCacheSize;
+using QS::Configure::Default::GetMaxDiskCacheSize;
+using QS::Configure::Default::GetMaxSharedCacheSize;
 using QS::Configure::Default::GetMaxListObjectsCount;
 using QS::Configure::Default::GetMaxStatCount;
 using QS::Configure::Default::GetTransactionDefaultTimeDuration;
@@ -80,10 +87,25 @@ static struct options {
   int retries = GetDefaultMaxRetries();
   int32_t reqtimeout = GetTransactionDefaultTimeDuration();    // in ms
   int32_t maxcache = GetMaxCacheSize() / QS::Data::Size::MB1;  // in MB
+  int32_t maxdiskcache = GetMaxDiskCacheSize() / QS::Data::Size::MB1;  // in MB
   const char *diskdir;
+  int keepcache = 0;           // default not keep disk cache
+  int directio = 0;            // default buffered io for disk cache
+  int compress = 0;            // default not compress cache
+  int admission = 0;           // default admit all files into cache
+  int mempressure = 0;         // default fixed max cache size
+  const char *cachepolicy;
+  const char *sharedcache;
+  int32_t maxsharedcache = GetMaxSharedCacheSize() / QS::Data::Size::MB1;
+  const char *accesslog;
+  const char *filequota;       // MB or percent of cache with suffix '%'
+  int32_t warmup = 0;          // default not warm up cache
+  int dirtyratio = GetDefaultDirtyRatio();  // in percent of max cache
+  int dirtybgratio = GetDefaultDirtyBackgroundRatio();  // in percent
   int32_t maxstat = GetMaxStatCount() / QS::Data::Size::K1;    // in K
   int32_t maxlist = GetMaxListObjectsCount();  // max file count for ls
   int32_t statexpire = -1;    // in mins, negative value disable state expire
+  int32_t negexpire = GetDefaultNegativeExpireInSec();  // in secs
   int numtransfer = GetDefaultParallelTransfers();
   int32_t bufsize = GetDefaultTransferBufSize() / QS::Data::Size::MB1;  // in MB
   int threads = GetClientDefaultPoolSize();
@@ -114,10 +136,26 @@ static const struct fuse_opt optionSpec[] = {
     OPTION("-r=%i", retries),        OPTION("--retries=%i",     retries),
     OPTION("-R=%li", reqtimeout),    OPTION("--reqtimeout=%li", reqtimeout),
     OPTION("-Z=%li", maxcache),      OPTION("--maxcache=%li",   maxcache),
+    OPTION("-Y=%li", maxdiskcache),  OPTION("--maxdiskcache=%li", maxdiskcache),
     OPTION("-D=%s",  diskdir),       OPTION("--diskdir=%s",     diskdir),
+    OPTION("-k",     keepcache),     OPTION("--keepcache",      keepcache),
+    OPTION("-O",     directio),      OPTION("--directio",       directio),
+    OPTION("-x",     compress),      OPTION("--compress",       compress),
+    OPTION("-A",     admission),     OPTION("--admission",      admission),
+    OPTION("-E",     mempressure),   OPTION("--mempressure",    mempressure),
+    OPTION("-y=%s", cachepolicy),    OPTION("--cachepolicy=%s", cachepolicy),
+    OPTION("-X=%s", sharedcache),    OPTION("--sharedcache=%s", sharedcache),
+    OPTION("-M=%li", maxsharedcache),
+    OPTION("--maxsharedcache=%li", maxsharedcache),
+    OPTION("-j=%s", accesslog),      OPTION("--accesslog=%s",   accesslog),
+    OPTION("-J=%i", warmup),         OPTION("--warmup=%i",      warmup),
+    OPTION("-q=%s", filequota),      OPTION("--filequota=%s",   filequota),
+    OPTION("-w=%i", dirtyratio),     OPTION("--dirtyratio=%i",  dirtyratio),
+    OPTION("-W=%i", dirtybgratio),   OPTION("--dirtybgratio=%i", dirtybgratio),
     OPTION("-t=%li", maxstat),       OPTION("--maxstat=%li",    maxstat),
     OPTION("-i=%li", maxlist),       OPTION("--maxlist=%li",    maxlist),
     OPTION("-e=%li", statexpire),    OPTION("--statexpire=%li", statexpire),
+    OPTION("-g=%i", negexpire),      OPTION("--negexpire=%i",   negexpire),
     OPTION("-n=%i",  numtransfer),   OPTION("--numtransfer=%i", numtransfer),
     OPTION("-u=%li", bufsize),       OPTION("--bufsize=%li",    bufsize),
     OPTION("-T=%i", threads),        OPTION("--threads=%i",     threads),
@@ -152,6 +190,10 @@ void Parse(int argc, char **argv) {
   options.logDirectory   = strdup(GetDefaultLogDirectory().c_str());
   options.logLevel       = strdup(GetDefaultLogLevelName().c_str());
   options.diskdir        = strdup(GetDefaultDiskCacheDirectory().c_str());
+  options.cachepolicy    = strdup("");
+  options.sharedcache    = strdup("");
+  options.accesslog      = strdup("");
+  options.filequota      = strdup("0");
   options.host           = strdup(GetDefaultHostName().c_str());
   options.protocol       = strdup(GetDefaultProtocolName().c_str());
   options.addtionalAgent = strdup("");
@@ -191,7 +233,73 @@ void Parse(int argc, char **argv) {
     qsOptions.SetMaxCacheSizeInMB(options.maxcache);
   }
 
+  if (options.maxdiskcache < 0) {
+    PrintWarnMsg("-Y|--maxdiskcache", options.maxdiskcache,
+                 GetMaxDiskCacheSize() / QS::Data::Size::MB1);
+    qsOptions.SetMaxDiskCacheSizeInMB(GetMaxDiskCacheSize() /
+                                      QS::Data::Size::MB1);
+  } else {
+    qsOptions.SetMaxDiskCacheSizeInMB(options.maxdiskcache);
+  }
+
   qsOptions.SetDiskCacheDirectory(options.diskdir);
+  qsOptions.SetKeepDiskCache(options.keepcache != 0);
+  qsOptions.SetDiskDirectIO(options.directio != 0);
+  qsOptions.SetCompressCache(options.compress != 0);
+  qsOptions.SetAdmissionFilter(options.admission != 0);
+  qsOptions.SetMemoryPressure(options.mempressure != 0);
+  qsOptions.SetCachePolicyFile(options.cachepolicy);
+  qsOptions.SetSharedCacheDirectory(options.sharedcache);
+  if (options.maxsharedcache <= 0) {
+    PrintWarnMsg("-M|--maxsharedcache", options.maxsharedcache,
+                 GetMaxSharedCacheSize() / QS::Data::Size::MB1);
+    qsOptions.SetMaxSharedCacheSizeInMB(GetMaxSharedCacheSize() /
+                                        QS::Data::Size::MB1);
+  } else {
+    qsOptions.SetMaxSharedCacheSizeInMB(options.maxsharedcache);
+  }
+  qsOptions.SetAccessLogFile(options.accesslog);
+  if (options.warmup < 0) {
+    PrintWarnMsg("-J|--warmup", options.warmup, 0);
+    qsOptions.SetWarmUpCount(0);
+  } else {
+    qsOptions.SetWarmUpCount(options.warmup);
+  }
+  {
+    char *end = nullptr;
+    auto filequota = strtol(options.filequota, &end, 10);
+    bool inPercent = end != options.filequota && *end == '%';
+    if (inPercent) {
+      ++end;
+    }
+    if (end == options.filequota || *end != '\0' || filequota < 0 ||
+        (inPercent && filequota > 100)) {
+      std::cerr << "[qsfs] invalid parameter in option -q|--filequota="
+                << options.filequota << ", 0 is used" << std::endl;
+      qsOptions.SetFileQuota(0, false);
+    } else {
+      qsOptions.SetFileQuota(static_cast<uint32_t>(filequota), inPercent);
+    }
+  }
+
+  if (options.dirtyratio <= 0 || options.dirtyratio > 100) {
+    PrintWarnMsg("-w|--dirtyratio", options.dirtyratio,
+                 GetDefaultDirtyRatio());
+    qsOptions.SetDirtyRatio(GetDefaultDirtyRatio());
+  } else {
+    qsOptions.SetDirtyRatio(options.dirtyratio);
+  }
+
+  if (options.dirtybgratio <= 0 ||
+      options.dirtybgratio >= qsOptions.GetDirtyRatio()) {
+    auto dirtybgratio =
+        std::min<int>(GetDefaultDirtyBackgroundRatio(),
+                      qsOptions.GetDirtyRatio() / 2);
+    PrintWarnMsg("-W|--dirtybgratio", options.dirtybgratio, dirtybgratio);
+    qsOptions.SetDirtyBackgroundRatio(dirtybgratio);
+  } else {
+    qsOptions.SetDirtyBackgroundRatio(options.dirtybgratio);
+  }
 
   if (options.maxstat <= 0) {
     PrintWarnMsg("-t|--maxstat", options.maxstat,
@@ -203,6 +311,13 @@ void Parse(int argc, char **argv) {
 
   qsOptions.SetMaxListCount(options.maxlist);
   qsOptions.SetStatExpireInMin(options.statexpire);
+  if (options.negexpire < 0) {
+    PrintWarnMsg("-g|--negexpire", options.negexpire,
+                 GetDefaultNegativeExpireInSec());
+    qsOptions.SetNegativeExpireInSec(GetDefaultNegativeExpireInSec());
+  } else {
+    qsOptions.SetNegativeExpireInSec(options.negexpire);
+  }
 
   if (options.numtransfer <= 0) {
     PrintWarnMsg("-n|--numtransfer", options.numtransfer,
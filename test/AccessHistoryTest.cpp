@@ -0,0 +1,132 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include <stdio.h>  // for remove
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "base/Logging.h"
+#include "base/Utils.h"
+#include "data/AccessHistory.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::ofstream;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using ::testing::Test;
+
+// default log dir
+static const char *defaultLogDir = "/tmp/qsfs.test.logs/";
+// access history file
+static const char *historyFile = "/tmp/qsfs.test.accesshistory";
+void InitLog() {
+  QS::Utils::CreateDirectoryIfNotExistsNoLog(defaultLogDir);
+  QS::Logging::InitializeLogging(
+      unique_ptr<QS::Logging::Log>(new QS::Logging::DefaultLog(defaultLogDir)));
+  EXPECT_TRUE(QS::Logging::GetLogInstance() != nullptr)
+      << "log instance is null";
+}
+
+class AccessHistoryTest : public Test {
+ protected:
+  static void SetUpTestCase() { InitLog(); }
+
+  void SetUp() override { remove(historyFile); }
+
+  void TearDown() override { remove(historyFile); }
+
+  void TestRecord() {
+    AccessHistory history(historyFile, 2);
+    EXPECT_FALSE(history.Load());
+    history.Record("/a", 100, 10);
+    history.Record("/a", 0, 10);  // within a second, count once
+    history.Record("/b", 0, 10);
+    EXPECT_EQ(history.GetNumRecords(), 2u);
+
+    auto records = history.GetHottest(10);
+    ASSERT_EQ(records.size(), 2u);
+    for (auto &record : records) {
+      EXPECT_GT(record.heat, 0.9);
+      EXPECT_LE(record.heat, 1.0);
+      if (record.path == "/a") {
+        // range covers all accesses
+        EXPECT_EQ(record.offset, 0);
+        EXPECT_EQ(record.size, 110u);
+      }
+    }
+    EXPECT_EQ(history.GetHottest(1).size(), 1u);
+
+    // no more than max num of records
+    history.Record("/c", 0, 10);
+    EXPECT_EQ(history.GetNumRecords(), 2u);
+  }
+
+  void TestSaveAndLoad() {
+    auto now = time(NULL);
+    {
+      ofstream out(historyFile);
+      out << "2 " << now << " 0 10 /warm\n"
+          << "invalid line\n"
+          << "8 " << now << " 5 20 /hot file\n"
+          << "1 " << now << " 0 10 /cold\n";
+    }
+    AccessHistory history(historyFile, 2);
+    EXPECT_TRUE(history.Load());
+    // coldest record is pruned
+    EXPECT_EQ(history.GetNumRecords(), 2u);
+    auto records = history.GetHottest(2);
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].path, "/hot file");
+    EXPECT_EQ(records[0].offset, 5);
+    EXPECT_EQ(records[0].size, 20u);
+    EXPECT_EQ(records[1].path, "/warm");
+
+    // new record replaces the coldest one
+    history.Record("/new", 0, 10);
+    EXPECT_EQ(history.GetNumRecords(), 2u);
+    EXPECT_TRUE(history.Save());
+    AccessHistory history2(historyFile, 10);
+    EXPECT_TRUE(history2.Load());
+    EXPECT_EQ(history2.GetNumRecords(), 2u);
+    records = history2.GetHottest(10);
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].path, "/hot file");
+    EXPECT_EQ(records[1].path, "/new");
+  }
+};
+
+TEST_F(AccessHistoryTest, Record) { TestRecord(); }
+
+TEST_F(AccessHistoryTest, SaveAndLoad) { TestSaveAndLoad(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
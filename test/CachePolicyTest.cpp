@@ -0,0 +1,156 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include <stdint.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "base/Logging.h"
+#include "base/Utils.h"
+#include "data/CachePolicy.h"
+#include "data/Size.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::ofstream;
+using std::string;
+using std::unique_ptr;
+using ::testing::Test;
+
+// default log dir
+static const char *defaultLogDir = "/tmp/qsfs.test.logs/";
+// cache policy file
+static const char *policyFile = "/tmp/qsfs.test.cachepolicy";
+void InitLog() {
+  QS::Utils::CreateDirectoryIfNotExistsNoLog(defaultLogDir);
+  QS::Logging::InitializeLogging(
+      unique_ptr<QS::Logging::Log>(new QS::Logging::DefaultLog(defaultLogDir)));
+  EXPECT_TRUE(QS::Logging::GetLogInstance() != nullptr)
+      << "log instance is null";
+}
+
+class CachePolicyTest : public Test {
+ protected:
+  static void SetUpTestCase() { InitLog(); }
+
+  void TestMatchPattern() {
+    EXPECT_TRUE(CachePolicy::MatchPattern("*.idx", "/search/a.idx"));
+    EXPECT_TRUE(CachePolicy::MatchPattern("*.idx", "/a.idx"));
+    EXPECT_FALSE(CachePolicy::MatchPattern("*.idx", "/search/a.idx.bak"));
+    EXPECT_TRUE(CachePolicy::MatchPattern("a?.log", "/logs/a1.log"));
+    EXPECT_FALSE(CachePolicy::MatchPattern("a?.log", "/logs/a12.log"));
+
+    EXPECT_TRUE(CachePolicy::MatchPattern("/video/**", "/video/a.mp4"));
+    EXPECT_TRUE(CachePolicy::MatchPattern("/video/**", "/video/2018/a.mp4"));
+    EXPECT_FALSE(CachePolicy::MatchPattern("/video/**", "/videos/a.mp4"));
+    EXPECT_TRUE(CachePolicy::MatchPattern("/video/*", "/video/a.mp4"));
+    EXPECT_FALSE(CachePolicy::MatchPattern("/video/*", "/video/2018/a.mp4"));
+    EXPECT_TRUE(CachePolicy::MatchPattern("/data/**/*.idx", "/data/x/y.idx"));
+    EXPECT_FALSE(CachePolicy::MatchPattern("/data/**/*.idx", "/data/y.txt"));
+    // pattern with '/' is matched from root
+    EXPECT_TRUE(CachePolicy::MatchPattern("models/*.bin", "/models/m.bin"));
+    EXPECT_FALSE(CachePolicy::MatchPattern("models/*.bin", "/a/models/m.bin"));
+  }
+
+  void TestAddRule() {
+    CachePolicy policy;
+    EXPECT_TRUE(policy.AddRule("*.idx pin tier=memory").first);
+    EXPECT_TRUE(policy.AddRule("/video/ nocache").first);
+    EXPECT_TRUE(policy.AddRule("/models/** prefetch=whole").first);
+    EXPECT_TRUE(policy.AddRule("/logs/** prefetch=4M tier=disk").first);
+    EXPECT_TRUE(policy.AddRule("# comment").first);
+    EXPECT_TRUE(policy.AddRule("   ").first);
+    EXPECT_EQ(policy.GetNumRules(), 4u);
+
+    EXPECT_FALSE(policy.AddRule("*.idx").first);
+    EXPECT_FALSE(policy.AddRule("*.idx pinned").first);
+    EXPECT_FALSE(policy.AddRule("*.idx prefetch=4X").first);
+    EXPECT_FALSE(policy.AddRule("*.idx tier=ssd").first);
+    EXPECT_EQ(policy.GetNumRules(), 4u);
+
+    auto rule1 = policy.Match("/search/a.idx");
+    EXPECT_TRUE(rule1.pin);
+    EXPECT_FALSE(rule1.noCache);
+    EXPECT_TRUE(rule1.tier == CacheTier::Memory);
+    auto rule2 = policy.Match("/video/2018/a.mp4");
+    EXPECT_TRUE(rule2.noCache);
+    EXPECT_FALSE(rule2.pin);
+    auto rule3 = policy.Match("/logs/a.log");
+    EXPECT_EQ(rule3.prefetchSize, 4 * Size::MB1);
+    EXPECT_TRUE(rule3.tier == CacheTier::Disk);
+    // the first matching rule applies
+    auto rule4 = policy.Match("/video/a.idx");
+    EXPECT_TRUE(rule4.pin);
+    EXPECT_FALSE(rule4.noCache);
+    // default rule
+    auto rule5 = policy.Match("/a.txt");
+    EXPECT_FALSE(rule5.pin);
+    EXPECT_FALSE(rule5.noCache);
+    EXPECT_EQ(rule5.prefetchSize, kPrefetchWhole);
+    EXPECT_TRUE(rule5.tier == CacheTier::Default);
+  }
+
+  void TestLoad() {
+    {
+      ofstream os(policyFile);
+      os << "# search index\n"
+         << "*.idx pin\n"
+         << "\n"
+         << "/video/** nocache\n";
+    }
+    CachePolicy policy;
+    auto res = policy.Load(policyFile);
+    EXPECT_TRUE(res.first) << res.second;
+    EXPECT_EQ(policy.GetNumRules(), 2u);
+
+    {
+      ofstream os(policyFile);
+      os << "*.log prefetch=0\n"
+         << "/video/** stream\n";
+    }
+    // rules are kept if policy file is invalid
+    res = policy.Load(policyFile);
+    EXPECT_FALSE(res.first);
+    EXPECT_NE(res.second.find("line 2"), string::npos) << res.second;
+    EXPECT_EQ(policy.GetNumRules(), 2u);
+    EXPECT_TRUE(policy.Match("/a.idx").pin);
+    QS::Utils::RemoveFileIfExists(policyFile);
+
+    EXPECT_FALSE(policy.Load(policyFile).first);
+  }
+};
+
+TEST_F(CachePolicyTest, MatchPattern) { TestMatchPattern(); }
+
+TEST_F(CachePolicyTest, AddRule) { TestAddRule(); }
+
+TEST_F(CachePolicyTest, Load) { TestLoad(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
@@ -16,8 +16,14 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <functional>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -25,13 +31,22 @@
 
 #include "base/Logging.h"
 #include "base/Utils.h"
+#include "configure/Options.h"
 #include "data/Cache.h"
+#include "data/CachePolicy.h"
+#include "data/DiskCacheIndex.h"
+#include "data/DiskFile.h"
+#include "data/FrequencySketch.h"
+#include "data/MemoryPressure.h"
+#include "data/Size.h"
 
 namespace QS {
 
 namespace Data {
 
 using std::make_shared;
+using std::ofstream;
+using std::string;
 using std::stringstream;
 using std::vector;
 using std::unique_ptr;
@@ -406,6 +421,522 @@ class CacheTest : public Test {
     vector<char> arr4{'0', '1'};
     EXPECT_EQ(buf4, arr4);
   }
+
+  // --------------------------------------------------------------------------
+  void TestReadSlices() {
+    uint64_t cacheCap = 6;
+    Cache cache(cacheCap);
+
+    constexpr const char *page1 = "012";
+    constexpr size_t len1 = strlen(page1);
+    cache.Write("file1", 0, len1, page1, 0);
+    cache.SetFileOpen("file1", true);
+    constexpr const char *page2 = "abc";
+    constexpr size_t len2 = strlen(page2);
+    constexpr size_t holeLen = 2;
+    off_t off2 = len1 + holeLen;
+    cache.Write("file1", off2, len2, page2, 0);
+    constexpr const char *page3 = "ABC";
+    constexpr size_t len3 = strlen(page3);
+    off_t off3 = off2 + len2;
+    cache.Write("file1", off3, len3, page3, 0);  // stored in disk file
+
+    FileSliceVec slices;
+    EXPECT_EQ(cache.ReadSlices("file1", 1, off3 + len3, &slices),
+              len1 - 1 + len2 + len3);
+    ASSERT_EQ(slices.size(), 4u);
+    EXPECT_EQ(string(slices[0].data, slices[0].len), "12");
+    EXPECT_TRUE(slices[1].data == nullptr && slices[1].diskFile == nullptr);
+    EXPECT_EQ(slices[1].len, holeLen);
+    EXPECT_EQ(string(slices[2].data, slices[2].len), page2);
+    EXPECT_TRUE(slices[3].data == nullptr && slices[3].diskFile != nullptr);
+    vector<char> buf(len3);
+    EXPECT_EQ(slices[3].diskFile->Read(slices[3].offset, len3, &buf[0]), len3);
+    EXPECT_EQ(string(buf.begin(), buf.end()), page3);
+
+    // replace page with a stream
+    cache.Write("file1", off2, len2, make_shared<stringstream>("xyz"), 0);
+    slices.clear();
+    EXPECT_EQ(cache.ReadSlices("file1", off2, len2, &slices), len2);
+    ASSERT_EQ(slices.size(), 1u);
+    EXPECT_EQ(string(slices[0].data, slices[0].len), "xyz");
+    cache.Write("file1", off2, len2, page2, 0);
+
+    slices.clear();
+    EXPECT_EQ(cache.ReadSlices("file2", 0, len1, &slices), 0u);
+    EXPECT_TRUE(slices.empty());
+
+    vector<char> buf1(off3 + len3, 'x');
+    EXPECT_EQ(cache.Read("file1", 0, buf1.size(), &buf1[0], 0, nullptr),
+              len1 + len2 + len3);
+    EXPECT_EQ(string(buf1.begin(), buf1.end()),
+              string("012\0\0abcABC", off3 + len3));
+  }
+
+  // --------------------------------------------------------------------------
+  void TestReadBenchmark() {
+    constexpr size_t fileSize = 16 * Size::MB1;
+    Cache cache(fileSize);
+    vector<char> data(Size::MB1, 'a');
+    for (size_t off = 0; off < fileSize; off += data.size()) {
+      cache.Write("file1", off, data.size(), &data[0], 0);
+    }
+
+    auto Bench = [&cache, fileSize](const char *name, size_t readSize,
+                          const std::function<size_t(off_t, char *)> &read) {
+      constexpr size_t totalSize = 256 * Size::MB1;
+      vector<char> buf(readSize);
+      auto start = std::chrono::steady_clock::now();
+      size_t readed = 0;
+      for (size_t i = 0; i < totalSize / readSize; ++i) {
+        off_t off = (i * readSize) % fileSize;
+        readed += read(off, &buf[0]);
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      EXPECT_EQ(readed, totalSize);
+      std::ostringstream key;
+      key << name << " " << readSize / Size::KB1 << "KB MB/s";
+      RecordProperty(key.str(),
+                     static_cast<int>(totalSize / Size::MB1 / elapsed.count()));
+    };
+
+    FileSliceVec slices;
+    for (auto readSize : {Size::KB4, Size::MB1}) {
+      Bench("ReadSlices (copy)", readSize, [&](off_t off, char *buf) {
+        slices.clear();
+        auto readed = cache.ReadSlices("file1", off, readSize, &slices);
+        for (auto &slice : slices) {  // all in memory
+          memcpy(buf + (slice.offset - off), slice.data, slice.len);
+        }
+        return readed;
+      });
+      Bench("Read (no alloc)", readSize, [&](off_t off, char *buf) {
+        return cache.Read("file1", off, readSize, buf, 0, nullptr);
+      });
+      Bench("ReadSlices", readSize, [&](off_t off, char *buf) {
+        slices.clear();
+        return cache.ReadSlices("file1", off, readSize, &slices);
+      });
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  void TestValidate() {
+    uint64_t cacheCap = 100;
+    Cache cache(cacheCap);
+    constexpr const char *data = "0123456789";
+    const size_t len = strlen(data);
+
+    EXPECT_TRUE(cache.Validate("file1", "etag1", len));  // not in cache
+    cache.Write("file1", 0, len, data, 1);
+    EXPECT_TRUE(cache.Validate("file1", "etag1", len));  // not keyed yet
+    cache.SetETag("file1", "etag1", len);
+    cache.SetTime("file1", 2);  // only mtime changed
+    EXPECT_TRUE(cache.Validate("file1", "etag1", len));
+    EXPECT_TRUE(cache.HasFileData("file1", 0, len));
+    EXPECT_FALSE(cache.Validate("file1", "etag1", len + 1));
+    EXPECT_FALSE(cache.HasFile("file1"));
+    EXPECT_EQ(cache.GetSize(), 0u);
+
+    cache.Write("file1", 0, len, data, 1);
+    cache.SetETag("file1", "etag1", len);
+    EXPECT_FALSE(cache.Validate("file1", "etag2", len));
+    EXPECT_FALSE(cache.HasFile("file1"));
+
+    cache.Write("file1", 0, len, data, 1);
+    cache.SetETag("file1", string(), 0);  // modified locally
+    EXPECT_TRUE(cache.Validate("file1", "etag2", len));
+    EXPECT_TRUE(cache.HasFileData("file1", 0, len));
+  }
+
+  // --------------------------------------------------------------------------
+  void TestCompress() {
+    constexpr size_t len = 64 * 1024;
+    string text;
+    while (text.size() < len) {
+      text += "2018-01-01 00:00:00 INFO request " +
+              std::to_string(text.size() % 1000) + " done\n";
+    }
+    text.resize(len);
+    uint64_t cacheCap = len + len / 2;
+    Cache cache(cacheCap);
+
+    cache.Write("file1", 0, len, text.c_str(), 0);
+    EXPECT_EQ(cache.GetSize(), len);
+    // file1 is compressed instead of being discarded
+    EXPECT_TRUE(cache.Compress(len, "file2"));
+    cache.Write("file2", 0, len, text.c_str(), 0);
+    EXPECT_TRUE(cache.HasFileData("file1", 0, len));
+    EXPECT_LT(cache.GetSize(), cacheCap);
+    EXPECT_LT(cache.Find("file1")->second->GetCachedSize(), len);
+
+    vector<char> buf(len);
+    EXPECT_EQ(cache.Read("file2", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(string(buf.begin(), buf.end()), text);
+    EXPECT_EQ(cache.GetTierStats().memory, len);
+    // file1 is decompressed on hit, and file2 is freed for it
+    EXPECT_EQ(cache.Read("file1", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(string(buf.begin(), buf.end()), text);
+    EXPECT_EQ(cache.GetTierStats().compressed, len);
+    EXPECT_EQ(cache.Find("file1")->second->GetCachedSize(), len);
+    EXPECT_EQ(cache.GetSize(), len);
+    EXPECT_FALSE(cache.HasFile("file2"));
+    EXPECT_EQ(cache.Read("file1", len, len, &buf[0], 0, nullptr), 0u);
+    EXPECT_EQ(cache.GetTierHitRatios(),
+              "[memory: 33%] [compressed: 33%] [disk: 0%] [missed: 33%]");
+  }
+
+  // --------------------------------------------------------------------------
+  void TestAdaptCapacity() {
+    string cgroupDir = "/tmp/qsfs.test.cache.cgroup/";
+    QS::Utils::CreateDirectoryIfNotExistsNoLog(cgroupDir);
+    auto writeCgroupFile = [&cgroupDir](const string &name, uint64_t value) {
+      ofstream os(cgroupDir + name);
+      os << value << "\n";
+    };
+
+    constexpr size_t len = 1024;
+    uint64_t cacheCap = 4 * len;
+    Cache cache(cacheCap);
+    string text(len, 'a');
+    for (auto fileId : {"file1", "file2", "file3", "file4"}) {
+      cache.Write(fileId, 0, len, text.c_str(), 0);
+    }
+    EXPECT_EQ(cache.GetSize(), cacheCap);
+
+    // cgroup nears its memory limit, cache shrinks by 1/4 of capacity
+    writeCgroupFile("memory.current", 58 * len);
+    writeCgroupFile("memory.high", 64 * len);
+    cache.SetMemoryPressure(unique_ptr<MemoryPressure>(
+        new MemoryPressure(cgroupDir, cgroupDir + "memory.pressure")));
+    vector<char> buf(len);
+    EXPECT_EQ(cache.Read("file4", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(cache.GetCapacity(), cacheCap - len);
+    EXPECT_EQ(cache.GetSize(), cacheCap - len);
+    // the least recently used file is discarded
+    EXPECT_FALSE(cache.HasFile("file1"));
+    EXPECT_TRUE(cache.HasFile("file2"));
+  }
+
+  // --------------------------------------------------------------------------
+  void TestDirtyFiles() {
+    uint64_t cacheCap = 100;
+    Cache cache(cacheCap);
+    cache.Write("file1", 0, 10, string(10, 'a').c_str(), 0, true);
+    cache.Write("file2", 0, 10, string(10, 'b').c_str(), 0);  // downloaded
+    cache.Write("file3", 0, 20, string(20, 'c').c_str(), 0, true);
+    cache.Write("file3", 10, 20, string(20, 'd').c_str(), 0, true);
+    EXPECT_EQ(cache.GetDirtySize(), 40u);
+    EXPECT_EQ(cache.GetSize(), 50u);
+    vector<char> buf(30);
+    EXPECT_EQ(cache.Read("file3", 0, 30, &buf[0], 0, nullptr), 30u);
+    EXPECT_EQ(string(buf.begin(), buf.end()),
+              string(10, 'c') + string(20, 'd'));
+
+    // least recently used first
+    vector<string> files1{"file1"};
+    EXPECT_EQ(cache.GetDirtyFiles(10, ""), files1);
+    vector<string> files2{"file1", "file3"};
+    EXPECT_EQ(cache.GetDirtyFiles(11, ""), files2);
+    vector<string> files3{"file3"};
+    EXPECT_EQ(cache.GetDirtyFiles(40, "file1"), files3);
+
+    // dirty files are not discarded
+    EXPECT_FALSE(cache.Free(cacheCap, ""));
+    EXPECT_TRUE(cache.HasFile("file1"));
+    EXPECT_FALSE(cache.HasFile("file2"));
+    EXPECT_TRUE(cache.HasFile("file3"));
+
+    cache.Resize("file3", 5, 0);
+    EXPECT_EQ(cache.GetDirtySize(), 15u);
+    cache.Resize("file3", 15, 0);  // fill hole
+    EXPECT_EQ(cache.GetDirtySize(), 25u);
+    // written during uploading, kept dirty
+    auto generation = cache.GetDirtyGeneration("file1");
+    cache.Write("file1", 5, 5, string(5, 'e').c_str(), 0, true);
+    EXPECT_FALSE(cache.SetUploadedETag("file1", "etag0", 10, generation));
+    EXPECT_TRUE(cache.GetETag("file1").empty());
+    EXPECT_EQ(cache.GetDirtySize(), 25u);
+    generation = cache.GetDirtyGeneration("file1");
+    EXPECT_TRUE(cache.SetUploadedETag("file1", "etag1", 10, generation));
+    EXPECT_EQ(cache.GetETag("file1"), "etag1");
+    EXPECT_EQ(cache.GetDirtySize(), 15u);
+    EXPECT_TRUE(cache.Free(cacheCap - 15, ""));
+    EXPECT_FALSE(cache.HasFile("file1"));
+
+    cache.Erase("file3");
+    EXPECT_EQ(cache.GetDirtySize(), 0u);
+    EXPECT_TRUE(cache.GetDirtyFiles(cacheCap, "").empty());
+  }
+
+  // --------------------------------------------------------------------------
+  void TestTwoTier() {
+    constexpr size_t len = 1024;
+    uint64_t cacheCap = 2 * len;
+    Cache cache(cacheCap, 2 * len);
+    string text1(len, 'a');
+    cache.Write("file1", 0, len, text1.c_str(), 0);
+    cache.Write("file2", 0, len, string(len, 'b').c_str(), 0);
+    cache.Write("file3", 0, len, string(len, 'c').c_str(), 0);
+    // file1 is demoted into disk tier instead of being discarded
+    EXPECT_TRUE(cache.HasFileData("file1", 0, len));
+    EXPECT_EQ(cache.GetSize(), cacheCap);
+    EXPECT_EQ(cache.GetDiskSize(), len);
+    EXPECT_EQ(cache.Find("file1")->second->GetDiskSize(), len);
+
+    vector<char> buf(len);
+    EXPECT_EQ(cache.Read("file1", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(string(buf.begin(), buf.end()), text1);
+    EXPECT_EQ(cache.Read("file1", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(cache.GetDiskSize(), len);
+    // hot page is promoted, and file2 is demoted for it
+    EXPECT_EQ(cache.Read("file1", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(string(buf.begin(), buf.end()), text1);
+    EXPECT_EQ(cache.Find("file1")->second->GetDiskSize(), 0u);
+    EXPECT_EQ(cache.Find("file2")->second->GetDiskSize(), len);
+    EXPECT_EQ(cache.GetSize(), cacheCap);
+    EXPECT_EQ(cache.GetDiskSize(), len);
+
+    // disk tier is full, disk pages of the least recently used file dropped
+    cache.Write("file4", 0, len, string(len, 'd').c_str(), 0);
+    EXPECT_EQ(cache.GetDiskSize(), 2 * len);
+    cache.Write("file5", 0, len, string(len, 'e').c_str(), 0);
+    EXPECT_FALSE(cache.HasFileData("file2", 0, len));
+    EXPECT_TRUE(cache.HasFileData("file1", 0, len));
+    EXPECT_TRUE(cache.HasFileData("file3", 0, len));
+    EXPECT_EQ(cache.GetDiskSize(), 2 * len);
+    EXPECT_EQ(cache.GetSize(), cacheCap);
+
+    cache.Erase("file1");
+    EXPECT_EQ(cache.GetDiskSize(), len);
+    cache.Erase("file3");
+    EXPECT_EQ(cache.GetDiskSize(), 0u);
+  }
+
+  // --------------------------------------------------------------------------
+  void TestCachePolicy() {
+    constexpr size_t len = 1024;
+    uint64_t cacheCap = 2 * len;
+    Cache cache(cacheCap, 2 * len);
+    unique_ptr<CachePolicy> policy(new CachePolicy);
+    EXPECT_TRUE(policy->AddRule("*.idx pin").first);
+    EXPECT_TRUE(policy->AddRule("/hot/ tier=memory").first);
+    EXPECT_TRUE(policy->AddRule("/cold/ tier=disk").first);
+    cache.SetCachePolicy(std::move(policy));
+
+    string text(len, 'a');
+    cache.Write("/a.idx", 0, len, text.c_str(), 0);
+    cache.Write("/hot/b", 0, len, text.c_str(), 0);
+    EXPECT_TRUE(cache.Find("/a.idx")->second->IsPinned());
+    EXPECT_FALSE(cache.Find("/hot/b")->second->IsPinned());
+    // file of disk tier is stored in disk file directly
+    cache.Write("/cold/c", 0, len, text.c_str(), 0);
+    EXPECT_TRUE(cache.Find("/cold/c")->second->UseDiskFile());
+    EXPECT_EQ(cache.GetSize(), cacheCap);
+    EXPECT_EQ(cache.GetDiskSize(), len);
+
+    // neither pinned file nor file of memory tier is demoted
+    cache.Write("/d", 0, len, text.c_str(), 0);
+    EXPECT_TRUE(cache.HasFileData("/a.idx", 0, len));
+    EXPECT_EQ(cache.Find("/a.idx")->second->GetDiskSize(), 0u);
+    EXPECT_FALSE(cache.HasFile("/hot/b"));
+    EXPECT_EQ(cache.GetSize(), cacheCap);
+
+    // pinned file is never discarded
+    EXPECT_FALSE(cache.Free(cacheCap, ""));
+    EXPECT_TRUE(cache.HasFile("/a.idx"));
+    EXPECT_FALSE(cache.HasFile("/d"));
+    EXPECT_EQ(cache.GetSize(), len);
+
+    // rule is applied again when renamed
+    cache.Rename("/a.idx", "/a.txt");
+    EXPECT_FALSE(cache.Find("/a.txt")->second->IsPinned());
+    EXPECT_TRUE(cache.Free(cacheCap, ""));
+    EXPECT_EQ(cache.Find("/a.txt")->second->GetDiskSize(), len);
+    EXPECT_EQ(cache.GetSize(), 0u);
+    cache.Erase("/a.txt");
+    EXPECT_EQ(cache.GetDiskSize(), 0u);
+  }
+
+  // --------------------------------------------------------------------------
+  void TestDiskSpaceAccounting() {
+    Cache cache(1024);
+    auto diskfolder =
+        QS::Configure::Options::Instance().GetDiskCacheDirectory();
+    EXPECT_TRUE(QS::Utils::CreateDirectoryIfNotExists(diskfolder));
+    EXPECT_TRUE(cache.HasFreeDiskSpace(diskfolder, 0));
+    auto freeSpace = cache.m_diskFreeSpace;
+    EXPECT_GT(freeSpace, 0u);
+
+    // bytes added into disk cache are taken from free space without statvfs
+    cache.m_diskSize += freeSpace;
+    EXPECT_FALSE(cache.HasFreeDiskSpace(diskfolder, 0));
+    cache.m_diskSize -= freeSpace;
+    EXPECT_TRUE(cache.HasFreeDiskSpace(diskfolder, 0));
+
+    // free space is checked again after the interval
+    cache.m_diskSize += freeSpace;
+    cache.m_diskSpaceCheckedTime = 0;
+    EXPECT_TRUE(cache.HasFreeDiskSpace(diskfolder, 0));
+    cache.m_diskSize -= freeSpace;
+  }
+
+  // --------------------------------------------------------------------------
+  void TestShareContent() {
+    constexpr size_t len = 1024;
+    Cache cache(4 * len);
+    string text(len, 'a');
+    cache.Write("/a", 0, len, text.c_str(), 0);
+    EXPECT_FALSE(cache.ShareContent("/b", "etag1", len, 0));  // no etag
+    cache.SetETag("/a", "etag1", len);
+    EXPECT_FALSE(cache.ShareContent("/b", "etag1", 2 * len, 0));
+    EXPECT_FALSE(cache.ShareContent("/b", "etag2", len, 0));
+    EXPECT_TRUE(cache.ShareContent("/b", "etag1", len, 0));
+    EXPECT_TRUE(cache.HasFileData("/b", 0, len));
+    EXPECT_EQ(cache.GetETag("/b"), "etag1");
+    EXPECT_EQ(cache.GetSize(), len);  // shared page is charged once
+    EXPECT_FALSE(cache.ShareContent("/b", "etag1", len, 0));  // has content
+
+    // modified file is not shared
+    cache.Write("/a", 0, 1, "b", 0);
+    cache.SetETag("/a", string(), 0);
+    EXPECT_FALSE(cache.ShareContent("/c", "etag1", len, 0));
+    EXPECT_EQ(cache.GetSize(), 2 * len);  // charge moves to the sole holder
+    vector<char> buf(len);
+    EXPECT_EQ(cache.Read("/b", 0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(string(&buf[0], len), text);
+
+    // content is indexed by renamed file
+    cache.Rename("/b", "/d");
+    EXPECT_TRUE(cache.ShareContent("/c", "etag1", len, 0));
+    EXPECT_EQ(cache.GetSize(), 2 * len);
+    cache.Erase("/d");
+    EXPECT_EQ(cache.GetSize(), 2 * len);  // charge moves on erase
+    EXPECT_TRUE(cache.HasFileData("/c", 0, len));
+    cache.Erase("/c");
+    EXPECT_FALSE(cache.ShareContent("/e", "etag1", len, 0));
+    EXPECT_EQ(cache.GetSize(), len);
+
+    // evicted file is removed from the index
+    cache.Write("/f", 0, len, text.c_str(), 0);
+    cache.SetETag("/f", "etag2", len);
+    ASSERT_EQ(cache.m_eTagIndex.size(), 1u);
+    EXPECT_EQ(cache.m_eTagIndex.begin()->second, "/f");
+    EXPECT_TRUE(cache.Free(3 * len, "/a"));
+    EXPECT_FALSE(cache.HasFile("/f"));
+    EXPECT_TRUE(cache.m_eTagIndex.empty());
+    EXPECT_FALSE(cache.ShareContent("/g", "etag2", len, 0));
+  }
+
+  // --------------------------------------------------------------------------
+  void TestAdmission() {
+    constexpr size_t len = 1024;
+    Cache cache(2 * len);
+    string text(len, 'a');
+    EXPECT_TRUE(cache.Admit("/a", len));  // admit all without sketch
+    cache.SetFrequencySketch(
+        unique_ptr<FrequencySketch>(new FrequencySketch(1024)));
+    cache.RecordAccess("/a");
+    cache.RecordAccess("/a");
+    cache.Write("/a", 0, len, text.c_str(), 0);
+    cache.RecordAccess("/b");
+    cache.Write("/b", 0, len, text.c_str(), 0);
+    EXPECT_TRUE(cache.Admit("/a", len));  // file in cache
+
+    // one-hit file does not displace the least recently used file
+    cache.RecordAccess("/c");
+    EXPECT_FALSE(cache.Admit("/c", len));
+    cache.RecordAccess("/c");
+    cache.RecordAccess("/c");
+    EXPECT_TRUE(cache.Admit("/c", len));
+
+    cache.RecordAccess("/b");
+    cache.RecordAccess("/b");
+    cache.RecordAccess("/b");
+    vector<char> buf(len);
+    cache.Read("/a", 0, len, &buf[0]);  // make /b least recent
+    EXPECT_FALSE(cache.Admit("/c", len));
+    cache.Erase("/b");
+    EXPECT_TRUE(cache.Admit("/c", len));  // free space
+  }
+
+  // --------------------------------------------------------------------------
+  void TestFileQuota() {
+    constexpr size_t len = 1024;
+    Cache cache(8 * len);
+    cache.SetFileQuota(50, true);
+    EXPECT_EQ(cache.GetFileQuota(), 4 * len);
+    string text(len, 'a');
+    cache.Write("/a", 0, len, text.c_str(), 0);
+    for (size_t i = 0; i < 8; ++i) {
+      EXPECT_TRUE(cache.Write("/b", i * len, len, text.c_str(), 0));
+    }
+    // file beyond quota recycles its own pages instead of other files
+    EXPECT_TRUE(cache.HasFileData("/a", 0, len));
+    EXPECT_FALSE(cache.HasFileData("/b", 0, 4 * len));
+    EXPECT_TRUE(cache.HasFileData("/b", 4 * len, 4 * len));
+    EXPECT_EQ(cache.GetSize(), 5 * len);
+
+    cache.SetFileQuota(0);
+    EXPECT_EQ(cache.GetFileQuota(), 0u);
+    EXPECT_TRUE(cache.Write("/b", 0, len, text.c_str(), 0));
+    EXPECT_EQ(cache.GetSize(), 6 * len);
+  }
+
+  // --------------------------------------------------------------------------
+  void TestKeepDiskFile() {
+    auto diskfolder =
+        QS::Configure::Options::Instance().GetDiskCacheDirectory();
+    constexpr const char *data = "0123456789";
+    const size_t len = strlen(data);
+    {
+      uint64_t cacheCap = 3;
+      Cache cache(cacheCap);
+      cache.Write("/dir/file1", 0, len, data, 1);  // stored in disk file
+      cache.Write("/dir/file2", 0, len, data, 1);  // modified locally
+      cache.SetETag("/dir/file1", "etag1", len);
+      EXPECT_TRUE(cache.SaveDiskCacheIndex(diskfolder));
+    }
+    {
+      uint64_t cacheCap = 3;
+      Cache cache(cacheCap);
+      EXPECT_TRUE(cache.LoadDiskCacheIndex(diskfolder));
+      EXPECT_FALSE(cache.HasFile("/dir/file1"));
+      EXPECT_FALSE(cache.AdoptDiskCacheFile("/dir/file2", "etag2", len));
+      EXPECT_TRUE(cache.AdoptDiskCacheFile("/dir/file1", "etag1", len));
+      EXPECT_TRUE(cache.HasFileData("/dir/file1", 0, len));
+      EXPECT_EQ(cache.GetSize(), 0u);
+      EXPECT_EQ(cache.GetETag("/dir/file1"), "etag1");
+      vector<char> buf(len);
+      cache.Read("/dir/file1", 0, len, &buf[0]);
+      EXPECT_EQ(string(buf.begin(), buf.end()), string(data));
+      EXPECT_TRUE(cache.SaveDiskCacheIndex(diskfolder));
+    }
+    {
+      uint64_t cacheCap = 3;
+      Cache cache(cacheCap);
+      EXPECT_TRUE(cache.LoadDiskCacheIndex(diskfolder));
+      // object changed since last mount
+      EXPECT_FALSE(cache.AdoptDiskCacheFile("/dir/file1", "etag3", len));
+      EXPECT_FALSE(cache.AdoptDiskCacheFile("/dir/file1", "etag1", len));
+      EXPECT_FALSE(cache.HasFile("/dir/file1"));
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  void TestDiskCacheBlockBitmap() {
+    uint64_t blockSize = 4;
+    uint64_t fileSize = 18;  // 5 blocks, the last one has 2 bytes
+    ContentRangeDeque ranges = {{0, 3}, {3, 3}, {9, 7}, {16, 2}};
+    auto blocks = DiskCacheIndex::BuildBlockBitmap(ranges, fileSize, blockSize);
+    vector<bool> expectBlocks{true, false, false, true, true};
+    EXPECT_EQ(blocks, expectBlocks);
+    ContentRangeDeque expectRanges = {{0, 4}, {12, 6}};
+    EXPECT_EQ(
+        DiskCacheIndex::BuildContentRanges(blocks, fileSize, blockSize),
+        expectRanges);
+  }
 };
 
 TEST_F(CacheTest, Default) { TestDefault(); }
@@ -422,6 +953,34 @@ TEST_F(CacheTest, Read) { TestRead(); }
 
 TEST_F(CacheTest, ReadDiskFile) { TestReadDiskFile(); }
 
+TEST_F(CacheTest, ReadSlices) { TestReadSlices(); }
+
+TEST_F(CacheTest, ReadBenchmark) { TestReadBenchmark(); }
+
+TEST_F(CacheTest, Validate) { TestValidate(); }
+
+TEST_F(CacheTest, Compress) { TestCompress(); }
+
+TEST_F(CacheTest, AdaptCapacity) { TestAdaptCapacity(); }
+
+TEST_F(CacheTest, DirtyFiles) { TestDirtyFiles(); }
+
+TEST_F(CacheTest, TwoTier) { TestTwoTier(); }
+
+TEST_F(CacheTest, CachePolicy) { TestCachePolicy(); }
+
+TEST_F(CacheTest, DiskSpaceAccounting) { TestDiskSpaceAccounting(); }
+
+TEST_F(CacheTest, ShareContent) { TestShareContent(); }
+
+TEST_F(CacheTest, Admission) { TestAdmission(); }
+
+TEST_F(CacheTest, FileQuota) { TestFileQuota(); }
+
+TEST_F(CacheTest, KeepDiskFile) { TestKeepDiskFile(); }
+
+TEST_F(CacheTest, DiskCacheBlockBitmap) { TestDiskCacheBlockBitmap(); }
+
 }  // namespace Data
 }  // namespace QS
 
@@ -14,6 +14,7 @@
 // | limitations under the License.
 // +-------------------------------------------------------------------------
 
+#include <malloc.h>
 #include <string.h>
 #include <time.h>
 
@@ -22,8 +23,10 @@
 
 #include <iostream>
 #include <memory>
+#include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -31,6 +34,7 @@
 #include "base/Utils.h"
 #include "data/Directory.h"
 #include "data/FileMetaData.h"
+#include "data/FileMetaDataManager.h"
 
 namespace {
 
@@ -140,6 +144,138 @@ shared_ptr<Node> NodeTest::pLinkNode(nullptr);
 unique_ptr<Node> NodeTest::pEmptyNode(nullptr);
 }  // namespace
 
+namespace QS {
+
+namespace Data {
+
+using std::vector;
+
+class DirectoryTreeTest : public Test {
+ protected:
+  static void SetUpTestCase() { InitLog(); }
+
+  void TestSetDirectoryListed() {
+    DirectoryTree tree(mtime_, uid_, gid_, fileMode_);
+    tree.Grow(BuildDefaultDirectoryMeta("/dir/", mtime_));
+    tree.Grow(make_shared<FileMetaData>("/dir/file1", 0, mtime_, mtime_,
+                                        uid_, gid_, fileMode_));
+    auto dir = tree.Find("/dir/").lock();
+    ASSERT_TRUE(dir && *dir);
+    EXPECT_EQ(dir->GetListedTime(), 0);
+
+    tree.SetDirectoryListed("/dir", vector<string>{"/dir/file1"}, true);
+    EXPECT_GT(dir->GetListedTime(), 0);
+    tree.SetDirectoryListed("/dir/", vector<string>(), false);
+    EXPECT_EQ(dir->GetListedTime(), 0);
+
+    // not listed completely if a child listed is not in the tree
+    tree.SetDirectoryListed("/dir/",
+                            vector<string>{"/dir/file1", "/dir/file2"}, true);
+    EXPECT_EQ(dir->GetListedTime(), 0);
+  }
+
+  void TestChildrenKeyedByPathName() {
+    DirectoryTree tree(mtime_, uid_, gid_, fileMode_);
+    tree.Grow(BuildDefaultDirectoryMeta("/dir/", mtime_));
+    tree.Grow(make_shared<FileMetaData>("/dir/file1", 0, mtime_, mtime_,
+                                        uid_, gid_, fileMode_));
+    tree.Grow(BuildDefaultDirectoryMeta("/dir/subdir/", mtime_));
+    tree.Grow(make_shared<FileMetaData>("/dir/subdir/file2", 0, mtime_,
+                                        mtime_, uid_, gid_, fileMode_));
+    auto dir = tree.Find("/dir/").lock();
+    ASSERT_TRUE(dir && *dir);
+    EXPECT_EQ(dir->GetChildren().count(PathName::Find("/dir/file1")), 1U);
+    EXPECT_EQ(dir->GetChildren().count(PathName::Find("/dir/subdir/")), 1U);
+    EXPECT_TRUE(dir->HaveChild("/dir/file1"));
+    EXPECT_EQ(dir->GetChildrenIds(),
+              (std::set<string>{"/dir/file1", "/dir/subdir/"}));
+    auto ids = dir->GetChildrenIdsRecursively();
+    EXPECT_EQ(ids.size(), 3U);
+    EXPECT_EQ(ids.back(), "/dir/subdir/file2");
+    EXPECT_EQ(tree.FindChildren("/dir/").size(), 2U);
+
+    tree.Rename("/dir/file1", "/dir/file3");
+    EXPECT_FALSE(dir->HaveChild("/dir/file1"));
+    EXPECT_EQ(dir->Find("/dir/file3"), tree.Find("/dir/file3").lock());
+
+    // file of another dir with the same name
+    EXPECT_FALSE(dir->HaveChild("/other/file3"));
+    EXPECT_FALSE(dir->Find("/file3"));
+
+    // rename into another dir
+    auto subdir = tree.Find("/dir/subdir/").lock();
+    ASSERT_TRUE(subdir && *subdir);
+    auto file = tree.Find("/dir/file3").lock();
+    tree.Rename("/dir/file3", "/dir/subdir/file3");
+    EXPECT_FALSE(dir->HaveChild("/dir/file3"));
+    EXPECT_EQ(dir->GetChildren().count(PathName::Find("/dir/file3")), 0U);
+    EXPECT_EQ(subdir->Find("/dir/subdir/file3"), file);
+    EXPECT_EQ(file->GetParent(), subdir);
+    EXPECT_EQ(tree.FindChildren("/dir/").size(), 1U);
+    EXPECT_EQ(tree.FindChildren("/dir/subdir/").size(), 2U);
+
+    // target exists, nothing is renamed
+    EXPECT_FALSE(subdir->RenameChild("/dir/subdir/file3",
+                                     "/dir/subdir/file2"));
+    EXPECT_EQ(subdir->Find("/dir/subdir/file3"), file);
+    EXPECT_EQ(file->GetFilePath(), "/dir/subdir/file3");
+
+    tree.Rename("/dir/subdir/file3", "/dir/file3");
+    EXPECT_EQ(dir->Find("/dir/file3"), file);
+    EXPECT_EQ(file->GetParent(), dir);
+
+    tree.Remove("/dir/subdir/");
+    EXPECT_FALSE(tree.Has("/dir/subdir/file2"));
+    EXPECT_EQ(dir->GetChildrenIds(), std::set<string>{"/dir/file3"});
+  }
+
+  // --------------------------------------------------------------------------
+  void TestMemoryBenchmark() {
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    constexpr int dirCount = 100;
+    constexpr int fileCount = 100;  // per dir
+    auto allocated = [] { return mallinfo2().uordblks; };
+
+    auto before = allocated();
+    {
+      DirectoryTree tree(mtime_, uid_, gid_, fileMode_);
+      tree.Grow(BuildDefaultDirectoryMeta("/benchmark/", mtime_));
+      size_t pathSize = 0;
+      for (int i = 0; i < dirCount; ++i) {
+        auto dirPath = "/benchmark/directory_" + std::to_string(i) + "/";
+        tree.Grow(BuildDefaultDirectoryMeta(dirPath, mtime_));
+        for (int j = 0; j < fileCount; ++j) {
+          auto filePath = dirPath + "file_" + std::to_string(j) + ".dat";
+          pathSize += filePath.size();
+          tree.Grow(make_shared<FileMetaData>(filePath, 0, mtime_, mtime_,
+                                              uid_, gid_, fileMode_));
+        }
+      }
+      auto entryCount = dirCount * (fileCount + 1) + 1;
+      ASSERT_TRUE(tree.Has("/benchmark/directory_0/file_0.dat"));
+      ASSERT_TRUE(FileMetaDataManager::Instance().Has(
+          "/benchmark/directory_99/file_99.dat"));
+      RecordProperty("Path bytes per entry",
+                     static_cast<int>(pathSize / (dirCount * fileCount)));
+      RecordProperty("Bytes per entry",
+                     static_cast<int>((allocated() - before) / entryCount));
+    }
+#endif
+  }
+};
+
+TEST_F(DirectoryTreeTest, SetDirectoryListed) { TestSetDirectoryListed(); }
+
+TEST_F(DirectoryTreeTest, ChildrenKeyedByPathName) {
+  TestChildrenKeyedByPathName();
+}
+
+TEST_F(DirectoryTreeTest, MemoryBenchmark) { TestMemoryBenchmark(); }
+
+}  // namespace Data
+}  // namespace QS
+
 TEST_P(EntryTest, CopyControl) {
   auto meta = GetParam();
   Entry entry = Entry(m_pFileMetaData);
@@ -28,6 +28,7 @@
 #include "base/Utils.h"
 #include "configure/Options.h"
 #include "data/File.h"
+#include "data/IOStream.h"
 #include "data/Page.h"
 
 namespace QS {
@@ -202,6 +203,119 @@ class FileTest : public Test {
     EXPECT_EQ(buf2, arr2);
   }
 
+  void TestWriteOverHoles() {
+    string filename = "file1";
+    File file1(filename, mtime_);  // empty file
+
+    // pages are written backward, leaving holes between them
+    file1.Write(6, 2, "gh", mtime_);
+    file1.Write(3, 1, "d", mtime_);
+    file1.Write(0, 1, "a", mtime_);
+    EXPECT_EQ(file1.GetNumPages(), 3u);
+    ContentRangeDeque holes{{1, 2}, {4, 2}};
+    EXPECT_EQ(file1.GetUnloadedRanges(0, 8), holes);
+
+    // a write across all pages fills the holes with new pages
+    constexpr const char *data = "ABCDEFGH";
+    const size_t len = strlen(data);
+    file1.Write(0, len, data, mtime_);
+    EXPECT_EQ(file1.GetSize(), len);
+    EXPECT_EQ(file1.GetNumPages(), 5u);
+    EXPECT_TRUE(file1.HasData(0, len));
+    EXPECT_TRUE(file1.GetUnloadedRanges(0, len).empty());
+
+    off_t prevNext = 0;
+    for (auto it = file1.BeginPage(); it != file1.EndPage(); ++it) {
+      EXPECT_EQ(it->offset, prevNext);
+      EXPECT_EQ(it->offset, it->page->Offset());
+      EXPECT_EQ(it->size, it->page->Size());
+      prevNext = it->Next();
+    }
+
+    string buf(len, 'x');
+    EXPECT_EQ(file1.Read(0, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(buf, string(data));
+  }
+
+  void TestDirtyRanges() {
+    string filename = "file1";
+    File file1(filename, mtime_);
+    constexpr const char *data = "0123456789abcdefghijklmnopqrstuvwxyz";
+    const size_t len = strlen(data);
+    file1.Write(0, len, data, mtime_);
+    EXPECT_FALSE(file1.IsDirty());
+
+    EXPECT_EQ(file1.AddDirtyRange(0, 10), 10u);
+    EXPECT_EQ(file1.AddDirtyRange(5, 10), 5u);  // overlapping
+    EXPECT_EQ(file1.AddDirtyRange(20, 5), 5u);
+    ContentRangeDeque ranges1{{0, 15}, {20, 5}};
+    EXPECT_EQ(file1.GetDirtyRanges(), ranges1);
+    EXPECT_EQ(file1.AddDirtyRange(15, 5), 5u);  // adjacent
+    EXPECT_EQ(file1.AddDirtyRange(30, 6), 6u);
+    EXPECT_EQ(file1.AddDirtyRange(2, 3), 0u);
+    ContentRangeDeque ranges2{{0, 25}, {30, 6}};
+    EXPECT_EQ(file1.GetDirtyRanges(), ranges2);
+    EXPECT_EQ(file1.GetDirtySize(), 31u);
+    EXPECT_TRUE(file1.IsDirty());
+
+    // dirty ranges beyond the new size are dropped
+    file1.ResizeToSmallerSize(10);
+    ContentRangeDeque ranges3{{0, 10}};
+    EXPECT_EQ(file1.GetDirtyRanges(), ranges3);
+    EXPECT_EQ(file1.GetDirtySize(), 10u);
+
+    // modified locally
+    file1.SetETag("", 0);
+    EXPECT_EQ(file1.GetDirtySize(), 10u);
+    // uploaded
+    file1.SetETag("etag", 10);
+    EXPECT_FALSE(file1.IsDirty());
+    EXPECT_TRUE(file1.GetDirtyRanges().empty());
+
+    file1.AddDirtyRange(0, 1);
+    file1.Clear();
+    EXPECT_FALSE(file1.IsDirty());
+  }
+
+  void TestMergePages(bool useDiskFile) {
+    string filename = "file3";
+    File file1(filename, mtime_);  // empty file
+    file1.SetUseDiskFile(useDiskFile);
+
+    // many small sequential writes
+    constexpr size_t numWrites = 1000;
+    constexpr size_t len = 1024;
+    string data;
+    for (size_t i = 0; i < numWrites; ++i) {
+      string chunk(len, static_cast<char>('a' + i % 26));
+      file1.Write(static_cast<off_t>(i * len), len, chunk.c_str(), mtime_);
+      data += chunk;
+    }
+    EXPECT_EQ(file1.GetSize(), numWrites * len);
+    EXPECT_LT(file1.GetNumPages(), 50u);
+    EXPECT_TRUE(file1.HasData(0, numWrites * len));
+
+    // a page behind a hole is not merged
+    constexpr off_t holeLen = 10;
+    off_t off = static_cast<off_t>(numWrites * len) + holeLen;
+    file1.Write(off, 3, "XYZ", mtime_);
+    ContentRangeDeque holes{{numWrites * len, holeLen}};
+    EXPECT_EQ(file1.GetUnloadedRanges(0, off + 3), holes);
+
+    off_t prevNext = 0;
+    for (auto it = file1.BeginPage(); it != file1.EndPage(); ++it) {
+      EXPECT_TRUE(it->offset == prevNext || it->offset == off);
+      EXPECT_EQ(it->offset, it->page->Offset());
+      EXPECT_EQ(it->size, it->page->Size());
+      prevNext = it->Next();
+    }
+
+    string buf(numWrites * len, '\0');
+    EXPECT_EQ(file1.Read(0, numWrites * len, &buf[0], 0, nullptr),
+              numWrites * len);
+    EXPECT_EQ(buf, data);
+  }
+
   void TestRead() {
     string filename = "file1";
     File file1(filename, mtime_);  // empty file
@@ -222,47 +336,38 @@ class FileTest : public Test {
     off_t off3 = off2 + holeLen + len3;
     file1.Write(off3, len3, page3, mtime_);
 
-    auto res1 = file1.Read(off1, len1, 0);
-    EXPECT_EQ(std::get<0>(res1), len1);
-    auto &pages1 = std::get<1>(res1);
-    EXPECT_EQ(pages1.size(), 1u);
-    array<char, len1> buf1;
-    pages1.front()->Read(&buf1[0]);
-    array<char, len1> arr1{'0', '1', '2'};
-    EXPECT_EQ(buf1, arr1);
-    auto &unloadPages1 = std::get<2>(res1);
+    FileSliceVec slices1;
+    ContentRangeDeque unloadPages1;
+    EXPECT_EQ(file1.ReadSlices(off1, len1, &slices1, 0, &unloadPages1), len1);
+    ASSERT_EQ(slices1.size(), 1u);
+    EXPECT_EQ(string(slices1[0].data, slices1[0].len), "012");
     EXPECT_TRUE(unloadPages1.empty());
 
-    auto res2 = file1.Read(off1 + 1, len1, 0);
-    EXPECT_EQ(std::get<0>(res2), len1 + len2);
-    auto &pages2 = std::get<1>(res2);
-    EXPECT_EQ(pages2.size(), 2u);
-    array<char, len1> buf2;
-    pages2.front()->Read(&buf2[0]);
-    EXPECT_EQ(buf2, arr1);
-    array<char, len2> buf3;
-    pages2.back()->Read(&buf3[0]);
-    array<char, len2> arr2{'a', 'b', 'c'};
-    EXPECT_EQ(buf3, arr2);
-    auto &unloadPages2 = std::get<2>(res2);
+    // slices are cut to the range
+    FileSliceVec slices2;
+    ContentRangeDeque unloadPages2;
+    EXPECT_EQ(file1.ReadSlices(off1 + 1, len1, &slices2, 0, &unloadPages2),
+              len1);
+    ASSERT_EQ(slices2.size(), 2u);
+    EXPECT_EQ(slices2[0].offset, off1 + 1);
+    EXPECT_EQ(string(slices2[0].data, slices2[0].len), "12");
+    EXPECT_EQ(slices2[1].offset, off2);
+    EXPECT_EQ(string(slices2[1].data, slices2[1].len), "a");
     EXPECT_TRUE(unloadPages2.empty());
 
-    auto res3 = file1.Read(off2 + len2, holeLen, 0);
-    EXPECT_EQ(std::get<0>(res3), 0u);
-    auto &pages3 = std::get<1>(res3);
-    EXPECT_TRUE(pages3.empty());
-    auto &unloadPages3 = std::get<2>(res3);
+    FileSliceVec slices3;
+    ContentRangeDeque unloadPages3;
+    EXPECT_EQ(file1.ReadSlices(off2 + len2, holeLen, &slices3, 0,
+                               &unloadPages3),
+              0u);
+    EXPECT_TRUE(slices3.empty());
     EXPECT_FALSE(unloadPages3.empty());
 
-    auto res4 = file1.Read(off3, len3, 0);
-    EXPECT_EQ(std::get<0>(res4), len3);
-    auto &pages4 = std::get<1>(res4);
-    EXPECT_EQ(pages4.size(), 1u);
-    array<char, len3> buf4;
-    pages4.front()->Read(&buf4[0]);
-    array<char, len3> arr3{'A', 'B', 'C'};
-    EXPECT_EQ(buf4, arr3);
-    auto &unloadPages4 = std::get<2>(res4);
+    FileSliceVec slices4;
+    ContentRangeDeque unloadPages4;
+    EXPECT_EQ(file1.ReadSlices(off3, len3, &slices4, 0, &unloadPages4), len3);
+    ASSERT_EQ(slices4.size(), 1u);
+    EXPECT_EQ(string(slices4[0].data, slices4[0].len), "ABC");
     EXPECT_TRUE(unloadPages4.empty());
   }
 
@@ -287,26 +392,149 @@ class FileTest : public Test {
     off_t off3 = off2 + holeLen + len3;
     file1.Write(off3, len3, page3, mtime_);
 
-    auto res1 = file1.Read(off1, len1, 0);
-    EXPECT_EQ(std::get<0>(res1), len1);
-    auto &pages1 = std::get<1>(res1);
-    EXPECT_EQ(pages1.size(), 1u);
-    array<char, len1> buf1;
-    pages1.front()->Read(&buf1[0]);
-    array<char, len1> arr1{'0', '1', '2'};
-    EXPECT_EQ(buf1, arr1);
+    FileSliceVec slices;
+    EXPECT_EQ(file1.ReadSlices(off1, len1, &slices, 0, nullptr), len1);
+    ASSERT_EQ(slices.size(), 1u);
+    EXPECT_TRUE(slices[0].data == nullptr);
+    EXPECT_TRUE(slices[0].diskFile != nullptr);
 
-    auto res2 = file1.Read(off1 + 1, len1, 0);
-    EXPECT_EQ(std::get<0>(res2), len1 + len2);
-    auto &pages2 = std::get<1>(res2);
-    EXPECT_EQ(pages2.size(), 2u);
-    array<char, len1> buf2;
-    pages2.front()->Read(&buf2[0]);
-    EXPECT_EQ(buf2, arr1);
-    array<char, len2> buf3;
-    pages2.back()->Read(&buf3[0]);
-    array<char, len2> arr2{'a', 'b', 'c'};
-    EXPECT_EQ(buf3, arr2);
+    string buf1(len1, 'x');
+    EXPECT_EQ(file1.Read(off1, len1, &buf1[0], 0, nullptr), len1);
+    EXPECT_EQ(buf1, "012");
+
+    string buf2(len1, 'x');
+    EXPECT_EQ(file1.Read(off1 + 1, len1, &buf2[0], 0, nullptr), len1);
+    EXPECT_EQ(buf2, "12a");
+  }
+
+  void TestDemotePromote() {
+    File file1("file3", mtime_);
+    constexpr size_t len = 1024;
+    string str1(len, 'a');
+    string str2(len, 'b');
+    file1.Write(0, len, str1.c_str(), mtime_);
+    file1.Write(2 * len, len, str2.c_str(), mtime_);
+
+    EXPECT_EQ(file1.Demote(len), len);
+    EXPECT_FALSE(file1.UseDiskFile());
+    EXPECT_EQ(file1.GetCachedSize(), len);
+    EXPECT_EQ(file1.GetDiskSize(), len);
+    EXPECT_TRUE(file1.HasData(0, len));
+
+    // page in disk file becomes hot after reads
+    FileSliceVec slices;
+    EXPECT_EQ(file1.ReadSlices(0, len, &slices, 0, nullptr), len);
+    EXPECT_EQ(file1.GetHotDiskSize(), 0u);
+    EXPECT_EQ(file1.ReadSlices(0, len, &slices, 0, nullptr), len);
+    EXPECT_EQ(file1.GetHotDiskSize(), len);
+    EXPECT_EQ(file1.PromoteHotPages(), len);
+    EXPECT_EQ(file1.GetHotDiskSize(), 0u);
+    EXPECT_EQ(file1.GetCachedSize(), 2 * len);
+    EXPECT_EQ(file1.GetDiskSize(), 0u);
+
+    // dropping disk pages keeps pages in memory
+    EXPECT_EQ(file1.Demote(len), len);
+    EXPECT_EQ(file1.DropDiskPages(), len);
+    EXPECT_EQ(file1.GetSize(), len);
+    EXPECT_EQ(file1.GetDiskSize(), 0u);
+    EXPECT_FALSE(file1.HasData(0, len));
+    EXPECT_TRUE(file1.HasData(2 * len, len));
+    file1.Clear();
+  }
+
+  void TestHoles() {
+    File file1("file4", mtime_);
+    constexpr size_t len = 4096;
+    string zeros(len, '\0');
+    string str1(len, 'a');
+    // all-zero pages are stored as holes
+    file1.Write(0, len, zeros.c_str(), mtime_);
+    file1.Write(len, len, str1.c_str(), mtime_);
+    file1.Write(2 * len, len, make_shared<IOStream>(len), mtime_);
+    EXPECT_EQ(file1.GetSize(), 3 * len);
+    EXPECT_EQ(file1.GetHoleSize(), 2 * len);
+    EXPECT_EQ(file1.GetCachedSize(), len);
+    EXPECT_EQ(file1.GetDiskSize(), 0u);
+    EXPECT_TRUE(file1.HasData(0, 3 * len));
+    EXPECT_EQ(file1.Demote(len), len);  // holes are not demoted
+    EXPECT_EQ(file1.GetDiskSize(), len);
+
+    string buf(3 * len, 'x');
+    EXPECT_EQ(file1.Read(0, 3 * len, &buf[0], 0, nullptr), 3 * len);
+    EXPECT_EQ(buf, zeros + str1 + zeros);
+
+    // hole is filled by writing into it
+    file1.Write(2 * len + 1, 1, "b", mtime_);
+    EXPECT_EQ(file1.GetHoleSize(), len);
+    EXPECT_EQ(file1.GetCachedSize(), len);
+    file1.ResizeToSmallerSize(len / 2);
+    EXPECT_EQ(file1.GetHoleSize(), len / 2);
+    EXPECT_EQ(file1.GetCachedSize(), 0u);
+    file1.Clear();
+    EXPECT_EQ(file1.GetHoleSize(), 0u);
+  }
+
+  void TestShareFrom() {
+    File file1("file5", mtime_);
+    File file2("file6", mtime_);
+    constexpr size_t len = 1024;
+    string str1(len, 'a');
+    file1.Write(0, len, str1.c_str(), mtime_);
+    file1.Write(len, len, str1.c_str(), mtime_);
+    EXPECT_EQ(file2.ShareFrom(&file1), 2 * len);
+    EXPECT_EQ(file2.GetCachedSize(), 0u);  // charged to the source
+    EXPECT_EQ(file2.GetUnchargedSize(), 2 * len);
+    EXPECT_EQ(file2.ChargeSharedPages(), 0u);  // source still holds them
+    EXPECT_EQ(file2.ShareFrom(&file1), 0u);  // has pages already
+    EXPECT_EQ(file1.Compress(), 0u);  // shared page is not compressed
+    EXPECT_EQ(file1.Demote(len), 0u);  // nor demoted
+
+    // shared page is copied when written
+    file2.Write(1, 1, "b", mtime_);
+    EXPECT_EQ(file2.GetCachedSize(), len);
+    EXPECT_EQ(file2.GetUnchargedSize(), len);
+    string buf(2 * len, 'x');
+    EXPECT_EQ(file1.Read(0, 2 * len, &buf[0], 0, nullptr), 2 * len);
+    EXPECT_EQ(buf, str1 + str1);
+    EXPECT_EQ(file2.Read(0, 2, &buf[0], 0, nullptr), 2u);
+    EXPECT_EQ(buf.substr(0, 2), "ab");
+    file2.ResizeToSmallerSize(len + 1);
+    EXPECT_EQ(file1.GetSize(), 2 * len);
+    EXPECT_EQ(file1.Read(len, len, &buf[0], 0, nullptr), len);
+    EXPECT_EQ(buf.substr(0, len), str1);
+
+    // shared pages are kept after the source is cleared
+    file1.Clear();
+    EXPECT_EQ(file2.Read(0, 2, &buf[0], 0, nullptr), 2u);
+    EXPECT_EQ(buf.substr(0, 2), "ab");
+    file2.Clear();
+  }
+
+  void TestRecycle() {
+    File file("file7", mtime_);
+    constexpr size_t len = 1024;
+    string str(len, 'a');
+    for (size_t i = 0; i < 4; ++i) {
+      file.Write(i * len, len, str.c_str(), mtime_);
+    }
+    file.AddDirtyRange(3 * len, 1);
+    string buf(len, 'x');
+    EXPECT_EQ(file.Read(0, len, &buf[0], 0, nullptr), len);
+
+    // least recently accessed page is recycled first
+    EXPECT_EQ(file.Recycle(1, len, 2 * len), len);
+    EXPECT_FALSE(file.HasData(2 * len, len));
+    EXPECT_TRUE(file.HasData(0, 2 * len));
+    EXPECT_EQ(file.GetCachedSize(), 3 * len);
+
+    // pages in range and dirty pages are kept
+    EXPECT_EQ(file.Recycle(4 * len, len, 2 * len), len);
+    EXPECT_FALSE(file.HasData(0, len));
+    EXPECT_TRUE(file.HasData(len, len));
+    EXPECT_TRUE(file.HasData(3 * len, len));
+    EXPECT_EQ(file.GetSize(), 2 * len);
+    EXPECT_EQ(file.GetCachedSize(), 2 * len);
+    file.Clear();
   }
 };
 
@@ -336,10 +564,26 @@ TEST_F(FileTest, Write) { TestWrite(); }
 
 TEST_F(FileTest, WriteDiskFile) { TestWriteDiskFile(); }
 
+TEST_F(FileTest, WriteOverHoles) { TestWriteOverHoles(); }
+
+TEST_F(FileTest, DirtyRanges) { TestDirtyRanges(); }
+
+TEST_F(FileTest, MergePages) { TestMergePages(false); }
+
+TEST_F(FileTest, MergePagesDiskFile) { TestMergePages(true); }
+
 TEST_F(FileTest, Read) { TestRead(); }
 
 TEST_F(FileTest, ReadDiskFile) { TestReadDiskFile(); }
 
+TEST_F(FileTest, DemotePromote) { TestDemotePromote(); }
+
+TEST_F(FileTest, Holes) { TestHoles(); }
+
+TEST_F(FileTest, ShareFrom) { TestShareFrom(); }
+
+TEST_F(FileTest, Recycle) { TestRecycle(); }
+
 }  // namespace Data
 }  // namespace QS
 
@@ -0,0 +1,78 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "data/FrequencySketch.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::string;
+using std::to_string;
+using ::testing::Test;
+
+class FrequencySketchTest : public Test {
+ protected:
+  void TestIncrement() {
+    FrequencySketch sketch(100);
+    EXPECT_EQ(sketch.GetNumCounters(), 128u);
+    EXPECT_EQ(sketch.Estimate("/a"), 0u);
+    sketch.Increment("/a");
+    sketch.Increment("/a");
+    sketch.Increment("/b");
+    EXPECT_GE(sketch.Estimate("/a"), 2u);
+    EXPECT_GE(sketch.Estimate("/b"), 1u);
+    EXPECT_GT(sketch.Estimate("/a"), sketch.Estimate("/b"));
+
+    // counter saturates at 15
+    for (int i = 0; i < 20; ++i) {
+      sketch.Increment("/a");
+    }
+    EXPECT_EQ(sketch.Estimate("/a"), 15u);
+  }
+
+  void TestAge() {
+    FrequencySketch sketch(64);
+    for (int i = 0; i < 15; ++i) {
+      sketch.Increment("/hot");
+    }
+    EXPECT_EQ(sketch.Estimate("/hot"), 15u);
+    // counters are halved after ten times the number of counters increments
+    for (int i = 0; i < 640; ++i) {
+      sketch.Increment("/scan" + to_string(i));
+    }
+    EXPECT_LT(sketch.Estimate("/hot"), 15u);
+    EXPECT_GE(sketch.Estimate("/hot"), 3u);
+  }
+};
+
+TEST_F(FrequencySketchTest, Increment) { TestIncrement(); }
+
+TEST_F(FrequencySketchTest, Age) { TestAge(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
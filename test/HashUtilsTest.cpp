@@ -0,0 +1,118 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "base/HashUtils.h"
+
+namespace QS {
+
+namespace HashUtils {
+
+using std::set;
+using std::string;
+using std::to_string;
+using std::vector;
+using ::testing::Test;
+
+class HashUtilsTest : public Test {
+ protected:
+  void TestMix() {
+    vector<uint64_t> values = {0,
+                               1,
+                               0xffffffffULL,
+                               0x100000000ULL,
+                               0xffffffffffffffffULL,
+                               0xa0761d6478bd642fULL,
+                               0xe7037ed1a0b428dbULL,
+                               0x8ebc6af09c88c6e3ULL};
+    for (auto a : values) {
+      for (auto b : values) {
+        EXPECT_EQ(Internal::Mix(a, b), Internal::MixBy32(a, b));
+      }
+    }
+    // max * max = 0xfffffffffffffffe0000000000000001
+    EXPECT_EQ(Internal::MixBy32(0xffffffffffffffffULL, 0xffffffffffffffffULL),
+              0xfffffffffffffffeULL ^ 1ULL);
+  }
+
+  void TestHash64TailLength() {
+    // each length covers a branch of tail: 0, 1-3, 4-7, 8-16 and over 16
+    set<uint64_t> hashes;
+    for (size_t len = 0; len <= 40; ++len) {
+      string str(len, 'a');
+      auto hash = Hash64(str.data(), str.size());
+      EXPECT_TRUE(hashes.insert(hash).second) << "len " << len;
+
+      // bytes out of range are not read
+      string padded = str + "bcd";
+      EXPECT_EQ(Hash64(padded.data(), len), hash) << "len " << len;
+
+      // every byte counts
+      for (size_t i = 0; i < len; ++i) {
+        string changed = str;
+        changed[i] = 'b';
+        EXPECT_NE(Hash64(changed.data(), changed.size()), hash)
+            << "len " << len << " pos " << i;
+      }
+    }
+  }
+
+  void TestHash64SharedPrefix() {
+    const string prefix = "/bucket/dir/subdir/another-long-dir-name/file";
+    set<uint64_t> hashes;
+    set<uint64_t> lowBits;  // used by hash tables with power of 2 buckets
+    constexpr size_t count = 1000;
+    for (size_t i = 0; i < count; ++i) {
+      auto path = prefix + to_string(i);
+      auto hash = Hash64(path.data(), path.size());
+      hashes.insert(hash);
+      lowBits.insert(hash & 0xffff);
+    }
+    EXPECT_EQ(hashes.size(), count);
+    EXPECT_GT(lowBits.size(), count * 9 / 10);
+  }
+
+  void TestStableHash64() {
+    // FNV-1a test vectors
+    EXPECT_EQ(StableHash64(string()), 0xcbf29ce484222325ULL);
+    EXPECT_EQ(StableHash64(string("a")), 0xaf63dc4c8601ec8cULL);
+    EXPECT_EQ(StableHash64("abc", 2), StableHash64(string("ab")));
+  }
+};
+
+TEST_F(HashUtilsTest, Mix) { TestMix(); }
+
+TEST_F(HashUtilsTest, Hash64TailLength) { TestHash64TailLength(); }
+
+TEST_F(HashUtilsTest, Hash64SharedPrefix) { TestHash64SharedPrefix(); }
+
+TEST_F(HashUtilsTest, StableHash64) { TestStableHash64(); }
+
+}  // namespace HashUtils
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
@@ -0,0 +1,152 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+#include <stdint.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "base/Logging.h"
+#include "base/Utils.h"
+#include "data/MemoryPressure.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::ofstream;
+using std::string;
+using std::unique_ptr;
+using ::testing::Test;
+
+// default log dir
+static const char *defaultLogDir = "/tmp/qsfs.test.logs/";
+// fake cgroup dir
+static const char *cgroupDir = "/tmp/qsfs.test.cgroup/";
+void InitLog() {
+  QS::Utils::CreateDirectoryIfNotExistsNoLog(defaultLogDir);
+  QS::Logging::InitializeLogging(
+      unique_ptr<QS::Logging::Log>(new QS::Logging::DefaultLog(defaultLogDir)));
+  EXPECT_TRUE(QS::Logging::GetLogInstance() != nullptr)
+      << "log instance is null";
+}
+
+void WriteCgroupFile(const string &name, const string &content) {
+  ofstream os(string(cgroupDir) + name);
+  os << content << "\n";
+}
+
+class MemoryPressureTest : public Test {
+ protected:
+  static void SetUpTestCase() {
+    InitLog();
+    QS::Utils::CreateDirectoryIfNotExistsNoLog(cgroupDir);
+  }
+
+  void TestReadStatus() {
+    MemoryPressure memoryPressure(cgroupDir,
+                                  string(cgroupDir) + "memory.pressure");
+    EXPECT_EQ(memoryPressure.GetCgroupDir(), string(cgroupDir));
+
+    WriteCgroupFile("memory.current", "1000");
+    WriteCgroupFile("memory.high", "max");
+    WriteCgroupFile("memory.max", "4000");
+    WriteCgroupFile("memory.pressure",
+                    "some avg10=12.50 avg60=3.00 avg300=1.00 total=100\n"
+                    "full avg10=2.00 avg60=1.00 avg300=0.00 total=10");
+    MemoryStatus status;
+    EXPECT_TRUE(memoryPressure.ReadStatus(&status));
+    EXPECT_EQ(status.current, 1000u);
+    EXPECT_EQ(status.limit, 4000u);  // memory.high is "max"
+    EXPECT_DOUBLE_EQ(status.pressure, 12.5);
+
+    WriteCgroupFile("memory.high", "3000");
+    WriteCgroupFile("memory.max", "max");
+    WriteCgroupFile("memory.pressure", "");
+    EXPECT_TRUE(memoryPressure.ReadStatus(&status));
+    EXPECT_EQ(status.limit, 3000u);
+    EXPECT_DOUBLE_EQ(status.pressure, 0);
+
+    WriteCgroupFile("memory.high", "max");
+    EXPECT_TRUE(memoryPressure.ReadStatus(&status));
+    EXPECT_EQ(status.limit, 0u);  // no limit
+
+    WriteCgroupFile("memory.pressure", "some avg10=12.50 avg60=3.00");
+    MemoryPressure noPsi(cgroupDir, "");  // pressure is not watched
+    EXPECT_TRUE(noPsi.ReadStatus(&status));
+    EXPECT_DOUBLE_EQ(status.pressure, 0);
+
+    MemoryPressure noCgroup("/tmp/qsfs.test.nonexistent.cgroup", "");
+    EXPECT_FALSE(noCgroup.ReadStatus(&status));
+  }
+
+  void TestAdaptCapacity() {
+    const uint64_t maxCap = 1600;
+    MemoryStatus status;
+    status.limit = 10000;
+
+    // near limit: shrink by the missing headroom
+    status.current = 9900;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 1600, status), 700u);
+    // near limit: shrink by 1/4 of capacity at least
+    status.current = 9001;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 1600, status), 1200u);
+    // never below 1/16 of max capacity
+    status.current = 10000;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 200, status), 100u);
+
+    // high pressure: shrink by 1/4 of capacity
+    status.current = 1000;
+    status.pressure = 20;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 800, status), 600u);
+
+    // far from limit and low pressure: grow by 1/8 of max capacity
+    status.pressure = 0;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 800, status), 1000u);
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 1500, status), maxCap);
+    // grow within the headroom above 1/4 of limit
+    status.current = 7450;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 800, status), 850u);
+
+    // between thresholds: keep capacity
+    status.current = 8000;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 800, status), 800u);
+    status.current = 1000;
+    status.pressure = 5;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 800, status), 800u);
+
+    // no limit
+    status.limit = 0;
+    status.pressure = 0;
+    EXPECT_EQ(MemoryPressure::AdaptCapacity(maxCap, 800, status), 1000u);
+  }
+};
+
+TEST_F(MemoryPressureTest, ReadStatus) { TestReadStatus(); }
+
+TEST_F(MemoryPressureTest, AdaptCapacity) { TestAdaptCapacity(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
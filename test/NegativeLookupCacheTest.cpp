@@ -0,0 +1,87 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include <unistd.h>  // for sleep
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "data/NegativeLookupCache.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::string;
+using ::testing::Test;
+
+class NegativeLookupCacheTest : public Test {
+ protected:
+  void TestAddAndErase() {
+    NegativeLookupCache cache(3, 60);
+    EXPECT_FALSE(cache.Has("/a/b/c"));
+    cache.Add("/a/b/c");
+    cache.Add("/a/d/");
+    cache.Add("/e");
+    EXPECT_TRUE(cache.Has("/a/b/c"));
+    EXPECT_TRUE(cache.Has("/e"));
+    EXPECT_EQ(cache.GetHits(), 2u);
+    EXPECT_EQ(cache.GetMisses(), 1u);
+
+    // oldest path is discarded when full
+    cache.Add("/a/b/c");
+    cache.Add("/f");
+    EXPECT_EQ(cache.GetSize(), 3u);
+    EXPECT_FALSE(cache.Has("/a/d/"));
+
+    // created path is removed in both forms, so are its ancestor dirs
+    cache.Add("/a/b/");
+    cache.Erase("/a/b/c/");
+    EXPECT_FALSE(cache.Has("/a/b/c"));
+    EXPECT_FALSE(cache.Has("/a/b/"));
+    EXPECT_TRUE(cache.Has("/f"));
+    cache.Clear();
+    EXPECT_EQ(cache.GetSize(), 0u);
+  }
+
+  void TestExpire() {
+    NegativeLookupCache cache(10, 1);
+    cache.Add("/a");
+    EXPECT_TRUE(cache.Has("/a"));
+    sleep(1);
+    EXPECT_FALSE(cache.Has("/a"));
+    EXPECT_EQ(cache.GetSize(), 0u);
+
+    NegativeLookupCache disabled(10, 0);
+    disabled.Add("/a");
+    EXPECT_FALSE(disabled.Has("/a"));
+  }
+};
+
+TEST_F(NegativeLookupCacheTest, AddAndErase) { TestAddAndErase(); }
+
+TEST_F(NegativeLookupCacheTest, Expire) { TestExpire(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
@@ -15,8 +15,11 @@
 // +-------------------------------------------------------------------------
 
 #include <assert.h>
+#include <stdlib.h>  // for rand_r
 #include <string.h>
 
+#include <sys/stat.h>
+
 #include <array>
 #include <memory>
 #include <sstream>
@@ -28,6 +31,8 @@
 #include "base/Logging.h"
 #include "base/Utils.h"
 #include "configure/Options.h"
+#include "data/DiskFile.h"
+#include "data/DiskIOEngine.h"
 #include "data/Page.h"
 #include "data/StreamUtils.h"
 
@@ -63,7 +68,8 @@ class PageTest : public Test {
     size_t len = str.size();
     string file1 = QS::Configure::Options::Instance().GetDiskCacheDirectory() +
                    "test_page1";
-    Page p1(0, len, str.c_str(), file1);
+    auto disk1 = make_shared<DiskFile>(file1);
+    Page p1(0, len, str.c_str(), disk1);
     EXPECT_EQ(p1.Stop(), (off_t)(len - 1));
     EXPECT_EQ(p1.Next(), (off_t)len);
     EXPECT_EQ(p1.Size(), len);
@@ -81,7 +87,8 @@ class PageTest : public Test {
     auto ss = make_shared<stringstream>(str);
     string file2 = QS::Configure::Options::Instance().GetDiskCacheDirectory() +
                    "test_page2";
-    Page p2(0, len, ss, file2);
+    auto disk2 = make_shared<DiskFile>(file2);
+    Page p2(0, len, ss, disk2);
     EXPECT_EQ(p2.Stop(), (off_t)(len - 1));
     EXPECT_EQ(p2.Next(), (off_t)len);
     EXPECT_EQ(p2.Size(), len);
@@ -107,7 +114,7 @@ class PageTest : public Test {
     constexpr size_t len = strlen(str);
     string file1 = QS::Configure::Options::Instance().GetDiskCacheDirectory() +
                    "test_page1";
-    Page p1(0, len, str, file1);
+    Page p1(0, len, str, make_shared<DiskFile>(file1));
 
     array<char, len - 1> arrSmaller{'1', '2'};
     p1.ResizeToSmallerSize(len - 1);
@@ -116,6 +123,180 @@ class PageTest : public Test {
     EXPECT_TRUE(buf1 == arrSmaller);
     RemoveFileIfExists(file1);
   }
+
+  void TestShareDiskFile() {
+    constexpr size_t len = 1024 * 1024;
+    string file1 = QS::Configure::Options::Instance().GetDiskCacheDirectory() +
+                   "test_page3";
+    auto disk1 = make_shared<DiskFile>(file1);
+    EXPECT_TRUE(disk1->IsOpen());
+    string str1(len, 'a');
+    string str2(len, 'b');
+    Page p1(0, len, str1.c_str(), disk1);
+    Page p2(len, len, str2.c_str(), disk1);
+
+    string buf(len, '\0');
+    EXPECT_EQ(p1.Read(&buf[0]), len);
+    EXPECT_EQ(buf, str1);
+    EXPECT_EQ(p2.Read(&buf[0]), len);
+    EXPECT_EQ(buf, str2);
+
+    struct stat st1;
+    ASSERT_EQ(stat(file1.c_str(), &st1), 0);
+    EXPECT_EQ(st1.st_size, static_cast<off_t>(2 * len));
+
+    // resize deallocates the removed bytes but keeps the file size
+    p2.ResizeToSmallerSize(0);
+    struct stat st2;
+    ASSERT_EQ(stat(file1.c_str(), &st2), 0);
+    EXPECT_EQ(st2.st_size, static_cast<off_t>(2 * len));
+    EXPECT_LT(st2.st_blocks, st1.st_blocks);
+    EXPECT_EQ(p1.Read(&buf[0]), len);
+    EXPECT_EQ(buf, str1);
+
+    p1.PunchHole();
+    EXPECT_EQ(disk1->Read(0, len, &buf[0]), len);
+    EXPECT_EQ(buf, string(len, '\0'));
+    RemoveFileIfExists(file1);
+  }
+
+  void TestBatchRead(DiskIOEngine *engine, bool directIO) {
+    string file1 = QS::Configure::Options::Instance().GetDiskCacheDirectory() +
+                   "test_page4";
+    auto disk1 = make_shared<DiskFile>(file1, directIO);
+    EXPECT_TRUE(disk1->IsOpen());
+    // unaligned pages: [0, 100), [100, 5000), [8192, 8292)
+    string str1(100, 'a');
+    string str2(4900, 'b');
+    string str3(100, 'c');
+    auto p1 = make_shared<Page>(0, str1.size(), str1.c_str(), disk1);
+    auto p2 = make_shared<Page>(100, str2.size(), str2.c_str(), disk1);
+    auto p3 = make_shared<Page>(8192, str3.size(), str3.c_str(), disk1);
+    auto p4 = make_shared<Page>(9000, 3, "xyz");  // in-memory page
+
+    string buf(8292, '\0');
+    DiskIORequestVec requests;
+    EXPECT_TRUE(p1->AddDiskReadRequest(0, str1.size(), &buf[0], &requests));
+    EXPECT_TRUE(
+        p2->AddDiskReadRequest(100, str2.size(), &buf[100], &requests));
+    EXPECT_TRUE(p3->AddDiskReadRequest(8192, 50, &buf[8192], &requests));
+    EXPECT_FALSE(p4->AddDiskReadRequest(9000, 3, &buf[0], &requests));
+    // successive requests of p1 and p2 are merged
+    ASSERT_EQ(requests.size(), 2u);
+    EXPECT_EQ(requests[0].len, str1.size() + str2.size());
+
+    EXPECT_EQ(engine->Read(&requests), str1.size() + str2.size() + 50);
+    EXPECT_EQ(buf.substr(0, 100), str1);
+    EXPECT_EQ(buf.substr(100, 4900), str2);
+    EXPECT_EQ(buf.substr(8192, 50), str3.substr(0, 50));
+
+    // refresh in place keeps the neighbour bytes
+    EXPECT_TRUE(p2->Refresh(off_t(4999), 1, "B"));
+    array<char, 3> buf2;
+    EXPECT_EQ(p2->Read(4998, 2, &buf2[0]), 2u);
+    EXPECT_EQ(buf2[0], 'b');
+    EXPECT_EQ(buf2[1], 'B');
+    EXPECT_EQ(p1->Read(99, 1, &buf2[2]), 1u);
+    EXPECT_EQ(buf2[2], 'a');
+    RemoveFileIfExists(file1);
+  }
+
+  // --------------------------------------------------------------------------
+  void TestCompress() {
+    constexpr size_t len = 64 * 1024;
+    string text;
+    while (text.size() < len) {
+      text +=
+          "{\"key\": \"value " + std::to_string(text.size() % 100) + "\"}\n";
+    }
+    text.resize(len);
+    Page p1(0, len, text.c_str());
+    EXPECT_FALSE(p1.IsCompressed());
+    auto savedSize = p1.Compress();
+    EXPECT_GT(savedSize, len / 2);
+    EXPECT_TRUE(p1.IsCompressed());
+    EXPECT_EQ(p1.GetCompressedSavedSize(), savedSize);
+    EXPECT_EQ(p1.Compress(), 0u);  // already compressed
+    EXPECT_TRUE(p1.GetData(0) == nullptr);
+
+    string buf(len, '\0');
+    EXPECT_EQ(p1.Read(&buf[0]), len);  // read without decompressing
+    EXPECT_EQ(buf, text);
+    EXPECT_TRUE(p1.IsCompressed());
+    EXPECT_EQ(p1.Decompress(), savedSize);
+    EXPECT_FALSE(p1.IsCompressed());
+    EXPECT_EQ(string(p1.GetData(0), len), text);
+
+    // random bytes are detected incompressible
+    string random(len, '\0');
+    unsigned seed = 1;
+    for (auto &c : random) {
+      c = static_cast<char>(rand_r(&seed));
+    }
+    Page p2(len, len, random.c_str());
+    EXPECT_EQ(p2.Compress(), 0u);
+    EXPECT_FALSE(p2.IsCompressed());
+    EXPECT_EQ(p2.Read(&buf[0]), len);
+    EXPECT_EQ(buf, random);
+  }
+
+  void TestDemotePromote() {
+    constexpr size_t len = 1024;
+    string file1 = QS::Configure::Options::Instance().GetDiskCacheDirectory() +
+                   "test_page4";
+    auto disk1 = make_shared<DiskFile>(file1);
+    EXPECT_TRUE(disk1->IsOpen());
+    string str1(len, 'a');
+    Page p1(0, len, str1.c_str());
+    EXPECT_FALSE(p1.Promote());  // not in disk file
+    EXPECT_TRUE(p1.Demote(disk1));
+    EXPECT_TRUE(p1.UseDiskFile());
+    EXPECT_TRUE(p1.GetData(0) == nullptr);
+    EXPECT_FALSE(p1.Demote(disk1));  // already in disk file
+
+    string buf(len, '\0');
+    EXPECT_EQ(p1.Read(&buf[0]), len);
+    EXPECT_EQ(buf, str1);
+    EXPECT_TRUE(p1.Promote());
+    EXPECT_FALSE(p1.UseDiskFile());
+    EXPECT_EQ(string(p1.GetData(0), len), str1);
+    // disk space is deallocated after promoting
+    EXPECT_EQ(disk1->Read(0, len, &buf[0]), len);
+    EXPECT_EQ(buf, string(len, '\0'));
+    RemoveFileIfExists(file1);
+  }
+
+  // --------------------------------------------------------------------------
+  void TestHole() {
+    constexpr size_t len = 1024;
+    string zeros(len, '\0');
+    EXPECT_TRUE(IsAllZero(zeros.c_str(), len));
+    for (size_t i : {size_t(0), size_t(70), len - 1}) {
+      string str1 = zeros;
+      str1[i] = 'a';
+      EXPECT_FALSE(IsAllZero(str1.c_str(), len)) << i;
+    }
+    EXPECT_TRUE(IsAllZero(nullptr, 0));
+
+    Page p1(0, len);
+    EXPECT_TRUE(p1.IsHole());
+    EXPECT_EQ(p1.GetHoleSize(), len);
+    EXPECT_TRUE(p1.GetData(0) == nullptr);
+    string buf(len, 'x');
+    EXPECT_EQ(p1.Read(&buf[0]), len);
+    EXPECT_EQ(buf, zeros);
+    EXPECT_EQ(p1.Compress(), 0u);
+    p1.ResizeToSmallerSize(len / 2);
+    EXPECT_EQ(p1.GetHoleSize(), len / 2);
+
+    // hole is filled when refreshed
+    EXPECT_TRUE(p1.Refresh(1, 1, "a"));
+    EXPECT_FALSE(p1.IsHole());
+    EXPECT_EQ(p1.Size(), len / 2);
+    EXPECT_EQ(p1.Read(0, 2, &buf[0]), 2u);
+    EXPECT_EQ(string(buf.c_str(), 2), string("\0a", 2));
+    EXPECT_EQ(p1.FillHole(), 0u);
+  }
 };
 
 // --------------------------------------------------------------------------
@@ -202,7 +383,7 @@ TEST_F(PageTest, ReadDiskFile) {
   array<char, len> arr{'1', '2', '3'};
   string file1 =
       QS::Configure::Options::Instance().GetDiskCacheDirectory() + "test_page1";
-  Page p1(0, len, str, file1);
+  Page p1(0, len, str, make_shared<DiskFile>(file1));
 
   array<char, len> buf1;
   p1.Read(0, len, &buf1[0]);
@@ -236,7 +417,7 @@ TEST_F(PageTest, RefreshDiskFile) {
   constexpr size_t len = strlen(str);
   string file1 =
       QS::Configure::Options::Instance().GetDiskCacheDirectory() + "test_page1";
-  Page p1(0, len, str, file1);
+  Page p1(0, len, str, make_shared<DiskFile>(file1));
 
   array<char, len> arrNew1{'4', '5', '6'};
   p1.Refresh(&arrNew1[0]);
@@ -259,6 +440,35 @@ TEST_F(PageTest, Resize) { TestResize(); }
 // --------------------------------------------------------------------------
 TEST_F(PageTest, ResizeDiskFile) { TestResizeDiskFile(); }
 
+// --------------------------------------------------------------------------
+TEST_F(PageTest, ShareDiskFile) { TestShareDiskFile(); }
+
+// --------------------------------------------------------------------------
+TEST_F(PageTest, Compress) { TestCompress(); }
+
+// --------------------------------------------------------------------------
+TEST_F(PageTest, DemotePromote) { TestDemotePromote(); }
+
+// --------------------------------------------------------------------------
+TEST_F(PageTest, Hole) { TestHole(); }
+
+// --------------------------------------------------------------------------
+TEST_F(PageTest, BatchReadByThreadPool) {
+  ThreadPoolDiskIOEngine engine(2);
+  TestBatchRead(&engine, false);
+  TestBatchRead(&engine, true);
+}
+
+// --------------------------------------------------------------------------
+TEST_F(PageTest, BatchReadByIoUring) {
+  if (!IoUringDiskIOEngine::IsSupported()) {
+    return;  // kernel not support io_uring
+  }
+  IoUringDiskIOEngine engine(4);
+  TestBatchRead(&engine, false);
+  TestBatchRead(&engine, true);
+}
+
 }  // namespace Data
 }  // namespace QS
 
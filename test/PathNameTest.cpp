@@ -0,0 +1,105 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "data/PathName.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::string;
+using ::testing::Test;
+
+class PathNameTest : public Test {
+ protected:
+  void TestDefault() {
+    PathName empty;
+    EXPECT_TRUE(empty.IsEmpty());
+    EXPECT_EQ(empty.ToString(), "");
+    EXPECT_EQ(empty.GetName(), "");
+    EXPECT_TRUE(empty.GetParent().IsEmpty());
+    EXPECT_TRUE(PathName("").IsEmpty());
+    EXPECT_EQ(empty, PathName::Find(""));
+  }
+
+  void TestIntern() {
+    auto count = PathName::GetComponentCount();
+    {
+      PathName file("/dir/subdir/file");
+      EXPECT_EQ(file.ToString(), "/dir/subdir/file");
+      EXPECT_EQ(file.GetName(), "file");
+      EXPECT_EQ(PathName::GetComponentCount(), count + 4);
+
+      // equal paths share the components
+      EXPECT_EQ(PathName("/dir/subdir/file"), file);
+      EXPECT_EQ(PathName::Find("/dir/subdir/file"), file);
+      EXPECT_EQ(PathName("/dir/subdir/file").Hash(), file.Hash());
+      EXPECT_NE(PathName("/dir/subdir/file/"), file);
+      EXPECT_NE(PathName("/dir/file"), file);
+
+      auto dir = file.GetParent();
+      EXPECT_EQ(dir.ToString(), "/dir/subdir/");
+      EXPECT_EQ(dir.GetName(), "subdir/");
+      EXPECT_EQ(dir, PathName::Find("/dir/subdir/"));
+      EXPECT_EQ(dir.GetParent().GetParent().ToString(), "/");
+      EXPECT_TRUE(dir.GetParent().GetParent().GetParent().IsEmpty());
+
+      // siblings share the dir components
+      PathName file2("/dir/subdir/file2");
+      EXPECT_EQ(file2.GetParent(), dir);
+      EXPECT_EQ(PathName::GetComponentCount(), count + 5);
+
+      // relative name has no parent
+      PathName name("file");
+      EXPECT_EQ(name.ToString(), "file");
+      EXPECT_TRUE(name.GetParent().IsEmpty());
+      EXPECT_NE(name, file);
+    }
+    // released with the last path name
+    EXPECT_EQ(PathName::GetComponentCount(), count);
+    EXPECT_TRUE(PathName::Find("/dir/subdir/file").IsEmpty());
+    EXPECT_TRUE(PathName::Find("/dir/").IsEmpty());
+  }
+
+  void TestFind() {
+    PathName file("/dir/file");
+    auto count = PathName::GetComponentCount();
+    EXPECT_TRUE(PathName::Find("/dir/file2").IsEmpty());
+    EXPECT_TRUE(PathName::Find("/other/file").IsEmpty());
+    EXPECT_EQ(PathName::GetComponentCount(), count);
+    EXPECT_EQ(PathName::Find("/dir/").ToString(), "/dir/");
+  }
+};
+
+TEST_F(PathNameTest, Default) { TestDefault(); }
+
+TEST_F(PathNameTest, Intern) { TestIntern(); }
+
+TEST_F(PathNameTest, Find) { TestFind(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}
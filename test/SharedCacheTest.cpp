@@ -0,0 +1,188 @@
+// +-------------------------------------------------------------------------
+// | Copyright (C) 2017 Yunify, Inc.
+// +-------------------------------------------------------------------------
+// | Licensed under the Apache License, Version 2.0 (the "License");
+// | You may not use this work except in compliance with the License.
+// | You may obtain a copy of the License in the LICENSE file, or at:
+// |
+// | http://www.apache.org/licenses/LICENSE-2.0
+// |
+// | Unless required by applicable law or agreed to in writing, software
+// | distributed under the License is distributed on an "AS IS" BASIS,
+// | WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// | See the License for the specific language governing permissions and
+// | limitations under the License.
+// +-------------------------------------------------------------------------
+
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <dirent.h>  // for opendir readdir
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "base/Logging.h"
+#include "base/Utils.h"
+#include "data/SharedCache.h"
+
+namespace QS {
+
+namespace Data {
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using ::testing::Test;
+
+// default log dir
+static const char *defaultLogDir = "/tmp/qsfs.test.logs/";
+// shared cache dir
+static const char *sharedDir = "/tmp/qsfs.test.shared/";
+void InitLog() {
+  QS::Utils::CreateDirectoryIfNotExistsNoLog(defaultLogDir);
+  QS::Logging::InitializeLogging(
+      unique_ptr<QS::Logging::Log>(new QS::Logging::DefaultLog(defaultLogDir)));
+  EXPECT_TRUE(QS::Logging::GetLogInstance() != nullptr)
+      << "log instance is null";
+}
+
+SharedCache::ContentReader MakeReader(const string &content) {
+  return [content](off_t offset, size_t len, char *buf) {
+    return content.copy(buf, len, offset);
+  };
+}
+
+class SharedCacheTest : public Test {
+ protected:
+  static void SetUpTestCase() { InitLog(); }
+
+  void SetUp() override {
+    QS::Utils::DeleteFilesInDirectoryNoLog(sharedDir, true);
+  }
+
+  void TestStoreAndRead() {
+    // two mounts of the same bucket on the host
+    SharedCache cache1(sharedDir, "bucket", 1024);
+    SharedCache cache2(sharedDir, "bucket", 1024);
+    string content = "0123456789";
+    EXPECT_FALSE(cache2.Has("/a", "etag1", content.size()));
+    EXPECT_TRUE(cache1.Store("/a", "etag1", content.size(),
+                             MakeReader(content)));
+    EXPECT_TRUE(cache2.Has("/a", "etag1", content.size()));
+    EXPECT_EQ(cache2.GetSize(), content.size());
+
+    vector<char> buf(content.size());
+    EXPECT_EQ(cache2.Read("/a", "etag1", content.size(), 2, 5, &buf[0]), 5u);
+    EXPECT_EQ(string(&buf[0], 5), "23456");
+    // out of range
+    EXPECT_EQ(cache2.Read("/a", "etag1", content.size(), 8, 5, &buf[0]), 0u);
+
+    // object is keyed by bucket, key, etag and size
+    EXPECT_FALSE(cache2.Has("/a", "etag2", content.size()));
+    EXPECT_FALSE(cache2.Has("/a", "etag1", content.size() + 1));
+    EXPECT_FALSE(cache2.Has("/b", "etag1", content.size()));
+    SharedCache cache3(sharedDir, "bucket2", 1024);
+    EXPECT_FALSE(cache3.Has("/a", "etag1", content.size()));
+    EXPECT_EQ(cache3.Read("/a", "etag1", content.size(), 0, 5, &buf[0]), 0u);
+
+    // object without etag or with partial content is not stored
+    EXPECT_FALSE(cache1.Store("/b", "", content.size(), MakeReader(content)));
+    EXPECT_FALSE(cache1.Store("/b", "etag1", content.size() + 1,
+                              MakeReader(content)));
+    EXPECT_FALSE(cache1.Has("/b", "etag1", content.size() + 1));
+    EXPECT_EQ(cache1.GetSize(), content.size());
+  }
+
+  void TestEvict() {
+    SharedCache cache(sharedDir, "bucket", 20);
+    string content1(10, 'a');
+    string content2(10, 'b');
+    string content3(10, 'c');
+    EXPECT_TRUE(cache.Store("/a", "etag", 10, MakeReader(content1)));
+    EXPECT_TRUE(cache.Store("/b", "etag", 10, MakeReader(content2)));
+    // make "/a" least recently used
+    vector<char> buf(10);
+    struct utimbuf times = {1, 1};
+    for (auto &name : ReadDirectory()) {
+      utime((string(sharedDir) + name).c_str(), &times);
+    }
+    EXPECT_EQ(cache.Read("/b", "etag", 10, 0, 10, &buf[0]), 10u);
+
+    EXPECT_TRUE(cache.Store("/c", "etag", 10, MakeReader(content3)));
+    EXPECT_FALSE(cache.Has("/a", "etag", 10));
+    EXPECT_TRUE(cache.Has("/b", "etag", 10));
+    EXPECT_TRUE(cache.Has("/c", "etag", 10));
+    EXPECT_EQ(cache.GetSize(), 20u);
+    EXPECT_FALSE(cache.Store("/d", "etag", 30, MakeReader(string(30, 'd'))));
+  }
+
+  void TestStoreConcurrently() {
+    SharedCache cache(sharedDir, "bucket", 20);
+    string content(10, 'a');
+    // the lock file is not held while copying the content, and the space
+    // of the object being stored is reserved
+    bool called = false;
+    auto reader = [&](off_t offset, size_t len, char *buf) {
+      if (!called) {
+        called = true;
+        EXPECT_FALSE(cache.Store("/a", "etag", 10, MakeReader(content)));
+        EXPECT_FALSE(
+            cache.Store("/b", "etag", 15, MakeReader(string(15, 'b'))));
+        EXPECT_TRUE(cache.Store("/c", "etag", 10, MakeReader(content)));
+      }
+      return content.copy(buf, len, offset);
+    };
+    EXPECT_TRUE(cache.Store("/a", "etag", 10, reader));
+    EXPECT_TRUE(called);
+    EXPECT_TRUE(cache.Has("/a", "etag", 10));
+    EXPECT_TRUE(cache.Has("/c", "etag", 10));
+    EXPECT_FALSE(cache.Has("/b", "etag", 15));
+
+    // temporary file left by a crashed process is removed
+    SharedCache cache2(sharedDir, "bucket", 30);
+    auto tmpPath = string(sharedDir) + "crashed.tmp";
+    FILE *file = fopen(tmpPath.c_str(), "w");
+    ASSERT_TRUE(file != nullptr);
+    fputs("0123456789", file);
+    fclose(file);
+    EXPECT_TRUE(cache2.Store("/d", "etag", 10, MakeReader(content)));
+    EXPECT_FALSE(QS::Utils::FileExists(tmpPath, false));
+    EXPECT_EQ(cache2.GetSize(), 30u);
+  }
+
+  vector<string> ReadDirectory() {
+    vector<string> names;
+    unique_ptr<DIR, decltype(&closedir)> dir(opendir(sharedDir), &closedir);
+    struct dirent *entry = nullptr;
+    while (dir && (entry = readdir(dir.get())) != nullptr) {
+      string name(entry->d_name);
+      if (name.front() != '.') {
+        names.push_back(name);
+      }
+    }
+    return names;
+  }
+};
+
+TEST_F(SharedCacheTest, StoreAndRead) { TestStoreAndRead(); }
+
+TEST_F(SharedCacheTest, Evict) { TestEvict(); }
+
+TEST_F(SharedCacheTest, StoreConcurrently) { TestStoreConcurrently(); }
+
+}  // namespace Data
+}  // namespace QS
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  int code = RUN_ALL_TESTS();
+  return code;
+}